@@ -22,10 +22,20 @@ project "VulkanTestbed"
 		"%{IncludeDir.glm}/util/glm.natvis",
 	}
 
+	-- Entry point of VulkanTestbedBench
+	removefiles
+	{
+		"src/Benchmark/BenchMain.cpp"
+	}
+
 	defines
 	{
 		"_CRT_SECURE_NO_WARNINGS",
-		"GLFW_INCLUDE_NONE"
+		"GLFW_INCLUDE_NONE",
+		-- Every translation unit has to see the same GLM configuration
+		"GLM_FORCE_RADIANS",
+		"GLM_FORCE_DEPTH_ZERO_TO_ONE",
+		"GLM_FORCE_INTRINSICS"
 	}
 
 	includedirs
@@ -41,37 +51,132 @@ project "VulkanTestbed"
 
 	links
 	{
-		"GLFW",
-
-		"%{Lib.vulkan}"
+		"GLFW"
 	}
 
 	filter "system:windows"
 		systemversion "latest"
+		links
+		{
+			"%{Lib.vulkan}"
+		}
+		postbuildcommands
+		{
+			'{COPY} "%{Lib.vulkan}" "%{cfg.targetdir}"'
+		}
+
+	filter "system:linux"
+		links
+		{
+			"vulkan",
+			"pthread",
+			"dl"
+		}
+
+	filter "options:avx2"
+		vectorextensions "AVX2"
 
 	filter "configurations:Debug"
 		defines "TESTBED_DEBUG"
 		runtime "Debug"
 		symbols "on"
-		postbuildcommands
-		{
-			'{COPY} "%{Lib.vulkan}" "%{cfg.targetdir}"'
-		}
 
 	filter "configurations:Release"
 		defines "TESTBED_RELEASE"
 		runtime "Release"
 		optimize "speed"
-		postbuildcommands
-		{
-			'{COPY} "%{Lib.vulkan}" "%{cfg.targetdir}"'
-		}
 
 	filter "configurations:Dist"
 		defines "TESTBED_DIST"
 		runtime "Release"
 		optimize "speed"
-		postbuildcommands
+
+-- CPU side benchmarks only, nothing in here calls into Vulkan or GLFW so it runs on machines without a GPU
+project "VulkanTestbedBench"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++17"
+	staticruntime "on"
+
+	targetdir ("%{wks.location}/bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("%{wks.location}/bin-int/" .. outputdir .. "/%{prj.name}")
+
+	pchheader "pch.h"
+	pchsource "src/pch.cpp"
+
+	files
+	{
+		"src/pch.h",
+		"src/pch.cpp",
+		"src/Asset/**.h",
+		"src/Asset/**.cpp",
+		"src/Benchmark/**.h",
+		"src/Benchmark/**.cpp",
+		"src/Core/**.h",
+		"src/Core/**.cpp",
+		"src/Scene/**.h",
+		"src/Scene/**.cpp",
+		"src/DeviceAllocator.h",
+		"src/DeviceAllocator.cpp",
+		"src/RenderQueue.h",
+		"src/RenderQueue.cpp",
+		"vendor/stb_image/**.h",
+		"vendor/stb_image/**.cpp",
+		"vendor/glm/glm/**.hpp",
+		"vendor/glm/glm/**.inl",
+	}
+
+	removefiles
+	{
+		"src/Core/Application.h",
+		"src/Core/Application.cpp",
+		"src/Core/Main.cpp",
+		"src/Benchmark/CommandRecordingBenchmark.cpp",
+		"src/Benchmark/RenderGraphBenchmark.cpp"
+	}
+
+	defines
+	{
+		"_CRT_SECURE_NO_WARNINGS",
+		"GLM_FORCE_RADIANS",
+		"GLM_FORCE_DEPTH_ZERO_TO_ONE",
+		"GLM_FORCE_INTRINSICS"
+	}
+
+	-- Vulkan headers for the handle and struct types, nothing is linked
+	includedirs
+	{
+		"src",
+		"vendor/spdlog/include",
+		"%{IncludeDir.glm}",
+		"%{IncludeDir.stb_image}",
+		"%{IncludeDir.tinyobj}",
+		"%{IncludeDir.vulkan}",
+	}
+
+	filter "system:windows"
+		systemversion "latest"
+
+	filter "system:linux"
+		links
 		{
-			'{COPY} "%{Lib.vulkan}" "%{cfg.targetdir}"'
+			"pthread"
 		}
+
+	filter "options:avx2"
+		vectorextensions "AVX2"
+
+	filter "configurations:Debug"
+		defines "TESTBED_DEBUG"
+		runtime "Debug"
+		symbols "on"
+
+	filter "configurations:Release"
+		defines "TESTBED_RELEASE"
+		runtime "Release"
+		optimize "speed"
+
+	filter "configurations:Dist"
+		defines "TESTBED_DIST"
+		runtime "Release"
+		optimize "speed"
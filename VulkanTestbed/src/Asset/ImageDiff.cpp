@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "ImageDiff.h"
+
+#include "Core/Simd.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t BytesPerPixel = 4;
+
+	// Set bits in a 4-bit mask
+	static constexpr uint8_t NibbleBitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+	static uint32_t PixelDifference(const uint8_t* a, const uint8_t* b)
+	{
+		uint32_t difference = 0;
+		for (uint32_t channel = 0; channel < BytesPerPixel; ++channel)
+			difference = std::max(difference, (uint32_t)std::abs((int)a[channel] - (int)b[channel]));
+		return difference;
+	}
+
+	ImageDiffResult ImageDiff::CompareScalar(const uint8_t* rgba, const uint8_t* reference, uint64_t pixelCount, uint8_t tolerance)
+	{
+		ImageDiffResult result;
+		result.Pixels = pixelCount;
+		for (uint64_t pixel = 0; pixel < pixelCount; ++pixel)
+		{
+			const uint32_t difference = PixelDifference(rgba + pixel * BytesPerPixel, reference + pixel * BytesPerPixel);
+			result.MismatchedPixels += difference > tolerance;
+			result.MaxDifference = std::max(result.MaxDifference, difference);
+		}
+		return result;
+	}
+
+	ImageDiffResult ImageDiff::Compare(const uint8_t* rgba, const uint8_t* reference, uint64_t pixelCount, uint8_t tolerance)
+	{
+		ImageDiffResult result;
+		result.Pixels = pixelCount;
+		uint64_t pixel = 0;
+
+#if defined(TESTBED_AVX2)
+		// Saturating subtraction both ways gives the absolute difference, whatever is left after subtracting the
+		// tolerance marks a mismatched channel
+		const __m256i toleranceWide = _mm256_set1_epi8((char)tolerance);
+		__m256i maxDifferenceWide = _mm256_setzero_si256();
+		for (; pixel + 8 <= pixelCount; pixel += 8)
+		{
+			const __m256i a = _mm256_loadu_si256((const __m256i*)(rgba + pixel * BytesPerPixel));
+			const __m256i b = _mm256_loadu_si256((const __m256i*)(reference + pixel * BytesPerPixel));
+			const __m256i difference = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+			maxDifferenceWide = _mm256_max_epu8(maxDifferenceWide, difference);
+			const __m256i within = _mm256_cmpeq_epi32(_mm256_subs_epu8(difference, toleranceWide), _mm256_setzero_si256());
+			const uint32_t mismatched = ~(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(within)) & 0xFF;
+			result.MismatchedPixels += NibbleBitCount[mismatched & 0xF] + NibbleBitCount[mismatched >> 4];
+		}
+		alignas(32) uint8_t maxDifferences[32];
+		_mm256_store_si256((__m256i*)maxDifferences, maxDifferenceWide);
+		for (uint8_t difference : maxDifferences)
+			result.MaxDifference = std::max<uint32_t>(result.MaxDifference, difference);
+#elif defined(TESTBED_SSE2)
+		const __m128i toleranceWide = _mm_set1_epi8((char)tolerance);
+		__m128i maxDifferenceWide = _mm_setzero_si128();
+		for (; pixel + 4 <= pixelCount; pixel += 4)
+		{
+			const __m128i a = _mm_loadu_si128((const __m128i*)(rgba + pixel * BytesPerPixel));
+			const __m128i b = _mm_loadu_si128((const __m128i*)(reference + pixel * BytesPerPixel));
+			const __m128i difference = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+			maxDifferenceWide = _mm_max_epu8(maxDifferenceWide, difference);
+			const __m128i within = _mm_cmpeq_epi32(_mm_subs_epu8(difference, toleranceWide), _mm_setzero_si128());
+			result.MismatchedPixels += NibbleBitCount[~(uint32_t)_mm_movemask_ps(_mm_castsi128_ps(within)) & 0xF];
+		}
+		alignas(16) uint8_t maxDifferences[16];
+		_mm_store_si128((__m128i*)maxDifferences, maxDifferenceWide);
+		for (uint8_t difference : maxDifferences)
+			result.MaxDifference = std::max<uint32_t>(result.MaxDifference, difference);
+#endif
+
+		const ImageDiffResult tail = CompareScalar(rgba + pixel * BytesPerPixel, reference + pixel * BytesPerPixel, pixelCount - pixel, tolerance);
+		result.MismatchedPixels += tail.MismatchedPixels;
+		result.MaxDifference = std::max(result.MaxDifference, tail.MaxDifference);
+		return result;
+	}
+
+	void ImageDiff::BuildDiffImage(const uint8_t* rgba, const uint8_t* reference, uint64_t pixelCount, uint8_t tolerance, uint8_t* outRGBA)
+	{
+		for (uint64_t pixel = 0; pixel < pixelCount; ++pixel)
+		{
+			const uint8_t* a = rgba + pixel * BytesPerPixel;
+			const uint8_t* b = reference + pixel * BytesPerPixel;
+			uint8_t* out = outRGBA + pixel * BytesPerPixel;
+			if (PixelDifference(a, b) > tolerance)
+			{
+				out[0] = 255;
+				out[1] = 0;
+				out[2] = 0;
+			}
+			else
+			{
+				const uint8_t gray = (uint8_t)(((uint32_t)b[0] * 77 + (uint32_t)b[1] * 150 + (uint32_t)b[2] * 29) >> 10);
+				out[0] = gray;
+				out[1] = gray;
+				out[2] = gray;
+			}
+			out[3] = 255;
+		}
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+namespace VulkanTestbed
+{
+	struct ImageDiffResult
+	{
+		uint64_t Pixels = 0;
+		// Pixels with at least one channel further off than the tolerance
+		uint64_t MismatchedPixels = 0;
+		// Largest difference of any channel of any pixel
+		uint32_t MaxDifference = 0;
+
+		double GetMismatchRatio() const { return Pixels > 0 ? (double)MismatchedPixels / (double)Pixels : 0.0; }
+	};
+
+	// Per pixel comparison of RGBA8 images against golden references. Rasterization rules leave drivers some
+	// freedom, so channels may differ by the tolerance without counting as a mismatch.
+	class ImageDiff
+	{
+	public:
+		// 8 pixels per step with AVX2, 4 with SSE2
+		static ImageDiffResult Compare(const uint8_t* rgba, const uint8_t* reference, uint64_t pixelCount, uint8_t tolerance);
+		static ImageDiffResult CompareScalar(const uint8_t* rgba, const uint8_t* reference, uint64_t pixelCount, uint8_t tolerance);
+
+		// Mismatched pixels in red over a darkened grayscale of the reference, for looking at failures
+		static void BuildDiffImage(const uint8_t* rgba, const uint8_t* reference, uint64_t pixelCount, uint8_t tolerance, uint8_t* outRGBA);
+	};
+}
@@ -0,0 +1,419 @@
+#include "pch.h"
+#include "ImageWriter.h"
+
+#include <cstring>
+#include <fstream>
+
+#include <glm/gtc/packing.hpp>
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t BytesPerPixel = 4;
+
+	// Deflate back-references reach 32 KiB back and copy 3 to 258 bytes
+	static constexpr uint32_t WindowSize = 32768;
+	static constexpr uint32_t MinMatch = 3;
+	static constexpr uint32_t MaxMatch = 258;
+	static constexpr uint32_t HashBits = 15;
+	// Candidates tried per position, past this the match rarely gets longer for rendered images
+	static constexpr uint32_t MaxChain = 16;
+
+	static constexpr uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static constexpr uint8_t LengthExtraBits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static constexpr uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static constexpr uint8_t DistanceExtraBits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// Deflate packs bits starting at the least significant one, Huffman codes most significant bit first
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(std::vector<uint8_t>& out)
+			: m_Out(out) {}
+
+		void Write(uint32_t bits, uint32_t count)
+		{
+			m_Bits |= (uint64_t)bits << m_Count;
+			m_Count += count;
+			while (m_Count >= 8)
+			{
+				m_Out.push_back((uint8_t)m_Bits);
+				m_Bits >>= 8;
+				m_Count -= 8;
+			}
+		}
+
+		void WriteCode(uint32_t code, uint32_t length)
+		{
+			uint32_t reversed = 0;
+			for (uint32_t i = 0; i < length; ++i)
+				reversed |= ((code >> i) & 1) << (length - 1 - i);
+			Write(reversed, length);
+		}
+
+		void Finish()
+		{
+			if (m_Count > 0)
+				m_Out.push_back((uint8_t)m_Bits);
+			m_Bits = 0;
+			m_Count = 0;
+		}
+
+	private:
+		std::vector<uint8_t>& m_Out;
+		uint64_t m_Bits = 0;
+		uint32_t m_Count = 0;
+	};
+
+	// The fixed literal/length code of RFC 1951 3.2.6
+	static void WriteFixedSymbol(BitWriter& writer, uint32_t symbol)
+	{
+		if (symbol < 144)
+			writer.WriteCode(0x30 + symbol, 8);
+		else if (symbol < 256)
+			writer.WriteCode(0x190 + symbol - 144, 9);
+		else if (symbol < 280)
+			writer.WriteCode(symbol - 256, 7);
+		else
+			writer.WriteCode(0xC0 + symbol - 280, 8);
+	}
+
+	static void WriteMatch(BitWriter& writer, uint32_t length, uint32_t distance)
+	{
+		const uint32_t lengthCode = (uint32_t)(std::upper_bound(std::begin(LengthBase), std::end(LengthBase), length) - std::begin(LengthBase)) - 1;
+		WriteFixedSymbol(writer, 257 + lengthCode);
+		writer.Write(length - LengthBase[lengthCode], LengthExtraBits[lengthCode]);
+
+		const uint32_t distanceCode = (uint32_t)(std::upper_bound(std::begin(DistanceBase), std::end(DistanceBase), distance) - std::begin(DistanceBase)) - 1;
+		writer.WriteCode(distanceCode, 5);
+		writer.Write(distance - DistanceBase[distanceCode], DistanceExtraBits[distanceCode]);
+	}
+
+	static uint32_t HashPosition(const uint8_t* data)
+	{
+		const uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16);
+		return (value * 2654435761u) >> (32 - HashBits);
+	}
+
+	// One fixed Huffman block with greedy hash chain matching
+	static void Deflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+	{
+		BitWriter writer(out);
+		writer.Write(1, 1);
+		writer.Write(1, 2);
+
+		std::vector<int32_t> head((size_t)1 << HashBits, -1);
+		std::vector<int32_t> previous(WindowSize, -1);
+		const auto insert = [&](size_t position)
+		{
+			const uint32_t hash = HashPosition(data + position);
+			previous[position & (WindowSize - 1)] = head[hash];
+			head[hash] = (int32_t)position;
+		};
+
+		size_t position = 0;
+		while (position < size)
+		{
+			uint32_t bestLength = 0;
+			uint32_t bestDistance = 0;
+			if (position + MinMatch <= size)
+			{
+				const uint32_t maxLength = (uint32_t)std::min<size_t>(MaxMatch, size - position);
+				int32_t candidate = head[HashPosition(data + position)];
+				for (uint32_t chain = 0; chain < MaxChain && candidate >= 0 && position - (size_t)candidate <= WindowSize; ++chain)
+				{
+					const uint8_t* match = data + candidate;
+					const uint8_t* current = data + position;
+					uint32_t length = 0;
+					while (length < maxLength && match[length] == current[length])
+						++length;
+					if (length > bestLength)
+					{
+						bestLength = length;
+						bestDistance = (uint32_t)(position - (size_t)candidate);
+						if (length == maxLength)
+							break;
+					}
+
+					// Slots are reused once the window moves past them, which also breaks the chain
+					const int32_t next = previous[candidate & (WindowSize - 1)];
+					if (next >= candidate)
+						break;
+					candidate = next;
+				}
+			}
+
+			if (bestLength >= MinMatch)
+			{
+				WriteMatch(writer, bestLength, bestDistance);
+				for (size_t end = position + bestLength; position < end; ++position)
+				{
+					if (position + MinMatch <= size)
+						insert(position);
+				}
+			}
+			else
+			{
+				WriteFixedSymbol(writer, data[position]);
+				if (position + MinMatch <= size)
+					insert(position);
+				++position;
+			}
+		}
+
+		WriteFixedSymbol(writer, 256);
+		writer.Finish();
+	}
+
+	static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+	{
+		static const std::array<uint32_t, 256> table = []()
+		{
+			std::array<uint32_t, 256> result;
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t value = i;
+				for (int bit = 0; bit < 8; ++bit)
+					value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+				result[i] = value;
+			}
+			return result;
+		}();
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	static uint32_t Adler32(const uint8_t* data, size_t size)
+	{
+		// 5552 bytes is the most that can be summed before the 32-bit sums have to be reduced
+		uint32_t a = 1;
+		uint32_t b = 0;
+		while (size > 0)
+		{
+			const size_t blockSize = std::min<size_t>(size, 5552);
+			for (size_t i = 0; i < blockSize; ++i)
+			{
+				a += data[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			data += blockSize;
+			size -= blockSize;
+		}
+		return (b << 16) | a;
+	}
+
+	static void AppendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back((uint8_t)(value >> 24));
+		out.push_back((uint8_t)(value >> 16));
+		out.push_back((uint8_t)(value >> 8));
+		out.push_back((uint8_t)value);
+	}
+
+	template<typename T>
+	static void AppendLittleEndian(std::vector<uint8_t>& out, T value)
+	{
+		uint8_t bytes[sizeof(T)];
+		memcpy(bytes, &value, sizeof(T));
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	static void AppendChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+	{
+		AppendBigEndian(out, (uint32_t)size);
+		const size_t typeOffset = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data, data + size);
+		AppendBigEndian(out, Crc32(out.data() + typeOffset, size + 4));
+	}
+
+	static uint8_t Paeth(uint8_t left, uint8_t up, uint8_t upLeft)
+	{
+		const int estimate = (int)left + (int)up - (int)upLeft;
+		const int distanceLeft = std::abs(estimate - (int)left);
+		const int distanceUp = std::abs(estimate - (int)up);
+		const int distanceUpLeft = std::abs(estimate - (int)upLeft);
+		if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft)
+			return left;
+		return distanceUp <= distanceUpLeft ? up : upLeft;
+	}
+
+	// Every row gets the filter whose output has the smallest sum of absolute signed bytes
+	static void FilterRows(uint32_t width, uint32_t height, const uint8_t* rgba, std::vector<uint8_t>& outFiltered)
+	{
+		const size_t rowSize = (size_t)width * BytesPerPixel;
+		outFiltered.resize((rowSize + 1) * height);
+		std::vector<uint8_t> candidates[5];
+		for (std::vector<uint8_t>& candidate : candidates)
+			candidate.resize(rowSize);
+		const std::vector<uint8_t> zeroRow(rowSize, 0);
+
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			const uint8_t* row = rgba + y * rowSize;
+			const uint8_t* up = y > 0 ? row - rowSize : zeroRow.data();
+			for (size_t i = 0; i < rowSize; ++i)
+			{
+				const uint8_t left = i >= BytesPerPixel ? row[i - BytesPerPixel] : 0;
+				const uint8_t upLeft = i >= BytesPerPixel ? up[i - BytesPerPixel] : 0;
+				candidates[0][i] = row[i];
+				candidates[1][i] = (uint8_t)(row[i] - left);
+				candidates[2][i] = (uint8_t)(row[i] - up[i]);
+				candidates[3][i] = (uint8_t)(row[i] - (uint8_t)(((uint32_t)left + up[i]) / 2));
+				candidates[4][i] = (uint8_t)(row[i] - Paeth(left, up[i], upLeft));
+			}
+
+			uint32_t bestFilter = 0;
+			uint64_t bestCost = ~0ull;
+			for (uint32_t filter = 0; filter < 5; ++filter)
+			{
+				uint64_t cost = 0;
+				for (uint8_t value : candidates[filter])
+					cost += (uint64_t)std::abs((int)(int8_t)value);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestFilter = filter;
+				}
+			}
+
+			uint8_t* out = outFiltered.data() + y * (rowSize + 1);
+			out[0] = (uint8_t)bestFilter;
+			memcpy(out + 1, candidates[bestFilter].data(), rowSize);
+		}
+	}
+
+	void ImageWriter::EncodePNG(uint32_t width, uint32_t height, const uint8_t* rgba, std::vector<uint8_t>& outFile)
+	{
+		std::vector<uint8_t> filtered;
+		FilterRows(width, height, rgba, filtered);
+
+		// zlib stream: deflate with a 32 KiB window, no dictionary, then the Adler-32 of the uncompressed data
+		std::vector<uint8_t> compressed = { 0x78, 0x01 };
+		compressed.reserve(filtered.size() / 4 + 64);
+		Deflate(filtered.data(), filtered.size(), compressed);
+		AppendBigEndian(compressed, Adler32(filtered.data(), filtered.size()));
+
+		// 8 bits per channel, RGBA, no interlacing
+		std::vector<uint8_t> header;
+		AppendBigEndian(header, width);
+		AppendBigEndian(header, height);
+		header.insert(header.end(), { 8, 6, 0, 0, 0 });
+
+		static constexpr uint8_t Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		outFile.assign(std::begin(Signature), std::end(Signature));
+		AppendChunk(outFile, "IHDR", header.data(), header.size());
+		AppendChunk(outFile, "IDAT", compressed.data(), compressed.size());
+		AppendChunk(outFile, "IEND", nullptr, 0);
+	}
+
+	static void AppendAttribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value)
+	{
+		out.insert(out.end(), name, name + strlen(name) + 1);
+		out.insert(out.end(), type, type + strlen(type) + 1);
+		AppendLittleEndian(out, (int32_t)value.size());
+		out.insert(out.end(), value.begin(), value.end());
+	}
+
+	void ImageWriter::EncodeEXR(uint32_t width, uint32_t height, const float* rgba, std::vector<uint8_t>& outFile)
+	{
+		// Channels have to be listed in alphabetical order, scanlines store them one after the other in that order
+		static constexpr char ChannelNames[4] = { 'A', 'B', 'G', 'R' };
+		static constexpr uint32_t ChannelSources[4] = { 3, 2, 1, 0 };
+
+		outFile.clear();
+		AppendLittleEndian(outFile, (uint32_t)20000630);
+		// Version 2, single part scanline file
+		AppendLittleEndian(outFile, (uint32_t)2);
+
+		std::vector<uint8_t> channels;
+		for (char name : ChannelNames)
+		{
+			channels.push_back((uint8_t)name);
+			channels.push_back(0);
+			// HALF, not linear, three reserved bytes and 1x1 sampling
+			AppendLittleEndian(channels, (int32_t)1);
+			channels.insert(channels.end(), { 0, 0, 0, 0 });
+			AppendLittleEndian(channels, (int32_t)1);
+			AppendLittleEndian(channels, (int32_t)1);
+		}
+		channels.push_back(0);
+		AppendAttribute(outFile, "channels", "chlist", channels);
+		AppendAttribute(outFile, "compression", "compression", { 0 });
+
+		std::vector<uint8_t> window;
+		AppendLittleEndian(window, (int32_t)0);
+		AppendLittleEndian(window, (int32_t)0);
+		AppendLittleEndian(window, (int32_t)width - 1);
+		AppendLittleEndian(window, (int32_t)height - 1);
+		AppendAttribute(outFile, "dataWindow", "box2i", window);
+		AppendAttribute(outFile, "displayWindow", "box2i", window);
+		AppendAttribute(outFile, "lineOrder", "lineOrder", { 0 });
+
+		std::vector<uint8_t> value;
+		AppendLittleEndian(value, 1.0f);
+		AppendAttribute(outFile, "pixelAspectRatio", "float", value);
+		value.clear();
+		AppendLittleEndian(value, 0.0f);
+		AppendLittleEndian(value, 0.0f);
+		AppendAttribute(outFile, "screenWindowCenter", "v2f", value);
+		value.clear();
+		AppendLittleEndian(value, 1.0f);
+		AppendAttribute(outFile, "screenWindowWidth", "float", value);
+		outFile.push_back(0);
+
+		// Uncompressed files store one scanline per block, the offset table points at each of them
+		const uint32_t lineSize = width * 4 * sizeof(uint16_t);
+		const uint64_t firstLine = outFile.size() + (uint64_t)height * sizeof(uint64_t);
+		for (uint32_t y = 0; y < height; ++y)
+			AppendLittleEndian(outFile, firstLine + (uint64_t)y * (lineSize + 8));
+
+		outFile.reserve(outFile.size() + (size_t)height * (lineSize + 8));
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			AppendLittleEndian(outFile, (int32_t)y);
+			AppendLittleEndian(outFile, (int32_t)lineSize);
+			const float* row = rgba + (size_t)y * width * 4;
+			for (uint32_t source : ChannelSources)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+					AppendLittleEndian(outFile, glm::packHalf1x16(row[x * 4 + source]));
+			}
+		}
+	}
+
+	static bool WriteFile(const std::filesystem::path& path, const std::vector<uint8_t>& data)
+	{
+		const std::filesystem::path tempPath = std::filesystem::path(path).concat(".tmp");
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write((const char*)data.data(), (std::streamsize)data.size());
+		file.close();
+		if (!file)
+			return false;
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, path, error);
+		return !error;
+	}
+
+	bool ImageWriter::WritePNG(const std::filesystem::path& path, uint32_t width, uint32_t height, const uint8_t* rgba)
+	{
+		std::vector<uint8_t> file;
+		EncodePNG(width, height, rgba, file);
+		return WriteFile(path, file);
+	}
+
+	bool ImageWriter::WriteEXR(const std::filesystem::path& path, uint32_t width, uint32_t height, const float* rgba)
+	{
+		std::vector<uint8_t> file;
+		EncodeEXR(width, height, rgba, file);
+		return WriteFile(path, file);
+	}
+}
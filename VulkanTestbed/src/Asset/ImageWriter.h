@@ -0,0 +1,29 @@
+#pragma once
+
+#include <filesystem>
+
+namespace VulkanTestbed
+{
+	enum class ImageFileFormat : uint8_t
+	{
+		// RGBA8, lossless
+		PNG = 0,
+		// RGBA half floats, uncompressed scanlines
+		EXR
+	};
+
+	class ImageWriter
+	{
+	public:
+		// Rows top to bottom, tightly packed. Safe to call from several threads at once.
+		static bool WritePNG(const std::filesystem::path& path, uint32_t width, uint32_t height, const uint8_t* rgba);
+		static bool WriteEXR(const std::filesystem::path& path, uint32_t width, uint32_t height, const float* rgba);
+
+		// Whole PNG file in memory. Rows are filtered the way libpng's heuristic picks and compressed with fixed
+		// Huffman deflate, which is a fraction of the raw size for rendered frames without any tables to build.
+		static void EncodePNG(uint32_t width, uint32_t height, const uint8_t* rgba, std::vector<uint8_t>& outFile);
+		static void EncodeEXR(uint32_t width, uint32_t height, const float* rgba, std::vector<uint8_t>& outFile);
+
+		static const char* GetExtension(ImageFileFormat format) { return format == ImageFileFormat::EXR ? ".exr" : ".png"; }
+	};
+}
@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "Mesh.h"
+
+#include <glm/common.hpp>
+
+namespace VulkanTestbed
+{
+	void MeshData::SetIndices(const uint32_t* indices, uint32_t count)
+	{
+		IndexCount = count;
+		IndexFormat = Vertices.size() <= std::numeric_limits<uint16_t>::max() ? IndexType::UInt16 : IndexType::UInt32;
+
+		if (IndexFormat == IndexType::UInt16)
+		{
+			IndexBuffer.resize(count * sizeof(uint16_t));
+			uint16_t* dst = (uint16_t*)IndexBuffer.data();
+			for (uint32_t i = 0; i < count; ++i)
+				dst[i] = (uint16_t)indices[i];
+		}
+		else
+		{
+			IndexBuffer.resize(count * sizeof(uint32_t));
+			memcpy(IndexBuffer.data(), indices, count * sizeof(uint32_t));
+		}
+	}
+
+	void MeshData::GetIndices(std::vector<uint32_t>& outIndices) const
+	{
+		outIndices.resize(IndexCount);
+		if (IndexFormat == IndexType::UInt16)
+		{
+			const uint16_t* src = (const uint16_t*)IndexBuffer.data();
+			for (uint32_t i = 0; i < IndexCount; ++i)
+				outIndices[i] = src[i];
+		}
+		else
+		{
+			memcpy(outIndices.data(), IndexBuffer.data(), IndexCount * sizeof(uint32_t));
+		}
+	}
+
+	uint32_t MeshData::GetIndex(uint32_t i) const
+	{
+		TESTBED_ASSERT(i < IndexCount);
+		if (IndexFormat == IndexType::UInt16)
+			return ((const uint16_t*)IndexBuffer.data())[i];
+
+		return ((const uint32_t*)IndexBuffer.data())[i];
+	}
+
+	void MeshData::ComputeBounds()
+	{
+		if (Vertices.empty())
+		{
+			BoundsMin = BoundsMax = glm::vec3(0.0f);
+			return;
+		}
+
+		BoundsMin = BoundsMax = Vertices[0].Position;
+		for (const Vertex& vertex : Vertices)
+		{
+			BoundsMin = glm::min(BoundsMin, vertex.Position);
+			BoundsMax = glm::max(BoundsMax, vertex.Position);
+		}
+	}
+
+	MeshView MeshData::GetView() const
+	{
+		MeshView view;
+		view.Name = Name;
+		view.Vertices = Vertices.data();
+		view.VertexCount = (uint32_t)Vertices.size();
+		view.PackedVertices = PackedVertices.empty() ? nullptr : PackedVertices.data();
+		view.TexCoordOffset = TexCoordOffset;
+		view.TexCoordScale = TexCoordScale;
+		view.Indices = IndexBuffer.data();
+		view.IndexFormat = IndexFormat;
+		view.IndexCount = IndexCount;
+		view.BoundsMin = BoundsMin;
+		view.BoundsMax = BoundsMax;
+		view.Meshlets = Meshlets.Meshlets.data();
+		view.MeshletCount = (uint32_t)Meshlets.Meshlets.size();
+		view.MeshletVertices = Meshlets.Vertices.data();
+		view.MeshletTriangles = Meshlets.Triangles.data();
+		for (size_t i = 0; i < view.MeshletBounds.Components.size(); ++i)
+			view.MeshletBounds.Components[i] = Meshlets.Bounds.Components[i].data();
+		view.Lods = Lods.data();
+		view.LodCount = (uint32_t)Lods.size();
+		view.LodIndices = LodIndexBuffer.data();
+		return view;
+	}
+}
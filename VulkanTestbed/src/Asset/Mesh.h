@@ -0,0 +1,148 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+namespace VulkanTestbed
+{
+	struct Vertex
+	{
+		glm::vec3 Position;
+		glm::vec3 Normal;
+		glm::vec2 TexCoord;
+	};
+
+	// Quantized vertex layout, 24 bytes instead of 32: half float normals and 16 bit normalized texture coordinates
+	// over the mesh's texture coordinate range, read as R16G16_UNORM: TexCoord = TexCoordOffset + unorm * TexCoordScale
+	struct PackedVertex
+	{
+		glm::vec3 Position;
+		uint16_t Normal[4];
+		uint16_t TexCoord[2];
+	};
+
+	enum class IndexType : uint8_t
+	{
+		UInt16 = 0,
+		UInt32
+	};
+
+	struct Meshlet
+	{
+		// Into MeshletVertices, which maps meshlet local vertices to the mesh vertex buffer
+		uint32_t VertexOffset;
+		// Into MeshletTriangles, 3 local uint8_t indices per triangle, padded to 4 bytes per meshlet
+		uint32_t TriangleOffset;
+		uint32_t VertexCount;
+		uint32_t TriangleCount;
+	};
+
+	enum class MeshletBoundsComponent : uint32_t
+	{
+		// Bounding sphere
+		CenterX = 0, CenterY, CenterZ, Radius,
+		// Axis aligned bounding box
+		MinX, MinY, MinZ, MaxX, MaxY, MaxZ,
+		// Normal cone, see MeshletBuilder::IsBackfacing
+		ConeAxisX, ConeAxisY, ConeAxisZ, ConeCutoff,
+
+		Count
+	};
+
+	// Per meshlet culling data in SoA layout so culling can test several meshlets per instruction
+	struct MeshletBounds
+	{
+		std::array<std::vector<float>, (size_t)MeshletBoundsComponent::Count> Components;
+
+		std::vector<float>& operator[](MeshletBoundsComponent component) { return Components[(size_t)component]; }
+		const std::vector<float>& operator[](MeshletBoundsComponent component) const { return Components[(size_t)component]; }
+	};
+
+	struct MeshletBoundsView
+	{
+		std::array<const float*, (size_t)MeshletBoundsComponent::Count> Components = {};
+
+		const float* operator[](MeshletBoundsComponent component) const { return Components[(size_t)component]; }
+	};
+
+	struct MeshletData
+	{
+		std::vector<Meshlet> Meshlets;
+		std::vector<uint32_t> Vertices;
+		std::vector<uint8_t> Triangles;
+		MeshletBounds Bounds;
+	};
+
+	// Reduced detail level, indexes the same vertex buffer as the base mesh
+	struct MeshLod
+	{
+		// Into the LOD index buffer, which uses the same IndexType as the base mesh
+		uint32_t FirstIndex;
+		uint32_t IndexCount;
+		// Deviation from the base mesh relative to its largest extent
+		float Error;
+	};
+
+	// Non-owning view over mesh data, either backed by a MeshData or mapped straight out of a mesh cache
+	struct MeshView
+	{
+		std::string_view Name;
+		const Vertex* Vertices = nullptr;
+		uint32_t VertexCount = 0;
+		// Same vertices quantized, null when the mesh wasn't
+		const PackedVertex* PackedVertices = nullptr;
+		glm::vec2 TexCoordOffset = glm::vec2(0.0f);
+		glm::vec2 TexCoordScale = glm::vec2(1.0f);
+		const void* Indices = nullptr;
+		IndexType IndexFormat = IndexType::UInt32;
+		uint32_t IndexCount = 0;
+
+		glm::vec3 BoundsMin = glm::vec3(0.0f);
+		glm::vec3 BoundsMax = glm::vec3(0.0f);
+
+		const Meshlet* Meshlets = nullptr;
+		uint32_t MeshletCount = 0;
+		const uint32_t* MeshletVertices = nullptr;
+		const uint8_t* MeshletTriangles = nullptr;
+		MeshletBoundsView MeshletBounds;
+
+		const MeshLod* Lods = nullptr;
+		uint32_t LodCount = 0;
+		const void* LodIndices = nullptr;
+
+		size_t GetVertexBufferSize() const { return VertexCount * sizeof(Vertex); }
+		size_t GetPackedVertexBufferSize() const { return PackedVertices ? VertexCount * sizeof(PackedVertex) : 0; }
+		size_t GetIndexBufferSize() const { return IndexCount * (IndexFormat == IndexType::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t)); }
+	};
+
+	struct MeshData
+	{
+		std::string Name;
+		std::vector<Vertex> Vertices;
+		// Filled by MeshOptimizer::QuantizeVertices, see PackedVertex
+		std::vector<PackedVertex> PackedVertices;
+		glm::vec2 TexCoordOffset = glm::vec2(0.0f);
+		glm::vec2 TexCoordScale = glm::vec2(1.0f);
+		// Tightly packed uint16_t or uint32_t indices (see IndexFormat), ready to be copied into an index buffer
+		std::vector<uint8_t> IndexBuffer;
+		IndexType IndexFormat = IndexType::UInt32;
+		uint32_t IndexCount = 0;
+
+		glm::vec3 BoundsMin = glm::vec3(0.0f);
+		glm::vec3 BoundsMax = glm::vec3(0.0f);
+
+		MeshletData Meshlets;
+
+		std::vector<MeshLod> Lods;
+		std::vector<uint8_t> LodIndexBuffer;
+
+		// Picks 16 bit indices whenever the vertex count allows it
+		void SetIndices(const uint32_t* indices, uint32_t count);
+		void GetIndices(std::vector<uint32_t>& outIndices) const;
+		uint32_t GetIndex(uint32_t i) const;
+
+		void ComputeBounds();
+
+		MeshView GetView() const;
+	};
+}
@@ -0,0 +1,404 @@
+#include "pch.h"
+#include "MeshCache.h"
+
+#include <fstream>
+
+#include "Core/JobSystem.h"
+#include "Core/Timer.h"
+#include "Asset/ObjImporter.h"
+#include "Asset/MeshOptimizer.h"
+#include "Asset/MeshletBuilder.h"
+#include "Asset/MeshSimplifier.h"
+#include "Asset/SourceFile.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t MeshCacheMagic = 0x48534D54; // "TMSH"
+	static constexpr uint32_t MeshCacheFormatVersion = 5;
+	// Sections start on cache line boundaries so mapped pointers can be handed to SIMD code and copies as they are
+	static constexpr uint64_t SectionAlignment = 64;
+
+	enum class MeshCacheSectionType : uint32_t
+	{
+		Name = 0,
+		Vertices,
+		// Empty when the mesh wasn't quantized
+		PackedVertices,
+		Indices,
+		Meshlets,
+		MeshletVertices,
+		MeshletTriangles,
+		// SoA, one aligned float array per MeshletBoundsComponent
+		MeshletBounds,
+		Lods,
+		LodIndices,
+
+		Count
+	};
+
+	struct MeshCacheHeader
+	{
+		uint32_t Magic;
+		uint32_t FormatVersion;
+		uint32_t ImporterVersion;
+		uint32_t MeshCount;
+
+		uint64_t SourceHash;
+		uint64_t SourceSize;
+		int64_t SourceWriteTime;
+
+		uint64_t FileSize;
+		uint64_t MeshTableOffset;
+		uint64_t SectionTableOffset;
+		uint32_t SectionCount;
+		uint32_t OptimizerVersion;
+		uint32_t MeshletVersion;
+		uint32_t SimplifierVersion;
+	};
+
+	struct MeshCacheEntry
+	{
+		uint32_t VertexCount;
+		uint32_t IndexCount;
+		uint32_t IndexFormat;
+		uint32_t FirstSection;
+		uint32_t MeshletCount;
+		uint32_t LodCount;
+		float BoundsMin[3];
+		float BoundsMax[3];
+		float TexCoordOffset[2];
+		float TexCoordScale[2];
+	};
+
+	struct MeshCacheSection
+	{
+		uint32_t Type;
+		uint32_t MeshIndex;
+		uint64_t Offset;
+		uint64_t Size;
+	};
+
+	static constexpr uint32_t SectionsPerMesh = (uint32_t)MeshCacheSectionType::Count;
+
+	static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	static uint64_t GetBoundsComponentStride(uint32_t meshletCount)
+	{
+		return AlignUp(meshletCount * sizeof(float), SectionAlignment);
+	}
+
+	// Every section of the mesh has to hold exactly what the entry's counts say, the views handed out are never bounds
+	// checked again. Sections are already known to lie inside the mapping.
+	static bool ValidateMesh(const uint8_t* base, const MeshCacheEntry& entry, const MeshCacheSection* sections, uint32_t meshIndex)
+	{
+		for (uint32_t type = 0; type < SectionsPerMesh; ++type)
+		{
+			if (sections[type].Type != type || sections[type].MeshIndex != meshIndex)
+				return false;
+		}
+
+		auto sectionSize = [&](MeshCacheSectionType type) { return sections[(uint32_t)type].Size; };
+		if (entry.IndexFormat > (uint32_t)IndexType::UInt32)
+			return false;
+
+		const uint64_t indexSize = entry.IndexFormat == (uint32_t)IndexType::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		const uint64_t packedVertexSize = sectionSize(MeshCacheSectionType::PackedVertices);
+		if (sectionSize(MeshCacheSectionType::Vertices) != (uint64_t)entry.VertexCount * sizeof(Vertex)
+			|| (packedVertexSize != 0 && packedVertexSize != (uint64_t)entry.VertexCount * sizeof(PackedVertex))
+			|| sectionSize(MeshCacheSectionType::Indices) != (uint64_t)entry.IndexCount * indexSize
+			|| sectionSize(MeshCacheSectionType::Meshlets) != (uint64_t)entry.MeshletCount * sizeof(Meshlet)
+			|| sectionSize(MeshCacheSectionType::MeshletVertices) % sizeof(uint32_t) != 0
+			|| sectionSize(MeshCacheSectionType::MeshletBounds) != GetBoundsComponentStride(entry.MeshletCount) * (uint64_t)MeshletBoundsComponent::Count
+			|| sectionSize(MeshCacheSectionType::Lods) != (uint64_t)entry.LodCount * sizeof(MeshLod)
+			|| sectionSize(MeshCacheSectionType::LodIndices) % indexSize != 0)
+		{
+			return false;
+		}
+
+		// Meshlets and LODs are small, their ranges are checked too so nothing indexes past the arrays they point into
+		const Meshlet* meshlets = (const Meshlet*)(base + sections[(uint32_t)MeshCacheSectionType::Meshlets].Offset);
+		const uint64_t meshletVertexCount = sectionSize(MeshCacheSectionType::MeshletVertices) / sizeof(uint32_t);
+		const uint64_t meshletTriangleSize = sectionSize(MeshCacheSectionType::MeshletTriangles);
+		for (uint32_t i = 0; i < entry.MeshletCount; ++i)
+		{
+			if ((uint64_t)meshlets[i].VertexOffset + meshlets[i].VertexCount > meshletVertexCount
+				|| (uint64_t)meshlets[i].TriangleOffset + (uint64_t)meshlets[i].TriangleCount * 3 > meshletTriangleSize)
+			{
+				return false;
+			}
+		}
+
+		const MeshLod* lods = (const MeshLod*)(base + sections[(uint32_t)MeshCacheSectionType::Lods].Offset);
+		const uint64_t lodIndexCount = sectionSize(MeshCacheSectionType::LodIndices) / indexSize;
+		for (uint32_t i = 0; i < entry.LodCount; ++i)
+		{
+			if ((uint64_t)lods[i].FirstIndex + lods[i].IndexCount > lodIndexCount)
+				return false;
+		}
+		return true;
+	}
+
+	static bool WriteCache(const std::filesystem::path& cachePath, const SourceFileInfo& source, const std::vector<MeshData>& meshes)
+	{
+		// Written next to the final file and renamed at the end, a crash mid-write never leaves a truncated cache behind
+		std::filesystem::path tempPath = cachePath;
+		tempPath += ".tmp";
+
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		MeshCacheHeader header = {};
+		header.Magic = MeshCacheMagic;
+		header.FormatVersion = MeshCacheFormatVersion;
+		header.ImporterVersion = ObjImporter::Version;
+		header.OptimizerVersion = MeshOptimizer::Version;
+		header.MeshletVersion = MeshletBuilder::Version;
+		header.SimplifierVersion = MeshSimplifier::Version;
+		header.MeshCount = (uint32_t)meshes.size();
+		header.SourceHash = source.Hash;
+		header.SourceSize = source.Size;
+		header.SourceWriteTime = source.WriteTime;
+		header.SectionCount = header.MeshCount * SectionsPerMesh;
+		header.MeshTableOffset = AlignUp(sizeof(MeshCacheHeader), SectionAlignment);
+		header.SectionTableOffset = AlignUp(header.MeshTableOffset + header.MeshCount * sizeof(MeshCacheEntry), SectionAlignment);
+
+		std::vector<MeshCacheEntry> entries(meshes.size());
+		std::vector<MeshCacheSection> sections;
+		sections.reserve(header.SectionCount);
+
+		uint64_t offset = AlignUp(header.SectionTableOffset + header.SectionCount * sizeof(MeshCacheSection), SectionAlignment);
+		static const char zeros[SectionAlignment] = {};
+		file.seekp((std::streamoff)offset);
+
+		auto writeAligned = [&](const void* data, uint64_t size)
+		{
+			file.write((const char*)data, (std::streamsize)size);
+			const uint64_t alignedEnd = AlignUp(offset + size, SectionAlignment);
+			file.write(zeros, (std::streamsize)(alignedEnd - offset - size));
+			offset = alignedEnd;
+		};
+
+		auto writeSection = [&](MeshCacheSectionType type, uint32_t meshIndex, const void* data, uint64_t size)
+		{
+			sections.push_back({ (uint32_t)type, meshIndex, offset, size });
+			writeAligned(data, size);
+		};
+
+		for (uint32_t i = 0; i < header.MeshCount; ++i)
+		{
+			const MeshData& mesh = meshes[i];
+			MeshCacheEntry& entry = entries[i];
+			entry.VertexCount = (uint32_t)mesh.Vertices.size();
+			entry.IndexCount = mesh.IndexCount;
+			entry.IndexFormat = (uint32_t)mesh.IndexFormat;
+			entry.FirstSection = (uint32_t)sections.size();
+			entry.MeshletCount = (uint32_t)mesh.Meshlets.Meshlets.size();
+			entry.LodCount = (uint32_t)mesh.Lods.size();
+			memcpy(entry.BoundsMin, &mesh.BoundsMin, sizeof(entry.BoundsMin));
+			memcpy(entry.BoundsMax, &mesh.BoundsMax, sizeof(entry.BoundsMax));
+			memcpy(entry.TexCoordOffset, &mesh.TexCoordOffset, sizeof(entry.TexCoordOffset));
+			memcpy(entry.TexCoordScale, &mesh.TexCoordScale, sizeof(entry.TexCoordScale));
+
+			writeSection(MeshCacheSectionType::Name, i, mesh.Name.data(), mesh.Name.size());
+			writeSection(MeshCacheSectionType::Vertices, i, mesh.Vertices.data(), mesh.Vertices.size() * sizeof(Vertex));
+			writeSection(MeshCacheSectionType::PackedVertices, i, mesh.PackedVertices.data(), mesh.PackedVertices.size() * sizeof(PackedVertex));
+			writeSection(MeshCacheSectionType::Indices, i, mesh.IndexBuffer.data(), mesh.IndexBuffer.size());
+			writeSection(MeshCacheSectionType::Meshlets, i, mesh.Meshlets.Meshlets.data(), mesh.Meshlets.Meshlets.size() * sizeof(Meshlet));
+			writeSection(MeshCacheSectionType::MeshletVertices, i, mesh.Meshlets.Vertices.data(), mesh.Meshlets.Vertices.size() * sizeof(uint32_t));
+			writeSection(MeshCacheSectionType::MeshletTriangles, i, mesh.Meshlets.Triangles.data(), mesh.Meshlets.Triangles.size());
+
+			sections.push_back({ (uint32_t)MeshCacheSectionType::MeshletBounds, i, offset, GetBoundsComponentStride(entry.MeshletCount) * (uint64_t)MeshletBoundsComponent::Count });
+			for (const std::vector<float>& component : mesh.Meshlets.Bounds.Components)
+				writeAligned(component.data(), component.size() * sizeof(float));
+
+			writeSection(MeshCacheSectionType::Lods, i, mesh.Lods.data(), mesh.Lods.size() * sizeof(MeshLod));
+			writeSection(MeshCacheSectionType::LodIndices, i, mesh.LodIndexBuffer.data(), mesh.LodIndexBuffer.size());
+		}
+
+		header.FileSize = offset;
+		file.seekp(0);
+		file.write((const char*)&header, sizeof(header));
+		file.seekp((std::streamoff)header.MeshTableOffset);
+		file.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(MeshCacheEntry)));
+		file.seekp((std::streamoff)header.SectionTableOffset);
+		file.write((const char*)sections.data(), (std::streamsize)(sections.size() * sizeof(MeshCacheSection)));
+		file.close();
+		if (!file)
+			return false;
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, cachePath, error);
+		return !error;
+	}
+
+	std::filesystem::path MeshCache::GetCachePath(const std::filesystem::path& sourcePath)
+	{
+		std::filesystem::path cachePath = sourcePath;
+		cachePath += ".meshcache";
+		return cachePath;
+	}
+
+	bool MeshCache::Load(const std::filesystem::path& sourcePath)
+	{
+		Unload();
+
+		Timer timer;
+		const std::filesystem::path cachePath = GetCachePath(sourcePath);
+		if (Open(cachePath, sourcePath))
+		{
+			LOG_INFO("MeshCache: Mapped {} ({} meshes) in {:.2f} ms", cachePath.filename().string(), m_MeshCount, timer.ElapsedMillis());
+			return true;
+		}
+
+		if (!Build(sourcePath, cachePath) || !Open(cachePath, sourcePath))
+		{
+			LOG_ERROR("MeshCache: Failed to build {}", cachePath.string());
+			return false;
+		}
+
+		LOG_INFO("MeshCache: Built {} ({} meshes) in {:.2f} ms", cachePath.filename().string(), m_MeshCount, timer.ElapsedMillis());
+		return true;
+	}
+
+	void MeshCache::Unload()
+	{
+		m_File.Close();
+		m_MeshCount = 0;
+	}
+
+	MeshView MeshCache::GetMesh(uint32_t index) const
+	{
+		TESTBED_ASSERT(index < m_MeshCount);
+
+		const uint8_t* base = m_File.GetData();
+		const MeshCacheHeader* header = (const MeshCacheHeader*)base;
+		const MeshCacheEntry& entry = ((const MeshCacheEntry*)(base + header->MeshTableOffset))[index];
+		const MeshCacheSection* sections = (const MeshCacheSection*)(base + header->SectionTableOffset) + entry.FirstSection;
+
+		MeshView view;
+		view.Name = std::string_view((const char*)base + sections[(uint32_t)MeshCacheSectionType::Name].Offset, sections[(uint32_t)MeshCacheSectionType::Name].Size);
+		view.Vertices = (const Vertex*)(base + sections[(uint32_t)MeshCacheSectionType::Vertices].Offset);
+		view.VertexCount = entry.VertexCount;
+		const MeshCacheSection& packedVertices = sections[(uint32_t)MeshCacheSectionType::PackedVertices];
+		view.PackedVertices = packedVertices.Size > 0 ? (const PackedVertex*)(base + packedVertices.Offset) : nullptr;
+		memcpy(&view.TexCoordOffset, entry.TexCoordOffset, sizeof(entry.TexCoordOffset));
+		memcpy(&view.TexCoordScale, entry.TexCoordScale, sizeof(entry.TexCoordScale));
+		view.Indices = base + sections[(uint32_t)MeshCacheSectionType::Indices].Offset;
+		view.IndexFormat = (IndexType)entry.IndexFormat;
+		view.IndexCount = entry.IndexCount;
+		memcpy(&view.BoundsMin, entry.BoundsMin, sizeof(entry.BoundsMin));
+		memcpy(&view.BoundsMax, entry.BoundsMax, sizeof(entry.BoundsMax));
+
+		view.Meshlets = (const Meshlet*)(base + sections[(uint32_t)MeshCacheSectionType::Meshlets].Offset);
+		view.MeshletCount = entry.MeshletCount;
+		view.MeshletVertices = (const uint32_t*)(base + sections[(uint32_t)MeshCacheSectionType::MeshletVertices].Offset);
+		view.MeshletTriangles = base + sections[(uint32_t)MeshCacheSectionType::MeshletTriangles].Offset;
+
+		const uint8_t* bounds = base + sections[(uint32_t)MeshCacheSectionType::MeshletBounds].Offset;
+		const uint64_t stride = GetBoundsComponentStride(entry.MeshletCount);
+		for (size_t c = 0; c < view.MeshletBounds.Components.size(); ++c)
+			view.MeshletBounds.Components[c] = (const float*)(bounds + c * stride);
+
+		view.Lods = (const MeshLod*)(base + sections[(uint32_t)MeshCacheSectionType::Lods].Offset);
+		view.LodCount = entry.LodCount;
+		view.LodIndices = base + sections[(uint32_t)MeshCacheSectionType::LodIndices].Offset;
+		return view;
+	}
+
+	bool MeshCache::Open(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath)
+	{
+		if (!m_File.Open(cachePath))
+			return false;
+
+		const uint8_t* base = m_File.GetData();
+		const size_t size = m_File.GetSize();
+		const MeshCacheHeader* header = (const MeshCacheHeader*)base;
+
+		bool valid = size >= sizeof(MeshCacheHeader)
+			&& header->Magic == MeshCacheMagic
+			&& header->FormatVersion == MeshCacheFormatVersion
+			&& header->ImporterVersion == ObjImporter::Version
+			&& header->OptimizerVersion == MeshOptimizer::Version
+			&& header->MeshletVersion == MeshletBuilder::Version
+			&& header->SimplifierVersion == MeshSimplifier::Version
+			&& header->FileSize == size
+			&& header->SectionCount == (uint64_t)header->MeshCount * SectionsPerMesh
+			&& header->MeshTableOffset % SectionAlignment == 0 && header->SectionTableOffset % SectionAlignment == 0
+			&& header->MeshTableOffset <= size && (uint64_t)header->MeshCount * sizeof(MeshCacheEntry) <= size - header->MeshTableOffset
+			&& header->SectionTableOffset <= size && (uint64_t)header->SectionCount * sizeof(MeshCacheSection) <= size - header->SectionTableOffset;
+
+		if (valid)
+		{
+			const MeshCacheSection* sections = (const MeshCacheSection*)(base + header->SectionTableOffset);
+			for (uint32_t i = 0; i < header->SectionCount && valid; ++i)
+				valid = sections[i].Offset % SectionAlignment == 0 && sections[i].Offset <= size && sections[i].Size <= size - sections[i].Offset;
+
+			const MeshCacheEntry* entries = (const MeshCacheEntry*)(base + header->MeshTableOffset);
+			for (uint32_t i = 0; i < header->MeshCount && valid; ++i)
+				valid = entries[i].FirstSection == i * SectionsPerMesh && ValidateMesh(base, entries[i], sections + entries[i].FirstSection, i);
+		}
+
+		if (!valid)
+		{
+			LOG_WARN("MeshCache: {} is corrupt or was written by another version, rebuilding", cachePath.filename().string());
+			m_File.Close();
+			return false;
+		}
+
+		bool touched = false;
+		if (!IsSourceFileUnchanged(sourcePath, { header->SourceHash, header->SourceSize, header->SourceWriteTime }, &touched))
+		{
+			LOG_INFO("MeshCache: {} is stale, rebuilding", cachePath.filename().string());
+			m_File.Close();
+			return false;
+		}
+
+		// Same contents under a new write time, remembered so later launches don't hash the source again
+		if (touched)
+		{
+			m_File.Close();
+			if (!UpdateSourceWriteTime(cachePath, offsetof(MeshCacheHeader, SourceWriteTime), sourcePath))
+				LOG_WARN("MeshCache: Failed to update the source write time in {}", cachePath.filename().string());
+			if (!m_File.Open(cachePath) || m_File.GetSize() != size)
+			{
+				m_File.Close();
+				return false;
+			}
+			header = (const MeshCacheHeader*)m_File.GetData();
+		}
+
+		m_MeshCount = header->MeshCount;
+		return true;
+	}
+
+	bool MeshCache::Build(const std::filesystem::path& sourcePath, const std::filesystem::path& cachePath)
+	{
+		SourceFileInfo source;
+		if (!ReadSourceFileInfo(sourcePath, source))
+			return false;
+
+		std::vector<MeshData> meshes;
+		if (!ObjImporter::Import(sourcePath, meshes))
+			return false;
+
+		ParallelFor((uint32_t)meshes.size(), [&](uint32_t i)
+		{
+			MeshData& mesh = meshes[i];
+			const MeshOptimizerStatistics stats = MeshOptimizer::Optimize(mesh);
+			LOG_INFO("MeshOptimizer: {} ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+				mesh.Name, stats.Before.ACMR, stats.After.ACMR, stats.Before.ATVR, stats.After.ATVR);
+
+			MeshletBuilder::Build(mesh);
+
+			MeshSimplifier::GenerateLods(mesh);
+			for (const MeshLod& lod : mesh.Lods)
+				LOG_INFO("MeshSimplifier: {} LOD {} triangles, error {:.4f}", mesh.Name, lod.IndexCount / 3, lod.Error);
+		});
+
+		return WriteCache(cachePath, source, meshes);
+	}
+}
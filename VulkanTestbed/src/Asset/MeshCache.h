@@ -0,0 +1,32 @@
+#pragma once
+
+#include <filesystem>
+
+#include "Core/MappedFile.h"
+#include "Asset/Mesh.h"
+
+namespace VulkanTestbed
+{
+	// Versioned binary cache of imported meshes. The cache is memory mapped and the returned views point
+	// straight into the mapping, so they stay valid until the cache is unloaded.
+	class MeshCache
+	{
+	public:
+		// Maps the cache next to the source file, (re)building it from the OBJ when missing or stale
+		bool Load(const std::filesystem::path& sourcePath);
+		void Unload();
+
+		uint32_t GetMeshCount() const { return m_MeshCount; }
+		MeshView GetMesh(uint32_t index) const;
+
+		static std::filesystem::path GetCachePath(const std::filesystem::path& sourcePath);
+
+	private:
+		bool Open(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath);
+		static bool Build(const std::filesystem::path& sourcePath, const std::filesystem::path& cachePath);
+
+	private:
+		MappedFile m_File;
+		uint32_t m_MeshCount = 0;
+	};
+}
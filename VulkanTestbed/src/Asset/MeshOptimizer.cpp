@@ -0,0 +1,312 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t InvalidIndex = std::numeric_limits<uint32_t>::max();
+
+	// Triangles adjacent to each vertex in compressed sparse row form
+	struct TriangleAdjacency
+	{
+		std::vector<uint32_t> Offsets;
+		std::vector<uint32_t> Counts;
+		std::vector<uint32_t> Triangles;
+
+		void Build(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount)
+		{
+			Counts.assign(vertexCount, 0);
+			Offsets.resize(vertexCount);
+			Triangles.resize(indexCount);
+
+			for (uint32_t i = 0; i < indexCount; ++i)
+				++Counts[indices[i]];
+
+			uint32_t offset = 0;
+			for (uint32_t v = 0; v < vertexCount; ++v)
+			{
+				Offsets[v] = offset;
+				offset += Counts[v];
+			}
+
+			std::vector<uint32_t> fill = Offsets;
+			for (uint32_t i = 0; i < indexCount; ++i)
+				Triangles[fill[indices[i]]++] = i / 3;
+		}
+	};
+
+	MeshOptimizerStatistics MeshOptimizer::Optimize(MeshData& mesh, const MeshOptimizerSettings& settings)
+	{
+		MeshOptimizerStatistics stats;
+		if (mesh.IndexCount == 0)
+			return stats;
+
+		std::vector<uint32_t> indices;
+		mesh.GetIndices(indices);
+		const uint32_t vertexCount = (uint32_t)mesh.Vertices.size();
+
+		stats.Before = AnalyzeVertexCache(indices.data(), mesh.IndexCount, vertexCount, settings.CacheSize);
+
+		std::vector<uint32_t> clusters;
+		OptimizeVertexCache(indices.data(), mesh.IndexCount, vertexCount, settings.CacheSize, settings.OptimizeOverdraw ? &clusters : nullptr);
+		if (settings.OptimizeOverdraw)
+			OptimizeOverdraw(indices.data(), mesh.IndexCount, mesh.Vertices.data(), vertexCount, clusters);
+		if (settings.OptimizeVertexFetch)
+			OptimizeVertexFetch(mesh.Vertices, indices.data(), mesh.IndexCount);
+
+		stats.After = AnalyzeVertexCache(indices.data(), mesh.IndexCount, (uint32_t)mesh.Vertices.size(), settings.CacheSize);
+		mesh.SetIndices(indices.data(), mesh.IndexCount);
+
+		// After the fetch reordering, both vertex streams share the final order
+		if (settings.QuantizeVertices)
+			QuantizeVertices(mesh.Vertices.data(), (uint32_t)mesh.Vertices.size(), mesh.PackedVertices, mesh.TexCoordOffset, mesh.TexCoordScale);
+		return stats;
+	}
+
+	void MeshOptimizer::OptimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>* outClusters)
+	{
+		const uint32_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+			return;
+
+		TriangleAdjacency adjacency;
+		adjacency.Build(indices, indexCount, vertexCount);
+
+		std::vector<uint32_t> liveTriangles = adjacency.Counts;
+		std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEndStack;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> output;
+		output.reserve(indexCount);
+
+		if (outClusters)
+			outClusters->clear();
+
+		uint32_t timestamp = cacheSize + 1;
+		uint32_t cursor = 0;
+		uint32_t fanningVertex = 0;
+		bool startCluster = true;
+
+		while (fanningVertex != InvalidIndex)
+		{
+			const uint32_t emittedTriangles = (uint32_t)output.size() / 3;
+			if (startCluster && outClusters && (outClusters->empty() || outClusters->back() != emittedTriangles))
+				outClusters->push_back(emittedTriangles);
+			startCluster = false;
+
+			candidates.clear();
+			const uint32_t* triangles = adjacency.Triangles.data() + adjacency.Offsets[fanningVertex];
+			for (uint32_t t = 0; t < adjacency.Counts[fanningVertex]; ++t)
+			{
+				const uint32_t triangle = triangles[t];
+				if (emitted[triangle])
+					continue;
+
+				for (uint32_t c = 0; c < 3; ++c)
+				{
+					const uint32_t v = indices[triangle * 3 + c];
+					output.push_back(v);
+					deadEndStack.push_back(v);
+					candidates.push_back(v);
+					--liveTriangles[v];
+
+					if (timestamp - cacheTimestamps[v] > cacheSize)
+						cacheTimestamps[v] = timestamp++;
+				}
+				emitted[triangle] = true;
+			}
+
+			// Prefer the candidate that will still be in the cache after its remaining triangles are emitted
+			uint32_t next = InvalidIndex;
+			int32_t bestPriority = -1;
+			for (uint32_t v : candidates)
+			{
+				if (liveTriangles[v] == 0)
+					continue;
+
+				int32_t priority = 0;
+				if (timestamp - cacheTimestamps[v] + 2 * liveTriangles[v] <= cacheSize)
+					priority = (int32_t)(timestamp - cacheTimestamps[v]);
+
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					next = v;
+				}
+			}
+
+			if (next == InvalidIndex)
+			{
+				// Dead end, fanning resumes somewhere the previous triangles don't lead to
+				startCluster = true;
+				while (!deadEndStack.empty() && next == InvalidIndex)
+				{
+					const uint32_t v = deadEndStack.back();
+					deadEndStack.pop_back();
+					if (liveTriangles[v] > 0)
+						next = v;
+				}
+
+				// Nothing recently used is left, jump to the next unfinished vertex in input order
+				while (next == InvalidIndex && cursor < vertexCount)
+				{
+					if (liveTriangles[cursor] > 0)
+						next = cursor;
+					++cursor;
+				}
+			}
+
+			// The next fan starts with a flushed cache, moving it elsewhere costs no extra transforms
+			if (next != InvalidIndex && timestamp - cacheTimestamps[next] > cacheSize)
+				startCluster = true;
+
+			fanningVertex = next;
+		}
+
+		TESTBED_ASSERT(output.size() == (size_t)triangleCount * 3);
+		memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+	}
+
+	void MeshOptimizer::OptimizeOverdraw(uint32_t* indices, uint32_t indexCount, const Vertex* vertices, uint32_t vertexCount, const std::vector<uint32_t>& clusters)
+	{
+		const uint32_t triangleCount = indexCount / 3;
+		if (clusters.size() <= 1)
+			return;
+
+		glm::vec3 meshCentroid(0.0f);
+		for (uint32_t v = 0; v < vertexCount; ++v)
+			meshCentroid += vertices[v].Position;
+		meshCentroid /= (float)std::max(vertexCount, 1u);
+
+		struct ClusterKey
+		{
+			float Sort;
+			uint32_t Cluster;
+		};
+
+		std::vector<ClusterKey> keys(clusters.size());
+		for (uint32_t c = 0; c < (uint32_t)clusters.size(); ++c)
+		{
+			const uint32_t begin = clusters[c];
+			const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+			glm::vec3 centroid(0.0f);
+			glm::vec3 normal(0.0f);
+			float area = 0.0f;
+			for (uint32_t t = begin; t < end; ++t)
+			{
+				const glm::vec3& p0 = vertices[indices[t * 3 + 0]].Position;
+				const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+				const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+				const glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+				const float faceArea = glm::length(faceNormal);
+
+				centroid += (p0 + p1 + p2) * (faceArea / 3.0f);
+				normal += faceNormal;
+				area += faceArea;
+			}
+
+			centroid = area > 0.0f ? centroid / area : vertices[indices[begin * 3]].Position;
+			const float normalLength = glm::length(normal);
+			normal = normalLength > 0.0f ? normal / normalLength : glm::vec3(0.0f);
+
+			keys[c] = { glm::dot(centroid - meshCentroid, normal), c };
+		}
+
+		std::stable_sort(keys.begin(), keys.end(), [](const ClusterKey& a, const ClusterKey& b) { return a.Sort > b.Sort; });
+
+		std::vector<uint32_t> output;
+		output.reserve(indexCount);
+		for (const ClusterKey& key : keys)
+		{
+			const uint32_t begin = clusters[key.Cluster];
+			const uint32_t end = key.Cluster + 1 < clusters.size() ? clusters[key.Cluster + 1] : triangleCount;
+			output.insert(output.end(), indices + begin * 3, indices + end * 3);
+		}
+
+		memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+	}
+
+	void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, uint32_t* indices, uint32_t indexCount)
+	{
+		std::vector<uint32_t> remap(vertices.size(), InvalidIndex);
+		std::vector<Vertex> reordered;
+		reordered.reserve(vertices.size());
+
+		for (uint32_t i = 0; i < indexCount; ++i)
+		{
+			uint32_t& newIndex = remap[indices[i]];
+			if (newIndex == InvalidIndex)
+			{
+				newIndex = (uint32_t)reordered.size();
+				reordered.push_back(vertices[indices[i]]);
+			}
+			indices[i] = newIndex;
+		}
+
+		vertices = std::move(reordered);
+	}
+
+	VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+	{
+		VertexCacheStatistics stats;
+		if (indexCount == 0)
+			return stats;
+
+		// FIFO cache, a vertex is in the cache if it was inserted less than cacheSize insertions ago
+		std::vector<uint32_t> insertedAt(vertexCount, 0);
+		uint32_t timestamp = cacheSize + 1;
+		uint32_t uniqueVertices = 0;
+		for (uint32_t i = 0; i < indexCount; ++i)
+		{
+			uint32_t& inserted = insertedAt[indices[i]];
+			if (inserted == 0)
+				++uniqueVertices;
+
+			if (timestamp - inserted > cacheSize)
+			{
+				inserted = timestamp++;
+				++stats.VerticesTransformed;
+			}
+		}
+
+		stats.ACMR = (float)stats.VerticesTransformed / (float)(indexCount / 3);
+		stats.ATVR = (float)stats.VerticesTransformed / (float)std::max(uniqueVertices, 1u);
+		return stats;
+	}
+
+	void MeshOptimizer::QuantizeVertices(const Vertex* vertices, uint32_t vertexCount, std::vector<PackedVertex>& outVertices,
+		glm::vec2& outTexCoordOffset, glm::vec2& outTexCoordScale)
+	{
+		// Tiled texture coordinates go well past [0, 1], so the range comes from the mesh
+		glm::vec2 texCoordMin(std::numeric_limits<float>::max());
+		glm::vec2 texCoordMax(-std::numeric_limits<float>::max());
+		for (uint32_t i = 0; i < vertexCount; ++i)
+		{
+			texCoordMin = glm::min(texCoordMin, vertices[i].TexCoord);
+			texCoordMax = glm::max(texCoordMax, vertices[i].TexCoord);
+		}
+		outTexCoordOffset = vertexCount > 0 ? texCoordMin : glm::vec2(0.0f);
+		outTexCoordScale = vertexCount > 0 ? texCoordMax - texCoordMin : glm::vec2(1.0f);
+		const glm::vec2 toUnorm(outTexCoordScale.x > 0.0f ? 65535.0f / outTexCoordScale.x : 0.0f, outTexCoordScale.y > 0.0f ? 65535.0f / outTexCoordScale.y : 0.0f);
+
+		outVertices.resize(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; ++i)
+		{
+			const Vertex& src = vertices[i];
+			PackedVertex& dst = outVertices[i];
+			dst.Position = src.Position;
+			dst.Normal[0] = glm::packHalf1x16(src.Normal.x);
+			dst.Normal[1] = glm::packHalf1x16(src.Normal.y);
+			dst.Normal[2] = glm::packHalf1x16(src.Normal.z);
+			dst.Normal[3] = 0;
+			const glm::vec2 unorm = glm::clamp(glm::round((src.TexCoord - outTexCoordOffset) * toUnorm), 0.0f, 65535.0f);
+			dst.TexCoord[0] = (uint16_t)unorm.x;
+			dst.TexCoord[1] = (uint16_t)unorm.y;
+		}
+	}
+}
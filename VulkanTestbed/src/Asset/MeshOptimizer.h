@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Asset/Mesh.h"
+
+namespace VulkanTestbed
+{
+	struct VertexCacheStatistics
+	{
+		uint32_t VerticesTransformed = 0;
+		// Average cache miss ratio, transformed vertices per triangle (0.5 is the best a regular grid can do)
+		float ACMR = 0.0f;
+		// Average transform to vertex ratio, transformed vertices per unique vertex (1.0 is optimal)
+		float ATVR = 0.0f;
+	};
+
+	struct MeshOptimizerStatistics
+	{
+		VertexCacheStatistics Before;
+		VertexCacheStatistics After;
+	};
+
+	struct MeshOptimizerSettings
+	{
+		// Size of the simulated post transform FIFO cache
+		uint32_t CacheSize = 16;
+		bool OptimizeOverdraw = true;
+		bool OptimizeVertexFetch = true;
+		// Adds the PackedVertex version of the vertices to the mesh
+		bool QuantizeVertices = true;
+	};
+
+	class MeshOptimizer
+	{
+	public:
+		// Bump whenever the optimized output changes, invalidates existing mesh caches
+		static constexpr uint32_t Version = 2;
+
+		// Runs vertex cache ordering, overdraw cluster sorting and vertex fetch reordering in place, then quantization
+		static MeshOptimizerStatistics Optimize(MeshData& mesh, const MeshOptimizerSettings& settings = {});
+
+		// Tipsify (Sander et al. 2007). Optionally returns the first triangle of every cluster, clusters start at dead
+		// ends and cache flushes so they can be reordered freely without hurting cache efficiency much.
+		static void OptimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>* outClusters = nullptr);
+		// Sorts clusters so outward facing ones are drawn first, which approximates front to back order from any view
+		static void OptimizeOverdraw(uint32_t* indices, uint32_t indexCount, const Vertex* vertices, uint32_t vertexCount, const std::vector<uint32_t>& clusters);
+		// Reorders vertices by first use so fetches walk memory linearly, unreferenced vertices are dropped
+		static void OptimizeVertexFetch(std::vector<Vertex>& vertices, uint32_t* indices, uint32_t indexCount);
+
+		static VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize);
+
+		// Texture coordinates are normalized over their range, which is returned for decoding
+		static void QuantizeVertices(const Vertex* vertices, uint32_t vertexCount, std::vector<PackedVertex>& outVertices,
+			glm::vec2& outTexCoordOffset, glm::vec2& outTexCoordScale);
+	};
+}
@@ -0,0 +1,449 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+
+#include "Asset/MeshOptimizer.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t InvalidIndex = std::numeric_limits<uint32_t>::max();
+	// Border edges are weighted up so open boundaries keep their outline
+	static constexpr float BorderWeight = 10.0f;
+
+	enum class VertexKind : uint8_t
+	{
+		Manifold = 0,
+		Border,
+		// Attribute seams and non-manifold vertices
+		Locked
+	};
+
+	// Symmetric 4x4 matrix, error(p) = p^T A p + 2 b^T p + c, normalized by the accumulated weight
+	struct Quadric
+	{
+		float A00 = 0.0f, A11 = 0.0f, A22 = 0.0f;
+		float A01 = 0.0f, A02 = 0.0f, A12 = 0.0f;
+		float B0 = 0.0f, B1 = 0.0f, B2 = 0.0f;
+		float C = 0.0f;
+		float Weight = 0.0f;
+
+		static Quadric FromPlane(const glm::vec3& n, float d, float weight)
+		{
+			Quadric q;
+			q.A00 = weight * n.x * n.x;
+			q.A11 = weight * n.y * n.y;
+			q.A22 = weight * n.z * n.z;
+			q.A01 = weight * n.x * n.y;
+			q.A02 = weight * n.x * n.z;
+			q.A12 = weight * n.y * n.z;
+			q.B0 = weight * n.x * d;
+			q.B1 = weight * n.y * d;
+			q.B2 = weight * n.z * d;
+			q.C = weight * d * d;
+			q.Weight = weight;
+			return q;
+		}
+
+		Quadric& operator+=(const Quadric& other)
+		{
+			A00 += other.A00; A11 += other.A11; A22 += other.A22;
+			A01 += other.A01; A02 += other.A02; A12 += other.A12;
+			B0 += other.B0; B1 += other.B1; B2 += other.B2;
+			C += other.C;
+			Weight += other.Weight;
+			return *this;
+		}
+
+		float Error(const glm::vec3& p) const
+		{
+			const float rx = A00 * p.x + A01 * p.y + A02 * p.z + 2.0f * B0;
+			const float ry = A01 * p.x + A11 * p.y + A12 * p.z + 2.0f * B1;
+			const float rz = A02 * p.x + A12 * p.y + A22 * p.z + 2.0f * B2;
+			const float error = std::abs(rx * p.x + ry * p.y + rz * p.z + C);
+			return Weight > 0.0f ? error / Weight : error;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t From;
+		uint32_t To;
+		float Cost;
+	};
+
+	static uint64_t EdgeKey(uint32_t a, uint32_t b)
+	{
+		return ((uint64_t)a << 32) | b;
+	}
+
+	// Groups vertices with bit identical positions, outRemap points every vertex to the first one of its group
+	static void BuildPositionRemap(const glm::vec3* positions, uint32_t vertexCount, std::vector<uint32_t>& outRemap, std::vector<uint32_t>& outWedgeCount)
+	{
+		std::vector<uint32_t> order(vertexCount);
+		for (uint32_t i = 0; i < vertexCount; ++i)
+			order[i] = i;
+
+		auto less = [&](uint32_t a, uint32_t b)
+		{
+			const glm::vec3& pa = positions[a];
+			const glm::vec3& pb = positions[b];
+			if (pa.x != pb.x) return pa.x < pb.x;
+			if (pa.y != pb.y) return pa.y < pb.y;
+			if (pa.z != pb.z) return pa.z < pb.z;
+			return a < b;
+		};
+		std::sort(order.begin(), order.end(), less);
+
+		outRemap.resize(vertexCount);
+		outWedgeCount.assign(vertexCount, 0);
+		for (uint32_t i = 0; i < vertexCount; )
+		{
+			uint32_t end = i + 1;
+			while (end < vertexCount && positions[order[end]] == positions[order[i]])
+				++end;
+
+			for (uint32_t j = i; j < end; ++j)
+			{
+				outRemap[order[j]] = order[i];
+				outWedgeCount[order[j]] = end - i;
+			}
+			i = end;
+		}
+	}
+
+	static void ClassifyVertices(const uint32_t* indices, uint32_t indexCount, const std::vector<uint32_t>& remap,
+		const std::vector<uint32_t>& wedgeCount, std::vector<VertexKind>& outKinds, std::vector<uint64_t>& outBorderEdges)
+	{
+		const uint32_t vertexCount = (uint32_t)remap.size();
+		outKinds.assign(vertexCount, VertexKind::Manifold);
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			if (wedgeCount[v] > 1)
+				outKinds[v] = VertexKind::Locked;
+		}
+
+		// Directed edges between positions, an edge without its twin lies on an open border
+		std::vector<uint64_t> edges;
+		edges.reserve(indexCount);
+		for (uint32_t i = 0; i < indexCount; i += 3)
+		{
+			for (uint32_t e = 0; e < 3; ++e)
+				edges.push_back(EdgeKey(remap[indices[i + e]], remap[indices[i + (e + 1) % 3]]));
+		}
+		std::sort(edges.begin(), edges.end());
+
+		outBorderEdges.clear();
+		for (size_t i = 0; i < edges.size(); ++i)
+		{
+			const uint32_t a = (uint32_t)(edges[i] >> 32);
+			const uint32_t b = (uint32_t)edges[i];
+
+			// The same directed edge twice means more than two triangles meet there
+			if (i + 1 < edges.size() && edges[i + 1] == edges[i])
+			{
+				outKinds[a] = VertexKind::Locked;
+				outKinds[b] = VertexKind::Locked;
+				continue;
+			}
+
+			if (!std::binary_search(edges.begin(), edges.end(), EdgeKey(b, a)))
+			{
+				outBorderEdges.push_back(edges[i]);
+				for (uint32_t v : { a, b })
+				{
+					if (outKinds[v] == VertexKind::Manifold)
+						outKinds[v] = VertexKind::Border;
+				}
+			}
+		}
+		std::sort(outBorderEdges.begin(), outBorderEdges.end());
+	}
+
+	static bool IsBorderEdge(const std::vector<uint64_t>& borderEdges, uint32_t a, uint32_t b)
+	{
+		return std::binary_search(borderEdges.begin(), borderEdges.end(), EdgeKey(a, b))
+			|| std::binary_search(borderEdges.begin(), borderEdges.end(), EdgeKey(b, a));
+	}
+
+	static bool CanCollapse(const std::vector<VertexKind>& kinds, const std::vector<uint64_t>& borderEdges, uint32_t from, uint32_t to)
+	{
+		switch (kinds[from])
+		{
+			case VertexKind::Manifold:	return true;
+			case VertexKind::Border:	return kinds[to] != VertexKind::Manifold && IsBorderEdge(borderEdges, from, to);
+			default:					return false;
+		}
+	}
+
+	// Rejects collapses that would flip any remaining triangle around the removed vertex
+	static bool FlipsTriangles(const glm::vec3* positions, const uint32_t* indices, const uint32_t* adjacency, uint32_t adjacencyCount,
+		uint32_t from, uint32_t to)
+	{
+		for (uint32_t i = 0; i < adjacencyCount; ++i)
+		{
+			const uint32_t* triangle = indices + adjacency[i] * 3;
+			if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+				continue;
+
+			const uint32_t corner = triangle[0] == from ? 0 : (triangle[1] == from ? 1 : 2);
+			const glm::vec3& p1 = positions[triangle[(corner + 1) % 3]];
+			const glm::vec3& p2 = positions[triangle[(corner + 2) % 3]];
+
+			const glm::vec3 before = glm::cross(p1 - positions[from], p2 - positions[from]);
+			const glm::vec3 after = glm::cross(p1 - positions[to], p2 - positions[to]);
+			if (glm::dot(before, after) <= 1e-2f * glm::dot(before, before))
+				return true;
+		}
+
+		return false;
+	}
+
+	uint32_t MeshSimplifier::Simplify(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+		uint32_t targetIndexCount, float targetError, uint32_t* outIndices, float* outError)
+	{
+		memcpy(outIndices, indices, indexCount * sizeof(uint32_t));
+		if (outError)
+			*outError = 0.0f;
+		if (indexCount <= targetIndexCount || vertexCount == 0)
+			return indexCount;
+
+		// Positions are normalized to the unit cube, so quadric errors are relative to the mesh extent
+		glm::vec3 min = vertices[0].Position, max = vertices[0].Position;
+		for (uint32_t v = 1; v < vertexCount; ++v)
+		{
+			min = glm::min(min, vertices[v].Position);
+			max = glm::max(max, vertices[v].Position);
+		}
+		const glm::vec3 size = max - min;
+		const float extent = std::max(std::max(size.x, size.y), size.z);
+		const float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+
+		std::vector<glm::vec3> positions(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; ++v)
+			positions[v] = (vertices[v].Position - min) * scale;
+
+		std::vector<uint32_t> remap, wedgeCount;
+		BuildPositionRemap(positions.data(), vertexCount, remap, wedgeCount);
+
+		std::vector<VertexKind> kinds;
+		std::vector<uint64_t> borderEdges;
+		ClassifyVertices(indices, indexCount, remap, wedgeCount, kinds, borderEdges);
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (uint32_t i = 0; i < indexCount; i += 3)
+		{
+			const glm::vec3& p0 = positions[indices[i + 0]];
+			const glm::vec3& p1 = positions[indices[i + 1]];
+			const glm::vec3& p2 = positions[indices[i + 2]];
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const float area = glm::length(normal);
+			if (area <= 0.0f)
+				continue;
+
+			normal /= area;
+			const Quadric q = Quadric::FromPlane(normal, -glm::dot(normal, p0), area);
+			for (uint32_t c = 0; c < 3; ++c)
+				quadrics[indices[i + c]] += q;
+
+			for (uint32_t e = 0; e < 3; ++e)
+			{
+				const uint32_t a = indices[i + e];
+				const uint32_t b = indices[i + (e + 1) % 3];
+				if (!std::binary_search(borderEdges.begin(), borderEdges.end(), EdgeKey(remap[a], remap[b])))
+					continue;
+
+				// Plane through the border edge, perpendicular to the triangle
+				const glm::vec3 edge = positions[b] - positions[a];
+				const float length = glm::length(edge);
+				if (length <= 0.0f)
+					continue;
+
+				const glm::vec3 edgeNormal = glm::normalize(glm::cross(edge, normal));
+				const Quadric borderQuadric = Quadric::FromPlane(edgeNormal, -glm::dot(edgeNormal, positions[a]), length * BorderWeight);
+				quadrics[a] += borderQuadric;
+				quadrics[b] += borderQuadric;
+			}
+		}
+
+		const float maxCost = targetError * targetError;
+		float resultError = 0.0f;
+		uint32_t resultCount = indexCount;
+
+		std::vector<uint32_t> collapseRemap(vertexCount);
+		std::vector<bool> touched(vertexCount);
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+		std::vector<uint32_t> adjacency;
+		std::vector<Collapse> collapses;
+		std::vector<uint64_t> edges;
+
+		while (resultCount > targetIndexCount)
+		{
+			// Triangles around every vertex for the flip test
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (uint32_t i = 0; i < resultCount; ++i)
+				++adjacencyOffsets[outIndices[i] + 1];
+			for (uint32_t v = 0; v < vertexCount; ++v)
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+			adjacency.resize(resultCount);
+			{
+				std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (uint32_t i = 0; i < resultCount; ++i)
+					adjacency[fill[outIndices[i]]++] = i / 3;
+			}
+
+			edges.clear();
+			for (uint32_t i = 0; i < resultCount; i += 3)
+			{
+				for (uint32_t e = 0; e < 3; ++e)
+				{
+					const uint32_t a = outIndices[i + e];
+					const uint32_t b = outIndices[i + (e + 1) % 3];
+					edges.push_back(EdgeKey(std::min(a, b), std::max(a, b)));
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+			edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+			collapses.clear();
+			for (uint64_t edge : edges)
+			{
+				const uint32_t a = (uint32_t)(edge >> 32);
+				const uint32_t b = (uint32_t)edge;
+
+				Quadric q = quadrics[a];
+				q += quadrics[b];
+
+				Collapse best = { InvalidIndex, InvalidIndex, std::numeric_limits<float>::max() };
+				if (CanCollapse(kinds, borderEdges, remap[a], remap[b]))
+					best = { a, b, q.Error(positions[b]) };
+				if (CanCollapse(kinds, borderEdges, remap[b], remap[a]))
+				{
+					const float cost = q.Error(positions[a]);
+					if (cost < best.Cost)
+						best = { b, a, cost };
+				}
+
+				if (best.From != InvalidIndex && best.Cost <= maxCost)
+					collapses.push_back(best);
+			}
+
+			if (collapses.empty())
+				break;
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.Cost < y.Cost; });
+
+			for (uint32_t v = 0; v < vertexCount; ++v)
+				collapseRemap[v] = v;
+			std::fill(touched.begin(), touched.end(), false);
+
+			// Every collapse removes about two triangles (one on borders), stop once the estimate reaches the target
+			const uint32_t trianglesToRemove = (resultCount - targetIndexCount) / 3;
+			uint32_t trianglesRemoved = 0;
+			uint32_t collapseCount = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (trianglesRemoved >= trianglesToRemove)
+					break;
+
+				// Disjoint collapses only, so quadrics and adjacency stay valid for the whole pass
+				if (touched[collapse.From] || touched[collapse.To])
+					continue;
+
+				const uint32_t* triangles = adjacency.data() + adjacencyOffsets[collapse.From];
+				const uint32_t triangleCount = adjacencyOffsets[collapse.From + 1] - adjacencyOffsets[collapse.From];
+				if (FlipsTriangles(positions.data(), outIndices, triangles, triangleCount, collapse.From, collapse.To))
+					continue;
+
+				collapseRemap[collapse.From] = collapse.To;
+				quadrics[collapse.To] += quadrics[collapse.From];
+				touched[collapse.From] = true;
+				touched[collapse.To] = true;
+
+				// Triangles around the removed vertex change shape, lock their vertices for the rest of the pass
+				for (uint32_t i = 0; i < triangleCount; ++i)
+				{
+					const uint32_t* triangle = outIndices + triangles[i] * 3;
+					if (triangle[0] == collapse.To || triangle[1] == collapse.To || triangle[2] == collapse.To)
+						++trianglesRemoved;
+
+					for (uint32_t c = 0; c < 3; ++c)
+						touched[triangle[c]] = true;
+				}
+
+				resultError = std::max(resultError, collapse.Cost);
+				++collapseCount;
+			}
+
+			if (collapseCount == 0)
+				break;
+
+			uint32_t writeCount = 0;
+			for (uint32_t i = 0; i < resultCount; i += 3)
+			{
+				const uint32_t a = collapseRemap[outIndices[i + 0]];
+				const uint32_t b = collapseRemap[outIndices[i + 1]];
+				const uint32_t c = collapseRemap[outIndices[i + 2]];
+				if (a == b || b == c || a == c)
+					continue;
+
+				outIndices[writeCount++] = a;
+				outIndices[writeCount++] = b;
+				outIndices[writeCount++] = c;
+			}
+			resultCount = writeCount;
+		}
+
+		if (outError)
+			*outError = std::sqrt(resultError);
+		return resultCount;
+	}
+
+	void MeshSimplifier::GenerateLods(MeshData& mesh, const MeshLodSettings& settings)
+	{
+		mesh.Lods.clear();
+		mesh.LodIndexBuffer.clear();
+		if (mesh.IndexCount == 0)
+			return;
+
+		std::vector<uint32_t> previous;
+		mesh.GetIndices(previous);
+		const uint32_t vertexCount = (uint32_t)mesh.Vertices.size();
+
+		std::vector<uint32_t> allLodIndices;
+		std::vector<uint32_t> lod(previous.size());
+		float accumulatedError = 0.0f;
+		for (float ratio : settings.TargetRatios)
+		{
+			const uint32_t target = std::max(3u, (uint32_t)(mesh.IndexCount * ratio) / 3 * 3);
+			float error = 0.0f;
+			const uint32_t count = Simplify(mesh.Vertices.data(), vertexCount, previous.data(), (uint32_t)previous.size(),
+				target, settings.MaxError - accumulatedError, lod.data(), &error);
+
+			if (count == 0 || (float)count > (float)previous.size() * (1.0f - settings.MinReduction))
+				break;
+
+			// Each level is simplified from the previous one, so its error bound is the sum of both
+			accumulatedError += error;
+			MeshOptimizer::OptimizeVertexCache(lod.data(), count, vertexCount, MeshOptimizerSettings().CacheSize);
+
+			mesh.Lods.push_back({ (uint32_t)allLodIndices.size(), count, accumulatedError });
+			allLodIndices.insert(allLodIndices.end(), lod.begin(), lod.begin() + count);
+			previous.assign(lod.begin(), lod.begin() + count);
+		}
+
+		if (mesh.IndexFormat == IndexType::UInt16)
+		{
+			mesh.LodIndexBuffer.resize(allLodIndices.size() * sizeof(uint16_t));
+			uint16_t* dst = (uint16_t*)mesh.LodIndexBuffer.data();
+			for (size_t i = 0; i < allLodIndices.size(); ++i)
+				dst[i] = (uint16_t)allLodIndices[i];
+		}
+		else
+		{
+			mesh.LodIndexBuffer.resize(allLodIndices.size() * sizeof(uint32_t));
+			memcpy(mesh.LodIndexBuffer.data(), allLodIndices.data(), mesh.LodIndexBuffer.size());
+		}
+	}
+}
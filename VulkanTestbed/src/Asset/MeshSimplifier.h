@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Asset/Mesh.h"
+
+namespace VulkanTestbed
+{
+	struct MeshLodSettings
+	{
+		// Triangle count of each level relative to the base mesh
+		std::vector<float> TargetRatios = { 0.5f, 0.25f, 0.125f, 0.0625f };
+		// Maximum deviation of any level relative to the mesh extent
+		float MaxError = 0.02f;
+		// A level that removes less than this share of the previous level's triangles ends the chain
+		float MinReduction = 0.1f;
+	};
+
+	class MeshSimplifier
+	{
+	public:
+		// Bump whenever the produced LODs change, invalidates existing mesh caches
+		static constexpr uint32_t Version = 1;
+
+		// Quadric error edge collapse (Garland & Heckbert 1997). Vertices only ever collapse onto neighbours, so the
+		// result indexes the original vertex buffer. Attribute seams are kept intact and open borders only collapse
+		// along themselves. Returns the new index count, outIndices needs room for indexCount indices.
+		static uint32_t Simplify(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+			uint32_t targetIndexCount, float targetError, uint32_t* outIndices, float* outError = nullptr);
+
+		// Fills mesh.Lods and mesh.LodIndexBuffer, each level is simplified from the previous one
+		static void GenerateLods(MeshData& mesh, const MeshLodSettings& settings = {});
+	};
+}
@@ -0,0 +1,162 @@
+#include "pch.h"
+#include "MeshletBuilder.h"
+
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+
+namespace VulkanTestbed
+{
+	static constexpr uint8_t UnusedLocalIndex = 0xff;
+
+	static void ComputeBounds(const Vertex* vertices, const uint32_t* meshletVertices, const uint8_t* meshletTriangles,
+		const Meshlet& meshlet, MeshletBounds& outBounds)
+	{
+		glm::vec3 min = vertices[meshletVertices[meshlet.VertexOffset]].Position;
+		glm::vec3 max = min;
+		for (uint32_t i = 1; i < meshlet.VertexCount; ++i)
+		{
+			const glm::vec3& p = vertices[meshletVertices[meshlet.VertexOffset + i]].Position;
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+
+		const glm::vec3 center = (min + max) * 0.5f;
+		float radius = 0.0f;
+		for (uint32_t i = 0; i < meshlet.VertexCount; ++i)
+			radius = std::max(radius, glm::distance(center, vertices[meshletVertices[meshlet.VertexOffset + i]].Position));
+
+		// Average facing direction, the cone opens up to the triangle that deviates the most from it
+		auto triangleNormal = [&](uint32_t t)
+		{
+			const uint8_t* triangle = meshletTriangles + meshlet.TriangleOffset + t * 3;
+			const glm::vec3& p0 = vertices[meshletVertices[meshlet.VertexOffset + triangle[0]]].Position;
+			const glm::vec3& p1 = vertices[meshletVertices[meshlet.VertexOffset + triangle[1]]].Position;
+			const glm::vec3& p2 = vertices[meshletVertices[meshlet.VertexOffset + triangle[2]]].Position;
+			const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const float length = glm::length(normal);
+			return length > 0.0f ? normal / length : glm::vec3(0.0f);
+		};
+
+		glm::vec3 axis(0.0f);
+		for (uint32_t t = 0; t < meshlet.TriangleCount; ++t)
+			axis += triangleNormal(t);
+
+		float cutoff = 1.0f;
+		const float axisLength = glm::length(axis);
+		if (axisLength > 0.0f)
+		{
+			axis /= axisLength;
+
+			float minDot = 1.0f;
+			for (uint32_t t = 0; t < meshlet.TriangleCount; ++t)
+			{
+				const glm::vec3 normal = triangleNormal(t);
+				if (normal != glm::vec3(0.0f))
+					minDot = std::min(minDot, glm::dot(axis, normal));
+			}
+
+			// Cones wider than ~85 degrees are never culled in practice, keep them disabled
+			if (minDot > 0.1f)
+				cutoff = std::sqrt(1.0f - minDot * minDot);
+		}
+
+		auto push = [&](MeshletBoundsComponent component, float value) { outBounds[component].push_back(value); };
+		push(MeshletBoundsComponent::CenterX, center.x);
+		push(MeshletBoundsComponent::CenterY, center.y);
+		push(MeshletBoundsComponent::CenterZ, center.z);
+		push(MeshletBoundsComponent::Radius, radius);
+		push(MeshletBoundsComponent::MinX, min.x);
+		push(MeshletBoundsComponent::MinY, min.y);
+		push(MeshletBoundsComponent::MinZ, min.z);
+		push(MeshletBoundsComponent::MaxX, max.x);
+		push(MeshletBoundsComponent::MaxY, max.y);
+		push(MeshletBoundsComponent::MaxZ, max.z);
+		push(MeshletBoundsComponent::ConeAxisX, axis.x);
+		push(MeshletBoundsComponent::ConeAxisY, axis.y);
+		push(MeshletBoundsComponent::ConeAxisZ, axis.z);
+		push(MeshletBoundsComponent::ConeCutoff, cutoff);
+	}
+
+	void MeshletBuilder::Build(MeshData& mesh, const MeshletSettings& settings)
+	{
+		std::vector<uint32_t> indices;
+		mesh.GetIndices(indices);
+		Build(mesh.Vertices.data(), (uint32_t)mesh.Vertices.size(), indices.data(), mesh.IndexCount, settings, mesh.Meshlets);
+	}
+
+	void MeshletBuilder::Build(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+		const MeshletSettings& settings, MeshletData& outMeshlets)
+	{
+		TESTBED_ASSERT(settings.MaxVertices >= 3 && settings.MaxVertices <= 255, "Meshlet local indices are 8 bit and 0xff marks unused vertices!");
+		TESTBED_ASSERT(settings.MaxTriangles >= 1);
+
+		outMeshlets = {};
+		const uint32_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+			return;
+
+		// Lower bound, meshlets usually fill up on vertices before triangles
+		const uint32_t meshletEstimate = triangleCount / settings.MaxTriangles + 1;
+		outMeshlets.Meshlets.reserve(meshletEstimate);
+		outMeshlets.Triangles.reserve(indexCount + meshletEstimate * 4);
+		for (std::vector<float>& component : outMeshlets.Bounds.Components)
+			component.reserve(meshletEstimate);
+
+		std::vector<uint8_t> localIndices(vertexCount, UnusedLocalIndex);
+		Meshlet current = { 0, 0, 0, 0 };
+
+		auto flush = [&]()
+		{
+			if (current.TriangleCount == 0)
+				return;
+
+			for (uint32_t i = 0; i < current.VertexCount; ++i)
+				localIndices[outMeshlets.Vertices[current.VertexOffset + i]] = UnusedLocalIndex;
+
+			ComputeBounds(vertices, outMeshlets.Vertices.data(), outMeshlets.Triangles.data(), current, outMeshlets.Bounds);
+			outMeshlets.Meshlets.push_back(current);
+
+			// Keeps every meshlet's triangles 4 byte aligned so they can be fetched as uints on the GPU
+			outMeshlets.Triangles.resize((outMeshlets.Triangles.size() + 3) & ~size_t(3), 0);
+			current = { (uint32_t)outMeshlets.Vertices.size(), (uint32_t)outMeshlets.Triangles.size(), 0, 0 };
+		};
+
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			const uint32_t a = indices[t * 3 + 0];
+			const uint32_t b = indices[t * 3 + 1];
+			const uint32_t c = indices[t * 3 + 2];
+
+			const uint32_t newVertices = (localIndices[a] == UnusedLocalIndex)
+				+ (localIndices[b] == UnusedLocalIndex && b != a)
+				+ (localIndices[c] == UnusedLocalIndex && c != a && c != b);
+
+			if (current.VertexCount + newVertices > settings.MaxVertices || current.TriangleCount + 1 > settings.MaxTriangles)
+				flush();
+
+			for (uint32_t v : { a, b, c })
+			{
+				uint8_t& local = localIndices[v];
+				if (local == UnusedLocalIndex)
+				{
+					local = (uint8_t)current.VertexCount++;
+					outMeshlets.Vertices.push_back(v);
+				}
+				outMeshlets.Triangles.push_back(local);
+			}
+			++current.TriangleCount;
+		}
+		flush();
+	}
+
+	bool MeshletBuilder::IsBackfacing(const MeshletBoundsView& bounds, uint32_t meshlet, const glm::vec3& cameraPosition)
+	{
+		const glm::vec3 center(bounds[MeshletBoundsComponent::CenterX][meshlet], bounds[MeshletBoundsComponent::CenterY][meshlet], bounds[MeshletBoundsComponent::CenterZ][meshlet]);
+		const glm::vec3 axis(bounds[MeshletBoundsComponent::ConeAxisX][meshlet], bounds[MeshletBoundsComponent::ConeAxisY][meshlet], bounds[MeshletBoundsComponent::ConeAxisZ][meshlet]);
+		const float radius = bounds[MeshletBoundsComponent::Radius][meshlet];
+		const float cutoff = bounds[MeshletBoundsComponent::ConeCutoff][meshlet];
+
+		const glm::vec3 view = center - cameraPosition;
+		return glm::dot(view, axis) >= cutoff * glm::length(view) + radius;
+	}
+}
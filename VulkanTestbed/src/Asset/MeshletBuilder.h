@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+
+#include "Asset/Mesh.h"
+
+namespace VulkanTestbed
+{
+	struct MeshletSettings
+	{
+		// 64/124 fits the output limits preferred by most mesh shader implementations
+		uint32_t MaxVertices = 64;
+		uint32_t MaxTriangles = 124;
+	};
+
+	class MeshletBuilder
+	{
+	public:
+		// Bump whenever the produced meshlets change, invalidates existing mesh caches
+		static constexpr uint32_t Version = 1;
+
+		// Partitions the mesh in index order, run it after vertex cache optimization for compact meshlets
+		static void Build(MeshData& mesh, const MeshletSettings& settings = {});
+		static void Build(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+			const MeshletSettings& settings, MeshletData& outMeshlets);
+
+		// Cone test against the bounding sphere, true when every triangle of the meshlet faces away from the camera
+		static bool IsBackfacing(const MeshletBoundsView& bounds, uint32_t meshlet, const glm::vec3& cameraPosition);
+	};
+}
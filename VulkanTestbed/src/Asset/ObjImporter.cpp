@@ -0,0 +1,543 @@
+#include "pch.h"
+#include "ObjImporter.h"
+
+#include <atomic>
+#include <fstream>
+
+#include <glm/geometric.hpp>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include "Core/Hash.h"
+#include "Core/JobSystem.h"
+#include "Core/Timer.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t EmptySlot = std::numeric_limits<uint32_t>::max();
+	static constexpr size_t MinChunkSize = 1 << 20;
+	static constexpr uint32_t BlockSize = 1 << 16;
+	// Chunks sum generated normals over the range of positions they touch, past this much overlap it's done serially
+	static constexpr uint64_t MaxNormalRangeFactor = 4;
+
+	struct ObjCorner
+	{
+		int32_t Position;
+		int32_t TexCoord;
+		int32_t Normal;
+	};
+
+	struct ObjGroup
+	{
+		uint64_t FirstTriangle;
+		std::string Name;
+	};
+
+	struct ObjChunk
+	{
+		char* Begin = nullptr;
+		char* End = nullptr;
+
+		// Filled by the counting pass, turned into global offsets by a prefix sum
+		uint64_t PositionCount = 0;
+		uint64_t NormalCount = 0;
+		uint64_t TexCoordCount = 0;
+		uint64_t TriangleCount = 0;
+		uint64_t PositionBase = 0;
+		uint64_t NormalBase = 0;
+		uint64_t TexCoordBase = 0;
+		uint64_t TriangleBase = 0;
+		std::vector<ObjGroup> Groups;
+
+		// Face normal sums of the positions [GeneratedNormalBase, GeneratedNormalEnd) for corners without a normal
+		uint64_t GeneratedNormalBase = 0;
+		uint64_t GeneratedNormalEnd = 0;
+		std::vector<glm::vec3> GeneratedNormals;
+
+		bool Failed = false;
+	};
+
+	static char* SkipSpaces(char* token)
+	{
+		while (IS_SPACE(*token))
+			++token;
+		return token;
+	}
+
+	static char* NextLine(char* line, char* end)
+	{
+		char* newLine = (char*)memchr(line, '\n', end - line);
+		return newLine ? newLine + 1 : end;
+	}
+
+	static std::string ParseName(const char* token)
+	{
+		token += strspn(token, " \t");
+		size_t length = strcspn(token, "\r\n");
+		return std::string(token, length);
+	}
+
+	static void CountChunk(ObjChunk& chunk)
+	{
+		for (char* line = chunk.Begin; line < chunk.End; line = NextLine(line, chunk.End))
+		{
+			char* token = SkipSpaces(line);
+			if (token[0] == 'v' && IS_SPACE(token[1]))
+			{
+				++chunk.PositionCount;
+			}
+			else if (token[0] == 'v' && token[1] == 'n' && IS_SPACE(token[2]))
+			{
+				++chunk.NormalCount;
+			}
+			else if (token[0] == 'v' && token[1] == 't' && IS_SPACE(token[2]))
+			{
+				++chunk.TexCoordCount;
+			}
+			else if (token[0] == 'f' && IS_SPACE(token[1]))
+			{
+				uint32_t cornerCount = 0;
+				token += 2;
+				while (true)
+				{
+					token = SkipSpaces(token);
+					if (IS_NEW_LINE(*token) || *token == '#')
+						break;
+
+					++cornerCount;
+					while (!IS_SPACE(*token) && !IS_NEW_LINE(*token))
+						++token;
+				}
+
+				if (cornerCount >= 3)
+					chunk.TriangleCount += cornerCount - 2;
+			}
+			else if ((token[0] == 'o' || token[0] == 'g') && IS_SPACE(token[1]))
+			{
+				chunk.Groups.push_back({ chunk.TriangleCount, ParseName(token + 2) });
+			}
+		}
+	}
+
+	static bool ResolveIndex(int index, uint64_t countSoFar, uint64_t totalCount, int32_t& outIndex)
+	{
+		int resolved = 0;
+		if (!tinyobj::fixIndex(index, (int)countSoFar, &resolved) || resolved < 0 || (uint64_t)resolved >= totalCount)
+			return false;
+
+		outIndex = resolved;
+		return true;
+	}
+
+	struct ObjAttributes
+	{
+		glm::vec3* Positions;
+		glm::vec3* Normals;
+		glm::vec2* TexCoords;
+		uint64_t PositionCount;
+		uint64_t NormalCount;
+		uint64_t TexCoordCount;
+	};
+
+	static void ParseChunk(ObjChunk& chunk, const ObjAttributes& attributes, ObjCorner* corners)
+	{
+		uint64_t positionCount = chunk.PositionBase;
+		uint64_t normalCount = chunk.NormalBase;
+		uint64_t texCoordCount = chunk.TexCoordBase;
+		ObjCorner* corner = corners + chunk.TriangleBase * 3;
+
+		for (char* line = chunk.Begin; line < chunk.End; )
+		{
+			char* next = NextLine(line, chunk.End);
+			// tinyobj's tokenizers expect null terminated lines, each chunk only ever touches its own range
+			if (next[-1] == '\n')
+				next[-1] = '\0';
+
+			const char* token = SkipSpaces(line);
+			if (token[0] == 'v' && IS_SPACE(token[1]))
+			{
+				token += 2;
+				glm::vec3& p = attributes.Positions[positionCount++];
+				tinyobj::parseReal3(&p.x, &p.y, &p.z, &token);
+			}
+			else if (token[0] == 'v' && token[1] == 'n' && IS_SPACE(token[2]))
+			{
+				token += 3;
+				glm::vec3& n = attributes.Normals[normalCount++];
+				tinyobj::parseReal3(&n.x, &n.y, &n.z, &token);
+			}
+			else if (token[0] == 'v' && token[1] == 't' && IS_SPACE(token[2]))
+			{
+				token += 3;
+				glm::vec2& t = attributes.TexCoords[texCoordCount++];
+				tinyobj::parseReal2(&t.x, &t.y, &token);
+				// OBJ has the origin at the bottom left, Vulkan samples from the top left
+				t.y = 1.0f - t.y;
+			}
+			else if (token[0] == 'f' && IS_SPACE(token[1]))
+			{
+				token += 2;
+
+				ObjCorner first = {}, previous = {};
+				uint32_t cornerIndex = 0;
+				while (true)
+				{
+					token += strspn(token, " \t");
+					if (IS_NEW_LINE(*token) || *token == '#')
+						break;
+
+					tinyobj::vertex_index_t raw = tinyobj::parseRawTriple(&token);
+					ObjCorner current = { -1, -1, -1 };
+					if (!ResolveIndex(raw.v_idx, positionCount, attributes.PositionCount, current.Position)
+						|| (raw.vt_idx != 0 && !ResolveIndex(raw.vt_idx, texCoordCount, attributes.TexCoordCount, current.TexCoord))
+						|| (raw.vn_idx != 0 && !ResolveIndex(raw.vn_idx, normalCount, attributes.NormalCount, current.Normal)))
+					{
+						chunk.Failed = true;
+						return;
+					}
+
+					if (cornerIndex >= 2)
+					{
+						*corner++ = first;
+						*corner++ = previous;
+						*corner++ = current;
+					}
+					else if (cornerIndex == 0)
+					{
+						first = current;
+					}
+
+					previous = current;
+					++cornerIndex;
+				}
+			}
+
+			line = next;
+		}
+	}
+
+	static void AccumulateFaceNormals(const ObjCorner* corners, uint64_t triangleCount, const glm::vec3* positions, glm::vec3* sums, uint64_t sumBase)
+	{
+		for (uint64_t i = 0; i < triangleCount * 3; i += 3)
+		{
+			const ObjCorner* triangle = &corners[i];
+			if (triangle[0].Normal >= 0 && triangle[1].Normal >= 0 && triangle[2].Normal >= 0)
+				continue;
+
+			const glm::vec3& p0 = positions[triangle[0].Position];
+			const glm::vec3 faceNormal = glm::cross(positions[triangle[1].Position] - p0, positions[triangle[2].Position] - p0);
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				if (triangle[c].Normal < 0)
+					sums[triangle[c].Position - sumBase] += faceNormal;
+			}
+		}
+	}
+
+	// Area weighted smooth normals for faces that don't reference any. Every chunk sums its own faces, the sums are
+	// then added up in chunk order, so the result doesn't depend on scheduling. Empty when no face needs them.
+	static void GenerateNormals(std::vector<ObjChunk>& chunks, const ObjCorner* corners, const glm::vec3* positions, uint64_t positionCount,
+		std::vector<glm::vec3>& outNormals)
+	{
+		ParallelFor((uint32_t)chunks.size(), [&](uint32_t i)
+		{
+			ObjChunk& chunk = chunks[i];
+			uint64_t first = std::numeric_limits<uint64_t>::max(), last = 0;
+			const ObjCorner* corner = corners + chunk.TriangleBase * 3;
+			for (uint64_t c = 0; c < chunk.TriangleCount * 3; ++c)
+			{
+				if (corner[c].Normal >= 0)
+					continue;
+				first = std::min(first, (uint64_t)corner[c].Position);
+				last = std::max(last, (uint64_t)corner[c].Position + 1);
+			}
+			chunk.GeneratedNormalBase = first < last ? first : 0;
+			chunk.GeneratedNormalEnd = first < last ? last : 0;
+		});
+
+		uint64_t rangeSum = 0;
+		for (const ObjChunk& chunk : chunks)
+			rangeSum += chunk.GeneratedNormalEnd - chunk.GeneratedNormalBase;
+		if (rangeSum == 0)
+			return;
+
+		outNormals.assign(positionCount, glm::vec3(0.0f));
+		if (rangeSum > positionCount * MaxNormalRangeFactor)
+		{
+			// Faces reference positions all over the file, per chunk sums would take more memory than they save time
+			for (const ObjChunk& chunk : chunks)
+				AccumulateFaceNormals(corners + chunk.TriangleBase * 3, chunk.TriangleCount, positions, outNormals.data(), 0);
+		}
+		else
+		{
+			ParallelFor((uint32_t)chunks.size(), [&](uint32_t i)
+			{
+				ObjChunk& chunk = chunks[i];
+				chunk.GeneratedNormals.assign(chunk.GeneratedNormalEnd - chunk.GeneratedNormalBase, glm::vec3(0.0f));
+				AccumulateFaceNormals(corners + chunk.TriangleBase * 3, chunk.TriangleCount, positions, chunk.GeneratedNormals.data(), chunk.GeneratedNormalBase);
+			});
+		}
+
+		const uint32_t blockCount = (uint32_t)((positionCount + BlockSize - 1) / BlockSize);
+		ParallelFor(blockCount, [&](uint32_t block)
+		{
+			const uint64_t begin = (uint64_t)block * BlockSize;
+			const uint64_t end = std::min(positionCount, begin + BlockSize);
+			for (const ObjChunk& chunk : chunks)
+			{
+				const uint64_t overlapBegin = std::max(begin, chunk.GeneratedNormalBase);
+				const uint64_t overlapEnd = std::min(end, chunk.GeneratedNormalBase + chunk.GeneratedNormals.size());
+				for (uint64_t i = overlapBegin; i < overlapEnd; ++i)
+					outNormals[i] += chunk.GeneratedNormals[i - chunk.GeneratedNormalBase];
+			}
+
+			for (uint64_t i = begin; i < end; ++i)
+			{
+				const float length = glm::length(outNormals[i]);
+				outNormals[i] = length > 0.0f ? outNormals[i] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+			}
+		});
+
+		for (ObjChunk& chunk : chunks)
+			std::vector<glm::vec3>().swap(chunk.GeneratedNormals);
+	}
+
+	static bool CornerEquals(const ObjCorner& a, const ObjCorner& b)
+	{
+		return a.Position == b.Position && a.TexCoord == b.TexCoord && a.Normal == b.Normal;
+	}
+
+	static uint64_t HashCorner(const ObjCorner& corner)
+	{
+		uint64_t packed = (uint64_t)(uint32_t)corner.Position | ((uint64_t)(uint32_t)corner.TexCoord << 32);
+		return HashCombine(Mix64(packed), (uint32_t)corner.Normal);
+	}
+
+	// Builds one indexed mesh out of a range of triangle corners.
+	// Unique (position, normal, uv) tuples are found with a lock free open addressing table that keeps the lowest
+	// corner index per key, which makes the resulting vertex order deterministic (first occurrence) regardless of threading.
+	static void BuildMesh(const ObjCorner* corners, uint32_t cornerCount, const glm::vec3* positions, const glm::vec3* normals,
+		const glm::vec2* texCoords, const glm::vec3* generatedNormals, MeshData& outMesh)
+	{
+		// In size_t, one and a half times a large corner count doesn't fit 32 bits
+		size_t capacity = 16;
+		while (capacity < (size_t)cornerCount + cornerCount / 2)
+			capacity <<= 1;
+		const size_t mask = capacity - 1;
+
+		std::unique_ptr<std::atomic<uint32_t>[]> table(new std::atomic<uint32_t>[capacity]);
+		std::vector<uint32_t> representative(cornerCount);
+		std::vector<uint32_t> vertexIds(cornerCount);
+
+		const uint32_t blockCount = (uint32_t)(((size_t)cornerCount + BlockSize - 1) / BlockSize);
+		const uint32_t tableBlockCount = (uint32_t)((capacity + BlockSize - 1) / BlockSize);
+		const auto blockEnd = [](uint32_t block, size_t count) { return std::min(count, (size_t)(block + 1) * BlockSize); };
+
+		ParallelFor(tableBlockCount, [&](uint32_t block)
+		{
+			const size_t end = blockEnd(block, capacity);
+			for (size_t i = (size_t)block * BlockSize; i < end; ++i)
+				table[i].store(EmptySlot, std::memory_order_relaxed);
+		});
+
+		auto forEachCorner = [&](auto&& func)
+		{
+			ParallelFor(blockCount, [&](uint32_t block)
+			{
+				const uint32_t end = (uint32_t)blockEnd(block, cornerCount);
+				for (uint32_t i = block * BlockSize; i < end; ++i)
+					func(i);
+			});
+		};
+
+		forEachCorner([&](uint32_t corner)
+		{
+			size_t slot = (size_t)HashCorner(corners[corner]) & mask;
+			while (true)
+			{
+				uint32_t current = table[slot].load(std::memory_order_relaxed);
+				if (current == EmptySlot)
+				{
+					if (table[slot].compare_exchange_weak(current, corner, std::memory_order_relaxed))
+						return;
+					continue;
+				}
+
+				if (CornerEquals(corners[current], corners[corner]))
+				{
+					// Only a lower corner with the same key can replace the slot value from here on
+					while (corner < current && !table[slot].compare_exchange_weak(current, corner, std::memory_order_relaxed)) {}
+					return;
+				}
+
+				slot = (slot + 1) & mask;
+			}
+		});
+
+		std::vector<uint32_t> blockUniqueCount(blockCount, 0);
+		ParallelFor(blockCount, [&](uint32_t block)
+		{
+			uint32_t uniqueCount = 0;
+			const uint32_t end = (uint32_t)blockEnd(block, cornerCount);
+			for (uint32_t corner = block * BlockSize; corner < end; ++corner)
+			{
+				size_t slot = (size_t)HashCorner(corners[corner]) & mask;
+				uint32_t current = table[slot].load(std::memory_order_relaxed);
+				while (!CornerEquals(corners[current], corners[corner]))
+				{
+					slot = (slot + 1) & mask;
+					current = table[slot].load(std::memory_order_relaxed);
+				}
+
+				representative[corner] = current;
+				uniqueCount += current == corner;
+			}
+			blockUniqueCount[block] = uniqueCount;
+		});
+		table.reset();
+
+		std::vector<uint32_t> blockOffsets(blockCount, 0);
+		uint32_t vertexCount = 0;
+		for (uint32_t block = 0; block < blockCount; ++block)
+		{
+			blockOffsets[block] = vertexCount;
+			vertexCount += blockUniqueCount[block];
+		}
+
+		outMesh.Vertices.resize(vertexCount);
+		ParallelFor(blockCount, [&](uint32_t block)
+		{
+			uint32_t vertexId = blockOffsets[block];
+			const uint32_t end = (uint32_t)blockEnd(block, cornerCount);
+			for (uint32_t corner = block * BlockSize; corner < end; ++corner)
+			{
+				if (representative[corner] != corner)
+					continue;
+
+				const ObjCorner& c = corners[corner];
+				Vertex& vertex = outMesh.Vertices[vertexId];
+				vertex.Position = positions[c.Position];
+				vertex.Normal = c.Normal >= 0 ? normals[c.Normal] : generatedNormals[c.Position];
+				vertex.TexCoord = c.TexCoord >= 0 ? texCoords[c.TexCoord] : glm::vec2(0.0f);
+				vertexIds[corner] = vertexId++;
+			}
+		});
+
+		// Every representative has its id at this point, remap all corners to them
+		forEachCorner([&](uint32_t corner)
+		{
+			representative[corner] = vertexIds[representative[corner]];
+		});
+
+		outMesh.SetIndices(representative.data(), cornerCount);
+		outMesh.ComputeBounds();
+	}
+
+	bool ObjImporter::Import(const std::filesystem::path& path, std::vector<MeshData>& outMeshes)
+	{
+		Timer timer;
+
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			LOG_ERROR("ObjImporter: Failed to open {}", path.string());
+			return false;
+		}
+
+		const size_t fileSize = (size_t)file.tellg();
+		file.seekg(0);
+		// Trailing null so the last line is terminated even without a new line
+		std::vector<char> buffer(fileSize + 1, '\0');
+		file.read(buffer.data(), fileSize);
+		file.close();
+		const double readTime = timer.ElapsedMillis();
+
+		// Chunks are split at line boundaries, a few per thread to balance uneven lines
+		const uint32_t threadCount = JobSystem::GetThreadCount();
+		const size_t targetChunkSize = std::max(MinChunkSize, fileSize / (threadCount * 4) + 1);
+		std::vector<ObjChunk> chunks;
+		{
+			char* begin = buffer.data();
+			char* end = buffer.data() + fileSize;
+			while (begin < end)
+			{
+				char* chunkEnd = begin + std::min(targetChunkSize, (size_t)(end - begin));
+				chunkEnd = chunkEnd < end ? NextLine(chunkEnd, end) : end;
+				ObjChunk& chunk = chunks.emplace_back();
+				chunk.Begin = begin;
+				chunk.End = chunkEnd;
+				begin = chunkEnd;
+			}
+		}
+
+		ParallelFor((uint32_t)chunks.size(), [&](uint32_t i) { CountChunk(chunks[i]); });
+
+		uint64_t positionCount = 0, normalCount = 0, texCoordCount = 0, triangleCount = 0;
+		std::vector<ObjGroup> groups;
+		groups.push_back({ 0, path.stem().string() });
+		for (ObjChunk& chunk : chunks)
+		{
+			chunk.PositionBase = positionCount;
+			chunk.NormalBase = normalCount;
+			chunk.TexCoordBase = texCoordCount;
+			chunk.TriangleBase = triangleCount;
+			for (ObjGroup& group : chunk.Groups)
+				groups.push_back({ triangleCount + group.FirstTriangle, std::move(group.Name) });
+
+			positionCount += chunk.PositionCount;
+			normalCount += chunk.NormalCount;
+			texCoordCount += chunk.TexCoordCount;
+			triangleCount += chunk.TriangleCount;
+		}
+
+		if (triangleCount * 3 > std::numeric_limits<uint32_t>::max())
+		{
+			LOG_ERROR("ObjImporter: {} has too many triangles ({})", path.string(), triangleCount);
+			return false;
+		}
+
+		std::vector<glm::vec3> positions(positionCount);
+		std::vector<glm::vec3> normals(normalCount);
+		std::vector<glm::vec2> texCoords(texCoordCount);
+		std::vector<ObjCorner> corners(triangleCount * 3);
+		const ObjAttributes attributes = { positions.data(), normals.data(), texCoords.data(), positionCount, normalCount, texCoordCount };
+		ParallelFor((uint32_t)chunks.size(), [&](uint32_t i) { ParseChunk(chunks[i], attributes, corners.data()); });
+
+		for (const ObjChunk& chunk : chunks)
+		{
+			if (chunk.Failed)
+			{
+				LOG_ERROR("ObjImporter: {} references an invalid vertex index", path.string());
+				return false;
+			}
+		}
+		const double parseTime = timer.ElapsedMillis();
+
+		std::vector<glm::vec3> generatedNormals;
+		GenerateNormals(chunks, corners.data(), positions.data(), positionCount, generatedNormals);
+
+		outMeshes.clear();
+		for (size_t g = 0; g < groups.size(); ++g)
+		{
+			const uint64_t first = groups[g].FirstTriangle;
+			const uint64_t last = g + 1 < groups.size() ? groups[g + 1].FirstTriangle : triangleCount;
+			if (last <= first)
+				continue;
+
+			MeshData& mesh = outMeshes.emplace_back();
+			mesh.Name = groups[g].Name;
+			BuildMesh(corners.data() + first * 3, (uint32_t)((last - first) * 3), positions.data(), normals.data(),
+				texCoords.data(), generatedNormals.data(), mesh);
+		}
+
+		uint64_t vertexCount = 0;
+		for (const MeshData& mesh : outMeshes)
+			vertexCount += mesh.Vertices.size();
+
+		LOG_INFO("ObjImporter: {} -> {} meshes, {} triangles, {} vertices ({} chunks, {} threads)",
+			path.filename().string(), outMeshes.size(), triangleCount, vertexCount, chunks.size(), threadCount);
+		LOG_INFO("\tread {:.2f} ms, parse {:.2f} ms, dedup {:.2f} ms", readTime, parseTime - readTime, timer.ElapsedMillis() - parseTime);
+		return true;
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <filesystem>
+
+#include "Asset/Mesh.h"
+
+namespace VulkanTestbed
+{
+	class ObjImporter
+	{
+	public:
+		// Bump whenever the produced mesh data changes, invalidates existing mesh caches
+		static constexpr uint32_t Version = 2;
+
+		// Parses the file in parallel chunks and emits one deduplicated mesh per 'o'/'g' group.
+		// Materials are ignored, polygons are fan triangulated.
+		static bool Import(const std::filesystem::path& path, std::vector<MeshData>& outMeshes);
+	};
+}
@@ -0,0 +1,69 @@
+#include "pch.h"
+#include "SourceFile.h"
+
+#include <fstream>
+
+#include "Core/Hash.h"
+#include "Core/MappedFile.h"
+
+namespace VulkanTestbed
+{
+	static bool GetSourceTimestamp(const std::filesystem::path& path, SourceFileInfo& outInfo)
+	{
+		std::error_code error;
+		outInfo.Size = std::filesystem::file_size(path, error);
+		if (error)
+			return false;
+
+		outInfo.WriteTime = (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+		return !error;
+	}
+
+	static bool HashSourceFile(const std::filesystem::path& path, uint64_t& outHash)
+	{
+		MappedFile file;
+		if (!file.Open(path))
+			return false;
+
+		outHash = Hash64(file.GetData(), file.GetSize());
+		return true;
+	}
+
+	bool ReadSourceFileInfo(const std::filesystem::path& path, SourceFileInfo& outInfo)
+	{
+		return GetSourceTimestamp(path, outInfo) && HashSourceFile(path, outInfo.Hash);
+	}
+
+	bool IsSourceFileUnchanged(const std::filesystem::path& path, const SourceFileInfo& recorded, bool* outTouched)
+	{
+		if (outTouched)
+			*outTouched = false;
+
+		SourceFileInfo source;
+		if (!GetSourceTimestamp(path, source) || (source.Size == recorded.Size && source.WriteTime == recorded.WriteTime))
+			return true;
+
+		if (source.Size != recorded.Size || !HashSourceFile(path, source.Hash) || source.Hash != recorded.Hash)
+			return false;
+
+		if (outTouched)
+			*outTouched = true;
+		return true;
+	}
+
+	bool UpdateSourceWriteTime(const std::filesystem::path& cachePath, uint64_t offset, const std::filesystem::path& sourcePath)
+	{
+		SourceFileInfo source;
+		if (!GetSourceTimestamp(sourcePath, source))
+			return false;
+
+		std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+		if (!file)
+			return false;
+
+		file.seekp((std::streamoff)offset);
+		file.write((const char*)&source.WriteTime, sizeof(source.WriteTime));
+		file.close();
+		return (bool)file;
+	}
+}
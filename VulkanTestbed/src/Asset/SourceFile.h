@@ -0,0 +1,25 @@
+#pragma once
+
+#include <filesystem>
+
+namespace VulkanTestbed
+{
+	// Identifies the source an asset cache was built from
+	struct SourceFileInfo
+	{
+		uint64_t Hash = 0;
+		uint64_t Size = 0;
+		int64_t WriteTime = 0;
+	};
+
+	// Size, write time and content hash
+	bool ReadSourceFileInfo(const std::filesystem::path& path, SourceFileInfo& outInfo);
+
+	// A matching size and write time is trusted, otherwise the content hash decides so touched files don't force a rebuild.
+	// A missing source counts as unchanged, caches can ship without their sources. outTouched is set when only the hash
+	// matched, record the new write time with UpdateSourceWriteTime so the next check doesn't hash the file again.
+	bool IsSourceFileUnchanged(const std::filesystem::path& path, const SourceFileInfo& recorded, bool* outTouched = nullptr);
+
+	// Overwrites the write time a cache recorded at offset with the source's current one, the cache must not be mapped
+	bool UpdateSourceWriteTime(const std::filesystem::path& cachePath, uint64_t offset, const std::filesystem::path& sourcePath);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+namespace VulkanTestbed
+{
+	enum class TextureFormat : uint32_t
+	{
+		RGBA8 = 0,
+		// 4x4 blocks: RGB with 8 bytes per block
+		BC1,
+		// BC1 color plus a BC4 alpha block, 16 bytes
+		BC3,
+		// Two BC4 blocks for red and green, meant for tangent space normal maps
+		BC5,
+		// RGBA with 16 bytes per block, encoded with the single subset modes 5 and 6
+		BC7
+	};
+
+	inline const char* TextureFormatToString(TextureFormat format)
+	{
+		switch (format)
+		{
+			case TextureFormat::RGBA8:	return "RGBA8";
+			case TextureFormat::BC1:	return "BC1";
+			case TextureFormat::BC3:	return "BC3";
+			case TextureFormat::BC5:	return "BC5";
+			case TextureFormat::BC7:	return "BC7";
+		}
+		return "Unknown";
+	}
+
+	struct TextureMip
+	{
+		// Into TextureData::Pixels
+		size_t Offset;
+		uint32_t Width;
+		uint32_t Height;
+	};
+
+	// Tightly packed texels or blocks for every mip level, level 0 first
+	struct TextureData
+	{
+		std::string Name;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		TextureFormat Format = TextureFormat::RGBA8;
+		// Color data is sampled with sRGB decoding, normal maps and other data textures are not
+		bool SRGB = true;
+		std::vector<TextureMip> Mips;
+		std::vector<uint8_t> Pixels;
+
+		static constexpr uint32_t BytesPerPixel = 4;
+
+		// Texels along each side of a block, 1 for uncompressed formats
+		uint32_t GetBlockDimension() const { return Format == TextureFormat::RGBA8 ? 1 : 4; }
+		uint32_t GetBytesPerBlock() const
+		{
+			switch (Format)
+			{
+				case TextureFormat::RGBA8:	return BytesPerPixel;
+				case TextureFormat::BC1:	return 8;
+				default:					return 16;
+			}
+		}
+
+		uint32_t GetMipCount() const { return (uint32_t)Mips.size(); }
+		uint32_t GetBlockRowCount(uint32_t mip) const { return (Mips[mip].Height + GetBlockDimension() - 1) / GetBlockDimension(); }
+		size_t GetRowPitch(uint32_t mip) const { return (size_t)((Mips[mip].Width + GetBlockDimension() - 1) / GetBlockDimension()) * GetBytesPerBlock(); }
+		size_t GetMipSize(uint32_t mip) const { return GetRowPitch(mip) * GetBlockRowCount(mip); }
+		const uint8_t* GetMipPixels(uint32_t mip) const { return Pixels.data() + Mips[mip].Offset; }
+		uint8_t* GetMipPixels(uint32_t mip) { return Pixels.data() + Mips[mip].Offset; }
+	};
+}
@@ -0,0 +1,237 @@
+#include "pch.h"
+#include "TextureCache.h"
+
+#include <fstream>
+
+#include "Core/MappedFile.h"
+#include "Core/Timer.h"
+#include "Asset/SourceFile.h"
+#include "Asset/TextureImporter.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t TextureCacheMagic = 0x58455454; // "TTEX"
+	static constexpr uint32_t TextureCacheFormatVersion = 1;
+	static constexpr uint64_t MipAlignment = 64;
+
+	struct TextureCacheHeader
+	{
+		uint32_t Magic;
+		uint32_t FormatVersion;
+		uint32_t ImporterVersion;
+		uint32_t CompressorVersion;
+
+		uint64_t SourceHash;
+		uint64_t SourceSize;
+		int64_t SourceWriteTime;
+
+		uint64_t FileSize;
+		uint32_t Compression;
+		uint32_t NormalMap;
+		uint32_t Format;
+		uint32_t SRGB;
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t MipCount;
+		uint32_t Padding;
+	};
+
+	struct TextureCacheMip
+	{
+		uint64_t Offset;
+		uint64_t Size;
+		uint32_t Width;
+		uint32_t Height;
+	};
+
+	static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	static bool WriteCache(const std::filesystem::path& cachePath, const SourceFileInfo& source, TextureCompression quality, bool normalMap, const TextureData& texture)
+	{
+		// Workers may build caches for different sources at the same time, but never for the same one
+		std::filesystem::path tempPath = cachePath;
+		tempPath += ".tmp";
+
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		TextureCacheHeader header = {};
+		header.Magic = TextureCacheMagic;
+		header.FormatVersion = TextureCacheFormatVersion;
+		header.ImporterVersion = TextureImporter::Version;
+		header.CompressorVersion = TextureCompressor::Version;
+		header.SourceHash = source.Hash;
+		header.SourceSize = source.Size;
+		header.SourceWriteTime = source.WriteTime;
+		header.Compression = (uint32_t)quality;
+		header.NormalMap = normalMap ? 1 : 0;
+		header.Format = (uint32_t)texture.Format;
+		header.SRGB = texture.SRGB ? 1 : 0;
+		header.Width = texture.Width;
+		header.Height = texture.Height;
+		header.MipCount = texture.GetMipCount();
+
+		std::vector<TextureCacheMip> mips(header.MipCount);
+		uint64_t offset = AlignUp(sizeof(TextureCacheHeader) + mips.size() * sizeof(TextureCacheMip), MipAlignment);
+		for (uint32_t mip = 0; mip < header.MipCount; ++mip)
+		{
+			mips[mip] = { offset, texture.GetMipSize(mip), texture.Mips[mip].Width, texture.Mips[mip].Height };
+			offset = AlignUp(offset + mips[mip].Size, MipAlignment);
+		}
+		header.FileSize = offset;
+
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)mips.data(), (std::streamsize)(mips.size() * sizeof(TextureCacheMip)));
+		for (uint32_t mip = 0; mip < header.MipCount; ++mip)
+		{
+			file.seekp((std::streamoff)mips[mip].Offset);
+			file.write((const char*)texture.GetMipPixels(mip), (std::streamsize)mips[mip].Size);
+		}
+
+		// Pad the last mip so the file size matches the header
+		static const char zeros[MipAlignment] = {};
+		const uint64_t end = header.MipCount > 0 ? mips.back().Offset + mips.back().Size : (uint64_t)file.tellp();
+		file.write(zeros, (std::streamsize)(header.FileSize - end));
+		file.close();
+		if (!file)
+			return false;
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, cachePath, error);
+		return !error;
+	}
+
+	std::filesystem::path TextureCache::GetCachePath(const std::filesystem::path& sourcePath)
+	{
+		std::filesystem::path cachePath = sourcePath;
+		cachePath += ".texcache";
+		return cachePath;
+	}
+
+	bool TextureCache::Load(const std::filesystem::path& sourcePath, TextureCompression quality, bool normalMap, TextureData& outTexture)
+	{
+		const std::filesystem::path cachePath = GetCachePath(sourcePath);
+		if (Read(cachePath, sourcePath, quality, normalMap, outTexture))
+			return true;
+
+		if (!Build(sourcePath, cachePath, quality, normalMap, outTexture))
+		{
+			LOG_ERROR("TextureCache: Failed to build {}", cachePath.string());
+			return false;
+		}
+		return true;
+	}
+
+	bool TextureCache::Read(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath, TextureCompression quality, bool normalMap, TextureData& outTexture)
+	{
+		MappedFile file;
+		if (!file.Open(cachePath))
+			return false;
+
+		const uint8_t* base = file.GetData();
+		const size_t size = file.GetSize();
+		const TextureCacheHeader* header = (const TextureCacheHeader*)base;
+
+		bool valid = size >= sizeof(TextureCacheHeader)
+			&& header->Magic == TextureCacheMagic
+			&& header->FormatVersion == TextureCacheFormatVersion
+			&& header->ImporterVersion == TextureImporter::Version
+			&& header->CompressorVersion == TextureCompressor::Version
+			&& header->FileSize == size
+			&& sizeof(TextureCacheHeader) + (uint64_t)header->MipCount * sizeof(TextureCacheMip) <= size;
+
+		valid = valid
+			&& header->Format <= (uint32_t)TextureFormat::BC7
+			&& header->MipCount >= 1
+			&& header->MipCount <= TextureImporter::GetMipCount(header->Width, header->Height);
+
+		if (valid)
+		{
+			// Every mip has to hold exactly what its format and size need, a truncated entry would upload garbage
+			TextureData layout;
+			layout.Format = (TextureFormat)header->Format;
+			const TextureCacheMip* mips = (const TextureCacheMip*)(base + sizeof(TextureCacheHeader));
+			for (uint32_t mip = 0; mip < header->MipCount && valid; ++mip)
+			{
+				layout.Mips.push_back({ 0, std::max(1u, header->Width >> mip), std::max(1u, header->Height >> mip) });
+				valid = mips[mip].Width == layout.Mips[mip].Width && mips[mip].Height == layout.Mips[mip].Height
+					&& mips[mip].Size == layout.GetMipSize(mip)
+					&& mips[mip].Offset % MipAlignment == 0 && mips[mip].Offset <= size && mips[mip].Size <= size - mips[mip].Offset;
+			}
+		}
+
+		if (!valid)
+		{
+			LOG_WARN("TextureCache: {} is corrupt or was written by another version, rebuilding", cachePath.filename().string());
+			return false;
+		}
+
+		// Built with other settings, not an error
+		if (header->Compression != (uint32_t)quality || header->NormalMap != (normalMap ? 1u : 0u))
+			return false;
+
+		bool touched = false;
+		if (!IsSourceFileUnchanged(sourcePath, { header->SourceHash, header->SourceSize, header->SourceWriteTime }, &touched))
+		{
+			LOG_INFO("TextureCache: {} is stale, rebuilding", cachePath.filename().string());
+			return false;
+		}
+
+		const TextureCacheMip* mips = (const TextureCacheMip*)(base + sizeof(TextureCacheHeader));
+		outTexture.Name = sourcePath.filename().string();
+		outTexture.Width = header->Width;
+		outTexture.Height = header->Height;
+		outTexture.Format = (TextureFormat)header->Format;
+		outTexture.SRGB = header->SRGB != 0;
+		outTexture.Mips.resize(header->MipCount);
+
+		size_t offset = 0;
+		for (uint32_t mip = 0; mip < header->MipCount; ++mip)
+		{
+			outTexture.Mips[mip] = { offset, mips[mip].Width, mips[mip].Height };
+			offset += mips[mip].Size;
+		}
+
+		outTexture.Pixels.resize(offset);
+		for (uint32_t mip = 0; mip < header->MipCount; ++mip)
+			memcpy(outTexture.GetMipPixels(mip), base + mips[mip].Offset, mips[mip].Size);
+
+		// Same contents under a new write time, remembered so later loads don't hash the source again
+		file.Close();
+		if (touched && !UpdateSourceWriteTime(cachePath, offsetof(TextureCacheHeader, SourceWriteTime), sourcePath))
+			LOG_WARN("TextureCache: Failed to update the source write time in {}", cachePath.filename().string());
+		return true;
+	}
+
+	bool TextureCache::Build(const std::filesystem::path& sourcePath, const std::filesystem::path& cachePath, TextureCompression quality, bool normalMap, TextureData& outTexture)
+	{
+		SourceFileInfo source;
+		if (!ReadSourceFileInfo(sourcePath, source))
+			return false;
+
+		TextureData texture;
+		if (!TextureImporter::Import(sourcePath, texture))
+			return false;
+		texture.SRGB = !normalMap;
+
+		Timer timer;
+		const TextureFormat format = TextureCompressor::ChooseFormat(texture, quality, normalMap);
+		TextureCompressor::Compress(texture, format, quality, outTexture);
+		const double compressMillis = timer.ElapsedMillis();
+
+		TextureData decompressed;
+		TextureCompressor::Decompress(outTexture, decompressed);
+		LOG_INFO("TextureCache: Compressed {} to {} ({}x{}, {} mips) in {:.2f} ms, PSNR {:.2f} dB, {:.1f} MB -> {:.1f} MB",
+			outTexture.Name, TextureFormatToString(format), outTexture.Width, outTexture.Height, outTexture.GetMipCount(), compressMillis,
+			TextureCompressor::ComputePSNR(texture, decompressed, format),
+			(double)texture.Pixels.size() / (1024.0 * 1024.0), (double)outTexture.Pixels.size() / (1024.0 * 1024.0));
+
+		if (!WriteCache(cachePath, source, quality, normalMap, outTexture))
+			LOG_WARN("TextureCache: Failed to write {}", cachePath.string());
+		return true;
+	}
+}
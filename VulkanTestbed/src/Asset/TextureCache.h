@@ -0,0 +1,24 @@
+#pragma once
+
+#include <filesystem>
+
+#include "Asset/Texture.h"
+#include "Asset/TextureCompressor.h"
+
+namespace VulkanTestbed
+{
+	// Block compressed mip chains stored next to their source image, so a texture is only encoded once
+	class TextureCache
+	{
+	public:
+		// Reads the cached mip chain, importing and compressing the source first when the cache is missing,
+		// stale or was built with other settings. Safe to call from several threads for different sources.
+		static bool Load(const std::filesystem::path& sourcePath, TextureCompression quality, bool normalMap, TextureData& outTexture);
+
+		static std::filesystem::path GetCachePath(const std::filesystem::path& sourcePath);
+
+	private:
+		static bool Read(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath, TextureCompression quality, bool normalMap, TextureData& outTexture);
+		static bool Build(const std::filesystem::path& sourcePath, const std::filesystem::path& cachePath, TextureCompression quality, bool normalMap, TextureData& outTexture);
+	};
+}
@@ -0,0 +1,987 @@
+#include "pch.h"
+#include "TextureCompressor.h"
+
+#include <cfloat>
+#include <cmath>
+
+#include "Core/JobSystem.h"
+#include "Core/Simd.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t BlockTexelCount = 16;
+	// Block rows handed to a worker at once
+	static constexpr uint32_t BandHeight = 8;
+
+	static constexpr uint8_t BC7Weights2[4] = { 0, 21, 43, 64 };
+	static constexpr uint8_t BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Texels widened to 16 bits per channel, so squared distances fit the SSE2 multiply-add.
+	// Channels that should not count towards the error are zero in both texels and palette.
+	struct BlockTexels
+	{
+		alignas(16) int16_t Values[BlockTexelCount * 4];
+	};
+
+	static void LoadTexels(const uint8_t* texels, uint32_t channelMask, BlockTexels& outTexels)
+	{
+		for (uint32_t i = 0; i < BlockTexelCount * 4; ++i)
+			outTexels.Values[i] = (channelMask & (1u << (i % 4))) ? texels[i] : 0;
+	}
+
+	// Picks the closest palette entry for every texel, returns the summed squared error
+	static uint32_t FindClosest(const BlockTexels& texels, const int16_t* palette, uint32_t paletteSize, uint8_t* outIndices)
+	{
+#ifdef TESTBED_SSE2
+		__m128i values[8];
+		for (uint32_t i = 0; i < 8; ++i)
+			values[i] = _mm_load_si128((const __m128i*)texels.Values + i);
+
+		__m128i bestDistance[4];
+		__m128i bestIndex[4];
+		for (uint32_t g = 0; g < 4; ++g)
+		{
+			bestDistance[g] = _mm_set1_epi32(INT32_MAX);
+			bestIndex[g] = _mm_setzero_si128();
+		}
+
+		for (uint32_t p = 0; p < paletteSize; ++p)
+		{
+			const __m128i entry = _mm_loadl_epi64((const __m128i*)(palette + p * 4));
+			const __m128i color = _mm_unpacklo_epi64(entry, entry);
+			const __m128i index = _mm_set1_epi32((int)p);
+
+			// 4 texels per group, each register holds 2 texels
+			for (uint32_t g = 0; g < 4; ++g)
+			{
+				const __m128i d0 = _mm_sub_epi16(values[2 * g], color);
+				const __m128i d1 = _mm_sub_epi16(values[2 * g + 1], color);
+				const __m128 m0 = _mm_castsi128_ps(_mm_madd_epi16(d0, d0));
+				const __m128 m1 = _mm_castsi128_ps(_mm_madd_epi16(d1, d1));
+
+				// Add the RG and BA partial sums of each texel
+				const __m128i even = _mm_castps_si128(_mm_shuffle_ps(m0, m1, _MM_SHUFFLE(2, 0, 2, 0)));
+				const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(m0, m1, _MM_SHUFFLE(3, 1, 3, 1)));
+				const __m128i distance = _mm_add_epi32(even, odd);
+
+				const __m128i closer = _mm_cmplt_epi32(distance, bestDistance[g]);
+				bestDistance[g] = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, bestDistance[g]));
+				bestIndex[g] = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, bestIndex[g]));
+			}
+		}
+
+		alignas(16) int32_t distances[BlockTexelCount];
+		alignas(16) int32_t indices[BlockTexelCount];
+		for (uint32_t g = 0; g < 4; ++g)
+		{
+			_mm_store_si128((__m128i*)distances + g, bestDistance[g]);
+			_mm_store_si128((__m128i*)indices + g, bestIndex[g]);
+		}
+
+		uint32_t error = 0;
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+		{
+			outIndices[i] = (uint8_t)indices[i];
+			error += (uint32_t)distances[i];
+		}
+		return error;
+#else
+		uint32_t error = 0;
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+		{
+			const int16_t* texel = texels.Values + i * 4;
+			int32_t bestDistance = INT32_MAX;
+			for (uint32_t p = 0; p < paletteSize; ++p)
+			{
+				int32_t distance = 0;
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					const int32_t d = texel[c] - palette[p * 4 + c];
+					distance += d * d;
+				}
+
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					outIndices[i] = (uint8_t)p;
+				}
+			}
+			error += (uint32_t)bestDistance;
+		}
+		return error;
+#endif
+	}
+
+	// Endpoints along the principal axis of the texel distribution, found by power iteration
+	static void ComputePrincipalEndpoints(const BlockTexels& texels, uint32_t channelCount, float* outEndpoint0, float* outEndpoint1)
+	{
+		float mean[4] = {};
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+			for (uint32_t c = 0; c < channelCount; ++c)
+				mean[c] += texels.Values[i * 4 + c];
+		for (uint32_t c = 0; c < channelCount; ++c)
+			mean[c] /= (float)BlockTexelCount;
+
+		float covariance[4][4] = {};
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+		{
+			float d[4] = {};
+			for (uint32_t c = 0; c < channelCount; ++c)
+				d[c] = texels.Values[i * 4 + c] - mean[c];
+			for (uint32_t a = 0; a < channelCount; ++a)
+				for (uint32_t b = 0; b < channelCount; ++b)
+					covariance[a][b] += d[a] * d[b];
+		}
+
+		float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		for (uint32_t iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			float length = 0.0f;
+			for (uint32_t a = 0; a < channelCount; ++a)
+			{
+				for (uint32_t b = 0; b < channelCount; ++b)
+					next[a] += covariance[a][b] * axis[b];
+				length = std::max(length, std::abs(next[a]));
+			}
+
+			// Uniform blocks have no principal axis, both endpoints end up at the mean
+			if (length < 1e-6f)
+				break;
+			for (uint32_t c = 0; c < channelCount; ++c)
+				axis[c] = next[c] / length;
+		}
+
+		float axisLengthSquared = 0.0f;
+		for (uint32_t c = 0; c < channelCount; ++c)
+			axisLengthSquared += axis[c] * axis[c];
+
+		float minProjection = FLT_MAX, maxProjection = -FLT_MAX;
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+		{
+			float projection = 0.0f;
+			for (uint32_t c = 0; c < channelCount; ++c)
+				projection += (texels.Values[i * 4 + c] - mean[c]) * axis[c];
+			minProjection = std::min(minProjection, projection);
+			maxProjection = std::max(maxProjection, projection);
+		}
+		minProjection /= axisLengthSquared;
+		maxProjection /= axisLengthSquared;
+
+		for (uint32_t c = 0; c < channelCount; ++c)
+		{
+			outEndpoint0[c] = std::clamp(mean[c] + axis[c] * minProjection, 0.0f, 255.0f);
+			outEndpoint1[c] = std::clamp(mean[c] + axis[c] * maxProjection, 0.0f, 255.0f);
+		}
+	}
+
+	// Corners of the bounding box, the diagonal follows the sign of each channel's correlation with the widest one
+	static void ComputeBoxEndpoints(const BlockTexels& texels, uint32_t channelCount, float* outEndpoint0, float* outEndpoint1)
+	{
+		int32_t minValue[4] = { 255, 255, 255, 255 }, maxValue[4] = {};
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+		{
+			for (uint32_t c = 0; c < channelCount; ++c)
+			{
+				minValue[c] = std::min<int32_t>(minValue[c], texels.Values[i * 4 + c]);
+				maxValue[c] = std::max<int32_t>(maxValue[c], texels.Values[i * 4 + c]);
+			}
+		}
+
+		uint32_t widest = 0;
+		for (uint32_t c = 1; c < channelCount; ++c)
+		{
+			if (maxValue[c] - minValue[c] > maxValue[widest] - minValue[widest])
+				widest = c;
+		}
+
+		for (uint32_t c = 0; c < channelCount; ++c)
+		{
+			const float center = 0.5f * (float)(minValue[c] + maxValue[c]);
+			int32_t correlation = 0;
+			for (uint32_t i = 0; i < BlockTexelCount; ++i)
+				correlation += (texels.Values[i * 4 + c] * 2 - minValue[c] - maxValue[c]) * (texels.Values[i * 4 + widest] * 2 - minValue[widest] - maxValue[widest]);
+
+			// Inset by 1/16 of the range, the extremes are rarely hit exactly
+			const float extent = (float)(maxValue[c] - minValue[c]) * (0.5f - 1.0f / 16.0f);
+			outEndpoint0[c] = correlation >= 0 ? center - extent : center + extent;
+			outEndpoint1[c] = correlation >= 0 ? center + extent : center - extent;
+		}
+	}
+
+	// Least squares endpoints for fixed indices, texel i is approximated by lerp(endpoint0, endpoint1, weights[indices[i]])
+	static bool RefineEndpoints(const BlockTexels& texels, uint32_t channelCount, const uint8_t* indices, const float* weights, float* outEndpoint0, float* outEndpoint1)
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = {}, bx[4] = {};
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+		{
+			const float b = weights[indices[i]];
+			const float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (uint32_t c = 0; c < channelCount; ++c)
+			{
+				ax[c] += a * texels.Values[i * 4 + c];
+				bx[c] += b * texels.Values[i * 4 + c];
+			}
+		}
+
+		const float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f)
+			return false;
+
+		for (uint32_t c = 0; c < channelCount; ++c)
+		{
+			outEndpoint0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+			outEndpoint1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	//////////////////////////////////////////////////////////////////////////////
+	// BC1 //////////////////////////////////////////////////////////////////////
+	//////////////////////////////////////////////////////////////////////////////
+
+	static uint16_t QuantizeRGB565(const float* color)
+	{
+		const uint32_t r = (uint32_t)(color[0] * 31.0f / 255.0f + 0.5f);
+		const uint32_t g = (uint32_t)(color[1] * 63.0f / 255.0f + 0.5f);
+		const uint32_t b = (uint32_t)(color[2] * 31.0f / 255.0f + 0.5f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	static void ExpandRGB565(uint16_t color, int16_t* outColor)
+	{
+		const uint32_t r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+		outColor[0] = (int16_t)((r << 3) | (r >> 2));
+		outColor[1] = (int16_t)((g << 2) | (g >> 4));
+		outColor[2] = (int16_t)((b << 3) | (b >> 2));
+		outColor[3] = 0;
+	}
+
+	// Always 4 color mode, which is also the only mode the color block of BC3 has
+	static void BuildColorPalette(uint16_t color0, uint16_t color1, int16_t* outPalette)
+	{
+		ExpandRGB565(color0, outPalette);
+		ExpandRGB565(color1, outPalette + 4);
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			outPalette[8 + c] = (int16_t)((2 * outPalette[c] + outPalette[4 + c]) / 3);
+			outPalette[12 + c] = (int16_t)((outPalette[c] + 2 * outPalette[4 + c]) / 3);
+		}
+	}
+
+	static uint32_t EncodeColorEndpoints(const BlockTexels& texels, const float* endpoint0, const float* endpoint1, uint8_t* outBlock)
+	{
+		uint16_t color0 = QuantizeRGB565(endpoint0);
+		uint16_t color1 = QuantizeRGB565(endpoint1);
+		// color0 > color1 selects 4 color mode
+		if (color0 < color1)
+			std::swap(color0, color1);
+
+		int16_t palette[16];
+		BuildColorPalette(color0, color1, palette);
+
+		uint8_t indices[BlockTexelCount] = {};
+		uint32_t error = 0;
+		if (color0 == color1)
+			error = FindClosest(texels, palette, 1, indices);
+		else
+			error = FindClosest(texels, palette, 4, indices);
+
+		uint32_t indexBits = 0;
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+			indexBits |= (uint32_t)indices[i] << (2 * i);
+
+		memcpy(outBlock, &color0, 2);
+		memcpy(outBlock + 2, &color1, 2);
+		memcpy(outBlock + 4, &indexBits, 4);
+		return error;
+	}
+
+	static void EncodeColorBlock(const uint8_t* texels, TextureCompression quality, uint8_t* outBlock)
+	{
+		BlockTexels values;
+		LoadTexels(texels, 0x7, values);
+
+		float endpoint0[4], endpoint1[4];
+		if (quality == TextureCompression::Fast)
+			ComputeBoxEndpoints(values, 3, endpoint0, endpoint1);
+		else
+			ComputePrincipalEndpoints(values, 3, endpoint0, endpoint1);
+
+		uint32_t error = EncodeColorEndpoints(values, endpoint0, endpoint1, outBlock);
+		if (quality != TextureCompression::High)
+			return;
+
+		static constexpr float Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		for (uint32_t iteration = 0; iteration < 2 && error > 0; ++iteration)
+		{
+			uint8_t indices[BlockTexelCount];
+			uint32_t indexBits;
+			memcpy(&indexBits, outBlock + 4, 4);
+			for (uint32_t i = 0; i < BlockTexelCount; ++i)
+				indices[i] = (indexBits >> (2 * i)) & 3;
+
+			uint16_t color0, color1;
+			memcpy(&color0, outBlock, 2);
+			memcpy(&color1, outBlock + 2, 2);
+			if (color0 == color1 || !RefineEndpoints(values, 3, indices, Weights, endpoint0, endpoint1))
+				break;
+
+			uint8_t candidate[8];
+			const uint32_t candidateError = EncodeColorEndpoints(values, endpoint0, endpoint1, candidate);
+			if (candidateError >= error)
+				break;
+
+			error = candidateError;
+			memcpy(outBlock, candidate, sizeof(candidate));
+		}
+	}
+
+	static void DecodeColorBlock(const uint8_t* block, uint8_t* outTexels)
+	{
+		uint16_t color0, color1;
+		uint32_t indexBits;
+		memcpy(&color0, block, 2);
+		memcpy(&color1, block + 2, 2);
+		memcpy(&indexBits, block + 4, 4);
+
+		int16_t palette[16];
+		BuildColorPalette(color0, color1, palette);
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+		{
+			const int16_t* color = palette + ((indexBits >> (2 * i)) & 3) * 4;
+			for (uint32_t c = 0; c < 3; ++c)
+				outTexels[i * 4 + c] = (uint8_t)color[c];
+			outTexels[i * 4 + 3] = 255;
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////////
+	// BC4, single channel blocks used for BC3 alpha and both BC5 channels ///////
+	//////////////////////////////////////////////////////////////////////////////
+
+	// Always 8 value mode: value0 > value1, interpolated in sevenths
+	static void BuildChannelPalette(uint32_t value0, uint32_t value1, int16_t* outPalette)
+	{
+		memset(outPalette, 0, 8 * 4 * sizeof(int16_t));
+		outPalette[0] = (int16_t)value0;
+		outPalette[4] = (int16_t)value1;
+		for (uint32_t i = 2; i < 8; ++i)
+			outPalette[i * 4] = (int16_t)(((8 - i) * value0 + (i - 1) * value1 + 3) / 7);
+	}
+
+	static uint32_t EncodeChannelEndpoints(const BlockTexels& values, uint32_t value0, uint32_t value1, uint8_t* outBlock)
+	{
+		int16_t palette[8 * 4];
+		BuildChannelPalette(value0, value1, palette);
+
+		uint8_t indices[BlockTexelCount];
+		const uint32_t error = FindClosest(values, palette, value0 == value1 ? 1 : 8, indices);
+
+		uint64_t indexBits = 0;
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+			indexBits |= (uint64_t)indices[i] << (3 * i);
+
+		outBlock[0] = (uint8_t)value0;
+		outBlock[1] = (uint8_t)value1;
+		memcpy(outBlock + 2, &indexBits, 6);
+		return error;
+	}
+
+	static void EncodeChannelBlock(const uint8_t* texels, uint32_t channel, TextureCompression quality, uint8_t* outBlock)
+	{
+		// The channel is moved to slot 0 so the palette only needs one component
+		BlockTexels values = {};
+		uint32_t minValue = 255, maxValue = 0;
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+		{
+			const uint8_t value = texels[i * 4 + channel];
+			values.Values[i * 4] = value;
+			minValue = std::min<uint32_t>(minValue, value);
+			maxValue = std::max<uint32_t>(maxValue, value);
+		}
+
+		uint32_t error = EncodeChannelEndpoints(values, maxValue, minValue, outBlock);
+		if (quality != TextureCompression::High || error == 0)
+			return;
+
+		// Pulling the endpoints inwards often lines the interpolated values up with the texels better
+		for (uint32_t inset0 = 0; inset0 <= 2; ++inset0)
+		{
+			for (uint32_t inset1 = 0; inset1 <= 2; ++inset1)
+			{
+				if ((inset0 == 0 && inset1 == 0) || maxValue < minValue + inset0 + inset1 + 1)
+					continue;
+
+				uint8_t candidate[8];
+				const uint32_t candidateError = EncodeChannelEndpoints(values, maxValue - inset0, minValue + inset1, candidate);
+				if (candidateError < error)
+				{
+					error = candidateError;
+					memcpy(outBlock, candidate, sizeof(candidate));
+				}
+			}
+		}
+	}
+
+	static void DecodeChannelBlock(const uint8_t* block, uint32_t channel, uint8_t* outTexels)
+	{
+		const uint32_t value0 = block[0], value1 = block[1];
+		uint64_t indexBits = 0;
+		memcpy(&indexBits, block + 2, 6);
+
+		uint8_t palette[8] = { (uint8_t)value0, (uint8_t)value1 };
+		if (value0 > value1)
+		{
+			for (uint32_t i = 2; i < 8; ++i)
+				palette[i] = (uint8_t)(((8 - i) * value0 + (i - 1) * value1 + 3) / 7);
+		}
+		else
+		{
+			for (uint32_t i = 2; i < 6; ++i)
+				palette[i] = (uint8_t)(((6 - i) * value0 + (i - 1) * value1 + 2) / 5);
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+			outTexels[i * 4 + channel] = palette[(indexBits >> (3 * i)) & 7];
+	}
+
+	//////////////////////////////////////////////////////////////////////////////
+	// BC7, single subset modes only. Mode 6 has RGBA 7.7.7.7 endpoints with a p-bit each and
+	// 4 bit indices, mode 5 separates alpha with its own 2 bit indices for blocks where it does
+	// not follow the color.
+	//////////////////////////////////////////////////////////////////////////////
+
+	struct BitWriter
+	{
+		uint64_t Bits[2] = {};
+		uint32_t Position = 0;
+
+		void Write(uint32_t value, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; ++i, ++Position)
+				Bits[Position / 64] |= (uint64_t)((value >> i) & 1) << (Position % 64);
+		}
+	};
+
+	struct BitReader
+	{
+		uint64_t Bits[2] = {};
+		uint32_t Position = 0;
+
+		uint32_t Read(uint32_t count)
+		{
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < count; ++i, ++Position)
+				value |= (uint32_t)((Bits[Position / 64] >> (Position % 64)) & 1) << i;
+			return value;
+		}
+	};
+
+	// Picks the p-bit that lands the 8 bit endpoint closest to the unquantized one
+	static void QuantizeEndpointWithPBit(const float* endpoint, uint8_t* outEndpoint, uint32_t& outPBit)
+	{
+		float bestError = FLT_MAX;
+		for (uint32_t pBit = 0; pBit < 2; ++pBit)
+		{
+			uint8_t quantized[4];
+			float error = 0.0f;
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				const int32_t q = std::clamp((int32_t)((endpoint[c] - (float)pBit) * 0.5f + 0.5f), 0, 127);
+				quantized[c] = (uint8_t)((q << 1) | pBit);
+				error += (quantized[c] - endpoint[c]) * (quantized[c] - endpoint[c]);
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				outPBit = pBit;
+				memcpy(outEndpoint, quantized, 4);
+			}
+		}
+	}
+
+	static void BuildBC7Palette(const uint8_t* endpoint0, const uint8_t* endpoint1, int16_t* outPalette)
+	{
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			for (uint32_t c = 0; c < 4; ++c)
+				outPalette[i * 4 + c] = (int16_t)(((64 - BC7Weights4[i]) * endpoint0[c] + BC7Weights4[i] * endpoint1[c] + 32) >> 6);
+		}
+	}
+
+	static uint32_t EncodeBC7Endpoints(const BlockTexels& values, const float* endpoint0, const float* endpoint1, uint8_t* outBlock)
+	{
+		uint8_t quantized0[4], quantized1[4];
+		uint32_t pBit0 = 0, pBit1 = 0;
+		QuantizeEndpointWithPBit(endpoint0, quantized0, pBit0);
+		QuantizeEndpointWithPBit(endpoint1, quantized1, pBit1);
+
+		int16_t palette[16 * 4];
+		BuildBC7Palette(quantized0, quantized1, palette);
+
+		uint8_t indices[BlockTexelCount];
+		const uint32_t error = FindClosest(values, palette, 16, indices);
+
+		// The anchor index is stored without its top bit, so it must be below 8
+		if (indices[0] >= 8)
+		{
+			std::swap(quantized0, quantized1);
+			std::swap(pBit0, pBit1);
+			for (uint8_t& index : indices)
+				index = (uint8_t)(15 - index);
+		}
+
+		BitWriter writer;
+		writer.Write(1u << 6, 7);
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			writer.Write(quantized0[c] >> 1, 7);
+			writer.Write(quantized1[c] >> 1, 7);
+		}
+		writer.Write(pBit0, 1);
+		writer.Write(pBit1, 1);
+		writer.Write(indices[0], 3);
+		for (uint32_t i = 1; i < BlockTexelCount; ++i)
+			writer.Write(indices[i], 4);
+
+		memcpy(outBlock, writer.Bits, 16);
+		return error;
+	}
+
+	static void BuildBC7Mode5Palettes(const uint8_t* color0, const uint8_t* color1, uint8_t alpha0, uint8_t alpha1, int16_t* outColors, int16_t* outAlphas)
+	{
+		memset(outAlphas, 0, 4 * 4 * sizeof(int16_t));
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			for (uint32_t c = 0; c < 3; ++c)
+				outColors[i * 4 + c] = (int16_t)(((64 - BC7Weights2[i]) * color0[c] + BC7Weights2[i] * color1[c] + 32) >> 6);
+			outColors[i * 4 + 3] = 0;
+			outAlphas[i * 4] = (int16_t)(((64 - BC7Weights2[i]) * alpha0 + BC7Weights2[i] * alpha1 + 32) >> 6);
+		}
+	}
+
+	static uint32_t EncodeBC7Mode5(const BlockTexels& colors, const BlockTexels& alphas, const float* endpoint0, const float* endpoint1, uint8_t alpha0, uint8_t alpha1, uint8_t* outBlock)
+	{
+		// 7 bit color endpoints, expanded by replicating the top bit
+		uint8_t quantized0[3], quantized1[3], color0[3], color1[3];
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			quantized0[c] = (uint8_t)std::min((int32_t)(endpoint0[c] * 127.0f / 255.0f + 0.5f), 127);
+			quantized1[c] = (uint8_t)std::min((int32_t)(endpoint1[c] * 127.0f / 255.0f + 0.5f), 127);
+			color0[c] = (uint8_t)((quantized0[c] << 1) | (quantized0[c] >> 6));
+			color1[c] = (uint8_t)((quantized1[c] << 1) | (quantized1[c] >> 6));
+		}
+
+		int16_t colorPalette[4 * 4], alphaPalette[4 * 4];
+		BuildBC7Mode5Palettes(color0, color1, alpha0, alpha1, colorPalette, alphaPalette);
+
+		uint8_t colorIndices[BlockTexelCount], alphaIndices[BlockTexelCount];
+		const uint32_t error = FindClosest(colors, colorPalette, 4, colorIndices) + FindClosest(alphas, alphaPalette, 4, alphaIndices);
+
+		// Both anchor indices are stored without their top bit
+		if (colorIndices[0] >= 2)
+		{
+			std::swap(quantized0, quantized1);
+			for (uint8_t& index : colorIndices)
+				index = (uint8_t)(3 - index);
+		}
+		if (alphaIndices[0] >= 2)
+		{
+			std::swap(alpha0, alpha1);
+			for (uint8_t& index : alphaIndices)
+				index = (uint8_t)(3 - index);
+		}
+
+		BitWriter writer;
+		writer.Write(1u << 5, 6);
+		// No channel rotation
+		writer.Write(0, 2);
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			writer.Write(quantized0[c], 7);
+			writer.Write(quantized1[c], 7);
+		}
+		writer.Write(alpha0, 8);
+		writer.Write(alpha1, 8);
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+			writer.Write(colorIndices[i], i == 0 ? 1 : 2);
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+			writer.Write(alphaIndices[i], i == 0 ? 1 : 2);
+
+		memcpy(outBlock, writer.Bits, 16);
+		return error;
+	}
+
+	static void EncodeBC7Block(const uint8_t* texels, TextureCompression quality, uint8_t* outBlock)
+	{
+		BlockTexels values;
+		LoadTexels(texels, 0xF, values);
+
+		float endpoint0[4], endpoint1[4];
+		if (quality == TextureCompression::Fast)
+			ComputeBoxEndpoints(values, 4, endpoint0, endpoint1);
+		else
+			ComputePrincipalEndpoints(values, 4, endpoint0, endpoint1);
+
+		uint32_t error = EncodeBC7Endpoints(values, endpoint0, endpoint1, outBlock);
+		if (quality == TextureCompression::High)
+		{
+			float weights[16];
+			for (uint32_t i = 0; i < 16; ++i)
+				weights[i] = BC7Weights4[i] / 64.0f;
+
+			for (uint32_t iteration = 0; iteration < 2 && error > 0; ++iteration)
+			{
+				BitReader reader;
+				memcpy(reader.Bits, outBlock, 16);
+				reader.Position = 7 + 56 + 2;
+
+				uint8_t indices[BlockTexelCount];
+				indices[0] = (uint8_t)reader.Read(3);
+				for (uint32_t i = 1; i < BlockTexelCount; ++i)
+					indices[i] = (uint8_t)reader.Read(4);
+
+				// Indices are relative to the endpoints as stored, which may have been swapped for the anchor
+				if (!RefineEndpoints(values, 4, indices, weights, endpoint0, endpoint1))
+					break;
+
+				uint8_t candidate[16];
+				const uint32_t candidateError = EncodeBC7Endpoints(values, endpoint0, endpoint1, candidate);
+				if (candidateError >= error)
+					break;
+
+				error = candidateError;
+				memcpy(outBlock, candidate, sizeof(candidate));
+			}
+		}
+
+		uint8_t alphaMin = 255, alphaMax = 0;
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+		{
+			alphaMin = std::min(alphaMin, texels[i * 4 + 3]);
+			alphaMax = std::max(alphaMax, texels[i * 4 + 3]);
+		}
+		if (quality == TextureCompression::Fast || alphaMin == alphaMax || error == 0)
+			return;
+
+		// Alpha that varies independently of the color is better served by mode 5
+		BlockTexels colors, alphas = {};
+		LoadTexels(texels, 0x7, colors);
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+			alphas.Values[i * 4] = texels[i * 4 + 3];
+
+		ComputePrincipalEndpoints(colors, 3, endpoint0, endpoint1);
+		uint8_t candidate[16];
+		const uint32_t candidateError = EncodeBC7Mode5(colors, alphas, endpoint0, endpoint1, alphaMin, alphaMax, candidate);
+		if (candidateError < error)
+			memcpy(outBlock, candidate, sizeof(candidate));
+	}
+
+	static void DecodeBC7Block(const uint8_t* block, uint8_t* outTexels)
+	{
+		BitReader reader;
+		memcpy(reader.Bits, block, 16);
+
+		const uint32_t modeBits = reader.Read(6);
+		if (modeBits == (1u << 5))
+		{
+			const uint32_t rotation = reader.Read(2);
+			uint8_t color0[4], color1[4];
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				const uint32_t quantized0 = reader.Read(7), quantized1 = reader.Read(7);
+				color0[c] = (uint8_t)((quantized0 << 1) | (quantized0 >> 6));
+				color1[c] = (uint8_t)((quantized1 << 1) | (quantized1 >> 6));
+			}
+			color0[3] = (uint8_t)reader.Read(8);
+			color1[3] = (uint8_t)reader.Read(8);
+
+			int16_t colorPalette[4 * 4], alphaPalette[4 * 4];
+			BuildBC7Mode5Palettes(color0, color1, color0[3], color1[3], colorPalette, alphaPalette);
+			for (uint32_t i = 0; i < BlockTexelCount; ++i)
+			{
+				const uint32_t index = reader.Read(i == 0 ? 1 : 2);
+				for (uint32_t c = 0; c < 3; ++c)
+					outTexels[i * 4 + c] = (uint8_t)colorPalette[index * 4 + c];
+			}
+			for (uint32_t i = 0; i < BlockTexelCount; ++i)
+				outTexels[i * 4 + 3] = (uint8_t)alphaPalette[reader.Read(i == 0 ? 1 : 2) * 4];
+
+			if (rotation != 0)
+			{
+				for (uint32_t i = 0; i < BlockTexelCount; ++i)
+					std::swap(outTexels[i * 4 + 3], outTexels[i * 4 + rotation - 1]);
+			}
+			return;
+		}
+
+		// Only modes 5 and 6 are ever written, anything else decodes to magenta so it stands out
+		if (modeBits != 0 || reader.Read(1) != 1)
+		{
+			for (uint32_t i = 0; i < BlockTexelCount; ++i)
+			{
+				outTexels[i * 4 + 0] = 255;
+				outTexels[i * 4 + 1] = 0;
+				outTexels[i * 4 + 2] = 255;
+				outTexels[i * 4 + 3] = 255;
+			}
+			return;
+		}
+
+		uint8_t endpoint0[4], endpoint1[4];
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			endpoint0[c] = (uint8_t)(reader.Read(7) << 1);
+			endpoint1[c] = (uint8_t)(reader.Read(7) << 1);
+		}
+		const uint32_t pBit0 = reader.Read(1), pBit1 = reader.Read(1);
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			endpoint0[c] |= pBit0;
+			endpoint1[c] |= pBit1;
+		}
+
+		int16_t palette[16 * 4];
+		BuildBC7Palette(endpoint0, endpoint1, palette);
+		for (uint32_t i = 0; i < BlockTexelCount; ++i)
+		{
+			const uint32_t index = reader.Read(i == 0 ? 3 : 4);
+			for (uint32_t c = 0; c < 4; ++c)
+				outTexels[i * 4 + c] = (uint8_t)palette[index * 4 + c];
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////////
+
+	static void CopyMipLayout(const TextureData& texture, TextureFormat format, TextureData& outTexture)
+	{
+		outTexture.Name = texture.Name;
+		outTexture.Width = texture.Width;
+		outTexture.Height = texture.Height;
+		outTexture.Format = format;
+		outTexture.SRGB = texture.SRGB;
+		outTexture.Mips.resize(texture.Mips.size());
+
+		size_t offset = 0;
+		for (uint32_t mip = 0; mip < texture.GetMipCount(); ++mip)
+		{
+			outTexture.Mips[mip] = { offset, texture.Mips[mip].Width, texture.Mips[mip].Height };
+			offset += outTexture.GetMipSize(mip);
+		}
+		outTexture.Pixels.resize(offset);
+	}
+
+	struct BlockBand
+	{
+		uint32_t Mip;
+		uint32_t FirstBlockRow;
+	};
+
+	static std::vector<BlockBand> GetBlockBands(const TextureData& texture)
+	{
+		std::vector<BlockBand> bands;
+		for (uint32_t mip = 0; mip < texture.GetMipCount(); ++mip)
+		{
+			const uint32_t blockRows = (texture.Mips[mip].Height + 3) / 4;
+			for (uint32_t row = 0; row < blockRows; row += BandHeight)
+				bands.push_back({ mip, row });
+		}
+		return bands;
+	}
+
+	TextureFormat TextureCompressor::ChooseFormat(const TextureData& texture, TextureCompression quality, bool normalMap)
+	{
+		if (quality == TextureCompression::None)
+			return TextureFormat::RGBA8;
+		if (normalMap)
+			return TextureFormat::BC5;
+		if (quality != TextureCompression::Fast)
+			return TextureFormat::BC7;
+
+		const uint8_t* pixels = texture.GetMipPixels(0);
+		const size_t texelCount = (size_t)texture.Width * texture.Height;
+		for (size_t i = 0; i < texelCount; ++i)
+		{
+			if (pixels[i * 4 + 3] != 255)
+				return TextureFormat::BC3;
+		}
+		return TextureFormat::BC1;
+	}
+
+	void TextureCompressor::Compress(const TextureData& texture, TextureFormat format, TextureCompression quality, TextureData& outTexture)
+	{
+		TESTBED_ASSERT(texture.Format == TextureFormat::RGBA8, "Only RGBA8 textures can be compressed!");
+		if (format == TextureFormat::RGBA8)
+		{
+			outTexture = texture;
+			return;
+		}
+
+		CopyMipLayout(texture, format, outTexture);
+		const uint32_t bytesPerBlock = outTexture.GetBytesPerBlock();
+
+		const std::vector<BlockBand> bands = GetBlockBands(texture);
+		ParallelFor((uint32_t)bands.size(), [&](uint32_t bandIndex)
+		{
+			const BlockBand& band = bands[bandIndex];
+			const TextureMip& mip = texture.Mips[band.Mip];
+			const uint8_t* src = texture.GetMipPixels(band.Mip);
+			uint8_t* dst = outTexture.GetMipPixels(band.Mip);
+			const size_t dstPitch = outTexture.GetRowPitch(band.Mip);
+			const uint32_t blockColumns = (mip.Width + 3) / 4;
+			const uint32_t blockRows = std::min(band.FirstBlockRow + BandHeight, (mip.Height + 3) / 4);
+
+			uint8_t texels[BlockTexelCount * 4];
+			for (uint32_t by = band.FirstBlockRow; by < blockRows; ++by)
+			{
+				for (uint32_t bx = 0; bx < blockColumns; ++bx)
+				{
+					// Partial blocks at the edges repeat the last row and column
+					for (uint32_t y = 0; y < 4; ++y)
+					{
+						const uint32_t sy = std::min(by * 4 + y, mip.Height - 1);
+						for (uint32_t x = 0; x < 4; ++x)
+						{
+							const uint32_t sx = std::min(bx * 4 + x, mip.Width - 1);
+							memcpy(texels + (y * 4 + x) * 4, src + ((size_t)sy * mip.Width + sx) * 4, 4);
+						}
+					}
+
+					CompressBlock(texels, format, quality, dst + by * dstPitch + bx * bytesPerBlock);
+				}
+			}
+		});
+	}
+
+	void TextureCompressor::Decompress(const TextureData& texture, TextureData& outTexture)
+	{
+		if (texture.Format == TextureFormat::RGBA8)
+		{
+			outTexture = texture;
+			return;
+		}
+
+		CopyMipLayout(texture, TextureFormat::RGBA8, outTexture);
+		const uint32_t bytesPerBlock = texture.GetBytesPerBlock();
+
+		const std::vector<BlockBand> bands = GetBlockBands(texture);
+		ParallelFor((uint32_t)bands.size(), [&](uint32_t bandIndex)
+		{
+			const BlockBand& band = bands[bandIndex];
+			const TextureMip& mip = texture.Mips[band.Mip];
+			const uint8_t* src = texture.GetMipPixels(band.Mip);
+			uint8_t* dst = outTexture.GetMipPixels(band.Mip);
+			const size_t srcPitch = texture.GetRowPitch(band.Mip);
+			const uint32_t blockColumns = (mip.Width + 3) / 4;
+			const uint32_t blockRows = std::min(band.FirstBlockRow + BandHeight, (mip.Height + 3) / 4);
+
+			uint8_t texels[BlockTexelCount * 4];
+			for (uint32_t by = band.FirstBlockRow; by < blockRows; ++by)
+			{
+				for (uint32_t bx = 0; bx < blockColumns; ++bx)
+				{
+					DecompressBlock(src + by * srcPitch + bx * bytesPerBlock, texture.Format, texels);
+
+					for (uint32_t y = 0; y < 4 && by * 4 + y < mip.Height; ++y)
+					{
+						for (uint32_t x = 0; x < 4 && bx * 4 + x < mip.Width; ++x)
+							memcpy(dst + ((size_t)(by * 4 + y) * mip.Width + bx * 4 + x) * 4, texels + (y * 4 + x) * 4, 4);
+					}
+				}
+			}
+		});
+	}
+
+	void TextureCompressor::CompressBlock(const uint8_t* texels, TextureFormat format, TextureCompression quality, uint8_t* outBlock)
+	{
+		switch (format)
+		{
+			case TextureFormat::BC1:
+				EncodeColorBlock(texels, quality, outBlock);
+				break;
+			case TextureFormat::BC3:
+				EncodeChannelBlock(texels, 3, quality, outBlock);
+				EncodeColorBlock(texels, quality, outBlock + 8);
+				break;
+			case TextureFormat::BC5:
+				EncodeChannelBlock(texels, 0, quality, outBlock);
+				EncodeChannelBlock(texels, 1, quality, outBlock + 8);
+				break;
+			case TextureFormat::BC7:
+				EncodeBC7Block(texels, quality, outBlock);
+				break;
+			default:
+				TESTBED_ASSERT(false, "Not a block compressed format!");
+				break;
+		}
+	}
+
+	void TextureCompressor::DecompressBlock(const uint8_t* block, TextureFormat format, uint8_t* outTexels)
+	{
+		switch (format)
+		{
+			case TextureFormat::BC1:
+				DecodeColorBlock(block, outTexels);
+				break;
+			case TextureFormat::BC3:
+				DecodeColorBlock(block + 8, outTexels);
+				DecodeChannelBlock(block, 3, outTexels);
+				break;
+			case TextureFormat::BC5:
+				for (uint32_t i = 0; i < BlockTexelCount; ++i)
+				{
+					outTexels[i * 4 + 2] = 0;
+					outTexels[i * 4 + 3] = 255;
+				}
+				DecodeChannelBlock(block, 0, outTexels);
+				DecodeChannelBlock(block + 8, 1, outTexels);
+				break;
+			case TextureFormat::BC7:
+				DecodeBC7Block(block, outTexels);
+				break;
+			default:
+				TESTBED_ASSERT(false, "Not a block compressed format!");
+				break;
+		}
+	}
+
+	double TextureCompressor::ComputePSNR(const TextureData& reference, const TextureData& texture, TextureFormat format, uint32_t mip)
+	{
+		TESTBED_ASSERT(reference.Format == TextureFormat::RGBA8 && texture.Format == TextureFormat::RGBA8);
+		TESTBED_ASSERT(reference.Mips[mip].Width == texture.Mips[mip].Width && reference.Mips[mip].Height == texture.Mips[mip].Height);
+
+		uint32_t channelCount = 4;
+		if (format == TextureFormat::BC1)
+			channelCount = 3;
+		else if (format == TextureFormat::BC5)
+			channelCount = 2;
+
+		const uint8_t* a = reference.GetMipPixels(mip);
+		const uint8_t* b = texture.GetMipPixels(mip);
+		const size_t texelCount = (size_t)texture.Mips[mip].Width * texture.Mips[mip].Height;
+
+		uint64_t squaredError = 0;
+		for (size_t i = 0; i < texelCount; ++i)
+		{
+			for (uint32_t c = 0; c < channelCount; ++c)
+			{
+				const int32_t d = (int32_t)a[i * 4 + c] - (int32_t)b[i * 4 + c];
+				squaredError += (uint64_t)(d * d);
+			}
+		}
+
+		if (squaredError == 0)
+			return std::numeric_limits<double>::infinity();
+
+		const double meanSquaredError = (double)squaredError / (double)(texelCount * channelCount);
+		return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+	}
+}
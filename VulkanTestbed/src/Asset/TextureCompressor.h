@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Asset/Texture.h"
+
+namespace VulkanTestbed
+{
+	enum class TextureCompression : uint32_t
+	{
+		// Upload RGBA8 as decoded
+		None = 0,
+		// Bounding box endpoints, BC1/BC3 for color
+		Fast,
+		// Principal axis endpoints, BC7 for color
+		Normal,
+		// Principal axis endpoints refined by least squares, plus an endpoint search for alpha and normals
+		High
+	};
+
+	class TextureCompressor
+	{
+	public:
+		// Bump whenever the encoded output changes, invalidates existing texture caches
+		static constexpr uint32_t Version = 1;
+
+		// Normal maps get BC5, color textures BC7 or BC1/BC3 for the Fast preset depending on alpha
+		static TextureFormat ChooseFormat(const TextureData& texture, TextureCompression quality, bool normalMap);
+
+		// Encodes every mip of an RGBA8 texture, blocks are spread across all cores
+		static void Compress(const TextureData& texture, TextureFormat format, TextureCompression quality, TextureData& outTexture);
+		static void Decompress(const TextureData& texture, TextureData& outTexture);
+
+		// 16 RGBA8 texels in row order
+		static void CompressBlock(const uint8_t* texels, TextureFormat format, TextureCompression quality, uint8_t* outBlock);
+		static void DecompressBlock(const uint8_t* block, TextureFormat format, uint8_t* outTexels);
+
+		// Over the channels the format stores: RGB for BC1, RG for BC5, RGBA otherwise
+		static double ComputePSNR(const TextureData& reference, const TextureData& texture, TextureFormat format, uint32_t mip = 0);
+	};
+}
@@ -0,0 +1,113 @@
+#include "pch.h"
+#include "TextureImporter.h"
+
+#include <stb_image.h>
+
+#include "Core/Simd.h"
+
+namespace VulkanTestbed
+{
+	bool TextureImporter::Import(const std::filesystem::path& path, TextureData& outTexture)
+	{
+		int width = 0, height = 0, channels = 0;
+		stbi_uc* pixels = stbi_load(path.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		if (!pixels)
+		{
+			LOG_ERROR("TextureImporter: failed to load {} ({})", path.string(), stbi_failure_reason());
+			return false;
+		}
+
+		outTexture.Name = path.filename().string();
+		outTexture.Width = (uint32_t)width;
+		outTexture.Height = (uint32_t)height;
+		outTexture.Mips.assign(1, { 0, outTexture.Width, outTexture.Height });
+		outTexture.Pixels.assign(pixels, pixels + outTexture.GetMipSize(0));
+		stbi_image_free(pixels);
+
+		GenerateMips(outTexture);
+		return true;
+	}
+
+	void TextureImporter::GenerateMips(TextureData& texture)
+	{
+		const uint32_t mipCount = GetMipCount(texture.Width, texture.Height);
+		texture.Mips.resize(1);
+
+		size_t totalSize = texture.GetMipSize(0);
+		for (uint32_t mip = 1; mip < mipCount; ++mip)
+		{
+			const TextureMip& previous = texture.Mips.back();
+			texture.Mips.push_back({ totalSize, std::max(1u, previous.Width / 2), std::max(1u, previous.Height / 2) });
+			totalSize += texture.GetMipSize(mip);
+		}
+		texture.Pixels.resize(totalSize);
+
+		for (uint32_t mip = 1; mip < mipCount; ++mip)
+		{
+			const TextureMip& src = texture.Mips[mip - 1];
+			const TextureMip& dst = texture.Mips[mip];
+			Downsample(texture.GetMipPixels(mip - 1), src.Width, src.Height, texture.GetMipPixels(mip), dst.Width, dst.Height);
+		}
+	}
+
+	void TextureImporter::Downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight)
+	{
+		const size_t srcPitch = (size_t)srcWidth * TextureData::BytesPerPixel;
+		const size_t dstPitch = (size_t)dstWidth * TextureData::BytesPerPixel;
+
+		for (uint32_t y = 0; y < dstHeight; ++y)
+		{
+			// Clamping handles mips that are only one texel wide or high
+			const uint8_t* row0 = src + std::min(2 * y, srcHeight - 1) * srcPitch;
+			const uint8_t* row1 = src + std::min(2 * y + 1, srcHeight - 1) * srcPitch;
+			uint8_t* out = dst + y * dstPitch;
+
+			uint32_t x = 0;
+#ifdef TESTBED_SSE2
+			// 4 output texels per iteration, source texel pairs are summed in 16 bit lanes
+			if (srcWidth >= 2 * dstWidth)
+			{
+				const __m128i zero = _mm_setzero_si128();
+				const __m128i bias = _mm_set1_epi16(2);
+				for (; x + 4 <= dstWidth; x += 4)
+				{
+					const __m128i* p0 = (const __m128i*)(row0 + x * 8);
+					const __m128i* p1 = (const __m128i*)(row1 + x * 8);
+					const __m128i a0 = _mm_loadu_si128(p0), b0 = _mm_loadu_si128(p0 + 1);
+					const __m128i a1 = _mm_loadu_si128(p1), b1 = _mm_loadu_si128(p1 + 1);
+
+					// Vertical sums, each register holds two source texels
+					const __m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(a1, zero));
+					const __m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(a1, zero));
+					const __m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(b0, zero), _mm_unpacklo_epi8(b1, zero));
+					const __m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(b0, zero), _mm_unpackhi_epi8(b1, zero));
+
+					// Horizontal sums of neighbouring texels
+					const __m128i h01 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+					const __m128i h23 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+
+					const __m128i r01 = _mm_srli_epi16(_mm_add_epi16(h01, bias), 2);
+					const __m128i r23 = _mm_srli_epi16(_mm_add_epi16(h23, bias), 2);
+					_mm_storeu_si128((__m128i*)(out + x * 4), _mm_packus_epi16(r01, r23));
+				}
+			}
+#endif
+
+			for (; x < dstWidth; ++x)
+			{
+				const size_t c0 = (size_t)std::min(2 * x, srcWidth - 1) * TextureData::BytesPerPixel;
+				const size_t c1 = (size_t)std::min(2 * x + 1, srcWidth - 1) * TextureData::BytesPerPixel;
+				for (uint32_t c = 0; c < TextureData::BytesPerPixel; ++c)
+					out[x * 4 + c] = (uint8_t)((row0[c0 + c] + row0[c1 + c] + row1[c0 + c] + row1[c1 + c] + 2) >> 2);
+			}
+		}
+	}
+
+	uint32_t TextureImporter::GetMipCount(uint32_t width, uint32_t height)
+	{
+		uint32_t mipCount = 1;
+		for (uint32_t size = std::max(width, height); size > 1; size /= 2)
+			++mipCount;
+		return mipCount;
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <filesystem>
+
+#include "Asset/Texture.h"
+
+namespace VulkanTestbed
+{
+	class TextureImporter
+	{
+	public:
+		// Bump whenever the decoded pixels or generated mips change, invalidates existing texture caches
+		static constexpr uint32_t Version = 1;
+
+		// Decodes any format stb_image understands into RGBA8 and generates the full mip chain.
+		// Safe to call from several threads at once.
+		static bool Import(const std::filesystem::path& path, TextureData& outTexture);
+
+		// Allocates and fills mips 1..N from mip 0 with a 2x2 box filter, odd dimensions round down
+		static void GenerateMips(TextureData& texture);
+		static void Downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight);
+
+		static uint32_t GetMipCount(uint32_t width, uint32_t height);
+	};
+}
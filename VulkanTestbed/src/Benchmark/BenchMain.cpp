@@ -0,0 +1,92 @@
+#include "pch.h"
+
+#include <cstdlib>
+#include <new>
+
+#include "Benchmark/Benchmark.h"
+
+// Entry point of VulkanTestbedBench, which only builds the CPU side of the engine and runs without a GPU or window.
+
+#if defined(__GNUC__) && !defined(__clang__)
+	// GCC takes the malloc and free inside replaced allocation functions for a mismatched new and delete
+	#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// Every heap allocation goes through these, over-aligned ones excepted, so cases can report allocations per iteration
+void* operator new(size_t size)
+{
+	VulkanTestbed::Benchmark::CountAllocation(size);
+	if (void* memory = std::malloc(size > 0 ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+// VulkanTestbedBench [name|all]... [--json <path>] [--baseline <path>] [--threshold <fraction>] [--margin <ns>]
+// Exits with 1 when a benchmark is unknown or failed, or when a case regressed against the baseline
+int main(int argc, char** argv)
+{
+	std::vector<std::string> names;
+	std::filesystem::path jsonPath;
+	std::filesystem::path baselinePath;
+	double threshold = 0.1;
+	double marginNs = 100.0;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+			jsonPath = argv[++i];
+		else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+			baselinePath = argv[++i];
+		else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+			threshold = std::strtod(argv[++i], nullptr);
+		else if (strcmp(argv[i], "--margin") == 0 && i + 1 < argc)
+			marginNs = std::strtod(argv[++i], nullptr);
+		else
+			names.push_back(argv[i]);
+	}
+	if (names.empty())
+		names.push_back("all");
+
+	// Logging from the benchmarked code shouldn't wait on the console
+	VulkanTestbed::Log::Init();
+	VulkanTestbed::Benchmark::EnableAllocationCounting();
+
+	bool passed = true;
+	for (const std::string& name : names)
+		passed &= VulkanTestbed::Benchmark::Run(name);
+
+	if (!jsonPath.empty() && !VulkanTestbed::Benchmark::WriteResults(jsonPath))
+	{
+		LOG_ERROR("Failed to write benchmark results to {}", jsonPath.string());
+		passed = false;
+	}
+	if (!baselinePath.empty())
+		passed &= VulkanTestbed::Benchmark::CompareBaseline(baselinePath, threshold, marginNs * 1e-9);
+
+	VulkanTestbed::Log::Shutdown();
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,331 @@
+#include "pch.h"
+#include "Benchmark.h"
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+
+#include "Core/JobSystem.h"
+#include "Core/Timer.h"
+
+namespace VulkanTestbed
+{
+	static std::vector<BenchmarkResult> s_Results;
+	// Name of the benchmark being run, prefixes the names of its cases
+	static std::string s_CurrentBenchmark;
+	static uint32_t s_CurrentFailures = 0;
+
+	// Constant initialized, operator new may count before any static constructor has run
+	static std::atomic<bool> s_CountingAllocations = false;
+	// Per thread, a case only reads the counters of the thread it is measured on
+	static thread_local uint64_t t_AllocationCount = 0;
+	static thread_local uint64_t t_AllocatedBytes = 0;
+
+	// Function local so registration doesn't depend on static initialization order across translation units
+	static std::map<std::string, BenchmarkFunction>& GetBenchmarks()
+	{
+		static std::map<std::string, BenchmarkFunction> benchmarks;
+		return benchmarks;
+	}
+
+	static double Percentile(const std::vector<double>& sorted, double p)
+	{
+		if (sorted.empty())
+			return 0.0;
+
+		size_t index = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+
+	static std::string FormatSeconds(double seconds)
+	{
+		if (seconds < 1e-6)
+			return fmt::format("{:.1f} ns", seconds * 1e9);
+		if (seconds < 1e-3)
+			return fmt::format("{:.2f} us", seconds * 1e6);
+		if (seconds < 1.0)
+			return fmt::format("{:.2f} ms", seconds * 1e3);
+		return fmt::format("{:.2f} s", seconds);
+	}
+
+	static std::string FormatThroughput(double itemsPerSecond)
+	{
+		if (itemsPerSecond <= 0.0)
+			return "-";
+		if (itemsPerSecond >= 1e9)
+			return fmt::format("{:.2f} G/s", itemsPerSecond * 1e-9);
+		if (itemsPerSecond >= 1e6)
+			return fmt::format("{:.2f} M/s", itemsPerSecond * 1e-6);
+		if (itemsPerSecond >= 1e3)
+			return fmt::format("{:.2f} K/s", itemsPerSecond * 1e-3);
+		return fmt::format("{:.2f} /s", itemsPerSecond);
+	}
+
+	static void LogResults(size_t first)
+	{
+		if (first == s_Results.size())
+			return;
+
+		size_t nameWidth = 4;
+		for (size_t i = first; i < s_Results.size(); ++i)
+			nameWidth = std::max(nameWidth, s_Results[i].Name.size());
+
+		LOG_INFO("\t{:<{}} | {:>6} | {:>10} | {:>10} | {:>10} | {:>11} | {:>10}", "Case", nameWidth, "iters", "mean", "p50", "p99", "allocs/iter", "throughput");
+		for (size_t i = first; i < s_Results.size(); ++i)
+		{
+			const BenchmarkResult& result = s_Results[i];
+			const std::string allocations = result.Allocations >= 0.0 ? fmt::format("{:.1f}", result.Allocations) : "-";
+			LOG_INFO("\t{:<{}} | {:>6} | {:>10} | {:>10} | {:>10} | {:>11} | {:>10}", result.Name, nameWidth, result.Iterations, FormatSeconds(result.Mean),
+				FormatSeconds(result.P50), FormatSeconds(result.P99), allocations, FormatThroughput(result.Throughput));
+		}
+	}
+
+	BenchmarkCase::BenchmarkCase(const std::string& name, uint64_t itemsPerIteration)
+		: m_Name(s_CurrentBenchmark.empty() ? name : s_CurrentBenchmark + "/" + name), m_ItemsPerIteration(itemsPerIteration)
+	{
+	}
+
+	void BenchmarkCase::Begin()
+	{
+		m_BeginAllocations = t_AllocationCount;
+		m_BeginAllocatedBytes = t_AllocatedBytes;
+		m_Begin = std::chrono::steady_clock::now();
+	}
+
+	void BenchmarkCase::End()
+	{
+		const auto end = std::chrono::steady_clock::now();
+		m_Samples.push_back(std::chrono::duration<double>(end - m_Begin).count());
+		m_Allocations += t_AllocationCount - m_BeginAllocations;
+		m_AllocatedBytes += t_AllocatedBytes - m_BeginAllocatedBytes;
+	}
+
+	BenchmarkResult BenchmarkCase::Finish()
+	{
+		BenchmarkResult result;
+		result.Name = m_Name;
+		result.Iterations = (uint32_t)m_Samples.size();
+		result.Parallel = JobSystem::GetThreadCount() > 1;
+		if (!m_Samples.empty())
+		{
+			std::sort(m_Samples.begin(), m_Samples.end());
+			double total = 0.0;
+			for (double sample : m_Samples)
+				total += sample;
+
+			result.Mean = total / (double)m_Samples.size();
+			result.Min = m_Samples.front();
+			result.P50 = Percentile(m_Samples, 0.50);
+			result.P90 = Percentile(m_Samples, 0.90);
+			result.P99 = Percentile(m_Samples, 0.99);
+			result.Max = m_Samples.back();
+			if (Benchmark::IsCountingAllocations())
+			{
+				result.Allocations = (double)m_Allocations / (double)m_Samples.size();
+				result.AllocatedBytes = (double)m_AllocatedBytes / (double)m_Samples.size();
+			}
+			if (m_ItemsPerIteration > 0 && result.P50 > 0.0)
+				result.Throughput = (double)m_ItemsPerIteration / result.P50;
+		}
+
+		s_Results.push_back(result);
+		return result;
+	}
+
+	bool Benchmark::Register(const char* name, BenchmarkFunction function)
+	{
+		GetBenchmarks()[name] = function;
+		return true;
+	}
+
+	bool Benchmark::Run(const std::string& name)
+	{
+		const auto& benchmarks = GetBenchmarks();
+		bool found = false;
+		bool passed = true;
+		for (const auto& [benchmarkName, function] : benchmarks)
+		{
+			if (name != "all" && name != benchmarkName)
+				continue;
+
+			LOG_INFO("Benchmark '{}':", benchmarkName);
+			const size_t firstResult = s_Results.size();
+			s_CurrentBenchmark = benchmarkName;
+			s_CurrentFailures = 0;
+			Timer timer;
+			function();
+			s_CurrentBenchmark.clear();
+			LogResults(firstResult);
+			if (s_CurrentFailures > 0)
+				LOG_ERROR("Benchmark '{}' failed {} checks", benchmarkName, s_CurrentFailures);
+			LOG_INFO("Benchmark '{}' finished in {:.2f} s", benchmarkName, timer.Elapsed());
+			found = true;
+			passed &= s_CurrentFailures == 0;
+		}
+
+		if (!found)
+		{
+			LOG_ERROR("Unknown benchmark '{}', available:", name);
+			for (const auto& [benchmarkName, function] : benchmarks)
+				LOG_ERROR("\t{}", benchmarkName);
+		}
+		return found && passed;
+	}
+
+	void Benchmark::ReportFailure(const std::string& message)
+	{
+		LOG_ERROR("\t{}", message);
+		++s_CurrentFailures;
+	}
+
+	std::vector<uint32_t> Benchmark::GetThreadCounts()
+	{
+		const uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<uint32_t> threadCounts;
+		for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+			threadCounts.push_back(threads);
+		threadCounts.push_back(maxThreads);
+		return threadCounts;
+	}
+
+	const std::vector<BenchmarkResult>& Benchmark::GetResults()
+	{
+		return s_Results;
+	}
+
+	// One case per line, so CompareBaseline can read the file back without a JSON parser
+	bool Benchmark::WriteResults(const std::filesystem::path& path)
+	{
+		const auto count = [](double value) { return value >= 0.0 ? fmt::format("{:.2f}", value) : std::string("null"); };
+
+		std::string json = "{\n\t\"benchmarks\": [\n";
+		for (size_t i = 0; i < s_Results.size(); ++i)
+		{
+			const BenchmarkResult& result = s_Results[i];
+			json += fmt::format("\t\t{{ \"name\": \"{}\", \"iterations\": {}, \"meanNs\": {:.1f}, \"minNs\": {:.1f}, \"p50Ns\": {:.1f}, \"p90Ns\": {:.1f}, "
+				"\"p99Ns\": {:.1f}, \"maxNs\": {:.1f}, \"allocations\": {}, \"allocatedBytes\": {}, \"itemsPerSecond\": {:.1f} }}{}\n",
+				result.Name, result.Iterations, result.Mean * 1e9, result.Min * 1e9, result.P50 * 1e9, result.P90 * 1e9, result.P99 * 1e9, result.Max * 1e9,
+				count(result.Allocations), count(result.AllocatedBytes), result.Throughput, i + 1 < s_Results.size() ? "," : "");
+		}
+		json += "\t]\n}\n";
+
+		const std::filesystem::path tempPath = std::filesystem::path(path).concat(".tmp");
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write(json.data(), (std::streamsize)json.size());
+		file.close();
+		if (!file)
+			return false;
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, path, error);
+		if (error)
+			return false;
+
+		LOG_INFO("Benchmark: wrote {} results to {}", s_Results.size(), path.string());
+		return true;
+	}
+
+	static bool FindNumber(const std::string& line, const char* key, double& outValue)
+	{
+		const size_t position = line.find(fmt::format("\"{}\": ", key));
+		if (position == std::string::npos)
+			return false;
+
+		const char* begin = line.c_str() + position + strlen(key) + 4;
+		char* end = nullptr;
+		outValue = std::strtod(begin, &end);
+		return end != begin;
+	}
+
+	bool Benchmark::CompareBaseline(const std::filesystem::path& path, double threshold, double marginSeconds)
+	{
+		std::ifstream file(path);
+		if (!file)
+		{
+			LOG_ERROR("Benchmark: failed to read baseline {}", path.string());
+			return false;
+		}
+
+		struct BaselineEntry
+		{
+			double MinNs = 0.0;
+			double Allocations = -1.0;
+		};
+		std::unordered_map<std::string, BaselineEntry> baseline;
+		std::string line;
+		while (std::getline(file, line))
+		{
+			static constexpr const char NameKey[] = "\"name\": \"";
+			const size_t nameBegin = line.find(NameKey);
+			if (nameBegin == std::string::npos)
+				continue;
+
+			const size_t nameEnd = line.find('"', nameBegin + sizeof(NameKey) - 1);
+			BaselineEntry entry;
+			if (nameEnd == std::string::npos || !FindNumber(line, "minNs", entry.MinNs))
+				continue;
+			FindNumber(line, "allocations", entry.Allocations);
+			baseline[line.substr(nameBegin + sizeof(NameKey) - 1, nameEnd - nameBegin - sizeof(NameKey) + 1)] = entry;
+		}
+
+		LOG_INFO("Benchmark: comparing minimums against {}, regressions above {:.0f}% + {}", path.string(), threshold * 100.0, FormatSeconds(marginSeconds));
+		uint32_t regressions = 0;
+		uint32_t missing = 0;
+		for (const BenchmarkResult& result : s_Results)
+		{
+			auto it = baseline.find(result.Name);
+			if (it == baseline.end())
+			{
+				LOG_INFO("\t{}: not in the baseline", result.Name);
+				continue;
+			}
+
+			const BaselineEntry& entry = it->second;
+			const double baselineMin = entry.MinNs * 1e-9;
+			const double ratio = baselineMin > 0.0 ? result.Min / baselineMin : 1.0;
+			const bool slower = result.Min > baselineMin * (1.0 + threshold) + marginSeconds;
+			// On one thread the counts are deterministic and any growth is a real change
+			const bool moreAllocations = !result.Parallel && entry.Allocations >= 0.0 && result.Allocations >= 0.0 && result.Allocations > entry.Allocations + 0.5;
+			const bool regressed = slower || moreAllocations;
+			regressions += regressed;
+
+			const std::string message = fmt::format("\t{}: {} -> {} ({:+.1f}%){}", result.Name, FormatSeconds(baselineMin), FormatSeconds(result.Min),
+				(ratio - 1.0) * 100.0, moreAllocations ? fmt::format(", allocations {:.1f} -> {:.1f}", entry.Allocations, result.Allocations) : "");
+			if (regressed)
+				LOG_ERROR("{}", message);
+			else
+				LOG_INFO("{}", message);
+			baseline.erase(it);
+		}
+		for (const auto& [name, entry] : baseline)
+		{
+			LOG_WARN("\t{}: in the baseline but not measured", name);
+			++missing;
+		}
+
+		if (regressions > 0)
+			LOG_ERROR("Benchmark: {} of {} cases regressed", regressions, s_Results.size());
+		else
+			LOG_INFO("Benchmark: no regressions in {} cases, {} baseline cases not measured", s_Results.size(), missing);
+		return regressions == 0;
+	}
+
+	void Benchmark::EnableAllocationCounting()
+	{
+		s_CountingAllocations.store(true, std::memory_order_relaxed);
+	}
+
+	void Benchmark::CountAllocation(size_t size)
+	{
+		++t_AllocationCount;
+		t_AllocatedBytes += size;
+	}
+
+	bool Benchmark::IsCountingAllocations()
+	{
+		return s_CountingAllocations.load(std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+
+namespace VulkanTestbed
+{
+	using BenchmarkFunction = void(*)();
+
+	// Per iteration statistics of one case, times in seconds
+	struct BenchmarkResult
+	{
+		// Prefixed with the benchmark that measured it, "Culling/Frustum/4T"
+		std::string Name;
+		uint32_t Iterations = 0;
+		double Mean = 0.0;
+		double Min = 0.0;
+		double P50 = 0.0;
+		double P90 = 0.0;
+		double P99 = 0.0;
+		double Max = 0.0;
+		// Heap allocations of the measuring thread, negative when the executable doesn't count them. Jobs and the
+		// async logger's thread allocate on their own and would make the counts depend on timing.
+		double Allocations = -1.0;
+		double AllocatedBytes = -1.0;
+		// Measured while the job system had workers, the measuring thread's share of the jobs, and so its allocation
+		// count, then depends on timing
+		bool Parallel = false;
+		// Items per second at the median, 0 when the case didn't say what an item is
+		double Throughput = 0.0;
+	};
+
+	// Collects the samples of one case, Begin and End bracket every iteration
+	class BenchmarkCase
+	{
+	public:
+		BenchmarkCase(const std::string& name, uint64_t itemsPerIteration = 0);
+
+		void Begin();
+		void End();
+		// Adds the statistics to the results of the run
+		BenchmarkResult Finish();
+
+	private:
+		std::string m_Name;
+		uint64_t m_ItemsPerIteration;
+		std::vector<double> m_Samples;
+		uint64_t m_Allocations = 0;
+		uint64_t m_AllocatedBytes = 0;
+
+		std::chrono::steady_clock::time_point m_Begin;
+		uint64_t m_BeginAllocations = 0;
+		uint64_t m_BeginAllocatedBytes = 0;
+	};
+
+	// Benchmarks register themselves during static initialization and are run by name from the command line
+	class Benchmark
+	{
+	public:
+		static bool Register(const char* name, BenchmarkFunction function);
+		// "all" runs every registered benchmark, returns false for unknown names and failed benchmarks
+		static bool Run(const std::string& name);
+		// Fails the running benchmark, for the ones that check the results of what they measure
+		static void ReportFailure(const std::string& message);
+
+		// Powers of two up to the hardware thread count, which is always included
+		static std::vector<uint32_t> GetThreadCounts();
+
+		template<typename F>
+		static BenchmarkResult Measure(const std::string& name, uint32_t iterations, uint64_t itemsPerIteration, const F& func)
+		{
+			BenchmarkCase benchmarkCase(name, itemsPerIteration);
+			for (uint32_t i = 0; i < iterations; ++i)
+			{
+				benchmarkCase.Begin();
+				func();
+				benchmarkCase.End();
+			}
+			return benchmarkCase.Finish();
+		}
+
+		// Every case measured so far, in order
+		static const std::vector<BenchmarkResult>& GetResults();
+		static bool WriteResults(const std::filesystem::path& path);
+		// Compares against a file written by WriteResults. Minimums are the least noisy statistic, a case only regressed
+		// when its minimum grew by more than the relative threshold plus the absolute margin, which keeps timer
+		// resolution on nanosecond cases from tripping it. Growing allocation counts count for cases that ran on a single
+		// thread, parallel ones only compare times. False on regressions, cases missing on either side are only reported.
+		static bool CompareBaseline(const std::filesystem::path& path, double threshold, double marginSeconds);
+
+		// Called by the benchmark executable's operator new, allocations aren't counted anywhere else
+		static void EnableAllocationCounting();
+		static void CountAllocation(size_t size);
+		static bool IsCountingAllocations();
+	};
+}
+
+#define TESTBED_BENCHMARK(name) \
+	static void name##Benchmark(); \
+	static const bool s_##name##BenchmarkRegistered = ::VulkanTestbed::Benchmark::Register(#name, &name##Benchmark); \
+	static void name##Benchmark()
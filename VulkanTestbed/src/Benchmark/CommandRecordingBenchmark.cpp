@@ -0,0 +1,327 @@
+#include "pch.h"
+#include "Benchmark.h"
+
+#include "Core/JobSystem.h"
+#include "Core/Timer.h"
+#include "CommandRecorder.h"
+#include "DeviceAllocator.h"
+#include "HostAllocator.h"
+#include "VulkanContext.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t DrawCount = 50000;
+	static constexpr uint32_t DrawsPerCommandBuffer = 512;
+	static constexpr uint32_t WarmupFrames = 4;
+	static constexpr uint32_t MeasuredFrames = 32;
+	static constexpr VkExtent2D TargetExtent = { 64, 64 };
+
+	// Hand assembled so the benchmark runs without a shader compiler:
+	//   OpCapability Shader
+	//   OpMemoryModel Logical GLSL450
+	//   OpEntryPoint Vertex %main "main" %position
+	//   OpDecorate %position BuiltIn Position
+	//   ...
+	//   %main = OpFunction %void None %fn
+	//           OpStore %position (OpConstantNull %v4float)
+	static const uint32_t VertexShaderSpirv[] =
+	{
+		0x07230203, 0x00010000, 0x00000000, 10, 0,
+		0x00020011, 1,
+		0x0003000E, 0, 1,
+		0x0006000F, 0, 1, 0x6E69616D, 0x00000000, 7,
+		0x00040047, 7, 11, 0,
+		0x00020013, 2,
+		0x00030021, 3, 2,
+		0x00030016, 4, 32,
+		0x00040017, 5, 4, 4,
+		0x00040020, 6, 3, 5,
+		0x0004003B, 6, 7, 3,
+		0x0003002E, 5, 8,
+		0x00050036, 2, 1, 0, 3,
+		0x000200F8, 9,
+		0x0003003E, 7, 8,
+		0x000100FD,
+		0x00010038
+	};
+
+	struct DrawPushConstants
+	{
+		float Transform[16];
+	};
+
+	// Rasterization is discarded, the GPU side is only there so the recorded commands are valid and get executed
+	struct DrawTarget
+	{
+		VkImage Image = nullptr;
+		DeviceAllocation ImageMemory;
+		VkImageView View = nullptr;
+		VkRenderPass RenderPass = nullptr;
+		VkFramebuffer Framebuffer = nullptr;
+		VkPipelineLayout PipelineLayout = nullptr;
+		VkPipeline Pipeline = nullptr;
+		// Vertex and index data every draw points into
+		VkBuffer Buffer = nullptr;
+		DeviceAllocation BufferMemory;
+	};
+
+	static DrawTarget CreateDrawTarget()
+	{
+		const VkDevice device = VulkanContext::GetDevice();
+		const VkAllocationCallbacks* callbacks = HostAllocator::GetCallbacks(HostSubsystem::Pipelines);
+		DrawTarget target;
+
+		VkImageCreateInfo imageCreateInfo = {};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		imageCreateInfo.extent = { TargetExtent.width, TargetExtent.height, 1 };
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkResult result = vkCreateImage(device, &imageCreateInfo, callbacks, &target.Image);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create benchmark target!");
+		target.ImageMemory = VulkanContext::GetAllocator().AllocateImage(target.Image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		VkImageViewCreateInfo viewCreateInfo = {};
+		viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewCreateInfo.image = target.Image;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = imageCreateInfo.format;
+		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vkCreateImageView(device, &viewCreateInfo, callbacks, &target.View);
+
+		VkAttachmentDescription attachment = {};
+		attachment.format = imageCreateInfo.format;
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorReference;
+
+		VkRenderPassCreateInfo renderPassCreateInfo = {};
+		renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassCreateInfo.attachmentCount = 1;
+		renderPassCreateInfo.pAttachments = &attachment;
+		renderPassCreateInfo.subpassCount = 1;
+		renderPassCreateInfo.pSubpasses = &subpass;
+		vkCreateRenderPass(device, &renderPassCreateInfo, callbacks, &target.RenderPass);
+
+		VkFramebufferCreateInfo framebufferCreateInfo = {};
+		framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferCreateInfo.renderPass = target.RenderPass;
+		framebufferCreateInfo.attachmentCount = 1;
+		framebufferCreateInfo.pAttachments = &target.View;
+		framebufferCreateInfo.width = TargetExtent.width;
+		framebufferCreateInfo.height = TargetExtent.height;
+		framebufferCreateInfo.layers = 1;
+		vkCreateFramebuffer(device, &framebufferCreateInfo, callbacks, &target.Framebuffer);
+
+		const VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawPushConstants) };
+		VkPipelineLayoutCreateInfo layoutCreateInfo = {};
+		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutCreateInfo.pushConstantRangeCount = 1;
+		layoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		vkCreatePipelineLayout(device, &layoutCreateInfo, callbacks, &target.PipelineLayout);
+
+		VkShaderModuleCreateInfo moduleCreateInfo = {};
+		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleCreateInfo.codeSize = sizeof(VertexShaderSpirv);
+		moduleCreateInfo.pCode = VertexShaderSpirv;
+		VkShaderModule vertexShader = nullptr;
+		result = vkCreateShaderModule(device, &moduleCreateInfo, callbacks, &vertexShader);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create benchmark shader!");
+
+		VkPipelineShaderStageCreateInfo stage = {};
+		stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		stage.module = vertexShader;
+		stage.pName = "main";
+
+		VkPipelineVertexInputStateCreateInfo vertexInput = {};
+		vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+		const VkViewport viewport = { 0.0f, 0.0f, (float)TargetExtent.width, (float)TargetExtent.height, 0.0f, 1.0f };
+		const VkRect2D scissor = { { 0, 0 }, TargetExtent };
+		VkPipelineViewportStateCreateInfo viewportState = {};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.pViewports = &viewport;
+		viewportState.scissorCount = 1;
+		viewportState.pScissors = &scissor;
+
+		VkPipelineRasterizationStateCreateInfo rasterization = {};
+		rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterization.rasterizerDiscardEnable = VK_TRUE;
+		rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterization.cullMode = VK_CULL_MODE_NONE;
+		rasterization.lineWidth = 1.0f;
+
+		VkPipelineMultisampleStateCreateInfo multisample = {};
+		multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkPipelineColorBlendAttachmentState blendAttachment = {};
+		blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		VkPipelineColorBlendStateCreateInfo colorBlend = {};
+		colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlend.attachmentCount = 1;
+		colorBlend.pAttachments = &blendAttachment;
+
+		VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+		pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineCreateInfo.stageCount = 1;
+		pipelineCreateInfo.pStages = &stage;
+		pipelineCreateInfo.pVertexInputState = &vertexInput;
+		pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
+		pipelineCreateInfo.pViewportState = &viewportState;
+		pipelineCreateInfo.pRasterizationState = &rasterization;
+		pipelineCreateInfo.pMultisampleState = &multisample;
+		pipelineCreateInfo.pColorBlendState = &colorBlend;
+		pipelineCreateInfo.layout = target.PipelineLayout;
+		pipelineCreateInfo.renderPass = target.RenderPass;
+		result = vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineCreateInfo, callbacks, &target.Pipeline);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create benchmark pipeline!");
+		vkDestroyShaderModule(device, vertexShader, callbacks);
+
+		VkBufferCreateInfo bufferCreateInfo = {};
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = 64 * 1024;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		vkCreateBuffer(device, &bufferCreateInfo, callbacks, &target.Buffer);
+		target.BufferMemory = VulkanContext::GetAllocator().AllocateBuffer(target.Buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		// Every draw reads indices 0, 1, 2
+		memset(target.BufferMemory.MappedData, 0, (size_t)bufferCreateInfo.size);
+		((uint32_t*)target.BufferMemory.MappedData)[1] = 1;
+		((uint32_t*)target.BufferMemory.MappedData)[2] = 2;
+
+		return target;
+	}
+
+	static void DestroyDrawTarget(DrawTarget& target)
+	{
+		const VkDevice device = VulkanContext::GetDevice();
+		const VkAllocationCallbacks* callbacks = HostAllocator::GetCallbacks(HostSubsystem::Pipelines);
+		vkDestroyBuffer(device, target.Buffer, callbacks);
+		VulkanContext::GetAllocator().Free(target.BufferMemory);
+		vkDestroyPipeline(device, target.Pipeline, callbacks);
+		vkDestroyPipelineLayout(device, target.PipelineLayout, callbacks);
+		vkDestroyFramebuffer(device, target.Framebuffer, callbacks);
+		vkDestroyRenderPass(device, target.RenderPass, callbacks);
+		vkDestroyImageView(device, target.View, callbacks);
+		vkDestroyImage(device, target.Image, callbacks);
+		VulkanContext::GetAllocator().Free(target.ImageMemory);
+		target = {};
+	}
+
+	// What a typical mesh draw costs to record: state for the pipeline, its own buffers and constants, then the draw
+	static void RecordDraws(VkCommandBuffer commandBuffer, const DrawTarget& target, uint32_t begin, uint32_t end)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, target.Pipeline);
+		for (uint32_t draw = begin; draw < end; ++draw)
+		{
+			DrawPushConstants constants = {};
+			constants.Transform[0] = constants.Transform[5] = constants.Transform[10] = constants.Transform[15] = 1.0f;
+			constants.Transform[12] = (float)draw;
+
+			const VkDeviceSize vertexOffset = (draw % 256) * 64;
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &target.Buffer, &vertexOffset);
+			vkCmdBindIndexBuffer(commandBuffer, target.Buffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdPushConstants(commandBuffer, target.PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+			vkCmdDrawIndexed(commandBuffer, 3, 1, 0, 0, 0);
+		}
+	}
+
+	static void BeginRenderPass(VkCommandBuffer commandBuffer, const DrawTarget& target, VkSubpassContents contents)
+	{
+		VkRenderPassBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		beginInfo.renderPass = target.RenderPass;
+		beginInfo.framebuffer = target.Framebuffer;
+		beginInfo.renderArea = { { 0, 0 }, TargetExtent };
+		vkCmdBeginRenderPass(commandBuffer, &beginInfo, contents);
+	}
+
+	// Returns the average CPU time per frame spent recording the draws
+	static double MeasureFrames(const std::function<void(VkCommandBuffer)>& recordFrame)
+	{
+		double recordSeconds = 0.0;
+		for (uint32_t frame = 0; frame < WarmupFrames + MeasuredFrames; ++frame)
+		{
+			VulkanContext::BeginFrame();
+			const VkCommandBuffer primary = VulkanContext::GetCommandBuffer();
+
+			Timer timer;
+			recordFrame(primary);
+			if (frame >= WarmupFrames)
+				recordSeconds += timer.Elapsed();
+
+			VulkanContext::EndFrame();
+		}
+		VulkanContext::WaitIdle();
+		return recordSeconds / (double)MeasuredFrames;
+	}
+
+	TESTBED_BENCHMARK(CommandRecording)
+	{
+		VulkanContext::InitHeadless(TargetExtent.width, TargetExtent.height);
+		DrawTarget target = CreateDrawTarget();
+
+		LOG_INFO("\t{} draws, {} per secondary command buffer", DrawCount, DrawsPerCommandBuffer);
+		LOG_INFO("\tThreads | record (ms) | draws/ms | speedup");
+
+		// Everything on the main thread straight into the primary, what the secondaries have to beat
+		const double inlineSeconds = MeasureFrames([&](VkCommandBuffer primary)
+		{
+			BeginRenderPass(primary, target, VK_SUBPASS_CONTENTS_INLINE);
+			RecordDraws(primary, target, 0, DrawCount);
+			vkCmdEndRenderPass(primary);
+		});
+		LOG_INFO("\t{:>7} | {:>11.3f} | {:>8.0f} | {:>6.2f}x", "inline", inlineSeconds * 1000.0, (double)DrawCount / (inlineSeconds * 1000.0), 1.0);
+
+		VkCommandBufferInheritanceInfo inheritance = {};
+		inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritance.renderPass = target.RenderPass;
+		inheritance.subpass = 0;
+		inheritance.framebuffer = target.Framebuffer;
+
+		for (uint32_t threadCount : Benchmark::GetThreadCounts())
+		{
+			JobSystem::Init(threadCount - 1);
+			{
+				CommandRecorder recorder(VulkanContext::GetGraphicsQueueFamily());
+				const double seconds = MeasureFrames([&](VkCommandBuffer primary)
+				{
+					recorder.BeginFrame();
+					BeginRenderPass(primary, target, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+					recorder.Record(primary, inheritance, DrawCount, DrawsPerCommandBuffer, [&target](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)
+					{
+						RecordDraws(commandBuffer, target, begin, end);
+					});
+					vkCmdEndRenderPass(primary);
+				});
+				LOG_INFO("\t{:>7} | {:>11.3f} | {:>8.0f} | {:>6.2f}x", threadCount, seconds * 1000.0, (double)DrawCount / (seconds * 1000.0), inlineSeconds / seconds);
+			}
+			JobSystem::Shutdown();
+		}
+
+		DestroyDrawTarget(target);
+		VulkanContext::Shutdown();
+	}
+}
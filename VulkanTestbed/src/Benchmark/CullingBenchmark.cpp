@@ -0,0 +1,102 @@
+#include "pch.h"
+#include "Benchmark.h"
+
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Core/JobSystem.h"
+#include "Core/Timer.h"
+#include "Scene/InstanceCuller.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t InstanceCount = 1000000;
+	static constexpr uint32_t OccluderCount = 2000;
+	static constexpr float SceneSize = 2000.0f;
+	static constexpr uint32_t Iterations = 20;
+
+	// Small rotated props spread over a square, with walls between them that occlude most of what is behind
+	static void BuildScene(InstanceDatabase& instances)
+	{
+		std::mt19937 random(InstanceCount);
+		std::uniform_real_distribution<float> position(-SceneSize * 0.5f, SceneSize * 0.5f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		instances.Reserve(InstanceCount);
+		for (uint32_t i = 0; i < InstanceCount - OccluderCount; ++i)
+		{
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), unit(random) * 10.0f, position(random)));
+			transform = glm::rotate(transform, unit(random) * 6.2831853f, glm::vec3(0.0f, 1.0f, 0.0f));
+			transform = glm::scale(transform, glm::vec3(0.5f + unit(random) * 2.0f));
+			instances.Add(transform, glm::vec3(-0.5f), glm::vec3(0.5f));
+		}
+		for (uint32_t i = 0; i < OccluderCount; ++i)
+		{
+			const glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), 0.0f, position(random)));
+			instances.Add(transform, glm::vec3(-20.0f, 0.0f, -1.0f), glm::vec3(20.0f, 25.0f, 1.0f), InstanceFlags::Occluder);
+		}
+	}
+
+	// Straightforward per instance test the SIMD paths have to agree with
+	static void CullReference(const InstanceDatabase& instances, const Frustum& frustum, std::vector<uint32_t>& outVisible)
+	{
+		const InstanceBoundsView bounds = instances.GetBounds();
+		outVisible.clear();
+		for (uint32_t i = 0; i < bounds.Count; ++i)
+		{
+			const glm::vec3 center(bounds[InstanceBoundsComponent::CenterX][i], bounds[InstanceBoundsComponent::CenterY][i], bounds[InstanceBoundsComponent::CenterZ][i]);
+			const glm::vec3 boundsMin(bounds[InstanceBoundsComponent::MinX][i], bounds[InstanceBoundsComponent::MinY][i], bounds[InstanceBoundsComponent::MinZ][i]);
+			const glm::vec3 boundsMax(bounds[InstanceBoundsComponent::MaxX][i], bounds[InstanceBoundsComponent::MaxY][i], bounds[InstanceBoundsComponent::MaxZ][i]);
+
+			bool inside = true;
+			for (const glm::vec4& plane : frustum.Planes)
+			{
+				const glm::vec3 normal(plane);
+				const glm::vec3 farthest = glm::max(boundsMin * normal, boundsMax * normal);
+				inside = inside && glm::dot(center, normal) + plane.w > -bounds[InstanceBoundsComponent::Radius][i] && farthest.x + farthest.y + farthest.z + plane.w >= 0.0f;
+			}
+			if (inside)
+				outVisible.push_back(i);
+		}
+	}
+
+	TESTBED_BENCHMARK(Culling)
+	{
+		InstanceDatabase instances;
+		Timer timer;
+		BuildScene(instances);
+		LOG_INFO("\t{} instances built in {:.2f} s", instances.GetCount(), timer.Elapsed());
+
+		const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+		const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 5.0f, 0.0f), glm::vec3(1.0f, 5.0f, 0.3f), glm::vec3(0.0f, 1.0f, 0.0f));
+		const glm::mat4 viewProjection = projection * view;
+
+		std::vector<uint32_t> reference;
+		const double referenceSeconds = Benchmark::Measure("Scalar", Iterations, InstanceCount, [&]() { CullReference(instances, Frustum::FromViewProjection(viewProjection), reference); }).Min;
+
+		LOG_INFO("\tThreads | scalar (ms) | frustum (ms) | speedup | frustum visible | occlusion (ms) | occluders | visible");
+		for (uint32_t threadCount : Benchmark::GetThreadCounts())
+		{
+			JobSystem::Init(threadCount - 1);
+
+			std::vector<uint32_t> visible;
+			InstanceCuller frustumCuller;
+			const double frustumSeconds = Benchmark::Measure(fmt::format("Frustum/{}T", threadCount), Iterations, InstanceCount, [&]() { frustumCuller.Cull(instances, viewProjection, visible); }).Min;
+			if (visible != reference)
+				Benchmark::ReportFailure(fmt::format("SIMD frustum culling disagrees with the scalar reference with {} threads", threadCount));
+
+			CullSettings occlusionSettings;
+			occlusionSettings.Occlusion = true;
+			InstanceCuller occlusionCuller(occlusionSettings);
+			const double occlusionSeconds = Benchmark::Measure(fmt::format("Occlusion/{}T", threadCount), Iterations, InstanceCount, [&]() { occlusionCuller.Cull(instances, viewProjection, visible); }).Min;
+			const CullStatistics& statistics = occlusionCuller.GetStatistics();
+
+			JobSystem::Shutdown();
+
+			LOG_INFO("\t{:7} | {:11.2f} | {:12.2f} | {:6.2f}x | {:15} | {:14.2f} | {:9} | {}",
+				threadCount, referenceSeconds * 1000.0, frustumSeconds * 1000.0, referenceSeconds / frustumSeconds,
+				statistics.FrustumVisible, occlusionSeconds * 1000.0, statistics.Occluders, statistics.Visible);
+		}
+	}
+}
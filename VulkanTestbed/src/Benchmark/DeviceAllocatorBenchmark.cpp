@@ -0,0 +1,198 @@
+#include "pch.h"
+#include "Benchmark.h"
+
+#include <cmath>
+#include <random>
+
+#include "DeviceAllocator.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t OperationCount = 200000;
+	static constexpr uint32_t LiveAllocationTarget = 2000;
+	static constexpr uint32_t ValidationInterval = 10000;
+
+	// Hands out fake handles and tracks heap usage, enough to drive the allocator without a GPU
+	class MockMemoryBackend : public DeviceMemoryBackend
+	{
+	public:
+		MockMemoryBackend(VkDeviceSize bufferImageGranularity)
+			: m_BufferImageGranularity(bufferImageGranularity)
+		{
+			// Laid out like a typical discrete GPU: VRAM, system memory and the small BAR window
+			m_MemoryProperties.memoryHeapCount = 3;
+			m_MemoryProperties.memoryHeaps[0] = { 8ull << 30, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+			m_MemoryProperties.memoryHeaps[1] = { 16ull << 30, 0 };
+			m_MemoryProperties.memoryHeaps[2] = { 256ull << 20, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+			m_MemoryProperties.memoryTypeCount = 3;
+			m_MemoryProperties.memoryTypes[0] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+			m_MemoryProperties.memoryTypes[1] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1 };
+			m_MemoryProperties.memoryTypes[2] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 2 };
+		}
+
+		const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const override { return m_MemoryProperties; }
+		VkDeviceSize GetBufferImageGranularity() const override { return m_BufferImageGranularity; }
+
+		VkDeviceMemory Allocate(uint32_t memoryType, VkDeviceSize size, VkImage, VkBuffer) override
+		{
+			const uint32_t heap = m_MemoryProperties.memoryTypes[memoryType].heapIndex;
+			if (m_HeapUsage[heap] + size > m_MemoryProperties.memoryHeaps[heap].size)
+				return nullptr;
+
+			m_HeapUsage[heap] += size;
+			const VkDeviceMemory memory = (VkDeviceMemory)(uintptr_t)++m_NextHandle;
+			m_Allocations[memory] = { heap, size };
+			return memory;
+		}
+
+		void Free(VkDeviceMemory memory) override
+		{
+			auto it = m_Allocations.find(memory);
+			TESTBED_ASSERT(it != m_Allocations.end(), "Freeing unknown device memory!");
+			m_HeapUsage[it->second.first] -= it->second.second;
+			m_Allocations.erase(it);
+		}
+
+		void* Map(VkDeviceMemory memory) override
+		{
+			// Never dereferenced, only offset
+			return (void*)((uintptr_t)memory << 40);
+		}
+
+		size_t GetLiveAllocationCount() const { return m_Allocations.size(); }
+
+	private:
+		VkPhysicalDeviceMemoryProperties m_MemoryProperties = {};
+		VkDeviceSize m_BufferImageGranularity;
+		std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> m_HeapUsage = {};
+		std::unordered_map<VkDeviceMemory, std::pair<uint32_t, VkDeviceSize>> m_Allocations;
+		uint64_t m_NextHandle = 0;
+	};
+
+	struct LiveAllocation
+	{
+		DeviceAllocation Allocation;
+		VkDeviceSize RequestedSize;
+		VkDeviceSize Alignment;
+		DeviceResourceKind Kind;
+	};
+
+	// Ranges in the same memory must not overlap, and linear and optimal resources must not share a granularity page
+	static uint32_t Validate(const std::vector<LiveAllocation>& allocations, VkDeviceSize granularity)
+	{
+		std::vector<const LiveAllocation*> sorted;
+		for (const LiveAllocation& live : allocations)
+			sorted.push_back(&live);
+		std::sort(sorted.begin(), sorted.end(), [](const LiveAllocation* a, const LiveAllocation* b)
+		{
+			return a->Allocation.Memory != b->Allocation.Memory ? a->Allocation.Memory < b->Allocation.Memory : a->Allocation.Offset < b->Allocation.Offset;
+		});
+
+		uint32_t errors = 0;
+		for (size_t i = 0; i < sorted.size(); ++i)
+		{
+			const LiveAllocation& live = *sorted[i];
+			if (live.Allocation.Offset % live.Alignment != 0 || live.Allocation.Size < live.RequestedSize)
+				++errors;
+
+			if (i == 0 || sorted[i - 1]->Allocation.Memory != live.Allocation.Memory)
+				continue;
+
+			const LiveAllocation& prev = *sorted[i - 1];
+			const VkDeviceSize prevEnd = prev.Allocation.Offset + prev.Allocation.Size;
+			if (prevEnd > live.Allocation.Offset)
+				++errors;
+			if (prev.Kind != live.Kind && (prevEnd - 1) / granularity == live.Allocation.Offset / granularity)
+				++errors;
+		}
+		return errors;
+	}
+
+	static void RunStreamingChurn(VkDeviceSize granularity)
+	{
+		auto backendOwner = std::make_unique<MockMemoryBackend>(granularity);
+		MockMemoryBackend& backend = *backendOwner;
+		DeviceAllocator allocator(std::move(backendOwner));
+
+		// Fixed seed so runs are comparable
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		std::vector<LiveAllocation> live;
+		live.reserve(LiveAllocationTarget * 2);
+		uint32_t allocationCount = 0;
+		uint32_t failedCount = 0;
+		uint32_t errors = 0;
+		// Every operation is one sample, the tail shows the cost of reaching for a new block
+		BenchmarkCase allocateCase(fmt::format("Allocate/{}", granularity), 1);
+		BenchmarkCase freeCase(fmt::format("Free/{}", granularity), 1);
+
+		for (uint32_t operation = 0; operation < OperationCount; ++operation)
+		{
+			const bool allocate = live.empty() || (live.size() < LiveAllocationTarget ? unit(random) < 0.75f : unit(random) < 0.5f);
+			if (allocate)
+			{
+				// Log uniform between 4KB and 16MB, the spread of texture mips and mesh buffers
+				VkMemoryRequirements requirements = {};
+				requirements.size = (VkDeviceSize)std::exp2(12.0f + unit(random) * 12.0f);
+				requirements.alignment = 256ull << (uint32_t)(unit(random) * 9.0f);
+				requirements.memoryTypeBits = 0x7;
+				const DeviceResourceKind kind = unit(random) < 0.7f ? DeviceResourceKind::Optimal : DeviceResourceKind::Linear;
+				const VkMemoryPropertyFlags properties = unit(random) < 0.9f ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+				allocateCase.Begin();
+				DeviceAllocation allocation = allocator.Allocate(requirements, properties, kind);
+				allocateCase.End();
+
+				if (!allocation.Memory)
+				{
+					++failedCount;
+					continue;
+				}
+				live.push_back({ allocation, requirements.size, requirements.alignment, kind });
+				++allocationCount;
+			}
+			else
+			{
+				const size_t index = (size_t)(unit(random) * (float)(live.size() - 1));
+				std::swap(live[index], live.back());
+
+				freeCase.Begin();
+				allocator.Free(live.back().Allocation);
+				freeCase.End();
+
+				live.pop_back();
+			}
+
+			if ((operation + 1) % ValidationInterval == 0)
+				errors += Validate(live, granularity);
+		}
+
+		const BenchmarkResult allocateResult = allocateCase.Finish();
+		const BenchmarkResult freeResult = freeCase.Finish();
+		const DeviceAllocatorStatistics stats = allocator.GetStatistics();
+		const double mb = 1.0 / (1024.0 * 1024.0);
+		LOG_INFO("\t{:>11} | {:>14.1f} | {:>10.1f} | {:>11} | {:>6} / {:<6} | {:>7.1f} / {:<7.1f} | {:>12.1f}% | {}",
+			granularity, allocateResult.Mean * 1e9, freeResult.Mean * 1e9,
+			allocationCount, stats.BlockCount, stats.DedicatedCount, (double)stats.UsedSize * mb, (double)stats.ReservedSize * mb,
+			stats.GetFragmentation() * 100.0f, errors);
+		LOG_INFO("\t{:>11} | {} driver allocations instead of {}, {} failed", "", stats.DeviceAllocationCount, allocationCount, failedCount);
+
+		for (LiveAllocation& allocation : live)
+			allocator.Free(allocation.Allocation);
+		// Only the one block kept per pool may survive
+		if (backend.GetLiveAllocationCount() != allocator.GetStatistics().BlockCount)
+			Benchmark::ReportFailure(fmt::format("DeviceAllocator leaked device memory at granularity {}", granularity));
+		if (errors > 0)
+			Benchmark::ReportFailure(fmt::format("DeviceAllocator handed out {} invalid ranges at granularity {}", errors, granularity));
+	}
+
+	TESTBED_BENCHMARK(DeviceAllocator)
+	{
+		LOG_INFO("\tGranularity | alloc (ns/op) | free (ns/op) | allocations | blocks / dedicated | used / reserved (MB) | fragmentation | errors");
+		// Shared blocks when the granularity is below the range alignment, split pools above it
+		RunStreamingChurn(1);
+		RunStreamingChurn(1024);
+		RunStreamingChurn(64 * 1024);
+	}
+}
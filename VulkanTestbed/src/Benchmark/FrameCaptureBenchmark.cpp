@@ -0,0 +1,72 @@
+#include "pch.h"
+#include "Benchmark.h"
+
+#include <random>
+
+#include "Asset/ImageDiff.h"
+#include "Asset/ImageWriter.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t FrameWidth = 1600;
+	static constexpr uint32_t FrameHeight = 900;
+	static constexpr uint32_t Iterations = 5;
+
+	// Gradient sky over noisy geometry, compresses about as well as a rendered frame does
+	static std::vector<uint8_t> BuildFrame()
+	{
+		std::mt19937 random(FrameWidth);
+		std::vector<uint8_t> rgba((size_t)FrameWidth * FrameHeight * 4);
+		for (uint32_t y = 0; y < FrameHeight; ++y)
+		{
+			for (uint32_t x = 0; x < FrameWidth; ++x)
+			{
+				uint8_t* pixel = &rgba[((size_t)y * FrameWidth + x) * 4];
+				const bool geometry = y > FrameHeight / 2 && ((x / 64 + y / 48) & 1);
+				const uint8_t noise = geometry ? (uint8_t)(random() & 15) : 0;
+				pixel[0] = (uint8_t)(geometry ? 90 + noise : 40 + y * 60 / FrameHeight);
+				pixel[1] = (uint8_t)(geometry ? 70 + noise : 90 + y * 80 / FrameHeight);
+				pixel[2] = (uint8_t)(geometry ? 60 + noise : 200 - y * 40 / FrameHeight);
+				pixel[3] = 255;
+			}
+		}
+		return rgba;
+	}
+
+	TESTBED_BENCHMARK(FrameCapture)
+	{
+		const std::vector<uint8_t> frame = BuildFrame();
+		const uint64_t pixelCount = (uint64_t)FrameWidth * FrameHeight;
+
+		// The golden image differs by one step everywhere and by a lot in one block
+		std::vector<uint8_t> golden = frame;
+		for (size_t i = 0; i < golden.size(); i += 7)
+			golden[i] = golden[i] > 0 ? golden[i] - 1 : 1;
+		for (uint32_t y = 100; y < 140; ++y)
+			memset(&golden[((size_t)y * FrameWidth + 200) * 4], 0, 40 * 4);
+
+		std::vector<uint8_t> file;
+		const double pngSeconds = Benchmark::Measure("EncodePNG", Iterations, pixelCount, [&]() { ImageWriter::EncodePNG(FrameWidth, FrameHeight, frame.data(), file); }).Min;
+		const size_t pngSize = file.size();
+
+		std::vector<float> linear(frame.size());
+		for (size_t i = 0; i < frame.size(); ++i)
+			linear[i] = (float)frame[i] / 255.0f;
+		const double exrSeconds = Benchmark::Measure("EncodeEXR", Iterations, pixelCount, [&]() { ImageWriter::EncodeEXR(FrameWidth, FrameHeight, linear.data(), file); }).Min;
+
+		ImageDiffResult scalar, simd;
+		const double scalarSeconds = Benchmark::Measure("DiffScalar", Iterations, pixelCount, [&]() { scalar = ImageDiff::CompareScalar(frame.data(), golden.data(), pixelCount, 2); }).Min;
+		const double simdSeconds = Benchmark::Measure("Diff", Iterations, pixelCount, [&]() { simd = ImageDiff::Compare(frame.data(), golden.data(), pixelCount, 2); }).Min;
+		if (scalar.MismatchedPixels != simd.MismatchedPixels || scalar.MaxDifference != simd.MaxDifference)
+		{
+			Benchmark::ReportFailure(fmt::format("SIMD image diff disagrees with the scalar reference, {} vs {} mismatched pixels, max difference {} vs {}",
+				simd.MismatchedPixels, scalar.MismatchedPixels, simd.MaxDifference, scalar.MaxDifference));
+		}
+
+		LOG_INFO("\t{}x{} frame, {:.1f} MB raw", FrameWidth, FrameHeight, (double)frame.size() / (1024.0 * 1024.0));
+		LOG_INFO("\tPNG encode: {:.2f} ms, {:.1f} KB", pngSeconds * 1000.0, (double)pngSize / 1024.0);
+		LOG_INFO("\tEXR encode: {:.2f} ms, {:.1f} KB", exrSeconds * 1000.0, (double)file.size() / 1024.0);
+		LOG_INFO("\tDiff: scalar {:.2f} ms, SIMD {:.2f} ms ({:.2f}x, {:.1f} GB/s), {} mismatched pixels", scalarSeconds * 1000.0, simdSeconds * 1000.0,
+			scalarSeconds / simdSeconds, (double)frame.size() * 2.0 / simdSeconds / 1e9, simd.MismatchedPixels);
+	}
+}
@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "Benchmark.h"
+
+#include <cmath>
+
+#include "Core/JobSystem.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t EmptyJobBatch = 1000;
+	static constexpr uint32_t EmptyJobBatchCount = 200;
+	static constexpr uint32_t SplitItemCount = 200000;
+	static constexpr uint32_t WorkItemCount = 4096;
+	static constexpr uint32_t WorkIterations = 20000;
+	static constexpr uint32_t BackgroundJobCount = 64;
+	static constexpr uint32_t Iterations = 5;
+
+	// Fixed amount of floating point work the compiler can't drop
+	static float DoWork(uint32_t item)
+	{
+		float value = (float)item;
+		for (uint32_t i = 0; i < WorkIterations; ++i)
+			value = std::sqrt(value * 1.0001f + 1.0f);
+		return value;
+	}
+
+	TESTBED_BENCHMARK(JobSystem)
+	{
+		std::vector<float> results(WorkItemCount);
+		double baselineSeconds = 0.0;
+
+		LOG_INFO("\tThreads | empty job (ns) | grain 1 item (ns) | work (ms) | speedup");
+		for (uint32_t threadCount : Benchmark::GetThreadCounts())
+		{
+			JobSystem::Init(threadCount - 1);
+
+			// Scheduling overhead: jobs that do nothing, started from one thread and stolen by the others
+			const BenchmarkResult emptyJobs = Benchmark::Measure(fmt::format("EmptyJobs/{}T", threadCount), EmptyJobBatchCount, EmptyJobBatch, []()
+			{
+				JobCounter counter;
+				for (uint32_t i = 0; i < EmptyJobBatch; ++i)
+					JobSystem::Run(counter, []() {});
+				JobSystem::Wait(counter);
+			});
+			const double emptyJobNanos = emptyJobs.Mean * 1e9 / (double)EmptyJobBatch;
+
+			// Recursive splitting down to single items, every thread starts jobs
+			std::atomic<uint32_t> visited = 0;
+			const BenchmarkResult split = Benchmark::Measure(fmt::format("Split/{}T", threadCount), Iterations, SplitItemCount, [&]()
+			{
+				ParallelForRange(SplitItemCount, 1, [&](uint32_t begin, uint32_t end) { visited.fetch_add(end - begin, std::memory_order_relaxed); });
+			});
+			const double splitItemNanos = split.Min * 1e9 / (double)SplitItemCount;
+			TESTBED_ASSERT(visited == SplitItemCount * Iterations);
+
+			// Scaling on compute bound work
+			const double workSeconds = Benchmark::Measure(fmt::format("Work/{}T", threadCount), Iterations, WorkItemCount, [&]()
+			{
+				ParallelFor(WorkItemCount, [&](uint32_t item) { results[item] = DoWork(item); });
+			}).Min;
+			if (threadCount == 1)
+				baselineSeconds = workSeconds;
+
+			// Background jobs started on thread 0 stay off it, even while it waits on a ParallelFor next to them
+			if (threadCount > 1)
+			{
+				JobCounter background;
+				std::atomic<uint32_t> backgroundRuns = 0;
+				std::atomic<bool> ranOnMainThread = false;
+				for (uint32_t i = 0; i < BackgroundJobCount; ++i)
+				{
+					JobSystem::RunBackground(background, [&backgroundRuns, &ranOnMainThread]()
+					{
+						if (JobSystem::GetThreadIndex() == 0)
+							ranOnMainThread = true;
+						backgroundRuns.fetch_add(DoWork(0) > 0.0f ? 1 : 0, std::memory_order_relaxed);
+					});
+				}
+				ParallelFor(WorkItemCount, [&](uint32_t item) { results[item] = DoWork(item); });
+				JobSystem::Wait(background);
+
+				if (ranOnMainThread || backgroundRuns != BackgroundJobCount)
+					Benchmark::ReportFailure(fmt::format("Background jobs ran on the main thread with {} threads", threadCount));
+			}
+
+			JobSystem::Shutdown();
+
+			LOG_INFO("\t{:7} | {:14.1f} | {:17.1f} | {:9.2f} | {:.2f}x",
+				threadCount, emptyJobNanos, splitItemNanos, workSeconds * 1000.0, baselineSeconds / workSeconds);
+		}
+	}
+}
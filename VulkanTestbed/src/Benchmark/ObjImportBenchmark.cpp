@@ -0,0 +1,123 @@
+#include "pch.h"
+#include "Benchmark.h"
+
+#include <cmath>
+#include <fstream>
+
+#include "Asset/MeshCache.h"
+#include "Asset/ObjImporter.h"
+#include "Core/JobSystem.h"
+
+namespace VulkanTestbed
+{
+	// 512x512 quads in 16 groups, about 20MB of text
+	static constexpr uint32_t GridSize = 512;
+	static constexpr uint32_t GroupCount = 16;
+	static constexpr uint32_t Iterations = 5;
+
+	// Wavy terrain with positions, texture coordinates and normals, written the way exporters do
+	static bool WriteGrid(const std::filesystem::path& path)
+	{
+		std::string obj;
+		obj.reserve(24ull << 20);
+		const uint32_t vertexCount = GridSize + 1;
+		for (uint32_t y = 0; y < vertexCount; ++y)
+		{
+			for (uint32_t x = 0; x < vertexCount; ++x)
+			{
+				const float height = std::sin((float)x * 0.05f) * std::cos((float)y * 0.07f);
+				obj += fmt::format("v {:.6f} {:.6f} {:.6f}\n", (float)x * 0.1f, height, (float)y * 0.1f);
+			}
+		}
+		for (uint32_t y = 0; y < vertexCount; ++y)
+		{
+			for (uint32_t x = 0; x < vertexCount; ++x)
+				obj += fmt::format("vt {:.6f} {:.6f}\n", (float)x / (float)GridSize, (float)y / (float)GridSize);
+		}
+		for (uint32_t y = 0; y < vertexCount; ++y)
+		{
+			for (uint32_t x = 0; x < vertexCount; ++x)
+				obj += fmt::format("vn {:.6f} {:.6f} {:.6f}\n", 0.0f, 1.0f, 0.0f);
+		}
+
+		const uint32_t rowsPerGroup = GridSize / GroupCount;
+		for (uint32_t y = 0; y < GridSize; ++y)
+		{
+			if (y % rowsPerGroup == 0)
+				obj += fmt::format("g Strip{}\n", y / rowsPerGroup);
+
+			for (uint32_t x = 0; x < GridSize; ++x)
+			{
+				// OBJ indices start at 1
+				const uint32_t a = y * vertexCount + x + 1;
+				const uint32_t b = a + 1;
+				const uint32_t c = a + vertexCount + 1;
+				const uint32_t d = a + vertexCount;
+				obj += fmt::format("f {0}/{0}/{0} {1}/{1}/{1} {2}/{2}/{2} {3}/{3}/{3}\n", a, b, c, d);
+			}
+		}
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(obj.data(), (std::streamsize)obj.size());
+		return (bool)file;
+	}
+
+	TESTBED_BENCHMARK(ObjImport)
+	{
+		const std::filesystem::path directory = std::filesystem::temp_directory_path() / "VulkanTestbedObjImport";
+		const std::filesystem::path objPath = directory / "Grid.obj";
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		if (!WriteGrid(objPath))
+		{
+			LOG_ERROR("\tFailed to write {}", objPath.string());
+			return;
+		}
+
+		// Throughput is in bytes of OBJ text
+		const uint64_t fileSize = std::filesystem::file_size(objPath, error);
+		const std::filesystem::path cachePath = MeshCache::GetCachePath(objPath);
+		LOG_INFO("\t{}x{} quads, {:.1f} MB of OBJ", GridSize, GridSize, (double)fileSize / (1024.0 * 1024.0));
+
+		LOG_INFO("\tThreads | parse (ms) | MB/s   | cache build (ms) | cache load (ms)");
+		for (uint32_t threadCount : Benchmark::GetThreadCounts())
+		{
+			JobSystem::Init(threadCount - 1);
+
+			std::vector<MeshData> meshes;
+			const double parseSeconds = Benchmark::Measure(fmt::format("Parse/{}T", threadCount), Iterations, fileSize, [&]()
+			{
+				meshes.clear();
+				ObjImporter::Import(objPath, meshes);
+			}).Min;
+			TESTBED_ASSERT(meshes.size() == GroupCount, "OBJ import produced the wrong number of meshes!");
+
+			// Parsing, optimization, meshlets and LODs from scratch, then only mapping the result
+			BenchmarkCase buildCase(fmt::format("CacheBuild/{}T", threadCount), fileSize);
+			for (uint32_t i = 0; i < Iterations; ++i)
+			{
+				std::filesystem::remove(cachePath, error);
+				MeshCache cache;
+				buildCase.Begin();
+				[[maybe_unused]] const bool loaded = cache.Load(objPath);
+				buildCase.End();
+				TESTBED_ASSERT(loaded && cache.GetMeshCount() == GroupCount, "Failed to build the mesh cache!");
+			}
+			const double buildSeconds = buildCase.Finish().Min;
+
+			// Loading never reads the OBJ and only maps the cache, there is no item count that would make a throughput
+			const double loadSeconds = Benchmark::Measure(fmt::format("CacheLoad/{}T", threadCount), Iterations, 0, [&]()
+			{
+				MeshCache cache;
+				cache.Load(objPath);
+			}).Min;
+
+			JobSystem::Shutdown();
+
+			LOG_INFO("\t{:7} | {:10.2f} | {:6.1f} | {:16.2f} | {:.3f}", threadCount, parseSeconds * 1000.0,
+				(double)fileSize / parseSeconds / (1024.0 * 1024.0), buildSeconds * 1000.0, loadSeconds * 1000.0);
+		}
+
+		std::filesystem::remove_all(directory, error);
+	}
+}
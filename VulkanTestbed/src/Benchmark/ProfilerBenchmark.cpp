@@ -0,0 +1,63 @@
+#include "pch.h"
+#include "Benchmark.h"
+
+#include <filesystem>
+
+#include "Core/JobSystem.h"
+#include "Core/Profiler.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t ZoneCount = 1 << 22;
+	static constexpr uint32_t ZoneGrainSize = 1 << 16;
+	static constexpr uint32_t Iterations = 3;
+
+	static void RecordZones()
+	{
+		ParallelForRange(ZoneCount, ZoneGrainSize, [](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				TESTBED_PROFILE_SCOPE("Empty zone");
+			}
+		});
+	}
+
+	// Nanoseconds one thread spends per empty zone while every thread records into its own ring
+	static double MeasureZones(const std::string& name)
+	{
+		const BenchmarkResult result = Benchmark::Measure(name, Iterations, ZoneCount, RecordZones);
+		return result.Min * 1e9 * (double)JobSystem::GetThreadCount() / (double)ZoneCount;
+	}
+
+	TESTBED_BENCHMARK(Profiler)
+	{
+#ifndef TESTBED_PROFILE
+		LOG_WARN("\tZones are compiled out of this configuration, the numbers below measure empty loops");
+#endif
+		const std::filesystem::path tracePath = std::filesystem::temp_directory_path() / "VulkanTestbedProfilerBenchmark.json";
+
+		LOG_INFO("\tThreads | disabled (ns/zone) | enabled (ns/zone) | trace export (ms)");
+		for (uint32_t threadCount : Benchmark::GetThreadCounts())
+		{
+			JobSystem::Init(threadCount - 1);
+
+			const double disabledNanos = MeasureZones(fmt::format("Disabled/{}T", threadCount));
+
+			Profiler::Init();
+			// Registers every thread's ring, which only happens once per thread
+			RecordZones();
+			const double enabledNanos = MeasureZones(fmt::format("Enabled/{}T", threadCount));
+
+			const double exportSeconds = Benchmark::Measure(fmt::format("Export/{}T", threadCount), 1, 0, [&]() { Profiler::WriteChromeTrace(tracePath); }).Min;
+
+			JobSystem::Shutdown();
+			Profiler::Shutdown();
+
+			LOG_INFO("\t{:7} | {:18.2f} | {:17.2f} | {:.2f}", threadCount, disabledNanos, enabledNanos, exportSeconds * 1000.0);
+		}
+
+		std::error_code error;
+		std::filesystem::remove(tracePath, error);
+	}
+}
@@ -0,0 +1,183 @@
+#include "pch.h"
+#include "Benchmark.h"
+
+#include "RenderGraph.h"
+#include "VulkanContext.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t ColdCompiles = 10;
+	static constexpr uint32_t MeasuredFrames = 256;
+	static constexpr VkExtent2D TargetExtent = { 256, 256 };
+
+	// Declaration order, which is what the pass queries of the graph index
+	static constexpr uint32_t GBufferPass = 0;
+	static constexpr uint32_t LightingPass = 1;
+	static constexpr uint32_t DebugPass = 2;
+	static constexpr uint32_t HistogramPass = 3;
+	static constexpr uint32_t TonemapPass = 4;
+	static constexpr uint32_t BlitPass = 5;
+
+	struct GraphResources
+	{
+		RenderResource Output;
+		RenderResource GBuffer;
+		RenderResource Lit;
+		RenderResource Debug;
+		RenderResource Histogram;
+		RenderResource Tonemapped;
+	};
+
+	// Nothing reads Debug, so its pass is culled. GBuffer is dead by the time Tonemapped is first written, the two
+	// share memory.
+	static GraphResources DeclareGraph(RenderGraph& graph)
+	{
+		const RenderImageDesc outputDesc = { VulkanContext::GetBackbufferFormat(), VulkanContext::GetExtent() };
+		const RenderImageDesc colorDesc = { VK_FORMAT_R8G8B8A8_UNORM, TargetExtent };
+
+		GraphResources r;
+		graph.Reset();
+		r.Output = graph.ImportImage("Output", VulkanContext::GetBackbuffer(), nullptr, outputDesc, RenderAccess::Acquired, RenderAccess::TransferRead);
+		r.GBuffer = graph.CreateImage("GBuffer", colorDesc);
+		r.Lit = graph.CreateImage("Lit", colorDesc);
+		r.Debug = graph.CreateImage("Debug", colorDesc);
+		r.Histogram = graph.CreateBuffer("Histogram", { 256 * sizeof(uint32_t) });
+		r.Tonemapped = graph.CreateImage("Tonemapped", colorDesc);
+
+		graph.AddPass("GBuffer", [&](RenderPassBuilder& builder)
+		{
+			builder.Write(r.GBuffer, RenderAccess::ColorAttachment);
+		}, nullptr);
+		graph.AddPass("Lighting", [&](RenderPassBuilder& builder)
+		{
+			builder.Read(r.GBuffer, RenderAccess::SampledFragment);
+			builder.Write(r.Lit, RenderAccess::ColorAttachment);
+		}, nullptr);
+		graph.AddPass("Debug", [&](RenderPassBuilder& builder)
+		{
+			builder.Read(r.GBuffer, RenderAccess::SampledFragment);
+			builder.Write(r.Debug, RenderAccess::ColorAttachment);
+		}, nullptr);
+		graph.AddPass("Histogram", [&](RenderPassBuilder& builder)
+		{
+			builder.Read(r.Lit, RenderAccess::SampledCompute);
+			builder.Write(r.Histogram, RenderAccess::StorageWriteCompute);
+		}, nullptr);
+		graph.AddPass("Tonemap", [&](RenderPassBuilder& builder)
+		{
+			builder.Read(r.Lit, RenderAccess::SampledCompute);
+			builder.Read(r.Histogram, RenderAccess::StorageReadCompute);
+			builder.Write(r.Tonemapped, RenderAccess::StorageWriteCompute);
+		}, nullptr);
+		graph.AddPass("Blit", [&](RenderPassBuilder& builder)
+		{
+			builder.Read(r.Tonemapped, RenderAccess::TransferRead);
+			builder.Write(r.Output, RenderAccess::TransferWrite);
+		}, nullptr);
+		return r;
+	}
+
+	static const RenderBarrier* FindBarrier(const std::vector<RenderBarrier>& barriers, RenderResource resource)
+	{
+		auto it = std::find_if(barriers.begin(), barriers.end(), [&](const RenderBarrier& barrier) { return barrier.Resource == resource; });
+		return it != barriers.end() ? &*it : nullptr;
+	}
+
+	static void CheckBarriers(const RenderGraph& graph, const GraphResources& r)
+	{
+		auto check = [](bool condition, const char* message)
+		{
+			if (!condition)
+				Benchmark::ReportFailure(message);
+		};
+
+		const RenderGraphStatistics& stats = graph.GetStatistics();
+		check(stats.CulledPasses == 1 && graph.IsPassCulled(DebugPass) && !graph.IsPassCulled(LightingPass), "Only the debug pass should be culled");
+		check(stats.TransientResources == 4 && stats.TransientSize < stats.UnaliasedSize, "Tonemapped should alias the GBuffer");
+
+		std::vector<RenderBarrier> barriers;
+		graph.GetPassBarriers(DebugPass, barriers);
+		check(barriers.empty(), "The culled pass has barriers");
+
+		// The plan is replayed on the same memory every frame, the first use waits for the previous frame's lighting
+		// pass and, because they alias, its blit out of Tonemapped
+		graph.GetPassBarriers(GBufferPass, barriers);
+		const RenderBarrier* gbuffer = FindBarrier(barriers, r.GBuffer);
+		check(gbuffer && gbuffer->OldLayout == VK_IMAGE_LAYOUT_UNDEFINED && gbuffer->NewLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+			&& (gbuffer->SrcStages & VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT) && (gbuffer->SrcStages & VK_PIPELINE_STAGE_2_TRANSFER_BIT),
+			"GBuffer's first barrier doesn't wait for the previous frame");
+
+		graph.GetPassBarriers(LightingPass, barriers);
+		const RenderBarrier* gbufferRead = FindBarrier(barriers, r.GBuffer);
+		check(gbufferRead && gbufferRead->NewLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+			&& (gbufferRead->SrcAccess & VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT) && (gbufferRead->DstAccess & VK_ACCESS_2_SHADER_READ_BIT),
+			"GBuffer isn't made visible to the lighting pass");
+
+		graph.GetPassBarriers(TonemapPass, barriers);
+		const RenderBarrier* tonemapped = FindBarrier(barriers, r.Tonemapped);
+		check(tonemapped && tonemapped->OldLayout == VK_IMAGE_LAYOUT_UNDEFINED && tonemapped->NewLayout == VK_IMAGE_LAYOUT_GENERAL
+			&& (tonemapped->SrcStages & VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT), "Tonemapped doesn't wait for the last read of the GBuffer it aliases");
+		const RenderBarrier* histogram = FindBarrier(barriers, r.Histogram);
+		check(histogram && (histogram->SrcAccess & VK_ACCESS_2_SHADER_WRITE_BIT) && (histogram->DstAccess & VK_ACCESS_2_SHADER_READ_BIT),
+			"The histogram isn't made visible to tonemapping");
+		check(!FindBarrier(barriers, r.Lit), "Lit is already visible to compute, tonemapping shouldn't need a barrier for it");
+
+		graph.GetPassBarriers(BlitPass, barriers);
+		const RenderBarrier* output = FindBarrier(barriers, r.Output);
+		check(output && output->OldLayout == VK_IMAGE_LAYOUT_UNDEFINED && output->NewLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+			&& output->SrcStages == VK_PIPELINE_STAGE_2_TRANSFER_BIT, "The output isn't ordered after the acquire wait");
+
+		graph.GetFinalBarriers(barriers);
+		const RenderBarrier* final = FindBarrier(barriers, r.Output);
+		check(barriers.size() == 1 && final && final->OldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && final->NewLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			"The output doesn't end in its final access");
+	}
+
+	// Needs a device, only built into VulkanTestbed and run with --bench
+	TESTBED_BENCHMARK(RenderGraph)
+	{
+		VulkanContext::InitHeadless(TargetExtent.width, TargetExtent.height);
+
+		RenderGraph graph;
+		GraphResources resources = DeclareGraph(graph);
+		graph.Compile();
+		CheckBarriers(graph, resources);
+
+		// Every compilation after a topology change creates and places the transient resources again
+		BenchmarkCase cold("Compile/cold");
+		for (uint32_t i = 0; i < ColdCompiles; ++i)
+		{
+			graph.Release();
+			cold.Begin();
+			resources = DeclareGraph(graph);
+			graph.Compile();
+			cold.End();
+		}
+		cold.Finish();
+
+		// What a frame pays with an unchanged topology: declaring, the cache lookup and recording the barriers
+		BenchmarkCase cached("Frame/cached", 1);
+		for (uint32_t frame = 0; frame < MeasuredFrames; ++frame)
+		{
+			VulkanContext::BeginFrame();
+			cached.Begin();
+			resources = DeclareGraph(graph);
+			graph.Compile();
+			graph.Execute(VulkanContext::GetCommandBuffer());
+			cached.End();
+			VulkanContext::EndFrame();
+		}
+		cached.Finish();
+
+		if (graph.GetStatistics().CacheHits < MeasuredFrames)
+			Benchmark::ReportFailure("Unchanged declarations recompiled the graph");
+		CheckBarriers(graph, resources);
+
+		const RenderGraphStatistics& stats = graph.GetStatistics();
+		LOG_INFO("\t{} passes ({} culled), {} image and {} buffer barriers, {:.2f} MB transient memory ({:.2f} MB unaliased)", stats.Passes, stats.CulledPasses,
+			stats.ImageBarriers, stats.BufferBarriers, (double)stats.TransientSize / (1024.0 * 1024.0), (double)stats.UnaliasedSize / (1024.0 * 1024.0));
+
+		graph.Release();
+		VulkanContext::Shutdown();
+	}
+}
@@ -0,0 +1,117 @@
+#include "pch.h"
+#include "Benchmark.h"
+
+#include <random>
+
+#include "Core/JobSystem.h"
+#include "Core/RadixSort.h"
+#include "RenderQueue.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t DrawCounts[] = { 10000, 100000, 1000000 };
+	// Every size sorts about this many draws in total, the fastest run is reported
+	static constexpr uint32_t DrawsPerSize = 10000000;
+	static constexpr uint32_t PipelineCount = 64;
+	static constexpr uint32_t MaterialCount = 2048;
+	static constexpr uint32_t GeometryCount = 512;
+
+	enum BenchmarkPass : uint32_t { ShadowPass = 0, OpaquePass, TransparentPass };
+
+	struct DrawList
+	{
+		std::vector<uint64_t> Keys;
+		std::vector<uint32_t> Geometry;
+		// Pipeline or material changes when drawing in submission order
+		uint32_t UnsortedStateBinds = 0;
+	};
+
+	// Materials stick to one pipeline and mostly to one mesh, shadow draws don't care about depth and blended
+	// ones are drawn back to front, like a scene submitted in traversal order would look
+	static DrawList GenerateDraws(uint32_t drawCount)
+	{
+		std::mt19937 random(drawCount);
+		std::uniform_int_distribution<uint32_t> materialDistribution(0, MaterialCount - 1);
+		std::uniform_int_distribution<uint32_t> passDistribution(ShadowPass, TransparentPass);
+		std::uniform_real_distribution<float> depthDistribution(0.0f, 1.0f);
+
+		DrawList list;
+		list.Keys.resize(drawCount);
+		list.Geometry.resize(drawCount);
+		for (uint32_t i = 0; i < drawCount; ++i)
+		{
+			const uint32_t material = materialDistribution(random);
+			const uint32_t pass = passDistribution(random);
+			const uint32_t depthBucket = pass == ShadowPass ? 0 : DrawKey::DepthBucket(depthDistribution(random), pass == TransparentPass);
+			list.Keys[i] = DrawKey::Make(pass, material % PipelineCount, material, depthBucket);
+			list.Geometry[i] = random() % 8 == 0 ? random() % GeometryCount : material % GeometryCount;
+
+			if (i > 0 && ((list.Keys[i] ^ list.Keys[i - 1]) & DrawKey::StateMask) != 0)
+				++list.UnsortedStateBinds;
+		}
+		return list;
+	}
+
+	TESTBED_BENCHMARK(RenderQueue)
+	{
+		LOG_INFO("\tThreads |   Draws | std::sort (ms) | radix (ms) | speedup | queue (ms) | batches | state binds (unsorted)");
+		for (uint32_t threadCount : Benchmark::GetThreadCounts())
+		{
+			JobSystem::Init(threadCount - 1);
+
+			for (uint32_t drawCount : DrawCounts)
+			{
+				const DrawList list = GenerateDraws(drawCount);
+				const uint32_t iterations = std::max(3u, DrawsPerSize / drawCount);
+
+				// Submission index as tie breaker gives std::sort the same stable order the radix sort produces
+				std::vector<std::pair<uint64_t, uint32_t>> pairs(drawCount);
+				const double stdSortSeconds = Benchmark::Measure(fmt::format("StdSort/{}/{}T", drawCount, threadCount), iterations, drawCount, [&]()
+				{
+					for (uint32_t i = 0; i < drawCount; ++i)
+						pairs[i] = { list.Keys[i], i };
+					std::sort(pairs.begin(), pairs.end());
+				}).Min;
+
+				std::vector<uint64_t> keys(drawCount), scratchKeys(drawCount);
+				std::vector<uint32_t> values(drawCount), scratchValues(drawCount);
+				const double radixSeconds = Benchmark::Measure(fmt::format("RadixSort/{}/{}T", drawCount, threadCount), iterations, drawCount, [&]()
+				{
+					std::copy(list.Keys.begin(), list.Keys.end(), keys.begin());
+					for (uint32_t i = 0; i < drawCount; ++i)
+						values[i] = i;
+					RadixSort(keys.data(), values.data(), scratchKeys.data(), scratchValues.data(), drawCount);
+				}).Min;
+				uint32_t mismatches = 0;
+				for (uint32_t i = 0; i < drawCount; ++i)
+					mismatches += keys[i] != pairs[i].first || values[i] != pairs[i].second;
+				if (mismatches > 0)
+					Benchmark::ReportFailure(fmt::format("Radix sort disagrees with std::sort on {} of {} draws with {} threads", mismatches, drawCount, threadCount));
+
+				// Submission, sorting and merging into batches, what a frame pays
+				RenderQueue queue;
+				queue.Reserve(drawCount);
+				const double queueSeconds = Benchmark::Measure(fmt::format("Queue/{}/{}T", drawCount, threadCount), iterations, drawCount, [&]()
+				{
+					queue.Reset();
+					for (uint32_t i = 0; i < drawCount; ++i)
+						queue.Submit(list.Keys[i], list.Geometry[i], i);
+					queue.Sort();
+				}).Min;
+
+				const RenderQueueStatistics& statistics = queue.GetStatistics();
+				uint32_t instances = 0;
+				for (const DrawBatch& batch : queue.GetBatches())
+					instances += batch.InstanceCount;
+				if (instances != drawCount || statistics.Draws != drawCount)
+					Benchmark::ReportFailure(fmt::format("The queue's batches hold {} of {} draws with {} threads", instances, drawCount, threadCount));
+
+				LOG_INFO("\t{:7} | {:7} | {:14.3f} | {:10.3f} | {:6.2f}x | {:10.3f} | {:7} | {} ({})",
+					threadCount, drawCount, stdSortSeconds * 1000.0, radixSeconds * 1000.0, stdSortSeconds / radixSeconds,
+					queueSeconds * 1000.0, statistics.Batches, statistics.StateBinds, list.UnsortedStateBinds);
+			}
+
+			JobSystem::Shutdown();
+		}
+	}
+}
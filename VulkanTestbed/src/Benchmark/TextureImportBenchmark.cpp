@@ -0,0 +1,155 @@
+#include "pch.h"
+#include "Benchmark.h"
+
+#include <random>
+
+#include "Asset/ImageWriter.h"
+#include "Asset/TextureCompressor.h"
+#include "Asset/TextureImporter.h"
+#include "Core/JobSystem.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t TextureSize = 2048;
+	static constexpr uint32_t QualityTextureSize = 256;
+	static constexpr uint32_t Iterations = 5;
+
+	// Minimum PSNR of every format and preset on the quality texture, about 2 dB below what the encoders reach. The
+	// texture is seeded, so only changes to the encoders move the results.
+	struct QualityFloor
+	{
+		TextureFormat Format;
+		TextureCompression Quality;
+		double MinPSNR;
+	};
+
+	static constexpr QualityFloor QualityFloors[] =
+	{
+		{ TextureFormat::BC1, TextureCompression::Fast, 35.0 },
+		{ TextureFormat::BC1, TextureCompression::Normal, 37.0 },
+		{ TextureFormat::BC1, TextureCompression::High, 37.0 },
+		{ TextureFormat::BC3, TextureCompression::Fast, 35.5 },
+		{ TextureFormat::BC3, TextureCompression::Normal, 37.5 },
+		{ TextureFormat::BC3, TextureCompression::High, 37.5 },
+		{ TextureFormat::BC5, TextureCompression::Fast, 45.0 },
+		{ TextureFormat::BC5, TextureCompression::Normal, 45.0 },
+		{ TextureFormat::BC5, TextureCompression::High, 46.5 },
+		{ TextureFormat::BC7, TextureCompression::Fast, 33.5 },
+		{ TextureFormat::BC7, TextureCompression::Normal, 36.5 },
+		{ TextureFormat::BC7, TextureCompression::High, 36.5 },
+	};
+
+	static const char* CompressionToString(TextureCompression quality)
+	{
+		switch (quality)
+		{
+			case TextureCompression::None:		return "None";
+			case TextureCompression::Fast:		return "Fast";
+			case TextureCompression::Normal:	return "Normal";
+			case TextureCompression::High:		return "High";
+		}
+		return "Unknown";
+	}
+
+	// Smooth color variation with fine grain on top, decodes and compresses like a photo based albedo map. The alpha
+	// variant gives BC3 and BC7 an alpha channel worth encoding.
+	static std::vector<uint8_t> BuildTexture(uint32_t size, bool alpha)
+	{
+		std::mt19937 random(size);
+		std::vector<uint8_t> rgba((size_t)size * size * TextureData::BytesPerPixel);
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				uint8_t* texel = &rgba[((size_t)y * size + x) * TextureData::BytesPerPixel];
+				const uint32_t grain = random() & 31;
+				texel[0] = (uint8_t)(96 + ((x >> 4) & 63) + grain);
+				texel[1] = (uint8_t)(64 + ((y >> 4) & 63) + grain);
+				texel[2] = (uint8_t)(48 + (((x + y) >> 5) & 63) + grain);
+				texel[3] = alpha ? (uint8_t)(128 + (((x + 2 * y) >> 3) & 63) + grain) : 255;
+			}
+		}
+		return rgba;
+	}
+
+	// Round trips a mip chain through every format and preset and fails the run when one falls below its floor
+	static void CheckQuality()
+	{
+		TextureData reference;
+		reference.Width = QualityTextureSize;
+		reference.Height = QualityTextureSize;
+		reference.Pixels = BuildTexture(QualityTextureSize, true);
+		reference.Mips.push_back({ 0, QualityTextureSize, QualityTextureSize });
+		TextureImporter::GenerateMips(reference);
+
+		LOG_INFO("	Format | preset | PSNR (dB) | floor (dB)");
+		TextureData compressed, decompressed;
+		for (const QualityFloor& floor : QualityFloors)
+		{
+			TextureCompressor::Compress(reference, floor.Format, floor.Quality, compressed);
+			TextureCompressor::Decompress(compressed, decompressed);
+
+			// The smallest mips are single partial blocks, the top one decides what the texture looks like
+			double psnr = TextureCompressor::ComputePSNR(reference, decompressed, floor.Format);
+			for (uint32_t mip = 1; mip < reference.GetMipCount(); ++mip)
+				psnr = std::min(psnr, TextureCompressor::ComputePSNR(reference, decompressed, floor.Format, mip));
+
+			LOG_INFO("	{:>6} | {:>6} | {:9.2f} | {:.2f}", TextureFormatToString(floor.Format), CompressionToString(floor.Quality), psnr, floor.MinPSNR);
+			if (psnr < floor.MinPSNR)
+			{
+				Benchmark::ReportFailure(fmt::format("{} {} reaches {:.2f} dB, below its floor of {:.2f} dB", TextureFormatToString(floor.Format),
+					CompressionToString(floor.Quality), psnr, floor.MinPSNR));
+			}
+		}
+	}
+
+	TESTBED_BENCHMARK(TextureImport)
+	{
+		const std::filesystem::path directory = std::filesystem::temp_directory_path() / "VulkanTestbedTextureImport";
+		const std::filesystem::path pngPath = directory / "Albedo.png";
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		if (!ImageWriter::WritePNG(pngPath, TextureSize, TextureSize, BuildTexture(TextureSize, false).data()))
+		{
+			LOG_ERROR("\tFailed to write {}", pngPath.string());
+			return;
+		}
+
+		// Throughput is in texels of the top mip
+		const uint64_t texelCount = (uint64_t)TextureSize * TextureSize;
+
+		// One texture per call, the streamer imports several at once on different threads
+		TextureData texture;
+		const double importSeconds = Benchmark::Measure("DecodeAndMips", Iterations, texelCount, [&]() { TextureImporter::Import(pngPath, texture); }).Min;
+		if (texture.GetMipCount() != TextureImporter::GetMipCount(TextureSize, TextureSize))
+			Benchmark::ReportFailure(fmt::format("Texture import produced {} mips instead of {}", texture.GetMipCount(), TextureImporter::GetMipCount(TextureSize, TextureSize)));
+
+		const double mipSeconds = Benchmark::Measure("GenerateMips", Iterations, texelCount, [&]() { TextureImporter::GenerateMips(texture); }).Min;
+		LOG_INFO("\t{0}x{0} PNG, {1:.1f} MB: decode and mips {2:.2f} ms, of which mips {3:.2f} ms", TextureSize,
+			(double)std::filesystem::file_size(pngPath, error) / (1024.0 * 1024.0), importSeconds * 1000.0, mipSeconds * 1000.0);
+
+		CheckQuality();
+
+		LOG_INFO("\tThreads | BC1 fast (ms) | BC7 normal (ms)");
+		for (uint32_t threadCount : Benchmark::GetThreadCounts())
+		{
+			JobSystem::Init(threadCount - 1);
+
+			TextureData compressed;
+			const double bc1Seconds = Benchmark::Measure(fmt::format("CompressBC1/{}T", threadCount), Iterations, texelCount, [&]()
+			{
+				TextureCompressor::Compress(texture, TextureFormat::BC1, TextureCompression::Fast, compressed);
+			}).Min;
+			const double bc7Seconds = Benchmark::Measure(fmt::format("CompressBC7/{}T", threadCount), 1, texelCount, [&]()
+			{
+				TextureCompressor::Compress(texture, TextureFormat::BC7, TextureCompression::Normal, compressed);
+			}).Min;
+
+			JobSystem::Shutdown();
+
+			LOG_INFO("\t{:7} | {:13.2f} | {:.2f}", threadCount, bc1Seconds * 1000.0, bc7Seconds * 1000.0);
+		}
+
+		std::filesystem::remove_all(directory, error);
+	}
+}
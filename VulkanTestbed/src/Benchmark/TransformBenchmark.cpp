@@ -0,0 +1,137 @@
+#include "pch.h"
+#include "Benchmark.h"
+
+#include <cmath>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Core/JobSystem.h"
+#include "Core/Timer.h"
+#include "Scene/TransformHierarchy.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t NodeCount = 200000;
+	static constexpr uint32_t RootCount = 16;
+	// Share of the nodes moved in the sparse update
+	static constexpr uint32_t SparseDivisor = 100;
+	static constexpr uint32_t Iterations = 10;
+
+	// What the hierarchy replaces: heap allocated nodes that recurse through their children
+	struct PointerNode
+	{
+		LocalTransform Local;
+		glm::mat4 World = glm::mat4(1.0f);
+		std::vector<PointerNode*> Children;
+	};
+
+	static glm::mat4 ComposeLocal(const LocalTransform& local)
+	{
+		return glm::translate(glm::mat4(1.0f), local.Position) * glm::mat4_cast(local.Rotation) * glm::scale(glm::mat4(1.0f), local.Scale);
+	}
+
+	static void UpdatePointerNode(PointerNode& node, const glm::mat4& parentWorld)
+	{
+		node.World = parentWorld * ComposeLocal(node.Local);
+		for (PointerNode* child : node.Children)
+			UpdatePointerNode(*child, node.World);
+	}
+
+	static bool NearlyEqual(const glm::mat4& a, const glm::mat4& b)
+	{
+		for (int column = 0; column < 4; ++column)
+		{
+			for (int row = 0; row < 4; ++row)
+			{
+				if (std::abs(a[column][row] - b[column][row]) > 1e-3f * std::max(1.0f, std::abs(b[column][row])))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	TESTBED_BENCHMARK(Transform)
+	{
+		// Every node hangs off a uniformly random earlier one, a random recursive tree about ln(n) levels deep like
+		// the assembly trees of CAD imports
+		std::mt19937 random(NodeCount);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<uint32_t> parents(NodeCount);
+		std::vector<LocalTransform> locals(NodeCount);
+		for (uint32_t i = 0; i < NodeCount; ++i)
+		{
+			parents[i] = i < RootCount ? InvalidTransformNode : random() % i;
+			locals[i].Position = glm::vec3(unit(random), unit(random), unit(random)) * 10.0f;
+			locals[i].Rotation = glm::angleAxis(unit(random) * 3.14159265f, glm::normalize(glm::vec3(unit(random), unit(random), 1.0f)));
+			locals[i].Scale = glm::vec3(1.0f + unit(random) * 0.05f);
+		}
+
+		std::vector<std::unique_ptr<PointerNode>> pointerNodes(NodeCount);
+		for (uint32_t i = 0; i < NodeCount; ++i)
+		{
+			pointerNodes[i] = std::make_unique<PointerNode>();
+			pointerNodes[i]->Local = locals[i];
+			if (parents[i] != InvalidTransformNode)
+				pointerNodes[parents[i]]->Children.push_back(pointerNodes[i].get());
+		}
+		const double pointerSeconds = Benchmark::Measure("PointerTree", Iterations, NodeCount, [&]()
+		{
+			for (uint32_t root = 0; root < RootCount; ++root)
+				UpdatePointerNode(*pointerNodes[root], glm::mat4(1.0f));
+		}).Min;
+
+		std::vector<TransformNode> sparseNodes;
+		for (uint32_t i = 0; i < NodeCount / SparseDivisor; ++i)
+			sparseNodes.push_back(random() % NodeCount);
+
+		LOG_INFO("\tThreads | pointer tree (ms) | build (ms) | full (ms) | speedup | sparse (ms) | sparse nodes | idle (ms) | levels");
+		for (uint32_t threadCount : Benchmark::GetThreadCounts())
+		{
+			JobSystem::Init(threadCount - 1);
+
+			TransformHierarchy hierarchy;
+			Timer timer;
+			hierarchy.Reserve(NodeCount);
+			for (uint32_t i = 0; i < NodeCount; ++i)
+				hierarchy.Create(parents[i], locals[i]);
+			hierarchy.Update();
+			const double buildSeconds = timer.Elapsed();
+
+			uint32_t mismatches = 0;
+			for (uint32_t i = 0; i < NodeCount; ++i)
+				mismatches += !NearlyEqual(hierarchy.GetWorld(i), pointerNodes[i]->World);
+			if (mismatches > 0)
+				Benchmark::ReportFailure(fmt::format("{} world matrices disagree with the pointer tree with {} threads", mismatches, threadCount));
+
+			// Moving the roots dirties everything
+			const double fullSeconds = Benchmark::Measure(fmt::format("Full/{}T", threadCount), Iterations, NodeCount, [&]()
+			{
+				for (uint32_t root = 0; root < RootCount; ++root)
+					hierarchy.SetLocal(root, locals[root]);
+				hierarchy.Update();
+			}).Min;
+			if (hierarchy.GetStatistics().UpdatedNodes != NodeCount)
+				Benchmark::ReportFailure(fmt::format("Moving the roots updated {} of {} nodes", hierarchy.GetStatistics().UpdatedNodes, NodeCount));
+
+			const double sparseSeconds = Benchmark::Measure(fmt::format("Sparse/{}T", threadCount), Iterations, sparseNodes.size(), [&]()
+			{
+				for (TransformNode node : sparseNodes)
+					hierarchy.SetLocal(node, locals[node]);
+				hierarchy.Update();
+			}).Min;
+			const uint32_t sparseUpdatedNodes = hierarchy.GetStatistics().UpdatedNodes;
+
+			hierarchy.Update();
+			const double idleSeconds = Benchmark::Measure(fmt::format("Idle/{}T", threadCount), Iterations, 0, [&]() { hierarchy.Update(); }).Min;
+			if (hierarchy.GetStatistics().UpdatedNodes != 0)
+				Benchmark::ReportFailure(fmt::format("An update without changes touched {} nodes", hierarchy.GetStatistics().UpdatedNodes));
+
+			JobSystem::Shutdown();
+
+			LOG_INFO("\t{:7} | {:17.2f} | {:10.2f} | {:9.2f} | {:6.2f}x | {:11.2f} | {:12} | {:9.3f} | {}",
+				threadCount, pointerSeconds * 1000.0, buildSeconds * 1000.0, fullSeconds * 1000.0, pointerSeconds / fullSeconds,
+				sparseSeconds * 1000.0, sparseUpdatedNodes, idleSeconds * 1000.0, hierarchy.GetStatistics().Levels);
+		}
+	}
+}
@@ -0,0 +1,480 @@
+#include "pch.h"
+#include "BindlessDescriptors.h"
+
+#include <deque>
+
+#include "Core/Profiler.h"
+#include "DeviceAllocator.h"
+#include "HostAllocator.h"
+#include "UploadManager.h"
+#include "VulkanContext.h"
+
+namespace VulkanTestbed
+{
+	// Hands out array slots, a released slot goes back on the free list once the frames that may use it are done
+	struct SlotAllocator
+	{
+		uint32_t Capacity = 0;
+		// Slots below it have been handed out before
+		uint32_t NextSlot = 0;
+		uint32_t LiveCount = 0;
+		std::vector<uint32_t> FreeSlots;
+		// Released slot and the timeline value of the last frame that could have used it, in release order
+		std::deque<std::pair<uint32_t, uint64_t>> Retired;
+
+		uint32_t Allocate(uint64_t completedValue)
+		{
+			while (!Retired.empty() && Retired.front().second <= completedValue)
+			{
+				FreeSlots.push_back(Retired.front().first);
+				Retired.pop_front();
+			}
+
+			uint32_t slot = InvalidBindlessIndex;
+			if (!FreeSlots.empty())
+			{
+				slot = FreeSlots.back();
+				FreeSlots.pop_back();
+			}
+			else if (NextSlot < Capacity)
+			{
+				slot = NextSlot++;
+			}
+			else
+			{
+				return InvalidBindlessIndex;
+			}
+
+			++LiveCount;
+			return slot;
+		}
+
+		void Release(uint32_t slot, uint64_t frameValue)
+		{
+			TESTBED_ASSERT(slot < NextSlot && LiveCount > 0, "Releasing a bindless slot that was never allocated!");
+			Retired.emplace_back(slot, frameValue);
+			--LiveCount;
+		}
+	};
+
+	// Slots written since the set was last updated
+	struct DirtySlots
+	{
+		std::vector<uint32_t> Textures;
+		std::vector<uint32_t> Buffers;
+	};
+
+	static BindlessMode s_Mode = BindlessMode::Disabled;
+	static VkDescriptorSetLayout s_SetLayout = nullptr;
+	static VkDescriptorPool s_Pool = nullptr;
+	static std::vector<VkDescriptorSet> s_Sets;
+	static std::vector<DirtySlots> s_Dirty;
+	static VkSampler s_DefaultSampler = nullptr;
+
+	static SlotAllocator s_TextureSlots;
+	static SlotAllocator s_BufferSlots;
+	// What every slot should contain, the sets catch up through their dirty lists
+	static std::vector<VkDescriptorImageInfo> s_TextureInfos;
+	static std::vector<VkDescriptorBufferInfo> s_BufferInfos;
+	static BindlessStatistics s_Stats;
+
+	// Without partially bound arrays every slot a shader could index has to be valid. Textures registered before their
+	// contents exist point at the placeholder image in either mode.
+	static VkImage s_PlaceholderImage = nullptr;
+	static VkImageView s_PlaceholderView = nullptr;
+	static DeviceAllocation s_PlaceholderImageMemory;
+	static VkBuffer s_PlaceholderBuffer = nullptr;
+	static DeviceAllocation s_PlaceholderBufferMemory;
+
+	static void CreatePlaceholders()
+	{
+		VkDevice device = VulkanContext::GetDevice();
+		const VkAllocationCallbacks* callbacks = HostAllocator::GetCallbacks(HostSubsystem::Descriptors);
+		constexpr VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		VkImageCreateInfo imageCreateInfo = {};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		imageCreateInfo.extent = { 1, 1, 1 };
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkResult result = vkCreateImage(device, &imageCreateInfo, callbacks, &s_PlaceholderImage);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create placeholder image!");
+
+		s_PlaceholderImageMemory = VulkanContext::GetAllocator().AllocateImage(s_PlaceholderImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		TESTBED_ASSERT(s_PlaceholderImageMemory.Memory, "Failed to allocate placeholder image memory!");
+
+		VkImageViewCreateInfo viewCreateInfo = {};
+		viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewCreateInfo.image = s_PlaceholderImage;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = imageCreateInfo.format;
+		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		result = vkCreateImageView(device, &viewCreateInfo, callbacks, &s_PlaceholderView);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create placeholder image view!");
+
+		VkBufferCreateInfo bufferCreateInfo = {};
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = 256;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		result = vkCreateBuffer(device, &bufferCreateInfo, callbacks, &s_PlaceholderBuffer);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create placeholder buffer!");
+
+		s_PlaceholderBufferMemory = VulkanContext::GetAllocator().AllocateBuffer(s_PlaceholderBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		TESTBED_ASSERT(s_PlaceholderBufferMemory.Memory, "Failed to allocate placeholder buffer memory!");
+
+		// Opaque white and zeros, so a stray index shows up instead of reading garbage
+		StagingAllocation staging;
+		bool staged = UploadManager::AllocateStaging(4, 16, staging);
+		TESTBED_ASSERT(staged, "No staging space for the placeholder texture!");
+		memset(staging.Data, 0xFF, 4);
+
+		ImageUpload upload;
+		upload.Image = s_PlaceholderImage;
+		upload.Extent = { 1, 1, 1 };
+		upload.DstStages = shaderStages;
+		UploadManager::CopyToImage(staging, upload);
+
+		const uint8_t zeros[256] = {};
+		staged = UploadManager::UploadBuffer(s_PlaceholderBuffer, 0, zeros, sizeof(zeros), shaderStages, VK_ACCESS_SHADER_READ_BIT);
+		TESTBED_ASSERT(staged, "No staging space for the placeholder buffer!");
+	}
+
+	static void MarkDirty(bool texture, uint32_t slot)
+	{
+		for (DirtySlots& dirty : s_Dirty)
+			(texture ? dirty.Textures : dirty.Buffers).push_back(slot);
+	}
+
+	void BindlessDescriptors::Init(const BindlessSettings& settings)
+	{
+		if (!VulkanContext::IsDynamicDescriptorIndexingEnabled())
+		{
+			LOG_WARN("BindlessDescriptors: descriptor arrays can't be indexed dynamically on this device, bindless is disabled");
+			s_Mode = BindlessMode::Disabled;
+			return;
+		}
+
+		s_Mode = VulkanContext::IsDescriptorIndexingEnabled() ? BindlessMode::UpdateAfterBind : BindlessMode::PerFrameSets;
+		const bool updateAfterBind = s_Mode == BindlessMode::UpdateAfterBind;
+		VkDevice device = VulkanContext::GetDevice();
+		const VkAllocationCallbacks* callbacks = HostAllocator::GetCallbacks(HostSubsystem::Descriptors);
+
+		// Combined image samplers count against both the sampled image and the sampler limits
+		VkPhysicalDeviceDescriptorIndexingProperties indexingProps{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES };
+		VkPhysicalDeviceProperties2 deviceProps2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &indexingProps };
+		vkGetPhysicalDeviceProperties2(VulkanContext::GetPhysicalDevice(), &deviceProps2);
+		const VkPhysicalDeviceLimits& limits = deviceProps2.properties.limits;
+
+		uint32_t maxTextures = 0;
+		uint32_t maxBuffers = 0;
+		uint32_t maxResources = 0;
+		if (updateAfterBind)
+		{
+			maxTextures = std::min({ indexingProps.maxPerStageDescriptorUpdateAfterBindSampledImages, indexingProps.maxPerStageDescriptorUpdateAfterBindSamplers,
+				indexingProps.maxDescriptorSetUpdateAfterBindSampledImages, indexingProps.maxDescriptorSetUpdateAfterBindSamplers });
+			maxBuffers = std::min(indexingProps.maxPerStageDescriptorUpdateAfterBindStorageBuffers, indexingProps.maxDescriptorSetUpdateAfterBindStorageBuffers);
+			maxResources = indexingProps.maxPerStageUpdateAfterBindResources;
+		}
+		else
+		{
+			maxTextures = std::min({ limits.maxPerStageDescriptorSampledImages, limits.maxPerStageDescriptorSamplers,
+				limits.maxDescriptorSetSampledImages, limits.maxDescriptorSetSamplers });
+			maxBuffers = std::min(limits.maxPerStageDescriptorStorageBuffers, limits.maxDescriptorSetStorageBuffers);
+			maxResources = limits.maxPerStageResources;
+		}
+		// Whatever else the stage binds needs some room too
+		maxBuffers = std::min({ settings.MaxBuffers, maxBuffers, maxResources / 4 });
+		maxTextures = std::min({ settings.MaxTextures, maxTextures, maxResources / 2 });
+
+		s_TextureSlots = {};
+		s_TextureSlots.Capacity = maxTextures;
+		s_BufferSlots = {};
+		s_BufferSlots.Capacity = maxBuffers;
+		s_Stats = {};
+
+		VkDescriptorSetLayoutBinding bindings[2] = {};
+		bindings[0].binding = TextureBinding;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount = maxTextures;
+		bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+		bindings[1].binding = BufferBinding;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[1].descriptorCount = maxBuffers;
+		bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+		const VkDescriptorBindingFlags bindingFlags[2] =
+		{
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+		};
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo = {};
+		bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsCreateInfo.bindingCount = 2;
+		bindingFlagsCreateInfo.pBindingFlags = bindingFlags;
+
+		VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutCreateInfo.bindingCount = 2;
+		layoutCreateInfo.pBindings = bindings;
+		if (updateAfterBind)
+		{
+			layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+			layoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		}
+		VkResult result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, callbacks, &s_SetLayout);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create bindless descriptor set layout!");
+
+		const uint32_t setCount = updateAfterBind ? 1 : VulkanContext::GetFramesInFlight();
+		const VkDescriptorPoolSize poolSizes[] =
+		{
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTextures * setCount },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxBuffers * setCount }
+		};
+		VkDescriptorPoolCreateInfo poolCreateInfo = {};
+		poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolCreateInfo.flags = updateAfterBind ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0;
+		poolCreateInfo.maxSets = setCount;
+		poolCreateInfo.poolSizeCount = (uint32_t)std::size(poolSizes);
+		poolCreateInfo.pPoolSizes = poolSizes;
+		result = vkCreateDescriptorPool(device, &poolCreateInfo, callbacks, &s_Pool);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create bindless descriptor pool!");
+
+		s_Sets.resize(setCount);
+		std::vector<VkDescriptorSetLayout> setLayouts(setCount, s_SetLayout);
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = s_Pool;
+		allocInfo.descriptorSetCount = setCount;
+		allocInfo.pSetLayouts = setLayouts.data();
+		result = vkAllocateDescriptorSets(device, &allocInfo, s_Sets.data());
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to allocate bindless descriptor sets!");
+		s_Dirty.assign(setCount, {});
+
+		VkSamplerCreateInfo samplerCreateInfo = {};
+		samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+		result = vkCreateSampler(device, &samplerCreateInfo, callbacks, &s_DefaultSampler);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create default sampler!");
+
+		CreatePlaceholders();
+		s_TextureInfos.assign(maxTextures, {});
+		s_BufferInfos.assign(maxBuffers, {});
+		if (!updateAfterBind)
+		{
+			s_TextureInfos.assign(maxTextures, { s_DefaultSampler, s_PlaceholderView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+			s_BufferInfos.assign(maxBuffers, { s_PlaceholderBuffer, 0, VK_WHOLE_SIZE });
+			for (uint32_t slot = 0; slot < maxTextures; ++slot)
+				MarkDirty(true, slot);
+			for (uint32_t slot = 0; slot < maxBuffers; ++slot)
+				MarkDirty(false, slot);
+		}
+
+		LOG_INFO("BindlessDescriptors: {} textures and {} buffers, {}", maxTextures, maxBuffers,
+			updateAfterBind ? "update-after-bind" : "one set per frame in flight (no descriptor indexing)");
+	}
+
+	void BindlessDescriptors::Shutdown()
+	{
+		if (s_Mode == BindlessMode::Disabled)
+			return;
+
+		VulkanContext::WaitIdle();
+		VkDevice device = VulkanContext::GetDevice();
+		const VkAllocationCallbacks* callbacks = HostAllocator::GetCallbacks(HostSubsystem::Descriptors);
+
+		// Destroying the pool frees its sets
+		vkDestroyDescriptorPool(device, s_Pool, callbacks);
+		vkDestroyDescriptorSetLayout(device, s_SetLayout, callbacks);
+		vkDestroySampler(device, s_DefaultSampler, callbacks);
+		s_Pool = nullptr;
+		s_SetLayout = nullptr;
+		s_DefaultSampler = nullptr;
+		s_Sets.clear();
+		s_Dirty.clear();
+
+		vkDestroyImageView(device, s_PlaceholderView, callbacks);
+		vkDestroyImage(device, s_PlaceholderImage, callbacks);
+		VulkanContext::GetAllocator().Free(s_PlaceholderImageMemory);
+		vkDestroyBuffer(device, s_PlaceholderBuffer, callbacks);
+		VulkanContext::GetAllocator().Free(s_PlaceholderBufferMemory);
+		s_PlaceholderImage = nullptr;
+		s_PlaceholderView = nullptr;
+		s_PlaceholderBuffer = nullptr;
+
+		s_TextureSlots = {};
+		s_BufferSlots = {};
+		s_TextureInfos.clear();
+		s_BufferInfos.clear();
+		s_Mode = BindlessMode::Disabled;
+	}
+
+	BindlessMode BindlessDescriptors::GetMode()
+	{
+		return s_Mode;
+	}
+
+	bool BindlessDescriptors::IsEnabled()
+	{
+		return s_Mode != BindlessMode::Disabled;
+	}
+
+	BindlessIndex BindlessDescriptors::RegisterTexture(VkImageView view, VkSampler sampler, VkImageLayout layout)
+	{
+		TESTBED_ASSERT(IsEnabled(), "Bindless descriptors are disabled!");
+		const BindlessIndex index = s_TextureSlots.Allocate(VulkanContext::GetCompletedTimelineValue());
+		if (index == InvalidBindlessIndex)
+		{
+			LOG_ERROR("BindlessDescriptors: all {} texture slots are in use", s_TextureSlots.Capacity);
+			return InvalidBindlessIndex;
+		}
+
+		if (view)
+			s_TextureInfos[index] = { sampler ? sampler : s_DefaultSampler, view, layout };
+		else
+			s_TextureInfos[index] = { sampler ? sampler : s_DefaultSampler, s_PlaceholderView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		MarkDirty(true, index);
+		return index;
+	}
+
+	BindlessIndex BindlessDescriptors::UpdateTexture(BindlessIndex index, VkImageView view, VkSampler sampler, VkImageLayout layout)
+	{
+		TESTBED_ASSERT(IsEnabled(), "Bindless descriptors are disabled!");
+		if (s_Mode == BindlessMode::PerFrameSets)
+		{
+			// Each set only picks the write up once its own frame is done with it
+			s_TextureInfos[index] = { sampler ? sampler : s_DefaultSampler, view, layout };
+			MarkDirty(true, index);
+			return index;
+		}
+
+		const BindlessIndex newIndex = RegisterTexture(view, sampler, layout);
+		if (newIndex == InvalidBindlessIndex)
+			return index;
+
+		ReleaseTexture(index);
+		return newIndex;
+	}
+
+	BindlessIndex BindlessDescriptors::RegisterBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		TESTBED_ASSERT(IsEnabled(), "Bindless descriptors are disabled!");
+		const BindlessIndex index = s_BufferSlots.Allocate(VulkanContext::GetCompletedTimelineValue());
+		if (index == InvalidBindlessIndex)
+		{
+			LOG_ERROR("BindlessDescriptors: all {} buffer slots are in use", s_BufferSlots.Capacity);
+			return InvalidBindlessIndex;
+		}
+
+		s_BufferInfos[index] = { buffer, offset, range };
+		MarkDirty(false, index);
+		return index;
+	}
+
+	void BindlessDescriptors::ReleaseTexture(BindlessIndex index)
+	{
+		s_TextureSlots.Release(index, VulkanContext::GetFrameTimelineValue());
+		// Partially bound arrays may keep the stale descriptor, nothing indexes it anymore
+		if (s_Mode == BindlessMode::PerFrameSets)
+		{
+			s_TextureInfos[index] = { s_DefaultSampler, s_PlaceholderView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+			MarkDirty(true, index);
+		}
+	}
+
+	void BindlessDescriptors::ReleaseBuffer(BindlessIndex index)
+	{
+		s_BufferSlots.Release(index, VulkanContext::GetFrameTimelineValue());
+		if (s_Mode == BindlessMode::PerFrameSets)
+		{
+			s_BufferInfos[index] = { s_PlaceholderBuffer, 0, VK_WHOLE_SIZE };
+			MarkDirty(false, index);
+		}
+	}
+
+	void BindlessDescriptors::Update()
+	{
+		TESTBED_PROFILE_FUNCTION();
+		if (s_Mode == BindlessMode::Disabled)
+			return;
+
+		// Per frame sets are only written once BeginFrame made sure their last frame is done
+		const uint32_t setIndex = s_Mode == BindlessMode::PerFrameSets ? VulkanContext::GetFrameIndex() : 0;
+		DirtySlots& dirty = s_Dirty[setIndex];
+		if (dirty.Textures.empty() && dirty.Buffers.empty())
+			return;
+
+		// Runs of consecutive slots become one write straight out of the info arrays
+		std::vector<VkWriteDescriptorSet> writes;
+		auto addWrites = [&](std::vector<uint32_t>& slots, bool texture)
+		{
+			std::sort(slots.begin(), slots.end());
+			slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+			for (size_t i = 0; i < slots.size();)
+			{
+				size_t end = i + 1;
+				while (end < slots.size() && slots[end] == slots[end - 1] + 1)
+					++end;
+
+				VkWriteDescriptorSet& write = writes.emplace_back();
+				write = {};
+				write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				write.dstSet = s_Sets[setIndex];
+				write.dstBinding = texture ? TextureBinding : BufferBinding;
+				write.dstArrayElement = slots[i];
+				write.descriptorCount = (uint32_t)(end - i);
+				write.descriptorType = texture ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				if (texture)
+					write.pImageInfo = &s_TextureInfos[slots[i]];
+				else
+					write.pBufferInfo = &s_BufferInfos[slots[i]];
+
+				s_Stats.DescriptorWrites += end - i;
+				i = end;
+			}
+			slots.clear();
+		};
+		addWrites(dirty.Textures, true);
+		addWrites(dirty.Buffers, false);
+
+		vkUpdateDescriptorSets(VulkanContext::GetDevice(), (uint32_t)writes.size(), writes.data(), 0, nullptr);
+	}
+
+	VkDescriptorSetLayout BindlessDescriptors::GetSetLayout()
+	{
+		return s_SetLayout;
+	}
+
+	VkDescriptorSet BindlessDescriptors::GetDescriptorSet()
+	{
+		return s_Sets[s_Mode == BindlessMode::PerFrameSets ? VulkanContext::GetFrameIndex() : 0];
+	}
+
+	void BindlessDescriptors::Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t setIndex)
+	{
+		const VkDescriptorSet set = GetDescriptorSet();
+		vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, setIndex, 1, &set, 0, nullptr);
+	}
+
+	BindlessStatistics BindlessDescriptors::GetStatistics()
+	{
+		BindlessStatistics stats = s_Stats;
+		stats.Textures = s_TextureSlots.LiveCount;
+		stats.Buffers = s_BufferSlots.LiveCount;
+		stats.PendingReleases = (uint32_t)(s_TextureSlots.Retired.size() + s_BufferSlots.Retired.size());
+		return stats;
+	}
+}
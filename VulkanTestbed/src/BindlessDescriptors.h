@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace VulkanTestbed
+{
+	using BindlessIndex = uint32_t;
+	static constexpr BindlessIndex InvalidBindlessIndex = ~0u;
+
+	struct BindlessSettings
+	{
+		// Upper bounds, clamped to the device limits
+		uint32_t MaxTextures = 16384;
+		uint32_t MaxBuffers = 4096;
+	};
+
+	enum class BindlessMode : uint8_t
+	{
+		// VulkanContext was created without DescriptorIndexing or the device lacks even dynamic indexing
+		Disabled = 0,
+		// One update-after-bind set, indices may diverge within a draw (nonuniformEXT)
+		UpdateAfterBind,
+		// One set per frame in flight, updated when its frame slot comes around. Indices have to be dynamically
+		// uniform and unused slots point at placeholder resources.
+		PerFrameSets
+	};
+
+	struct BindlessStatistics
+	{
+		uint32_t Textures = 0;
+		uint32_t Buffers = 0;
+		// Released slots waiting for the frames that may still use them
+		uint32_t PendingReleases = 0;
+		uint64_t DescriptorWrites = 0;
+	};
+
+	// All textures and storage buffers in two descriptor arrays of one set, bound once per command buffer and indexed by
+	// the IDs handed out here. Released IDs are reused only once every frame that could have used them has finished.
+	// In GLSL:
+	//   layout(set = N, binding = 0) uniform sampler2D u_Textures[];
+	//   layout(set = N, binding = 1) buffer Buffers { uint Data[]; } u_Buffers[];
+	// Main thread only, apart from GetDescriptorSet and Bind.
+	class BindlessDescriptors
+	{
+	public:
+		// Needs VulkanContext and UploadManager
+		static void Init(const BindlessSettings& settings = {});
+		static void Shutdown();
+
+		static BindlessMode GetMode();
+		static bool IsEnabled();
+
+		// Null sampler picks the default one: linear, repeat, all mips. Null view holds the opaque white placeholder
+		// until UpdateTexture points the slot at real contents.
+		static BindlessIndex RegisterTexture(VkImageView view, VkSampler sampler = nullptr, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		// Points a registered texture at another view. Frames in flight may still read the old one, so keep it alive until
+		// they finished. Returns the slot to use from now on: per frame sets rewrite the slot in place, the single
+		// update-after-bind set can't be written while pending frames use the slot and moves the texture to a new one.
+		static BindlessIndex UpdateTexture(BindlessIndex index, VkImageView view, VkSampler sampler = nullptr, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		static BindlessIndex RegisterBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		static void ReleaseTexture(BindlessIndex index);
+		static void ReleaseBuffer(BindlessIndex index);
+
+		// Writes this frame's registrations into the set the frame binds, after VulkanContext::BeginFrame
+		static void Update();
+
+		static VkDescriptorSetLayout GetSetLayout();
+		// Set for the frame being recorded
+		static VkDescriptorSet GetDescriptorSet();
+		static void Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t setIndex);
+
+		static BindlessStatistics GetStatistics();
+
+		static constexpr uint32_t TextureBinding = 0;
+		static constexpr uint32_t BufferBinding = 1;
+	};
+}
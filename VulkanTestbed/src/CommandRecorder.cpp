@@ -0,0 +1,91 @@
+#include "pch.h"
+#include "CommandRecorder.h"
+
+#include "HostAllocator.h"
+#include "VulkanContext.h"
+
+namespace VulkanTestbed
+{
+	CommandRecorder::CommandRecorder(uint32_t queueFamilyIndex)
+		: m_ThreadCount(JobSystem::GetThreadCount()), m_FramesInFlight(VulkanContext::GetFramesInFlight())
+	{
+		m_Pools.resize(m_ThreadCount * m_FramesInFlight);
+
+		VkCommandPoolCreateInfo poolCreateInfo = {};
+		poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+		for (ThreadPool& pool : m_Pools)
+		{
+			VkResult result = vkCreateCommandPool(VulkanContext::GetDevice(), &poolCreateInfo, HostAllocator::GetCallbacks(HostSubsystem::Frame), &pool.Pool);
+			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create command pool!");
+		}
+	}
+
+	CommandRecorder::~CommandRecorder()
+	{
+		// Destroying a pool frees its command buffers
+		for (ThreadPool& pool : m_Pools)
+			vkDestroyCommandPool(VulkanContext::GetDevice(), pool.Pool, HostAllocator::GetCallbacks(HostSubsystem::Frame));
+	}
+
+	void CommandRecorder::BeginFrame()
+	{
+		const uint32_t frameIndex = VulkanContext::GetFrameIndex();
+		TESTBED_ASSERT(frameIndex < m_FramesInFlight, "CommandRecorder was created for fewer frames in flight!");
+
+		for (uint32_t thread = 0; thread < m_ThreadCount; ++thread)
+		{
+			ThreadPool& pool = m_Pools[frameIndex * m_ThreadCount + thread];
+			if (pool.UsedCount == 0)
+				continue;
+
+			vkResetCommandPool(VulkanContext::GetDevice(), pool.Pool, 0);
+			pool.UsedCount = 0;
+		}
+	}
+
+	VkCommandBuffer CommandRecorder::BeginSecondary(const VkCommandBufferInheritanceInfo& inheritance)
+	{
+		const uint32_t thread = JobSystem::GetThreadIndex();
+		TESTBED_ASSERT(thread < m_ThreadCount, "Command buffers can only be recorded on job threads!");
+
+		ThreadPool& pool = m_Pools[VulkanContext::GetFrameIndex() * m_ThreadCount + thread];
+		if (pool.UsedCount == pool.Buffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = pool.Pool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer = nullptr;
+			VkResult result = vkAllocateCommandBuffers(VulkanContext::GetDevice(), &allocInfo, &commandBuffer);
+			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to allocate secondary command buffer!");
+			pool.Buffers.push_back(commandBuffer);
+		}
+		const VkCommandBuffer commandBuffer = pool.Buffers[pool.UsedCount++];
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (inheritance.renderPass)
+			beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritance;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		return commandBuffer;
+	}
+
+	CommandRecorderStatistics CommandRecorder::GetStatistics() const
+	{
+		CommandRecorderStatistics stats;
+		const uint32_t frameIndex = VulkanContext::GetFrameIndex();
+		for (uint32_t i = 0; i < (uint32_t)m_Pools.size(); ++i)
+		{
+			if (i / m_ThreadCount == frameIndex)
+				stats.SecondaryBuffers += m_Pools[i].UsedCount;
+			stats.AllocatedBuffers += (uint32_t)m_Pools[i].Buffers.size();
+		}
+		return stats;
+	}
+}
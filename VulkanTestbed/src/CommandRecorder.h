@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "Core/JobSystem.h"
+
+namespace VulkanTestbed
+{
+	struct CommandRecorderStatistics
+	{
+		// Secondary command buffers recorded since the last BeginFrame
+		uint32_t SecondaryBuffers = 0;
+		// Allocated across all threads and frame slots, they are reused once allocated
+		uint32_t AllocatedBuffers = 0;
+	};
+
+	// Records secondary command buffers on all job threads. Every thread owns a transient command pool per frame in flight,
+	// so recording takes no locks, and a slot's pools are reset wholesale when VulkanContext comes back to it.
+	class CommandRecorder
+	{
+	public:
+		// Sized for the job threads and frames in flight at construction
+		CommandRecorder(uint32_t queueFamilyIndex);
+		~CommandRecorder();
+
+		CommandRecorder(const CommandRecorder&) = delete;
+		CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+		// Call after VulkanContext::BeginFrame, recycles the command buffers of the current frame slot
+		void BeginFrame();
+
+		// Splits [0, count) into ranges of rangeSize items, records each with record(commandBuffer, begin, end) into its
+		// own secondary command buffer on a job thread, then executes them on primary in order. Inside a render pass the
+		// primary has to be in VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS and inheritance has to name it.
+		template<typename F>
+		void Record(VkCommandBuffer primary, const VkCommandBufferInheritanceInfo& inheritance, uint32_t count, uint32_t rangeSize, const F& record);
+
+		CommandRecorderStatistics GetStatistics() const;
+
+	private:
+		// Begun, on the calling job thread's pool for the current frame slot
+		VkCommandBuffer BeginSecondary(const VkCommandBufferInheritanceInfo& inheritance);
+
+	private:
+		struct alignas(64) ThreadPool
+		{
+			VkCommandPool Pool = nullptr;
+			std::vector<VkCommandBuffer> Buffers;
+			uint32_t UsedCount = 0;
+		};
+
+		uint32_t m_ThreadCount = 0;
+		uint32_t m_FramesInFlight = 0;
+		// Indexed by frame slot * thread count + thread index
+		std::vector<ThreadPool> m_Pools;
+		std::vector<VkCommandBuffer> m_Secondaries;
+	};
+
+	template<typename F>
+	void CommandRecorder::Record(VkCommandBuffer primary, const VkCommandBufferInheritanceInfo& inheritance, uint32_t count, uint32_t rangeSize, const F& record)
+	{
+		if (count == 0)
+			return;
+
+		rangeSize = std::max(1u, rangeSize);
+		const uint32_t rangeCount = (count + rangeSize - 1) / rangeSize;
+		m_Secondaries.resize(rangeCount);
+
+		ParallelForRange(rangeCount, 1, [&](uint32_t rangeBegin, uint32_t rangeEnd)
+		{
+			for (uint32_t range = rangeBegin; range < rangeEnd; ++range)
+			{
+				const VkCommandBuffer commandBuffer = BeginSecondary(inheritance);
+				record(commandBuffer, range * rangeSize, std::min(count, (range + 1) * rangeSize));
+				vkEndCommandBuffer(commandBuffer);
+				m_Secondaries[range] = commandBuffer;
+			}
+		});
+
+		vkCmdExecuteCommands(primary, rangeCount, m_Secondaries.data());
+	}
+}
@@ -1,42 +1,336 @@
 #include "pch.h"
 #include "Application.h"
 
+#include <fstream>
+
 #include <GLFW/glfw3.h>
 
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
 
+#include "Core/JobSystem.h"
+#include "Core/Profiler.h"
+#include "Core/TaskGraph.h"
+#include "Core/Timer.h"
+#include "BindlessDescriptors.h"
+#include "FrameCapture.h"
+#include "GpuProfiler.h"
+#include "MeshUploader.h"
 #include "VulkanContext.h"
+#include "PipelineCache.h"
+#include "ShaderCache.h"
+#include "TextureStreamer.h"
+#include "UploadManager.h"
 
 namespace VulkanTestbed
 {
-	Application::Application()
+	static double Percentile(const std::vector<double>& sorted, double p)
 	{
-		Log::Init();
+		if (sorted.empty())
+			return 0.0;
 
-		glfwInit();
-		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-		m_Window = glfwCreateWindow(1600, 900, "Vulkan Testbed", nullptr, nullptr);
+		size_t index = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+
+	Application::Application(const ApplicationSpecification& spec)
+		: m_Specification(spec)
+	{
+		LogSettings logSettings;
+		logSettings.Async = m_Specification.AsyncLogging;
+		Log::Init(logSettings);
+#ifdef TESTBED_PROFILE
+		if (!m_Specification.ProfilePath.empty())
+			Profiler::Init();
+#else
+		if (!m_Specification.ProfilePath.empty())
+			LOG_WARN("Profiling is compiled out of Dist builds, ignoring --profile");
+#endif
+		JobSystem::Init();
+
+		// Driver initialization runs next to the asset work, only the GPU side of the texture streamer waits for the device
+		VulkanContextSettings vulkanSettings;
+		vulkanSettings.FramesInFlight = m_Specification.FramesInFlight;
+		vulkanSettings.DedicatedTransferQueue = m_Specification.DedicatedTransferQueue;
+		vulkanSettings.DescriptorIndexing = m_Specification.Bindless;
+
+		TaskGraph startup;
+		TaskID vulkan;
+		TaskID window = 0;
+		if (m_Specification.Headless)
+		{
+			vulkan = startup.AddTask("VulkanContext", [this, vulkanSettings]() { VulkanContext::InitHeadless(m_Specification.Width, m_Specification.Height, vulkanSettings); });
+		}
+		else
+		{
+			// GLFW windows belong to the thread that created them
+			window = startup.AddInlineTask("Window");
+			vulkan = startup.AddTask("VulkanContext", [this, vulkanSettings]() { VulkanContext::Init(m_Window, vulkanSettings); }, { window });
+		}
+
+		TaskID meshImport = 0;
+		if (!m_Specification.ModelPath.empty())
+			meshImport = startup.AddTask("Mesh import", [this]() { m_MeshCache.Load(m_Specification.ModelPath); });
+
+		const std::filesystem::path cacheDirectory = m_Specification.CacheDirectory;
+		startup.AddTask("Shader cache", [cacheDirectory]() { ShaderCache::Init(cacheDirectory / "Shaders"); });
+		startup.AddTask("Pipeline cache", [cacheDirectory]() { PipelineCache::Init(cacheDirectory / "pipeline.cache"); }, { vulkan });
+
+		const TaskID textures = startup.AddInlineTask("Texture requests");
+		const TaskID uploads = startup.AddTask("Upload manager", []() { UploadManager::Init(); }, { vulkan });
+		startup.AddTask("Texture streaming", []() { TextureStreamer::InitDevice(); }, { uploads, textures });
+		if (m_Specification.Bindless)
+			startup.AddTask("Bindless descriptors", []() { BindlessDescriptors::Init(); }, { uploads });
+		if (!m_Specification.ModelPath.empty())
+		{
+			// Views point into the mapped cache, which stays loaded until after the uploader shuts down
+			startup.AddTask("Mesh upload", [this]()
+			{
+				MeshUploader::Init();
+				for (uint32_t i = 0; i < m_MeshCache.GetMeshCount(); ++i)
+					m_Meshes.push_back(MeshUploader::Upload(m_MeshCache.GetMesh(i)));
+			}, { uploads, meshImport });
+		}
+
+		startup.Start();
+		if (!m_Specification.Headless)
+			startup.RunInline(window, [this]() { InitWindow(); });
+		startup.RunInline(textures, [this]() { LoadTextures(); });
+		startup.Wait();
+
+		startup.LogReport("Startup");
 
-		VulkanContext::Init(m_Window);
+		// Calibration submits to the graphics queue, which only the main thread uses from here on
+		if (Profiler::IsInitialized())
+			GpuProfiler::Init();
+
+		if (!m_Specification.CaptureDirectory.empty())
+		{
+			if (m_Specification.CaptureFrames.empty())
+				m_Specification.CaptureFrames.push_back(m_Specification.BenchmarkFrames > 0 ? m_Specification.BenchmarkFrames - 1 : 0);
+
+			FrameCaptureSettings captureSettings;
+			captureSettings.OutputDirectory = m_Specification.CaptureDirectory;
+			captureSettings.Format = m_Specification.CaptureFormat;
+			captureSettings.GoldenDirectory = m_Specification.GoldenDirectory;
+			captureSettings.UpdateGoldens = m_Specification.UpdateGoldens;
+			captureSettings.Tolerance = m_Specification.GoldenTolerance;
+			FrameCapture::Init(captureSettings);
+		}
 	}
 
 	Application::~Application()
 	{
+		GpuProfiler::Shutdown();
+		FrameCapture::Shutdown();
+		m_RenderGraph.Release();
+		TextureStreamer::Shutdown();
+		BindlessDescriptors::Shutdown();
+		MeshUploader::Shutdown();
+		UploadManager::Shutdown();
+		PipelineCache::Shutdown();
+		ShaderCache::Shutdown();
 		VulkanContext::Shutdown();
+		m_MeshCache.Unload();
+
+		if (m_Window)
+		{
+			glfwDestroyWindow(m_Window);
+			glfwTerminate();
+		}
+
+		JobSystem::Shutdown();
 
-		glfwDestroyWindow(m_Window);
-		glfwTerminate();
+		if (Profiler::IsInitialized())
+		{
+			if (!Profiler::WriteChromeTrace(m_Specification.ProfilePath))
+				LOG_ERROR("Failed to write profile to {}", m_Specification.ProfilePath);
+			Profiler::Shutdown();
+		}
 	}
 
-	void Application::Run()
+	bool Application::Run()
 	{
+		if (m_Specification.BenchmarkFrames > 0)
+		{
+			RunBenchmark();
+			return FrameCapture::AllPassed();
+		}
+
 		while (!glfwWindowShouldClose(m_Window))
 		{
 			glfwPollEvents();
+
+			TESTBED_PROFILE_SCOPE("Frame");
+			VulkanContext::BeginFrame();
+			GpuProfiler::BeginFrame();
+			FrameCapture::Update();
+			TextureStreamer::Update();
+			BindlessDescriptors::Update();
+			MeshUploader::Update();
+			UploadManager::Submit();
+			RenderFrame();
+			VulkanContext::EndFrame();
+		}
+
+		FrameCapture::Flush();
+		return FrameCapture::AllPassed();
+	}
+
+	void Application::InitWindow()
+	{
+		glfwInit();
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+		m_Window = glfwCreateWindow((int)m_Specification.Width, (int)m_Specification.Height, "Vulkan Testbed", nullptr, nullptr);
+	}
+
+	void Application::LoadTextures()
+	{
+		TextureStreamer::Init();
+		if (m_Specification.TextureDirectory.empty())
+			return;
+
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(m_Specification.TextureDirectory, error))
+		{
+			std::string extension = entry.path().extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)std::tolower(c); });
+			if (extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp")
+				TextureStreamer::Load(entry.path());
+		}
+
+		if (error)
+			LOG_ERROR("Failed to read texture directory {}: {}", m_Specification.TextureDirectory, error.message());
+		else
+			LOG_INFO("Streaming {} textures from {}", TextureStreamer::GetStatistics().Requested, m_Specification.TextureDirectory);
+	}
+
+	void Application::RenderFrame()
+	{
+		TESTBED_PROFILE_FUNCTION();
+		const VkExtent2D extent = VulkanContext::GetExtent();
+		const RenderImageDesc backbufferDesc = { VulkanContext::GetBackbufferFormat(), extent };
+
+		m_RenderGraph.Reset();
+		const RenderResource backbuffer = m_RenderGraph.ImportImage("Backbuffer", VulkanContext::GetBackbuffer(), nullptr, backbufferDesc,
+			RenderAccess::Acquired, VulkanContext::IsHeadless() ? RenderAccess::TransferRead : RenderAccess::Present);
+
+		m_RenderGraph.AddPass("Clear", [&](RenderPassBuilder& builder)
+		{
+			builder.Write(backbuffer, RenderAccess::TransferWrite);
+		},
+		[backbuffer](VkCommandBuffer commandBuffer, const RenderGraphResources& resources)
+		{
+			const float t = (float)((VulkanContext::GetFrameTimelineValue() - 1) % 256) / 255.0f;
+			const VkClearColorValue clearColor = { { 0.1f, 0.1f, t, 1.0f } };
+			const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			vkCmdClearColorImage(commandBuffer, resources.GetImage(backbuffer), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &range);
+		});
+
+		const uint64_t frame = VulkanContext::GetFrameTimelineValue() - 1;
+		const std::vector<uint32_t>& captureFrames = m_Specification.CaptureFrames;
+		if (FrameCapture::IsInitialized() && std::find(captureFrames.begin(), captureFrames.end(), frame) != captureFrames.end())
+			FrameCapture::Capture(m_RenderGraph, backbuffer, fmt::format("{}_{:05}", m_Specification.SceneName, frame));
+
+		m_RenderGraph.Compile();
+		m_RenderGraph.Execute(VulkanContext::GetCommandBuffer());
+	}
+
+	void Application::RunBenchmark()
+	{
+		const uint32_t frameCount = m_Specification.BenchmarkFrames;
+		std::vector<double> frameTimes;
+		frameTimes.reserve(frameCount);
+
+		Timer totalTimer;
+		for (uint32_t frame = 0; frame < frameCount; ++frame)
+		{
+			Timer frameTimer;
+			TESTBED_PROFILE_SCOPE("Frame");
+
+			if (m_Window)
+			{
+				glfwPollEvents();
+				if (glfwWindowShouldClose(m_Window))
+					break;
+			}
+
+			VulkanContext::BeginFrame();
+			GpuProfiler::BeginFrame();
+			FrameCapture::Update();
+			TextureStreamer::Update();
+			BindlessDescriptors::Update();
+			MeshUploader::Update();
+			UploadManager::Submit();
+			RenderFrame();
+			VulkanContext::EndFrame();
+
+			frameTimes.push_back(frameTimer.ElapsedMillis());
+		}
+		VulkanContext::WaitIdle();
+		const double totalSeconds = totalTimer.Elapsed();
+
+		std::sort(frameTimes.begin(), frameTimes.end());
+		LOG_INFO("Benchmark: {} frames in {:.3f} s ({})", frameTimes.size(), totalSeconds, VulkanContext::IsHeadless() ? "headless" : "swapchain");
+		LOG_INFO("\tFrames/sec: {:.2f}", (double)frameTimes.size() / totalSeconds);
+		LOG_INFO("\tCPU frame time p50: {:.3f} ms, p99: {:.3f} ms", Percentile(frameTimes, 0.50), Percentile(frameTimes, 0.99));
+
+		// Waiting on most frames means the CPU is ahead and the GPU is the bottleneck, waiting on none with a low
+		// frame rate means the CPU is
+		const FrameStatistics frameStats = VulkanContext::GetFrameStatistics();
+		LOG_INFO("\tFrames in flight: {}, GPU wait on {} of {} frames, {:.3f} ms total, {:.3f} ms worst, acquire {:.3f} ms total",
+			VulkanContext::GetFramesInFlight(), frameStats.StalledFrames, frameStats.Frames, frameStats.CpuWaitSeconds * 1000.0,
+			frameStats.MaxCpuWaitSeconds * 1000.0, frameStats.AcquireWaitSeconds * 1000.0);
+
+		if (m_Specification.CaptureDirectory.empty())
+			return;
+
+		FrameCapture::Flush();
+		for (const CaptureResult& result : FrameCapture::GetResults())
+		{
+			LOG_INFO("\tCapture {}: {}, {} of {} pixels mismatched, max difference {}, processed in {:.1f} ms", result.Name, CaptureStatusToString(result.Status),
+				result.Diff.MismatchedPixels, result.Diff.Pixels, result.Diff.MaxDifference, result.ProcessSeconds * 1000.0);
+		}
+		WriteSceneReport(frameTimes, totalSeconds);
+	}
+
+	// Timings and capture results of one scene, CI compares these across runs
+	void Application::WriteSceneReport(const std::vector<double>& sortedFrameTimes, double totalSeconds)
+	{
+		const FrameStatistics frameStats = VulkanContext::GetFrameStatistics();
+		std::string json = "{\n";
+		const DeviceIdentity& device = VulkanContext::GetDeviceIdentity();
+		json += fmt::format("\t\"scene\": \"{}\",\n\t\"device\": \"{:04x}:{:04x}\",\n\t\"headless\": {},\n", m_Specification.SceneName,
+			device.VendorID, device.DeviceID, VulkanContext::IsHeadless());
+		json += fmt::format("\t\"frames\": {},\n\t\"seconds\": {:.6f},\n\t\"fps\": {:.3f},\n", sortedFrameTimes.size(), totalSeconds,
+			totalSeconds > 0.0 ? (double)sortedFrameTimes.size() / totalSeconds : 0.0);
+		json += fmt::format("\t\"frameMs\": {{ \"p50\": {:.4f}, \"p90\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f} }},\n", Percentile(sortedFrameTimes, 0.50),
+			Percentile(sortedFrameTimes, 0.90), Percentile(sortedFrameTimes, 0.99), sortedFrameTimes.empty() ? 0.0 : sortedFrameTimes.back());
+		json += fmt::format("\t\"gpuWaitFrames\": {},\n\t\"captures\": [", frameStats.StalledFrames);
+
+		const std::vector<CaptureResult> results = FrameCapture::GetResults();
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const CaptureResult& result = results[i];
+			json += fmt::format("{}\n\t\t{{ \"name\": \"{}\", \"frame\": {}, \"status\": \"{}\", \"mismatchedPixels\": {}, \"maxDifference\": {}, \"processMs\": {:.3f} }}",
+				i > 0 ? "," : "", result.Name, result.Frame, CaptureStatusToString(result.Status), result.Diff.MismatchedPixels, result.Diff.MaxDifference,
+				result.ProcessSeconds * 1000.0);
 		}
+		json += results.empty() ? "]\n}\n" : "\n\t]\n}\n";
+
+		const std::filesystem::path path = std::filesystem::path(m_Specification.CaptureDirectory) / (m_Specification.SceneName + ".json");
+		const std::filesystem::path tempPath = std::filesystem::path(path).concat(".tmp");
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write(json.data(), (std::streamsize)json.size());
+		file.close();
+
+		std::error_code error;
+		if (file)
+			std::filesystem::rename(tempPath, path, error);
+		if (!file || error)
+			LOG_ERROR("Failed to write scene report {}", path.string());
+		else
+			LOG_INFO("\tReport written to {}", path.string());
 	}
 }
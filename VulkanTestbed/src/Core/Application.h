@@ -1,18 +1,77 @@
 #pragma once
 
+#include "Asset/ImageWriter.h"
+#include "Asset/MeshCache.h"
+#include "MeshUploader.h"
+#include "RenderGraph.h"
+
 struct GLFWwindow;
 
 namespace VulkanTestbed
 {
+	struct ApplicationSpecification
+	{
+		uint32_t Width = 1600;
+		uint32_t Height = 900;
+
+		// Skips window, surface and swapchain creation and renders into offscreen images
+		bool Headless = false;
+		// Runs this many frames and reports throughput, 0 runs until the window is closed
+		uint32_t BenchmarkFrames = 0;
+		// Frames the CPU records ahead of the GPU
+		uint32_t FramesInFlight = 2;
+		// Uploads go through a transfer-only queue family when the device has one
+		bool DedicatedTransferQueue = true;
+		// Registers every texture in one descriptor array indexed by ID instead of per material sets
+		bool Bindless = false;
+
+		// Optional OBJ file imported at startup
+		std::string ModelPath;
+		// Optional directory whose images are streamed in at startup
+		std::string TextureDirectory;
+		// Compiled SPIR-V and the pipeline cache are kept here between runs
+		std::string CacheDirectory = "Cache";
+		// Console and file output are written by a logging thread instead of the thread that logs
+		bool AsyncLogging = true;
+		// CPU and GPU zones are recorded and written here as a Chrome trace on exit, nothing is recorded when empty
+		std::string ProfilePath;
+
+		// Frames are read back and written here along with a timing report, nothing is captured when empty
+		std::string CaptureDirectory;
+		// Frame numbers to capture, the last benchmark frame when empty
+		std::vector<uint32_t> CaptureFrames;
+		ImageFileFormat CaptureFormat = ImageFileFormat::PNG;
+		// Captures are compared against the PNG of the same name here and the run fails on a mismatch
+		std::string GoldenDirectory;
+		// Writes the captures as the new goldens instead of comparing against them
+		bool UpdateGoldens = false;
+		uint8_t GoldenTolerance = 2;
+		// Prefix of the capture names and name of the timing report, one per test scene
+		std::string SceneName = "Default";
+	};
+
 	class Application
 	{
 	public:
-		Application();
+		Application(const ApplicationSpecification& spec);
 		~Application();
 
-		void Run();
+		// False when a frame capture failed or didn't match its golden image
+		bool Run();
 
 	private:
-		GLFWwindow* m_Window;
+		void RunBenchmark();
+		void WriteSceneReport(const std::vector<double>& sortedFrameTimes, double totalSeconds);
+		void InitWindow();
+		void LoadTextures();
+		void RenderFrame();
+
+	private:
+		ApplicationSpecification m_Specification;
+		GLFWwindow* m_Window = nullptr;
+
+		MeshCache m_MeshCache;
+		std::vector<MeshHandle> m_Meshes;
+		RenderGraph m_RenderGraph;
 	};
 }
@@ -1,12 +1,33 @@
 #pragma once
 
-#include <filesystem>
+#include <type_traits>
 
 #include "Log.h"
 
+namespace VulkanTestbed
+{
+	// Offset of the file name in a path, the part after the last separator
+	constexpr size_t FileNameOffset(const char* path)
+	{
+		size_t offset = 0;
+		for (size_t i = 0; path[i]; ++i)
+		{
+			if (path[i] == '/' || path[i] == '\\')
+				offset = i + 1;
+		}
+		return offset;
+	}
+}
+
+// Evaluated by the compiler, a failing assert doesn't parse paths
+#define TESTBED_FILENAME (__FILE__ + std::integral_constant<size_t, ::VulkanTestbed::FileNameOffset(__FILE__)>::value)
+
 #ifdef TESTBED_DEBUG
 #if defined(_WIN32)
 #define TESTBED_DEBUGBREAK() __debugbreak()
+#elif defined(__linux__)
+#include <signal.h>
+#define TESTBED_DEBUGBREAK() raise(SIGTRAP)
 #else
 #error "Platform doesn't support debugbreak yet!"
 #endif
@@ -21,9 +42,9 @@
 #ifdef TESTBED_ENABLE_ASSERTS
 // Alteratively we could use the same "default" message for both "WITH_MSG" and "NO_MSG" and
 // provide support for custom formatting by concatenating the formatting string instead of having the format inside the default message
-#define TESTBED_INTERNAL_ASSERT_IMPL(type, check, msg, ...) { if(!(check)) { LOG_ERROR(msg, __VA_ARGS__); TESTBED_DEBUGBREAK(); } }
+#define TESTBED_INTERNAL_ASSERT_IMPL(type, check, msg, ...) { if(!(check)) { LOG_ERROR(msg, __VA_ARGS__); ::VulkanTestbed::Log::Flush(); TESTBED_DEBUGBREAK(); } }
 #define TESTBED_INTERNAL_ASSERT_WITH_MSG(type, check, ...) TESTBED_INTERNAL_ASSERT_IMPL(type, check, "Assertion failed: {0}", __VA_ARGS__)
-#define TESTBED_INTERNAL_ASSERT_NO_MSG(type, check) TESTBED_INTERNAL_ASSERT_IMPL(type, check, "Assertion '{0}' failed at {1}:{2}", TESTBED_STRINGIFY_MACRO(check), std::filesystem::path(__FILE__).filename().string(), __LINE__)
+#define TESTBED_INTERNAL_ASSERT_NO_MSG(type, check) TESTBED_INTERNAL_ASSERT_IMPL(type, check, "Assertion '{0}' failed at {1}:{2}", TESTBED_STRINGIFY_MACRO(check), TESTBED_FILENAME, __LINE__)
 
 #define TESTBED_INTERNAL_ASSERT_GET_MACRO_NAME(arg1, arg2, macro, ...) macro
 #define TESTBED_INTERNAL_ASSERT_GET_MACRO(...) TESTBED_EXPAND_MACRO( TESTBED_INTERNAL_ASSERT_GET_MACRO_NAME(__VA_ARGS__, TESTBED_INTERNAL_ASSERT_WITH_MSG, TESTBED_INTERNAL_ASSERT_NO_MSG) )
@@ -0,0 +1,108 @@
+#include "pch.h"
+#include "Hash.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+	static constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+	static constexpr uint64_t Prime3 = 0x165667B19E3779F9ull;
+	static constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ull;
+	static constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ull;
+
+	static inline uint64_t RotateLeft(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	static inline uint64_t Read64(const uint8_t* data)
+	{
+		uint64_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	static inline uint32_t Read32(const uint8_t* data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	static inline uint64_t Round(uint64_t acc, uint64_t input)
+	{
+		acc += input * Prime2;
+		acc = RotateLeft(acc, 31);
+		return acc * Prime1;
+	}
+
+	static inline uint64_t MergeRound(uint64_t acc, uint64_t value)
+	{
+		acc ^= Round(0, value);
+		return acc * Prime1 + Prime4;
+	}
+
+	uint64_t Hash64(const void* data, size_t size, uint64_t seed)
+	{
+		const uint8_t* p = (const uint8_t*)data;
+		const uint8_t* end = p + size;
+		uint64_t hash;
+
+		if (size >= 32)
+		{
+			uint64_t v1 = seed + Prime1 + Prime2;
+			uint64_t v2 = seed + Prime2;
+			uint64_t v3 = seed;
+			uint64_t v4 = seed - Prime1;
+
+			const uint8_t* limit = end - 32;
+			do
+			{
+				v1 = Round(v1, Read64(p));
+				v2 = Round(v2, Read64(p + 8));
+				v3 = Round(v3, Read64(p + 16));
+				v4 = Round(v4, Read64(p + 24));
+				p += 32;
+			} while (p <= limit);
+
+			hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+			hash = MergeRound(hash, v1);
+			hash = MergeRound(hash, v2);
+			hash = MergeRound(hash, v3);
+			hash = MergeRound(hash, v4);
+		}
+		else
+		{
+			hash = seed + Prime5;
+		}
+
+		hash += (uint64_t)size;
+
+		while (p + 8 <= end)
+		{
+			hash ^= Round(0, Read64(p));
+			hash = RotateLeft(hash, 27) * Prime1 + Prime4;
+			p += 8;
+		}
+
+		if (p + 4 <= end)
+		{
+			hash ^= (uint64_t)Read32(p) * Prime1;
+			hash = RotateLeft(hash, 23) * Prime2 + Prime3;
+			p += 4;
+		}
+
+		while (p < end)
+		{
+			hash ^= (*p) * Prime5;
+			hash = RotateLeft(hash, 11) * Prime1;
+			++p;
+		}
+
+		hash ^= hash >> 33;
+		hash *= Prime2;
+		hash ^= hash >> 29;
+		hash *= Prime3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace VulkanTestbed
+{
+	// Finalizer from MurmurHash3, good avalanche for integer keys
+	inline uint64_t Mix64(uint64_t key)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdull;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ull;
+		key ^= key >> 33;
+		return key;
+	}
+
+	inline uint64_t HashCombine(uint64_t seed, uint64_t value)
+	{
+		return Mix64(seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2)));
+	}
+
+	// XXH64 over a block of memory
+	uint64_t Hash64(const void* data, size_t size, uint64_t seed = 0);
+}
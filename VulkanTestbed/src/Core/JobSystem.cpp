@@ -0,0 +1,286 @@
+#include "pch.h"
+#include "JobSystem.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace VulkanTestbed
+{
+	// Powers of two. A thread with this many unfinished jobs of its own runs new ones inline.
+	static constexpr uint32_t QueueCapacity = 4096;
+	static constexpr uint32_t JobPoolSize = 4096;
+	// Failed steal rounds before a worker goes to sleep
+	static constexpr uint32_t SpinCount = 64;
+
+	// Chase-Lev deque (Le et al. 2013, "Correct and Efficient Work-Stealing for Weak Memory Models")
+	class JobQueue
+	{
+	public:
+		// Owner only
+		bool Push(Job* job)
+		{
+			const int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+			const int64_t top = m_Top.load(std::memory_order_acquire);
+			if (bottom - top >= (int64_t)QueueCapacity)
+				return false;
+
+			m_Jobs[bottom & (QueueCapacity - 1)].store(job, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		// Owner only
+		Job* Pop()
+		{
+			const int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+			m_Bottom.store(bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t top = m_Top.load(std::memory_order_relaxed);
+
+			if (top > bottom)
+			{
+				m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			Job* job = m_Jobs[bottom & (QueueCapacity - 1)].load(std::memory_order_relaxed);
+			if (top == bottom)
+			{
+				// Last job, race the thieves for it
+				if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					job = nullptr;
+				m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		// Any thread
+		Job* Steal()
+		{
+			int64_t top = m_Top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+			if (top >= bottom)
+				return nullptr;
+
+			Job* job = m_Jobs[top & (QueueCapacity - 1)].load(std::memory_order_relaxed);
+			if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return nullptr;
+			return job;
+		}
+
+	private:
+		// Thieves hammer the top, the owner the bottom
+		alignas(64) std::atomic<int64_t> m_Top = 0;
+		alignas(64) std::atomic<int64_t> m_Bottom = 0;
+		alignas(64) std::array<std::atomic<Job*>, QueueCapacity> m_Jobs = {};
+	};
+
+	struct JobThread
+	{
+		JobQueue Queue;
+		// Thread 0 pushes background jobs here but never pops, workers steal them
+		JobQueue BackgroundQueue;
+		std::array<Job, JobPoolSize> Jobs;
+		uint32_t NextJob = 0;
+		uint32_t RandomState = 0;
+	};
+
+	static thread_local uint32_t s_ThreadIndex = JobSystem::InvalidThreadIndex;
+	// Set while the thread runs a background job, the jobs it starts are background jobs as well
+	static thread_local bool s_RunningBackground = false;
+
+	static std::unique_ptr<JobThread[]> s_Threads;
+	static uint32_t s_ThreadCount = 0;
+	static std::vector<std::thread> s_Workers;
+	static std::atomic<bool> s_Running = false;
+
+	// Jobs sitting in a queue, workers only sleep while this is zero
+	static std::atomic<uint32_t> s_QueuedJobs = 0;
+	static std::atomic<uint32_t> s_SleepingWorkers = 0;
+	static std::mutex s_SleepMutex;
+	static std::condition_variable s_SleepCondition;
+
+	static void Execute(Job* job)
+	{
+		// Background jobs can wait on foreground ones and the other way around, restore whatever ran below
+		const bool runningBackground = s_RunningBackground;
+		s_RunningBackground = job->Background;
+		job->Function(*job);
+		s_RunningBackground = runningBackground;
+
+		JobCounter* counter = job->Counter;
+		job->Finished.store(true, std::memory_order_release);
+		counter->Pending.fetch_sub(1, std::memory_order_acq_rel);
+	}
+
+	static Job* FindJob(uint32_t threadIndex, JobQueue JobThread::* queue)
+	{
+		JobThread& thread = s_Threads[threadIndex];
+		if (Job* job = (thread.*queue).Pop())
+			return job;
+
+		// Xorshift, starts each steal round at a different victim so thieves spread out
+		uint32_t& state = thread.RandomState;
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		const uint32_t start = state % s_ThreadCount;
+		for (uint32_t i = 0; i < s_ThreadCount; ++i)
+		{
+			const uint32_t victim = (start + i) % s_ThreadCount;
+			if (victim == threadIndex)
+				continue;
+
+			if (Job* job = (s_Threads[victim].*queue).Steal())
+				return job;
+		}
+		return nullptr;
+	}
+
+	static bool RunOneJob(uint32_t threadIndex, bool background)
+	{
+		Job* job = FindJob(threadIndex, &JobThread::Queue);
+		if (!job && background)
+			job = FindJob(threadIndex, &JobThread::BackgroundQueue);
+		if (!job)
+			return false;
+
+		s_QueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+		Execute(job);
+		return true;
+	}
+
+	static void WorkerLoop(uint32_t threadIndex)
+	{
+		s_ThreadIndex = threadIndex;
+
+		uint32_t idleRounds = 0;
+		while (s_Running.load(std::memory_order_relaxed))
+		{
+			if (RunOneJob(threadIndex, true))
+			{
+				idleRounds = 0;
+				continue;
+			}
+
+			if (++idleRounds < SpinCount)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			// Submit bumps the queued count before checking for sleepers, so either we see the job or it sees us
+			std::unique_lock<std::mutex> lock(s_SleepMutex);
+			s_SleepingWorkers.fetch_add(1);
+			s_SleepCondition.wait(lock, []() { return !s_Running.load() || s_QueuedJobs.load() > 0; });
+			s_SleepingWorkers.fetch_sub(1);
+			idleRounds = 0;
+		}
+	}
+
+	void JobSystem::Init(uint32_t workerCount)
+	{
+		TESTBED_ASSERT(s_ThreadCount == 0, "JobSystem is already running!");
+
+		if (workerCount == DefaultWorkerCount)
+			workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+		s_ThreadCount = workerCount + 1;
+		s_Threads.reset(new JobThread[s_ThreadCount]);
+		for (uint32_t i = 0; i < s_ThreadCount; ++i)
+			s_Threads[i].RandomState = 0x9E3779B9u * (i + 1);
+
+		s_ThreadIndex = 0;
+		s_Running = true;
+		for (uint32_t i = 1; i < s_ThreadCount; ++i)
+			s_Workers.emplace_back(WorkerLoop, i);
+	}
+
+	void JobSystem::Shutdown()
+	{
+		if (s_ThreadCount == 0)
+			return;
+
+		// Anything still queued belongs to a counter somebody waits on, drain it first
+		while (RunOneJob(0, true)) {}
+
+		{
+			std::lock_guard<std::mutex> lock(s_SleepMutex);
+			s_Running = false;
+		}
+		s_SleepCondition.notify_all();
+		for (std::thread& worker : s_Workers)
+			worker.join();
+		s_Workers.clear();
+
+		s_Threads.reset();
+		s_ThreadCount = 0;
+		s_ThreadIndex = InvalidThreadIndex;
+		s_QueuedJobs = 0;
+	}
+
+	uint32_t JobSystem::GetThreadCount()
+	{
+		return std::max(1u, s_ThreadCount);
+	}
+
+	uint32_t JobSystem::GetThreadIndex()
+	{
+		return s_ThreadIndex;
+	}
+
+	void JobSystem::Wait(JobCounter& counter)
+	{
+		const uint32_t threadIndex = s_ThreadIndex;
+		while (!counter.IsDone())
+		{
+			// Only background jobs wait on background work, anything else would stall behind a long decode
+			if (threadIndex == InvalidThreadIndex || !RunOneJob(threadIndex, s_RunningBackground))
+				std::this_thread::yield();
+		}
+	}
+
+	Job* JobSystem::AllocateJob()
+	{
+		const uint32_t threadIndex = s_ThreadIndex;
+		if (threadIndex == InvalidThreadIndex)
+			return nullptr;
+
+		JobThread& thread = s_Threads[threadIndex];
+		Job* job = &thread.Jobs[thread.NextJob++ & (JobPoolSize - 1)];
+		// The pool wrapped around onto a job that hasn't finished. It may be running further up this very stack,
+		// so waiting for it could never return, the caller runs the new job inline instead.
+		if (!job->Finished.load(std::memory_order_acquire))
+			return nullptr;
+
+		job->Finished.store(false, std::memory_order_relaxed);
+		return job;
+	}
+
+	void JobSystem::Submit(Job* job)
+	{
+		// Without workers nobody else would ever run background jobs
+		job->Background = (job->Background || s_RunningBackground) && s_ThreadCount > 1;
+		JobThread& thread = s_Threads[s_ThreadIndex];
+		JobQueue& queue = job->Background ? thread.BackgroundQueue : thread.Queue;
+
+		// Counted before it becomes visible, so a thief never decrements below zero
+		s_QueuedJobs.fetch_add(1);
+		if (!queue.Push(job))
+		{
+			s_QueuedJobs.fetch_sub(1);
+			Execute(job);
+			return;
+		}
+
+		if (s_SleepingWorkers.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(s_SleepMutex);
+			s_SleepCondition.notify_one();
+		}
+	}
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+
+namespace VulkanTestbed
+{
+	// Every job started with a counter is its child. The counter reaches zero once all of them are done,
+	// including the jobs they started with the same counter, which is how dependencies are expressed.
+	struct JobCounter
+	{
+		std::atomic<uint32_t> Pending = 0;
+
+		bool IsDone() const { return Pending.load(std::memory_order_acquire) == 0; }
+	};
+
+	// One cache line, the callable is stored inline so starting a job never allocates
+	struct alignas(64) Job
+	{
+		static constexpr size_t DataSize = 40;
+
+		void (*Function)(Job& job) = nullptr;
+		JobCounter* Counter = nullptr;
+		// Set once the job has run, its pool slot can be reused after that
+		std::atomic<bool> Finished = true;
+		bool Background = false;
+		alignas(8) uint8_t Data[DataSize];
+	};
+
+	// Work stealing scheduler: every thread owns a Chase-Lev deque it pushes and pops at the bottom,
+	// idle threads steal from the top of the others. Jobs started on threads the system doesn't own
+	// run inline. Background jobs, and every job they start, live in a second set of deques that idle
+	// workers take from once there is nothing else to do, so waiting on foreground work never ends up
+	// running a long background job.
+	class JobSystem
+	{
+	public:
+		// The calling thread becomes thread 0. By default one worker is started per remaining hardware thread, but at
+		// least one so background jobs make progress while the calling thread doesn't wait on anything.
+		static void Init(uint32_t workerCount = DefaultWorkerCount);
+		static void Shutdown();
+
+		// Workers plus the thread that called Init, 1 when the system isn't running
+		static uint32_t GetThreadCount();
+		// 0 on the thread that called Init, InvalidThreadIndex on threads the system doesn't own
+		static uint32_t GetThreadIndex();
+
+		template<typename F>
+		static void Run(JobCounter& counter, F&& func);
+		// For long running work nobody on thread 0 waits for soon, such as texture decoding
+		template<typename F>
+		static void RunBackground(JobCounter& counter, F&& func);
+
+		// Runs other jobs on the calling thread until the counter reaches zero. Background jobs are only picked up
+		// while waiting inside one.
+		static void Wait(JobCounter& counter);
+
+		static constexpr uint32_t InvalidThreadIndex = ~0u;
+		static constexpr uint32_t DefaultWorkerCount = ~0u;
+
+	private:
+		template<typename F>
+		static void Start(JobCounter& counter, F&& func, bool background);
+
+		static Job* AllocateJob();
+		static void Submit(Job* job);
+	};
+
+	template<typename F>
+	void JobSystem::Run(JobCounter& counter, F&& func)
+	{
+		Start(counter, std::forward<F>(func), false);
+	}
+
+	template<typename F>
+	void JobSystem::RunBackground(JobCounter& counter, F&& func)
+	{
+		Start(counter, std::forward<F>(func), true);
+	}
+
+	template<typename F>
+	void JobSystem::Start(JobCounter& counter, F&& func, bool background)
+	{
+		using Function = std::decay_t<F>;
+		static_assert(sizeof(Function) <= Job::DataSize, "Job captures too much, capture by reference instead");
+		static_assert(alignof(Function) <= 8, "Job capture alignment is not supported");
+
+		counter.Pending.fetch_add(1, std::memory_order_relaxed);
+
+		Job* job = AllocateJob();
+		if (!job)
+		{
+			func();
+			counter.Pending.fetch_sub(1, std::memory_order_release);
+			return;
+		}
+
+		new (job->Data) Function(std::forward<F>(func));
+		job->Function = [](Job& job)
+		{
+			Function& function = *std::launder((Function*)job.Data);
+			function();
+			function.~Function();
+		};
+		job->Counter = &counter;
+		job->Background = background;
+		Submit(job);
+	}
+
+	namespace Detail
+	{
+		// Hands the upper half to other threads and keeps splitting the lower one, so thieves take the largest ranges
+		template<typename F>
+		void SplitRange(JobCounter& counter, uint32_t begin, uint32_t end, uint32_t grainSize, const F& func)
+		{
+			while (end - begin > grainSize)
+			{
+				const uint32_t middle = begin + (end - begin) / 2;
+				JobSystem::Run(counter, [&counter, &func, middle, end, grainSize]() { SplitRange(counter, middle, end, grainSize, func); });
+				end = middle;
+			}
+			func(begin, end);
+		}
+	}
+
+	// Calls func(begin, end) for ranges of at most grainSize elements that cover [0, count), returns when all are done
+	template<typename F>
+	void ParallelForRange(uint32_t count, uint32_t grainSize, const F& func)
+	{
+		if (count == 0)
+			return;
+
+		JobCounter counter;
+		Detail::SplitRange(counter, 0, count, std::max(1u, grainSize), func);
+		JobSystem::Wait(counter);
+	}
+
+	// Calls func(i) for every i in [0, count) spread across all threads, returns when all calls are done
+	template<typename F>
+	void ParallelFor(uint32_t count, const F& func)
+	{
+		const uint32_t grainSize = std::max(1u, count / (JobSystem::GetThreadCount() * 4));
+		ParallelForRange(count, grainSize, [&func](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++i)
+				func(i);
+		});
+	}
+}
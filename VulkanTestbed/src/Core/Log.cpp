@@ -1,14 +1,48 @@
 #include "pch.h"
 #include "Log.h"
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <spdlog/async.h>
+#include <spdlog/sinks/base_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/basic_file_sink.h>
 
 namespace VulkanTestbed
 {
+	// Last sink of the logger, so a flush reaching it means every sink before it has flushed
+	class FlushSignalSink : public spdlog::sinks::base_sink<spdlog::details::null_mutex>
+	{
+	public:
+		uint64_t GetFlushCount() const { return m_FlushCount.load(std::memory_order_acquire); }
+
+	protected:
+		void sink_it_(const spdlog::details::log_msg&) override {}
+		void flush_() override { m_FlushCount.fetch_add(1, std::memory_order_release); }
+
+	private:
+		std::atomic<uint64_t> m_FlushCount = 0;
+	};
+
+	// First sink of the direct logger, writes everything queued before it so errors stay in order with earlier messages
+	class QueueDrainSink : public spdlog::sinks::base_sink<spdlog::details::null_mutex>
+	{
+	protected:
+		void sink_it_(const spdlog::details::log_msg&) override { Log::Flush(); }
+		void flush_() override {}
+	};
+
+	// A flush queued with DropOldest can itself be dropped, so waiting for it gives up eventually
+	static constexpr std::chrono::seconds FlushTimeout(1);
+
 	std::shared_ptr<spdlog::logger> Log::s_Logger;
+	std::shared_ptr<spdlog::logger> Log::s_DirectLogger;
+	static std::shared_ptr<spdlog::details::thread_pool> s_ThreadPool;
+	static std::shared_ptr<FlushSignalSink> s_FlushSignal;
 
-	void Log::Init()
+	void Log::Init(const LogSettings& settings)
 	{
 		std::vector<spdlog::sink_ptr> logSinks;
 		logSinks.emplace_back(std::make_shared<spdlog::sinks::stdout_color_sink_mt>());
@@ -17,8 +51,62 @@ namespace VulkanTestbed
 		logSinks[0]->set_pattern("%^[%T] %n: %v%$");
 		logSinks[1]->set_pattern("[%T] [%l] %n: %v");
 
-		s_Logger = std::make_shared<spdlog::logger>("ARC_ENGINE", begin(logSinks), end(logSinks));
+		if (settings.Async)
+		{
+			s_FlushSignal = std::make_shared<FlushSignalSink>();
+			logSinks.push_back(s_FlushSignal);
+
+			s_ThreadPool = std::make_shared<spdlog::details::thread_pool>(settings.QueueSize, 1);
+			const spdlog::async_overflow_policy overflow = settings.Overflow == LogOverflow::Block ? spdlog::async_overflow_policy::block : spdlog::async_overflow_policy::overrun_oldest;
+			s_Logger = std::make_shared<spdlog::async_logger>("ARC_ENGINE", begin(logSinks), end(logSinks), s_ThreadPool, overflow);
+
+			if (settings.Overflow == LogOverflow::DropOldest)
+			{
+				// Shares the console and file sinks, which lock, with the logging thread
+				std::vector<spdlog::sink_ptr> directSinks = { std::make_shared<QueueDrainSink>(), logSinks[0], logSinks[1] };
+				s_DirectLogger = std::make_shared<spdlog::logger>("ARC_ENGINE", begin(directSinks), end(directSinks));
+				s_DirectLogger->set_level((spdlog::level::level_enum)TESTBED_LOG_LEVEL);
+				s_DirectLogger->flush_on(spdlog::level::err);
+			}
+		}
+		else
+		{
+			s_Logger = std::make_shared<spdlog::logger>("ARC_ENGINE", begin(logSinks), end(logSinks));
+		}
 		spdlog::register_logger(s_Logger);
-		s_Logger->set_level(spdlog::level::trace);
+		s_Logger->set_level((spdlog::level::level_enum)TESTBED_LOG_LEVEL);
+		// Errors reach the file even when the process dies before Shutdown
+		s_Logger->flush_on(spdlog::level::err);
+	}
+
+	void Log::Shutdown()
+	{
+		if (!s_Logger)
+			return;
+
+		if (s_ThreadPool && s_ThreadPool->overrun_counter() > 0)
+			LOG_WARN("Log: {} messages were dropped because the queue was full", s_ThreadPool->overrun_counter());
+
+		// Destroying the pool writes whatever is still queued before its thread exits
+		spdlog::drop(s_Logger->name());
+		s_Logger.reset();
+		s_DirectLogger.reset();
+		s_ThreadPool.reset();
+		s_FlushSignal.reset();
+	}
+
+	void Log::Flush()
+	{
+		if (!s_FlushSignal)
+		{
+			s_Logger->flush();
+			return;
+		}
+
+		const uint64_t flushCount = s_FlushSignal->GetFlushCount();
+		s_Logger->flush();
+		const auto deadline = std::chrono::steady_clock::now() + FlushTimeout;
+		while (s_FlushSignal->GetFlushCount() == flushCount && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::yield();
 	}
 }
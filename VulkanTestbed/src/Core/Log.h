@@ -7,23 +7,92 @@
 #include <spdlog/fmt/bundled/format.h>
 #pragma warning(pop)
 
+// Messages below this level are compiled out together with their arguments. Defaults to everything in Debug,
+// debug and up in Release and info and up in Dist, define it to override.
+#ifndef TESTBED_LOG_LEVEL
+	#if defined(TESTBED_DEBUG)
+		#define TESTBED_LOG_LEVEL SPDLOG_LEVEL_TRACE
+	#elif defined(TESTBED_RELEASE)
+		#define TESTBED_LOG_LEVEL SPDLOG_LEVEL_DEBUG
+	#else
+		#define TESTBED_LOG_LEVEL SPDLOG_LEVEL_INFO
+	#endif
+#endif
+
 namespace VulkanTestbed
 {
+	enum class LogOverflow : uint8_t
+	{
+		// Callers wait for the logging thread to make room
+		Block = 0,
+		// The oldest queued message is dropped, logging never waits
+		DropOldest
+	};
+
+	struct LogSettings
+	{
+		// Callers only format the message and queue it, the pattern and the console and file I/O run on a logging
+		// thread. Synchronous logging writes before the call returns.
+		bool Async = true;
+		// Messages queued for the logging thread before Overflow applies
+		uint32_t QueueSize = 8192;
+		// Errors and above never go through the queue with DropOldest, they are written before the call returns
+		LogOverflow Overflow = LogOverflow::DropOldest;
+	};
+
 	class Log
 	{
 	public:
-		static void Init();
+		static void Init(const LogSettings& settings = {});
+		// Writes everything still queued, logging isn't possible afterwards
+		static void Shutdown();
+		// Returns once everything logged so far is written, used before breaking into the debugger
+		static void Flush();
 
 		static std::shared_ptr<spdlog::logger>& GetCoreLogger() { return s_Logger; }
+		// The logger a message of this level goes to, errors skip a queue that may drop them
+		static std::shared_ptr<spdlog::logger>& GetLogger(spdlog::level::level_enum level) { return level >= spdlog::level::err && s_DirectLogger ? s_DirectLogger : s_Logger; }
 
 	private:
 		static std::shared_ptr<spdlog::logger> s_Logger;
+		static std::shared_ptr<spdlog::logger> s_DirectLogger;
 	};
 }
 
-#define LOG_TRACE(...)		::VulkanTestbed::Log::GetCoreLogger()->trace(__VA_ARGS__)
-#define LOG_INFO(...)		::VulkanTestbed::Log::GetCoreLogger()->info(__VA_ARGS__)
-#define LOG_DEBUG(...)		::VulkanTestbed::Log::GetCoreLogger()->debug(__VA_ARGS__)
-#define LOG_WARN(...)		::VulkanTestbed::Log::GetCoreLogger()->warn(__VA_ARGS__)
-#define LOG_ERROR(...)		::VulkanTestbed::Log::GetCoreLogger()->error(__VA_ARGS__)
-#define LOG_CRITICAL(...)	::VulkanTestbed::Log::GetCoreLogger()->critical(__VA_ARGS__)
+// The runtime level is checked before any argument is evaluated
+#define TESTBED_LOG(level, ...) \
+	do { \
+		if (::VulkanTestbed::Log::GetCoreLogger()->should_log(level)) \
+			::VulkanTestbed::Log::GetLogger(level)->log(level, __VA_ARGS__); \
+	} while (false)
+
+#if TESTBED_LOG_LEVEL <= SPDLOG_LEVEL_TRACE
+	#define LOG_TRACE(...)		TESTBED_LOG(spdlog::level::trace, __VA_ARGS__)
+#else
+	#define LOG_TRACE(...)		(void)0
+#endif
+#if TESTBED_LOG_LEVEL <= SPDLOG_LEVEL_DEBUG
+	#define LOG_DEBUG(...)		TESTBED_LOG(spdlog::level::debug, __VA_ARGS__)
+#else
+	#define LOG_DEBUG(...)		(void)0
+#endif
+#if TESTBED_LOG_LEVEL <= SPDLOG_LEVEL_INFO
+	#define LOG_INFO(...)		TESTBED_LOG(spdlog::level::info, __VA_ARGS__)
+#else
+	#define LOG_INFO(...)		(void)0
+#endif
+#if TESTBED_LOG_LEVEL <= SPDLOG_LEVEL_WARN
+	#define LOG_WARN(...)		TESTBED_LOG(spdlog::level::warn, __VA_ARGS__)
+#else
+	#define LOG_WARN(...)		(void)0
+#endif
+#if TESTBED_LOG_LEVEL <= SPDLOG_LEVEL_ERROR
+	#define LOG_ERROR(...)		TESTBED_LOG(spdlog::level::err, __VA_ARGS__)
+#else
+	#define LOG_ERROR(...)		(void)0
+#endif
+#if TESTBED_LOG_LEVEL <= SPDLOG_LEVEL_CRITICAL
+	#define LOG_CRITICAL(...)	TESTBED_LOG(spdlog::level::critical, __VA_ARGS__)
+#else
+	#define LOG_CRITICAL(...)	(void)0
+#endif
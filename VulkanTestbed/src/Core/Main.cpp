@@ -1,9 +1,77 @@
 #include "pch.h"
 
 #include "Application.h"
+#include "Benchmark/Benchmark.h"
 
-void main()
+int main(int argc, char** argv)
 {
-	VulkanTestbed::Application app;
-	app.Run();
+	VulkanTestbed::ApplicationSpecification spec;
+	for (int i = 1; i < argc; ++i)
+	{
+		// No window, benchmarks that need a device create a headless one
+		if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+		{
+			VulkanTestbed::Log::Init();
+			const bool found = VulkanTestbed::Benchmark::Run(argv[i + 1]);
+			VulkanTestbed::Log::Shutdown();
+			return found ? 0 : 1;
+		}
+		else if (strcmp(argv[i], "--headless") == 0)
+			spec.Headless = true;
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			spec.BenchmarkFrames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+			spec.FramesInFlight = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+			spec.ModelPath = argv[++i];
+		else if (strcmp(argv[i], "--textures") == 0 && i + 1 < argc)
+			spec.TextureDirectory = argv[++i];
+		else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+			spec.CacheDirectory = argv[++i];
+		else if (strcmp(argv[i], "--no-transfer-queue") == 0)
+			spec.DedicatedTransferQueue = false;
+		else if (strcmp(argv[i], "--bindless") == 0)
+			spec.Bindless = true;
+		else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+			spec.ProfilePath = argv[++i];
+		else if (strcmp(argv[i], "--sync-log") == 0)
+			spec.AsyncLogging = false;
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+			spec.CaptureDirectory = argv[++i];
+		else if (strcmp(argv[i], "--capture-frames") == 0 && i + 1 < argc)
+		{
+			// Comma separated frame numbers
+			for (char* next = argv[++i]; *next;)
+			{
+				spec.CaptureFrames.push_back((uint32_t)std::strtoul(next, &next, 10));
+				if (*next == ',')
+					++next;
+				else
+					break;
+			}
+		}
+		else if (strcmp(argv[i], "--exr") == 0)
+			spec.CaptureFormat = VulkanTestbed::ImageFileFormat::EXR;
+		else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+			spec.GoldenDirectory = argv[++i];
+		else if (strcmp(argv[i], "--update-golden") == 0)
+			spec.UpdateGoldens = true;
+		else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+			spec.GoldenTolerance = (uint8_t)std::min(std::strtoul(argv[++i], nullptr, 10), 255ul);
+		else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+			spec.SceneName = argv[++i];
+	}
+
+	// Without a window there is nothing to close, so a headless run always has a frame budget
+	if (spec.Headless && spec.BenchmarkFrames == 0)
+		spec.BenchmarkFrames = 1000;
+
+	bool passed;
+	{
+		VulkanTestbed::Application app(spec);
+		passed = app.Run();
+	}
+	VulkanTestbed::Log::Shutdown();
+	// CI fails the scene when a capture doesn't match its golden image
+	return passed ? 0 : 1;
 }
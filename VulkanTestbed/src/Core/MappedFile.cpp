@@ -0,0 +1,120 @@
+#include "pch.h"
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VulkanTestbed
+{
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+			std::swap(m_Data, other.m_Data);
+			std::swap(m_Size, other.m_Size);
+#ifdef _WIN32
+			std::swap(m_FileHandle, other.m_FileHandle);
+			std::swap(m_MappingHandle, other.m_MappingHandle);
+#endif
+		}
+
+		return *this;
+	}
+
+	bool MappedFile::Open(const std::filesystem::path& path)
+	{
+		Close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!data)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		m_FileHandle = file;
+		m_MappingHandle = mapping;
+		m_Data = (const uint8_t*)data;
+		m_Size = (size_t)size.QuadPart;
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+		{
+			close(fd);
+			return false;
+		}
+
+		void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		// The mapping keeps its own reference to the file
+		close(fd);
+		if (data == MAP_FAILED)
+			return false;
+
+		madvise(data, (size_t)st.st_size, MADV_WILLNEED);
+		m_Data = (const uint8_t*)data;
+		m_Size = (size_t)st.st_size;
+#endif
+
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (!m_Data)
+			return;
+
+#ifdef _WIN32
+		UnmapViewOfFile(m_Data);
+		CloseHandle((HANDLE)m_MappingHandle);
+		CloseHandle((HANDLE)m_FileHandle);
+		m_FileHandle = nullptr;
+		m_MappingHandle = nullptr;
+#else
+		munmap((void*)m_Data, m_Size);
+#endif
+
+		m_Data = nullptr;
+		m_Size = 0;
+	}
+}
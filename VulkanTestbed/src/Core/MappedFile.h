@@ -0,0 +1,35 @@
+#pragma once
+
+#include <filesystem>
+
+namespace VulkanTestbed
+{
+	// Read-only memory mapping of a whole file
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		bool Open(const std::filesystem::path& path);
+		void Close();
+
+		bool IsOpen() const { return m_Data != nullptr; }
+		const uint8_t* GetData() const { return m_Data; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		const uint8_t* m_Data = nullptr;
+		size_t m_Size = 0;
+
+#ifdef _WIN32
+		void* m_FileHandle = nullptr;
+		void* m_MappingHandle = nullptr;
+#endif
+	};
+}
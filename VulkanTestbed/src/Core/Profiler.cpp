@@ -0,0 +1,237 @@
+#include "pch.h"
+#include "Profiler.h"
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <unordered_set>
+
+#include "Core/JobSystem.h"
+
+namespace VulkanTestbed
+{
+	struct ProfileEvent
+	{
+		uint64_t Begin;
+		uint64_t End;
+		const char* Name;
+	};
+
+	struct ProfileRing
+	{
+		std::unique_ptr<ProfileEvent[]> Events;
+		uint32_t Mask = 0;
+		// Only the owning thread writes, the event is stored before the count is published
+		std::atomic<uint64_t> WriteCount = 0;
+		uint32_t TrackID = 0;
+		std::string Name;
+		// GPU zones are already in steady_clock nanoseconds
+		bool Nanoseconds = false;
+	};
+
+	static constexpr uint32_t GpuTrackID = 1000;
+
+	static std::mutex s_RingMutex;
+	static std::vector<std::unique_ptr<ProfileRing>> s_Rings;
+	static ProfileRing* s_GpuRing = nullptr;
+	static uint32_t s_RingCapacity = 0;
+
+	// Bumped by every Init so rings cached by threads from an earlier run are never used, 0 while shut down
+	static std::atomic<uint32_t> s_Generation = 0;
+	static uint32_t s_LastGeneration = 0;
+
+	static uint64_t s_InitTicks = 0;
+	static int64_t s_InitNanoseconds = 0;
+
+	static thread_local ProfileRing* t_Ring = nullptr;
+	static thread_local uint32_t t_Generation = 0;
+
+	static std::unique_ptr<ProfileRing> CreateRing(uint32_t trackID, std::string name)
+	{
+		auto ring = std::make_unique<ProfileRing>();
+		ring->Events = std::make_unique<ProfileEvent[]>(s_RingCapacity);
+		ring->Mask = s_RingCapacity - 1;
+		ring->TrackID = trackID;
+		ring->Name = std::move(name);
+		return ring;
+	}
+
+	static ProfileRing* RegisterThread()
+	{
+		const uint32_t generation = s_Generation.load(std::memory_order_acquire);
+		if (generation == 0)
+			return nullptr;
+
+		std::string name;
+		const uint32_t threadIndex = JobSystem::GetThreadIndex();
+		if (threadIndex == 0)
+			name = "Main";
+		else if (threadIndex != JobSystem::InvalidThreadIndex)
+			name = fmt::format("Worker {}", threadIndex);
+
+		std::lock_guard lock(s_RingMutex);
+		const uint32_t trackID = (uint32_t)s_Rings.size();
+		s_Rings.push_back(CreateRing(trackID, name.empty() ? fmt::format("Thread {}", trackID) : std::move(name)));
+		t_Ring = s_Rings.back().get();
+		t_Generation = generation;
+		return t_Ring;
+	}
+
+	static void Push(ProfileRing& ring, const char* name, uint64_t begin, uint64_t end)
+	{
+		const uint64_t index = ring.WriteCount.load(std::memory_order_relaxed);
+		ring.Events[index & ring.Mask] = { begin, end, name };
+		ring.WriteCount.store(index + 1, std::memory_order_release);
+	}
+
+	void Profiler::Init(const ProfilerSettings& settings)
+	{
+		TESTBED_ASSERT(s_Generation == 0, "Profiler already initialized!");
+
+		s_RingCapacity = 1;
+		while (s_RingCapacity < settings.EventsPerThread)
+			s_RingCapacity <<= 1;
+
+		s_InitNanoseconds = NowNanoseconds();
+		s_InitTicks = Now();
+
+		s_GpuRing = nullptr;
+		{
+			std::lock_guard lock(s_RingMutex);
+			s_Rings.push_back(CreateRing(GpuTrackID, "GPU"));
+			s_GpuRing = s_Rings.back().get();
+			s_GpuRing->Nanoseconds = true;
+		}
+
+		s_Generation = ++s_LastGeneration;
+	}
+
+	void Profiler::Shutdown()
+	{
+		// Every thread has to be done recording, the rings are freed
+		s_Generation = 0;
+		std::lock_guard lock(s_RingMutex);
+		s_Rings.clear();
+		s_GpuRing = nullptr;
+	}
+
+	bool Profiler::IsInitialized()
+	{
+		return s_Generation.load(std::memory_order_relaxed) != 0;
+	}
+
+	void Profiler::RecordZone(const char* name, uint64_t begin, uint64_t end)
+	{
+		const uint32_t generation = s_Generation.load(std::memory_order_relaxed);
+		if (generation == 0)
+			return;
+
+		ProfileRing* ring = t_Ring;
+		if (t_Generation != generation)
+		{
+			ring = RegisterThread();
+			if (!ring)
+				return;
+		}
+		Push(*ring, name, begin, end);
+	}
+
+	const char* Profiler::InternName(std::string_view name)
+	{
+		// Node based, so the strings never move, and never freed since zones recorded with them may still be exported
+		static std::mutex mutex;
+		static std::unordered_set<std::string> names;
+		std::lock_guard lock(mutex);
+		return names.emplace(name).first->c_str();
+	}
+
+	void Profiler::RecordGpuZone(const char* name, int64_t beginNanoseconds, int64_t endNanoseconds)
+	{
+		if (s_GpuRing)
+			Push(*s_GpuRing, name, (uint64_t)beginNanoseconds, (uint64_t)endNanoseconds);
+	}
+
+	static void AppendEscaped(std::string& out, const char* text)
+	{
+		for (; *text; ++text)
+		{
+			const char c = *text;
+			if (c == '"' || c == '\\')
+			{
+				out += '\\';
+				out += c;
+			}
+			else if ((unsigned char)c < 0x20)
+				out += fmt::format("\\u{:04x}", (unsigned)c);
+			else
+				out += c;
+		}
+	}
+
+	bool Profiler::WriteChromeTrace(const std::filesystem::path& path)
+	{
+		if (!IsInitialized())
+			return false;
+
+		// The tick rate is measured over everything since Init, which is plenty to pin down the TSC frequency
+		const double ticksPerNanosecond = (double)(Now() - s_InitTicks) / (double)std::max<int64_t>(NowNanoseconds() - s_InitNanoseconds, 1);
+		const auto toMicroseconds = [&](const ProfileRing& ring, uint64_t time)
+		{
+			if (ring.Nanoseconds)
+				return (double)((int64_t)time - s_InitNanoseconds) / 1000.0;
+			return (double)(int64_t)(time - s_InitTicks) / ticksPerNanosecond / 1000.0;
+		};
+
+		std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		uint64_t eventCount = 0;
+		std::vector<ProfileEvent> events;
+
+		std::lock_guard lock(s_RingMutex);
+		for (const std::unique_ptr<ProfileRing>& ring : s_Rings)
+		{
+			json += fmt::format("{{\"ph\":\"M\",\"pid\":1,\"tid\":{},\"name\":\"thread_name\",\"args\":{{\"name\":\"", ring->TrackID);
+			AppendEscaped(json, ring->Name.c_str());
+			json += fmt::format("\"}}}},\n{{\"ph\":\"M\",\"pid\":1,\"tid\":{0},\"name\":\"thread_sort_index\",\"args\":{{\"sort_index\":{0}}}}},\n", ring->TrackID);
+
+			// Copied while the owner may still write, whatever it overwrote during the copy is dropped
+			const uint64_t capacity = ring->Mask + 1;
+			const uint64_t writeCount = ring->WriteCount.load(std::memory_order_acquire);
+			const uint64_t first = writeCount > capacity ? writeCount - capacity : 0;
+			events.resize(writeCount - first);
+			for (uint64_t i = first; i < writeCount; ++i)
+				events[i - first] = ring->Events[i & ring->Mask];
+			const uint64_t laterCount = ring->WriteCount.load(std::memory_order_acquire);
+			const uint64_t valid = laterCount > capacity ? laterCount - capacity : 0;
+
+			for (uint64_t i = std::max(first, valid); i < writeCount; ++i)
+			{
+				const ProfileEvent& event = events[i - first];
+				const double begin = toMicroseconds(*ring, event.Begin);
+				json += fmt::format("{{\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},\"name\":\"", ring->TrackID, begin, std::max(toMicroseconds(*ring, event.End) - begin, 0.0));
+				AppendEscaped(json, event.Name);
+				json += "\"},\n";
+				++eventCount;
+			}
+		}
+		// Every event above ends in a comma, so the list closes with one more that needs none
+		json += "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"VulkanTestbed\"}}\n]}\n";
+
+		const std::filesystem::path tempPath = std::filesystem::path(path).concat(".tmp");
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write(json.data(), (std::streamsize)json.size());
+		file.close();
+		if (!file)
+			return false;
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, path, error);
+		if (error)
+			return false;
+
+		LOG_INFO("Profiler: wrote {} zones to {}", eventCount, path.string());
+		return true;
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string_view>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
+	#define TESTBED_PROFILER_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+	#define TESTBED_PROFILER_RDTSC
+#endif
+
+// Zones compile to nothing in Dist builds
+#ifndef TESTBED_DIST
+	#define TESTBED_PROFILE
+#endif
+
+namespace VulkanTestbed
+{
+	struct ProfilerSettings
+	{
+		// Per thread, rounded up to a power of two. Older zones are overwritten once a thread has recorded this many.
+		uint32_t EventsPerThread = 1u << 16;
+	};
+
+	// Records finished zones into one ring per thread. A thread only ever writes its own ring, so recording takes
+	// no locks and costs two timestamp reads and a store. Exporting reads the rings while they are written and drops
+	// whatever was overwritten in the meantime.
+	class Profiler
+	{
+	public:
+		static void Init(const ProfilerSettings& settings = {});
+		static void Shutdown();
+		static bool IsInitialized();
+
+		// Raw CPU timestamp, the TSC where there is one
+		static uint64_t Now()
+		{
+#ifdef TESTBED_PROFILER_RDTSC
+			return __rdtsc();
+#else
+			return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+		}
+		// std::chrono::steady_clock time, the timebase GPU zones have to be converted to
+		static int64_t NowNanoseconds() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+		// Name has to outlive the profiler, string literals do
+		static void RecordZone(const char* name, uint64_t begin, uint64_t end);
+		// Stable copy for names that aren't literals, takes a lock so look it up once rather than per zone
+		static const char* InternName(std::string_view name);
+		// Main thread only, times in NowNanoseconds() time
+		static void RecordGpuZone(const char* name, int64_t beginNanoseconds, int64_t endNanoseconds);
+
+		// Everything still in the rings as Chrome trace JSON, opens in chrome://tracing and ui.perfetto.dev
+		static bool WriteChromeTrace(const std::filesystem::path& path);
+	};
+
+	class ProfileScope
+	{
+	public:
+		// Without a running profiler the zone reads no timestamps and records nothing
+		explicit ProfileScope(const char* name)
+			: m_Name(Profiler::IsInitialized() ? name : nullptr), m_Begin(m_Name ? Profiler::Now() : 0) {}
+		~ProfileScope()
+		{
+			if (m_Name)
+				Profiler::RecordZone(m_Name, m_Begin, Profiler::Now());
+		}
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+	private:
+		const char* m_Name;
+		uint64_t m_Begin;
+	};
+}
+
+#define TESTBED_PROFILE_CONCAT_IMPL(a, b) a##b
+#define TESTBED_PROFILE_CONCAT(a, b) TESTBED_PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef TESTBED_PROFILE
+	#define TESTBED_PROFILE_SCOPE(name) ::VulkanTestbed::ProfileScope TESTBED_PROFILE_CONCAT(profileScope, __LINE__)(name)
+	#define TESTBED_PROFILE_FUNCTION() TESTBED_PROFILE_SCOPE(__func__)
+#else
+	#define TESTBED_PROFILE_SCOPE(name)
+	#define TESTBED_PROFILE_FUNCTION()
+#endif
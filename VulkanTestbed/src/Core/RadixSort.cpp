@@ -0,0 +1,118 @@
+#include "pch.h"
+#include "RadixSort.h"
+
+#include <cstring>
+
+#include "JobSystem.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t DigitBits = 8;
+	static constexpr uint32_t BucketCount = 1u << DigitBits;
+	static constexpr uint32_t PassCount = 64 / DigitBits;
+	// Below this the job overhead costs more than the threads save
+	static constexpr uint32_t ParallelThreshold = 1u << 15;
+	static constexpr uint32_t MinBlockSize = 1u << 14;
+
+	using Histogram = std::array<uint32_t, BucketCount>;
+
+	void RadixSort(uint64_t* keys, uint32_t* values, uint64_t* scratchKeys, uint32_t* scratchValues, uint32_t count)
+	{
+		if (count < 2)
+			return;
+
+		uint32_t blockCount = 1;
+		if (count >= ParallelThreshold && JobSystem::GetThreadCount() > 1)
+			blockCount = std::clamp(count / MinBlockSize, 1u, JobSystem::GetThreadCount() * 2);
+		const uint32_t blockSize = (count + blockCount - 1) / blockCount;
+
+		// Bits that differ between any two keys, every pass without one of them is a no-op
+		std::vector<std::pair<uint64_t, uint64_t>> blockBits(blockCount);
+		ParallelForRange(blockCount, 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t block = begin; block < end; ++block)
+			{
+				uint64_t anyBits = 0, allBits = ~0ull;
+				const uint32_t last = std::min(count, (block + 1) * blockSize);
+				for (uint32_t i = block * blockSize; i < last; ++i)
+				{
+					anyBits |= keys[i];
+					allBits &= keys[i];
+				}
+				blockBits[block] = { anyBits, allBits };
+			}
+		});
+		uint64_t anyBits = 0, allBits = ~0ull;
+		for (const auto& [blockAny, blockAll] : blockBits)
+		{
+			anyBits |= blockAny;
+			allBits &= blockAll;
+		}
+		const uint64_t differingBits = anyBits ^ allBits;
+
+		std::vector<Histogram> histograms(blockCount);
+		uint64_t* srcKeys = keys;
+		uint32_t* srcValues = values;
+		uint64_t* dstKeys = scratchKeys;
+		uint32_t* dstValues = scratchValues;
+		for (uint32_t pass = 0; pass < PassCount; ++pass)
+		{
+			const uint32_t shift = pass * DigitBits;
+			if (((differingBits >> shift) & (BucketCount - 1)) == 0)
+				continue;
+
+			ParallelForRange(blockCount, 1, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t block = begin; block < end; ++block)
+				{
+					Histogram& histogram = histograms[block];
+					histogram.fill(0);
+					const uint32_t last = std::min(count, (block + 1) * blockSize);
+					for (uint32_t i = block * blockSize; i < last; ++i)
+						++histogram[(srcKeys[i] >> shift) & (BucketCount - 1)];
+				}
+			});
+
+			// Offsets in bucket major, block minor order keep equal keys in input order
+			uint32_t offset = 0;
+			for (uint32_t bucket = 0; bucket < BucketCount; ++bucket)
+			{
+				for (Histogram& histogram : histograms)
+				{
+					const uint32_t bucketCount = histogram[bucket];
+					histogram[bucket] = offset;
+					offset += bucketCount;
+				}
+			}
+
+			ParallelForRange(blockCount, 1, [&](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t block = begin; block < end; ++block)
+				{
+					Histogram& offsets = histograms[block];
+					const uint32_t last = std::min(count, (block + 1) * blockSize);
+					for (uint32_t i = block * blockSize; i < last; ++i)
+					{
+						const uint32_t destination = offsets[(srcKeys[i] >> shift) & (BucketCount - 1)]++;
+						dstKeys[destination] = srcKeys[i];
+						dstValues[destination] = srcValues[i];
+					}
+				}
+			});
+
+			std::swap(srcKeys, dstKeys);
+			std::swap(srcValues, dstValues);
+		}
+
+		if (srcKeys == keys)
+			return;
+
+		ParallelForRange(blockCount, 1, [&](uint32_t begin, uint32_t end)
+		{
+			const uint32_t first = begin * blockSize;
+			const uint32_t last = std::min(count, end * blockSize);
+			std::memcpy(keys + first, srcKeys + first, (last - first) * sizeof(uint64_t));
+			std::memcpy(values + first, srcValues + first, (last - first) * sizeof(uint32_t));
+		});
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace VulkanTestbed
+{
+	// Stable LSD radix sort of 64-bit keys with a 32-bit value moved alongside each, one 8-bit digit per pass.
+	// Digits all keys share can't change the order, so their passes are skipped, which makes sparsely packed keys
+	// cheap. Large inputs are split into blocks that are histogrammed and scattered on the job threads, every block
+	// writes a range of each bucket of its own so the result doesn't depend on the thread count.
+	// The scratch arrays need room for count elements, the sorted result always ends up in keys and values.
+	void RadixSort(uint64_t* keys, uint32_t* values, uint64_t* scratchKeys, uint32_t* scratchValues, uint32_t count);
+}
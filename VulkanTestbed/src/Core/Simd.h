@@ -0,0 +1,14 @@
+#pragma once
+
+// SSE2 is part of x86-64, so it is the baseline every SIMD path in the testbed targets. Other
+// architectures compile the scalar fallbacks.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define TESTBED_SSE2
+	#include <emmintrin.h>
+#endif
+
+// Only when the compiler targets it (premake --avx2), there is no runtime dispatch
+#if defined(__AVX2__)
+	#define TESTBED_AVX2
+	#include <immintrin.h>
+#endif
@@ -0,0 +1,113 @@
+#include "pch.h"
+#include "TaskGraph.h"
+
+#include "Core/Profiler.h"
+
+namespace VulkanTestbed
+{
+	TaskID TaskGraph::AddTask(std::string name, std::function<void()> function, std::initializer_list<TaskID> dependencies)
+	{
+		TESTBED_ASSERT(!m_Started, "Tasks can't be added to a running graph!");
+
+		const TaskID id = (TaskID)m_Tasks.size();
+		Task& task = m_Tasks.emplace_back();
+		task.Name = std::move(name);
+		task.Function = std::move(function);
+		task.RemainingDependencies = (uint32_t)dependencies.size();
+
+		for (TaskID dependency : dependencies)
+		{
+			TESTBED_ASSERT(dependency < id, "Unknown task dependency!");
+			m_Tasks[dependency].Dependents.push_back(id);
+		}
+		return id;
+	}
+
+	TaskID TaskGraph::AddInlineTask(std::string name)
+	{
+		const TaskID id = AddTask(std::move(name), nullptr);
+		m_Tasks[id].Inline = true;
+		// Inline tasks count as pending until they ran
+		m_Counter.Pending.fetch_add(1, std::memory_order_relaxed);
+		return id;
+	}
+
+	void TaskGraph::Start()
+	{
+		TESTBED_ASSERT(!m_Started, "The graph is already running!");
+		m_Started = true;
+
+		// Launching a task can finish it before the loop moves on, so find the roots first
+		std::vector<TaskID> roots;
+		for (TaskID id = 0; id < (TaskID)m_Tasks.size(); ++id)
+		{
+			if (!m_Tasks[id].Inline && m_Tasks[id].RemainingDependencies.load() == 0)
+				roots.push_back(id);
+		}
+
+		for (TaskID id : roots)
+			Launch(id);
+	}
+
+	void TaskGraph::RunInline(TaskID id, const std::function<void()>& function)
+	{
+		TESTBED_ASSERT(m_Started && m_Tasks[id].Inline, "Only inline tasks of a running graph can run inline!");
+
+		Execute(id, function);
+		m_Counter.Pending.fetch_sub(1, std::memory_order_release);
+	}
+
+	void TaskGraph::Wait()
+	{
+		JobSystem::Wait(m_Counter);
+		m_WaitTime = m_Timer.Elapsed();
+	}
+
+	void TaskGraph::Launch(TaskID id)
+	{
+		JobSystem::Run(m_Counter, [this, id]() { Execute(id, m_Tasks[id].Function); });
+	}
+
+	void TaskGraph::Execute(TaskID id, const std::function<void()>& function)
+	{
+		Task& task = m_Tasks[id];
+		task.ThreadIndex = JobSystem::GetThreadIndex();
+
+		task.StartTime = m_Timer.Elapsed();
+		{
+			TESTBED_PROFILE_SCOPE(Profiler::IsInitialized() ? Profiler::InternName(task.Name) : nullptr);
+			function();
+		}
+		task.EndTime = m_Timer.Elapsed();
+
+		// Dependents join the counter before this task leaves it, Wait can't return early
+		for (TaskID dependent : task.Dependents)
+		{
+			if (m_Tasks[dependent].RemainingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				Launch(dependent);
+		}
+	}
+
+	void TaskGraph::LogReport(std::string_view title) const
+	{
+		std::vector<const Task*> tasks;
+		double endTime = 0.0;
+		double busyTime = 0.0;
+		for (const Task& task : m_Tasks)
+		{
+			tasks.push_back(&task);
+			endTime = std::max(endTime, task.EndTime);
+			busyTime += task.EndTime - task.StartTime;
+		}
+		std::sort(tasks.begin(), tasks.end(), [](const Task* a, const Task* b) { return a->StartTime < b->StartTime; });
+
+		LOG_INFO("{}: {:.2f} ms ({:.2f} ms until the last task finished), {:.2f} ms of work on {} threads", title, std::max(endTime, m_WaitTime) * 1000.0,
+			endTime * 1000.0, busyTime * 1000.0, JobSystem::GetThreadCount());
+		LOG_INFO("\t{:<24} | {:>10} | {:>10} | thread", "Phase", "start (ms)", "time (ms)");
+		for (const Task* task : tasks)
+		{
+			const std::string thread = task->ThreadIndex == JobSystem::InvalidThreadIndex ? "-" : std::to_string(task->ThreadIndex);
+			LOG_INFO("\t{:<24} | {:>10.2f} | {:>10.2f} | {}", task->Name, task->StartTime * 1000.0, (task->EndTime - task->StartTime) * 1000.0, thread);
+		}
+	}
+}
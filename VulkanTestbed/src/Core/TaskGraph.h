@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+
+#include "Core/JobSystem.h"
+#include "Core/Timer.h"
+
+namespace VulkanTestbed
+{
+	using TaskID = uint32_t;
+
+	// Named tasks with dependencies, each one starts as a job the moment its last dependency finishes.
+	// Every task is timed so the graph can report where the time went.
+	class TaskGraph
+	{
+	public:
+		// Dependencies have to be added first, tasks can't be added once the graph started
+		TaskID AddTask(std::string name, std::function<void()> function, std::initializer_list<TaskID> dependencies = {});
+		// For work that has to stay on one thread, such as window creation. The graph never schedules it,
+		// the owning thread calls RunInline once the graph started.
+		TaskID AddInlineTask(std::string name);
+
+		// Starts every task without dependencies and returns immediately
+		void Start();
+		// Runs the function on the calling thread as the given inline task, then starts the tasks waiting on it
+		void RunInline(TaskID id, const std::function<void()>& function);
+		// Runs jobs on the calling thread until every task has finished
+		void Wait();
+
+		// Start time, duration and thread of every task, ordered by start time
+		void LogReport(std::string_view title) const;
+
+	private:
+		struct Task
+		{
+			std::string Name;
+			std::function<void()> Function;
+			std::vector<TaskID> Dependents;
+			std::atomic<uint32_t> RemainingDependencies = 0;
+			bool Inline = false;
+
+			// In seconds since the graph was created
+			double StartTime = 0.0;
+			double EndTime = 0.0;
+			uint32_t ThreadIndex = 0;
+		};
+
+		void Launch(TaskID id);
+		void Execute(TaskID id, const std::function<void()>& function);
+
+	private:
+		// Jobs point into it, a deque never moves its elements
+		std::deque<Task> m_Tasks;
+		JobCounter m_Counter;
+		Timer m_Timer;
+		// When Wait returned, the caller can be held up past the last task by whatever else it ran meanwhile
+		double m_WaitTime = 0.0;
+		bool m_Started = false;
+	};
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+
+namespace VulkanTestbed
+{
+	class Timer
+	{
+	public:
+		Timer()
+		{
+			Reset();
+		}
+
+		void Reset()
+		{
+			m_Start = std::chrono::high_resolution_clock::now();
+		}
+
+		double Elapsed() const
+		{
+			return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - m_Start).count();
+		}
+
+		double ElapsedMillis() const
+		{
+			return Elapsed() * 1000.0;
+		}
+
+	private:
+		std::chrono::time_point<std::chrono::high_resolution_clock> m_Start;
+	};
+}
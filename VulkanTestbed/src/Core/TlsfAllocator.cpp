@@ -0,0 +1,257 @@
+#include "pch.h"
+#include "TlsfAllocator.h"
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
+namespace VulkanTestbed
+{
+	// Index of the lowest set bit, value must not be zero
+	static uint32_t FindLowestBit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return (uint32_t)index;
+#else
+		return (uint32_t)__builtin_ctzll(value);
+#endif
+	}
+
+	// Index of the highest set bit, value must not be zero
+	static uint32_t FindHighestBit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return (uint32_t)index;
+#else
+		return 63u - (uint32_t)__builtin_clzll(value);
+#endif
+	}
+
+	static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// The first level splits sizes by powers of two, the second level splits each of those linearly
+	template<uint32_t SecondLevelBits>
+	static void MapSize(uint64_t size, uint32_t& outFirstLevel, uint32_t& outSecondLevel)
+	{
+		outFirstLevel = FindHighestBit(size);
+		outSecondLevel = (uint32_t)(size >> (outFirstLevel - SecondLevelBits)) & ((1u << SecondLevelBits) - 1);
+	}
+
+	TlsfAllocator::TlsfAllocator(uint64_t capacity)
+		: m_Capacity(capacity & ~(MinAlignment - 1))
+	{
+		TESTBED_ASSERT(m_Capacity >= MinAlignment, "TLSF capacity is too small!");
+
+		for (auto& secondLevel : m_FreeLists)
+			secondLevel.fill(InvalidBlock);
+
+		InsertFreeBlock(CreateBlock(0, m_Capacity));
+	}
+
+	TlsfAllocation TlsfAllocator::Allocate(uint64_t size, uint64_t alignment)
+	{
+		TESTBED_ASSERT(alignment != 0 && (alignment & (alignment - 1)) == 0, "Alignment has to be a power of two!");
+
+		size = AlignUp(std::max<uint64_t>(size, 1), MinAlignment);
+		alignment = std::max(alignment, MinAlignment);
+		// Free blocks start at any multiple of MinAlignment, reserve room to align the worst of them
+		const uint64_t searchSize = size + alignment - MinAlignment;
+		if (searchSize > m_Capacity)
+			return {};
+
+		uint32_t index = FindFreeBlock(searchSize);
+		if (index == InvalidBlock)
+			return {};
+		RemoveFreeBlock(index);
+
+		// Free neighbours are always merged, so the split off parts never border another free block
+		const uint64_t padding = AlignUp(m_Blocks[index].Offset, alignment) - m_Blocks[index].Offset;
+		if (padding > 0)
+		{
+			const uint32_t front = CreateBlock(m_Blocks[index].Offset, padding);
+			Block& block = m_Blocks[index];
+			m_Blocks[front].PrevPhysical = block.PrevPhysical;
+			m_Blocks[front].NextPhysical = index;
+			if (block.PrevPhysical != InvalidBlock)
+				m_Blocks[block.PrevPhysical].NextPhysical = front;
+			block.PrevPhysical = front;
+			block.Offset += padding;
+			block.Size -= padding;
+			InsertFreeBlock(front);
+		}
+
+		if (m_Blocks[index].Size - size >= MinAlignment)
+		{
+			const uint32_t back = CreateBlock(m_Blocks[index].Offset + size, m_Blocks[index].Size - size);
+			Block& block = m_Blocks[index];
+			m_Blocks[back].PrevPhysical = index;
+			m_Blocks[back].NextPhysical = block.NextPhysical;
+			if (block.NextPhysical != InvalidBlock)
+				m_Blocks[block.NextPhysical].PrevPhysical = back;
+			block.NextPhysical = back;
+			block.Size = size;
+			InsertFreeBlock(back);
+		}
+
+		Block& block = m_Blocks[index];
+		m_UsedSize += block.Size;
+		++m_AllocationCount;
+		return { block.Offset, block.Size, index };
+	}
+
+	void TlsfAllocator::Free(const TlsfAllocation& allocation)
+	{
+		TESTBED_ASSERT(allocation.IsValid() && !m_Blocks[allocation.Block].Free, "Invalid TLSF free!");
+
+		uint32_t index = allocation.Block;
+		m_UsedSize -= m_Blocks[index].Size;
+		--m_AllocationCount;
+
+		const uint32_t prev = m_Blocks[index].PrevPhysical;
+		if (prev != InvalidBlock && m_Blocks[prev].Free)
+		{
+			RemoveFreeBlock(prev);
+			m_Blocks[prev].Size += m_Blocks[index].Size;
+			m_Blocks[prev].NextPhysical = m_Blocks[index].NextPhysical;
+			if (m_Blocks[index].NextPhysical != InvalidBlock)
+				m_Blocks[m_Blocks[index].NextPhysical].PrevPhysical = prev;
+			ReleaseBlock(index);
+			index = prev;
+		}
+
+		const uint32_t next = m_Blocks[index].NextPhysical;
+		if (next != InvalidBlock && m_Blocks[next].Free)
+		{
+			RemoveFreeBlock(next);
+			m_Blocks[index].Size += m_Blocks[next].Size;
+			m_Blocks[index].NextPhysical = m_Blocks[next].NextPhysical;
+			if (m_Blocks[next].NextPhysical != InvalidBlock)
+				m_Blocks[m_Blocks[next].NextPhysical].PrevPhysical = index;
+			ReleaseBlock(next);
+		}
+
+		InsertFreeBlock(index);
+	}
+
+	TlsfStatistics TlsfAllocator::GetStatistics() const
+	{
+		TlsfStatistics stats;
+		stats.Capacity = m_Capacity;
+		stats.UsedSize = m_UsedSize;
+		stats.AllocationCount = m_AllocationCount;
+		stats.FreeRangeCount = m_FreeRangeCount;
+
+		// The largest range sits in the highest non-empty size class, only that list needs to be walked
+		if (m_FirstLevelBitmap != 0)
+		{
+			const uint32_t firstLevel = FindHighestBit(m_FirstLevelBitmap);
+			const uint32_t secondLevel = FindHighestBit(m_SecondLevelBitmaps[firstLevel]);
+			for (uint32_t index = m_FreeLists[firstLevel][secondLevel]; index != InvalidBlock; index = m_Blocks[index].NextFree)
+				stats.LargestFreeRange = std::max(stats.LargestFreeRange, m_Blocks[index].Size);
+		}
+		return stats;
+	}
+
+	uint32_t TlsfAllocator::CreateBlock(uint64_t offset, uint64_t size)
+	{
+		uint32_t index;
+		if (!m_UnusedBlocks.empty())
+		{
+			index = m_UnusedBlocks.back();
+			m_UnusedBlocks.pop_back();
+		}
+		else
+		{
+			index = (uint32_t)m_Blocks.size();
+			m_Blocks.emplace_back();
+		}
+
+		m_Blocks[index] = {};
+		m_Blocks[index].Offset = offset;
+		m_Blocks[index].Size = size;
+		return index;
+	}
+
+	void TlsfAllocator::ReleaseBlock(uint32_t index)
+	{
+		m_UnusedBlocks.push_back(index);
+	}
+
+	void TlsfAllocator::InsertFreeBlock(uint32_t index)
+	{
+		uint32_t firstLevel, secondLevel;
+		MapSize<SecondLevelBits>(m_Blocks[index].Size, firstLevel, secondLevel);
+
+		Block& block = m_Blocks[index];
+		block.Free = true;
+		block.PrevFree = InvalidBlock;
+		block.NextFree = m_FreeLists[firstLevel][secondLevel];
+		if (block.NextFree != InvalidBlock)
+			m_Blocks[block.NextFree].PrevFree = index;
+		m_FreeLists[firstLevel][secondLevel] = index;
+
+		m_FirstLevelBitmap |= 1ull << firstLevel;
+		m_SecondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+		++m_FreeRangeCount;
+	}
+
+	void TlsfAllocator::RemoveFreeBlock(uint32_t index)
+	{
+		uint32_t firstLevel, secondLevel;
+		MapSize<SecondLevelBits>(m_Blocks[index].Size, firstLevel, secondLevel);
+
+		Block& block = m_Blocks[index];
+		if (block.PrevFree != InvalidBlock)
+			m_Blocks[block.PrevFree].NextFree = block.NextFree;
+		else
+			m_FreeLists[firstLevel][secondLevel] = block.NextFree;
+		if (block.NextFree != InvalidBlock)
+			m_Blocks[block.NextFree].PrevFree = block.PrevFree;
+		block.Free = false;
+
+		if (m_FreeLists[firstLevel][secondLevel] == InvalidBlock)
+		{
+			m_SecondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+			if (m_SecondLevelBitmaps[firstLevel] == 0)
+				m_FirstLevelBitmap &= ~(1ull << firstLevel);
+		}
+		--m_FreeRangeCount;
+	}
+
+	uint32_t TlsfAllocator::FindFreeBlock(uint64_t size) const
+	{
+		// Round up to the next size class, every block in it is then large enough
+		const uint64_t roundedSize = size + (1ull << (FindHighestBit(size) - SecondLevelBits)) - 1;
+		uint32_t firstLevel, secondLevel;
+		MapSize<SecondLevelBits>(roundedSize, firstLevel, secondLevel);
+
+		uint32_t secondLevelMap = m_SecondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+		if (secondLevelMap == 0)
+		{
+			const uint64_t firstLevelMap = firstLevel + 1 < FirstLevelCount ? m_FirstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+			if (firstLevelMap == 0)
+			{
+				// Nothing in the larger classes, blocks in the class of the size itself may still fit
+				MapSize<SecondLevelBits>(size, firstLevel, secondLevel);
+				for (uint32_t index = m_FreeLists[firstLevel][secondLevel]; index != InvalidBlock; index = m_Blocks[index].NextFree)
+				{
+					if (m_Blocks[index].Size >= size)
+						return index;
+				}
+				return InvalidBlock;
+			}
+
+			firstLevel = FindLowestBit(firstLevelMap);
+			secondLevelMap = m_SecondLevelBitmaps[firstLevel];
+		}
+
+		return m_FreeLists[firstLevel][FindLowestBit(secondLevelMap)];
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+namespace VulkanTestbed
+{
+	struct TlsfAllocation
+	{
+		uint64_t Offset = 0;
+		uint64_t Size = 0;
+		uint32_t Block = ~0u;
+
+		bool IsValid() const { return Block != ~0u; }
+	};
+
+	struct TlsfStatistics
+	{
+		uint64_t Capacity = 0;
+		uint64_t UsedSize = 0;
+		uint64_t LargestFreeRange = 0;
+		uint32_t AllocationCount = 0;
+		uint32_t FreeRangeCount = 0;
+	};
+
+	// Two-level segregated fit (Masmano et al. 2004, "TLSF: a New Dynamic Memory Allocator for Real-Time Systems")
+	// over an abstract range, Allocate and Free are O(1). Only offsets are handed out, the memory behind them
+	// belongs to the caller.
+	class TlsfAllocator
+	{
+	public:
+		// Offsets and sizes are always multiples of this
+		static constexpr uint64_t MinAlignment = 256;
+
+		explicit TlsfAllocator(uint64_t capacity);
+
+		// Alignment has to be a power of two, returns an invalid allocation when no free range fits
+		TlsfAllocation Allocate(uint64_t size, uint64_t alignment = MinAlignment);
+		void Free(const TlsfAllocation& allocation);
+
+		bool IsEmpty() const { return m_AllocationCount == 0; }
+		uint64_t GetCapacity() const { return m_Capacity; }
+		uint64_t GetUsedSize() const { return m_UsedSize; }
+		TlsfStatistics GetStatistics() const;
+
+	private:
+		static constexpr uint32_t SecondLevelBits = 4;
+		static constexpr uint32_t SecondLevelCount = 1u << SecondLevelBits;
+		static constexpr uint32_t FirstLevelCount = 64;
+		static constexpr uint32_t InvalidBlock = ~0u;
+
+		struct Block
+		{
+			uint64_t Offset = 0;
+			uint64_t Size = 0;
+			// Neighbours in address order
+			uint32_t PrevPhysical = InvalidBlock;
+			uint32_t NextPhysical = InvalidBlock;
+			// Neighbours in the free list of its size class, only valid while free
+			uint32_t PrevFree = InvalidBlock;
+			uint32_t NextFree = InvalidBlock;
+			bool Free = false;
+		};
+
+		uint32_t CreateBlock(uint64_t offset, uint64_t size);
+		void ReleaseBlock(uint32_t index);
+		void InsertFreeBlock(uint32_t index);
+		void RemoveFreeBlock(uint32_t index);
+		// Returns a free block of at least size bytes, InvalidBlock when there is none
+		uint32_t FindFreeBlock(uint64_t size) const;
+
+	private:
+		uint64_t m_Capacity = 0;
+		uint64_t m_UsedSize = 0;
+		uint32_t m_AllocationCount = 0;
+		uint32_t m_FreeRangeCount = 0;
+
+		std::vector<Block> m_Blocks;
+		std::vector<uint32_t> m_UnusedBlocks;
+
+		// A set bit means the matching free list is not empty
+		uint64_t m_FirstLevelBitmap = 0;
+		std::array<uint32_t, FirstLevelCount> m_SecondLevelBitmaps = {};
+		std::array<std::array<uint32_t, SecondLevelCount>, FirstLevelCount> m_FreeLists;
+	};
+}
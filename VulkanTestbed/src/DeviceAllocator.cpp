@@ -0,0 +1,216 @@
+#include "pch.h"
+#include "DeviceAllocator.h"
+
+namespace VulkanTestbed
+{
+	struct MemoryBlock
+	{
+		VkDeviceMemory Memory = nullptr;
+		void* MappedData = nullptr;
+		uint32_t MemoryType = 0;
+		uint32_t Pool = 0;
+		TlsfAllocator Allocator;
+
+		MemoryBlock(VkDeviceSize size)
+			: Allocator(size)
+		{
+		}
+	};
+
+	static DeviceAllocation MakeAllocation(MemoryBlock& block, const TlsfAllocation& range)
+	{
+		DeviceAllocation allocation;
+		allocation.Memory = block.Memory;
+		allocation.Offset = range.Offset;
+		allocation.Size = range.Size;
+		allocation.MappedData = block.MappedData ? (uint8_t*)block.MappedData + range.Offset : nullptr;
+		allocation.Block = &block;
+		allocation.Range = range;
+		return allocation;
+	}
+
+	DeviceAllocator::DeviceAllocator(std::unique_ptr<DeviceMemoryBackend> backend, const DeviceAllocatorSettings& settings)
+		: m_Backend(std::move(backend)), m_Settings(settings)
+	{
+		// Ranges are aligned to TlsfAllocator::MinAlignment anyway, below that both kinds can share blocks
+		m_SeparateKinds = m_Backend->GetBufferImageGranularity() > TlsfAllocator::MinAlignment;
+	}
+
+	DeviceAllocator::~DeviceAllocator()
+	{
+		for (auto& pools : m_Blocks)
+		{
+			for (auto& blocks : pools)
+			{
+				for (auto& block : blocks)
+				{
+					if (!block->Allocator.IsEmpty())
+						LOG_WARN("DeviceAllocator: {} allocations leaked in memory type {}", block->Allocator.GetStatistics().AllocationCount, block->MemoryType);
+					m_Backend->Free(block->Memory);
+				}
+				blocks.clear();
+			}
+		}
+
+		if (m_DedicatedCount > 0)
+			LOG_WARN("DeviceAllocator: {} dedicated allocations leaked", m_DedicatedCount);
+	}
+
+	DeviceAllocation DeviceAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, DeviceResourceKind kind, bool dedicated)
+	{
+		return AllocateInternal(requirements, properties, kind, dedicated, nullptr, nullptr);
+	}
+
+	DeviceAllocation DeviceAllocator::AllocateInternal(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, DeviceResourceKind kind,
+		bool dedicated, VkImage dedicatedImage, VkBuffer dedicatedBuffer)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		dedicated |= requirements.size > m_Settings.DedicatedThreshold;
+
+		// Later types with the same properties usually sit in another heap, try them once the first one is full
+		const VkPhysicalDeviceMemoryProperties& memoryProps = m_Backend->GetMemoryProperties();
+		for (uint32_t memoryType = 0; memoryType < memoryProps.memoryTypeCount; ++memoryType)
+		{
+			if (!(requirements.memoryTypeBits & (1u << memoryType)) || (memoryProps.memoryTypes[memoryType].propertyFlags & properties) != properties)
+				continue;
+
+			DeviceAllocation allocation;
+			if (AllocateFromType(memoryType, requirements, kind, dedicated, dedicatedImage, dedicatedBuffer, allocation))
+				return allocation;
+		}
+
+		LOG_ERROR("DeviceAllocator: out of memory for {} bytes with properties {:#x}", requirements.size, properties);
+		return {};
+	}
+
+	bool DeviceAllocator::AllocateFromType(uint32_t memoryType, const VkMemoryRequirements& requirements, DeviceResourceKind kind,
+		bool dedicated, VkImage dedicatedImage, VkBuffer dedicatedBuffer, DeviceAllocation& outAllocation)
+	{
+		const bool hostVisible = m_Backend->GetMemoryProperties().memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+		if (dedicated)
+		{
+			VkDeviceMemory memory = m_Backend->Allocate(memoryType, requirements.size, dedicatedImage, dedicatedBuffer);
+			if (!memory)
+				return false;
+
+			outAllocation.Memory = memory;
+			outAllocation.Offset = 0;
+			outAllocation.Size = requirements.size;
+			outAllocation.MappedData = hostVisible ? m_Backend->Map(memory) : nullptr;
+			++m_DedicatedCount;
+			++m_DeviceAllocationCount;
+			m_DedicatedSize += requirements.size;
+			return true;
+		}
+
+		const uint32_t pool = m_SeparateKinds ? (uint32_t)kind : 0;
+		auto& blocks = m_Blocks[memoryType][pool];
+		for (auto& block : blocks)
+		{
+			TlsfAllocation range = block->Allocator.Allocate(requirements.size, requirements.alignment);
+			if (!range.IsValid())
+				continue;
+
+			outAllocation = MakeAllocation(*block, range);
+			return true;
+		}
+
+		const VkDeviceSize blockSize = GetBlockSize(memoryType);
+		if (requirements.size + requirements.alignment > blockSize)
+			return AllocateFromType(memoryType, requirements, kind, true, dedicatedImage, dedicatedBuffer, outAllocation);
+
+		VkDeviceMemory memory = m_Backend->Allocate(memoryType, blockSize, nullptr, nullptr);
+		if (!memory)
+			return false;
+		++m_DeviceAllocationCount;
+
+		auto& block = blocks.emplace_back(std::make_unique<MemoryBlock>(blockSize));
+		block->Memory = memory;
+		block->MappedData = hostVisible ? m_Backend->Map(memory) : nullptr;
+		block->MemoryType = memoryType;
+		block->Pool = pool;
+
+		TlsfAllocation range = block->Allocator.Allocate(requirements.size, requirements.alignment);
+		TESTBED_ASSERT(range.IsValid());
+		outAllocation = MakeAllocation(*block, range);
+		return true;
+	}
+
+	void DeviceAllocator::Free(DeviceAllocation& allocation)
+	{
+		if (!allocation.Memory)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (!allocation.Block)
+		{
+			m_Backend->Free(allocation.Memory);
+			--m_DedicatedCount;
+			m_DedicatedSize -= allocation.Size;
+			allocation = {};
+			return;
+		}
+
+		MemoryBlock* block = allocation.Block;
+		block->Allocator.Free(allocation.Range);
+		allocation = {};
+
+		// Keep one empty block per pool around, streaming would otherwise allocate and free it over and over
+		auto& blocks = m_Blocks[block->MemoryType][block->Pool];
+		if (block->Allocator.IsEmpty() && blocks.size() > 1)
+		{
+			m_Backend->Free(block->Memory);
+			blocks.erase(std::find_if(blocks.begin(), blocks.end(), [block](const auto& other) { return other.get() == block; }));
+		}
+	}
+
+	VkDeviceSize DeviceAllocator::GetBlockSize(uint32_t memoryType) const
+	{
+		const VkPhysicalDeviceMemoryProperties& memoryProps = m_Backend->GetMemoryProperties();
+		const VkDeviceSize heapSize = memoryProps.memoryHeaps[memoryProps.memoryTypes[memoryType].heapIndex].size;
+		// Small heaps such as the 256MB BAR window would be gone after a handful of blocks
+		if (heapSize <= (1ull << 30))
+			return std::min(m_Settings.BlockSize, std::max<VkDeviceSize>(heapSize / 8, TlsfAllocator::MinAlignment));
+		return m_Settings.BlockSize;
+	}
+
+	DeviceAllocatorStatistics DeviceAllocator::GetStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		DeviceAllocatorStatistics stats;
+		stats.DedicatedCount = m_DedicatedCount;
+		stats.DedicatedSize = m_DedicatedSize;
+		stats.AllocationCount = m_DedicatedCount;
+		stats.DeviceAllocationCount = m_DeviceAllocationCount;
+		for (const auto& pools : m_Blocks)
+		{
+			for (const auto& blocks : pools)
+			{
+				for (const auto& block : blocks)
+				{
+					const TlsfStatistics blockStats = block->Allocator.GetStatistics();
+					++stats.BlockCount;
+					stats.AllocationCount += blockStats.AllocationCount;
+					stats.ReservedSize += blockStats.Capacity;
+					stats.UsedSize += blockStats.UsedSize;
+					stats.FreeSize += blockStats.Capacity - blockStats.UsedSize;
+					stats.LargestFreeRange = std::max(stats.LargestFreeRange, blockStats.LargestFreeRange);
+					stats.FragmentedSize += blockStats.Capacity - blockStats.UsedSize - blockStats.LargestFreeRange;
+				}
+			}
+		}
+		return stats;
+	}
+
+	void DeviceAllocator::LogStatistics() const
+	{
+		const DeviceAllocatorStatistics stats = GetStatistics();
+		const double mb = 1.0 / (1024.0 * 1024.0);
+		LOG_INFO("DeviceAllocator: {} allocations, {:.1f} MB used of {:.1f} MB in {} blocks, fragmentation {:.1f}%",
+			stats.AllocationCount, (double)stats.UsedSize * mb, (double)stats.ReservedSize * mb, stats.BlockCount, stats.GetFragmentation() * 100.0f);
+		LOG_INFO("\tDedicated: {} allocations, {:.1f} MB", stats.DedicatedCount, (double)stats.DedicatedSize * mb);
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+
+#include "Core/TlsfAllocator.h"
+
+namespace VulkanTestbed
+{
+	struct MemoryBlock;
+
+	// Where device memory actually comes from, the Vulkan one is used at runtime. Anything else only has to hand
+	// out unique handles, which lets the suballocation logic run without a GPU.
+	class DeviceMemoryBackend
+	{
+	public:
+		virtual ~DeviceMemoryBackend() = default;
+
+		virtual const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const = 0;
+		virtual VkDeviceSize GetBufferImageGranularity() const = 0;
+
+		// Returns nullptr when the heap is out of memory. The dedicated resources are null unless the memory
+		// only ever backs that one image or buffer.
+		virtual VkDeviceMemory Allocate(uint32_t memoryType, VkDeviceSize size, VkImage dedicatedImage, VkBuffer dedicatedBuffer) = 0;
+		virtual void Free(VkDeviceMemory memory) = 0;
+		virtual void* Map(VkDeviceMemory memory) = 0;
+	};
+
+	std::unique_ptr<DeviceMemoryBackend> CreateVulkanMemoryBackend(VkPhysicalDevice physicalDevice, VkDevice device);
+
+	// Resources with linear and optimal tiling live in separate blocks so bufferImageGranularity never applies
+	// between neighbours
+	enum class DeviceResourceKind : uint8_t
+	{
+		Linear = 0,
+		Optimal
+	};
+
+	struct DeviceAllocation
+	{
+		VkDeviceMemory Memory = nullptr;
+		VkDeviceSize Offset = 0;
+		VkDeviceSize Size = 0;
+		// Only for host visible memory, blocks stay mapped for their whole lifetime
+		void* MappedData = nullptr;
+
+		// Null for dedicated allocations
+		MemoryBlock* Block = nullptr;
+		TlsfAllocation Range;
+	};
+
+	struct DeviceAllocatorSettings
+	{
+		// Size of the VkDeviceMemory blocks, smaller heaps use an eighth of the heap instead
+		VkDeviceSize BlockSize = 64ull << 20;
+		// Larger requests get their own VkDeviceMemory
+		VkDeviceSize DedicatedThreshold = 32ull << 20;
+	};
+
+	struct DeviceAllocatorStatistics
+	{
+		uint32_t BlockCount = 0;
+		uint32_t DedicatedCount = 0;
+		uint32_t AllocationCount = 0;
+		// Backend allocations made so far, dedicated ones included
+		uint32_t DeviceAllocationCount = 0;
+		VkDeviceSize ReservedSize = 0;
+		VkDeviceSize UsedSize = 0;
+		VkDeviceSize DedicatedSize = 0;
+		VkDeviceSize FreeSize = 0;
+		VkDeviceSize LargestFreeRange = 0;
+		// Free space outside the largest free range of its block
+		VkDeviceSize FragmentedSize = 0;
+
+		// Share of the free space in blocks that is scattered between allocations
+		float GetFragmentation() const { return FreeSize > 0 ? (float)FragmentedSize / (float)FreeSize : 0.0f; }
+	};
+
+	// Grabs large VkDeviceMemory blocks per memory type and resource kind and suballocates them with TLSF
+	class DeviceAllocator
+	{
+	public:
+		DeviceAllocator(std::unique_ptr<DeviceMemoryBackend> backend, const DeviceAllocatorSettings& settings = {});
+		~DeviceAllocator();
+
+		DeviceAllocator(const DeviceAllocator&) = delete;
+		DeviceAllocator& operator=(const DeviceAllocator&) = delete;
+
+		// Picks the first memory type in requirements.memoryTypeBits with all the properties, the returned allocation
+		// has no memory when every such heap is full
+		DeviceAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, DeviceResourceKind kind, bool dedicated = false);
+		void Free(DeviceAllocation& allocation);
+
+		// Allocate and bind, honouring the driver's preference for dedicated memory
+		DeviceAllocation AllocateImage(VkImage image, VkMemoryPropertyFlags properties);
+		DeviceAllocation AllocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+
+		DeviceAllocatorStatistics GetStatistics() const;
+		void LogStatistics() const;
+
+	private:
+		DeviceAllocation AllocateInternal(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, DeviceResourceKind kind,
+			bool dedicated, VkImage dedicatedImage, VkBuffer dedicatedBuffer);
+		bool AllocateFromType(uint32_t memoryType, const VkMemoryRequirements& requirements, DeviceResourceKind kind,
+			bool dedicated, VkImage dedicatedImage, VkBuffer dedicatedBuffer, DeviceAllocation& outAllocation);
+		VkDeviceSize GetBlockSize(uint32_t memoryType) const;
+
+	private:
+		std::unique_ptr<DeviceMemoryBackend> m_Backend;
+		DeviceAllocatorSettings m_Settings;
+
+		// Only when bufferImageGranularity is coarser than the range alignment
+		bool m_SeparateKinds = false;
+
+		mutable std::mutex m_Mutex;
+		// Indexed by memory type and resource kind
+		std::vector<std::unique_ptr<MemoryBlock>> m_Blocks[VK_MAX_MEMORY_TYPES][2];
+		uint32_t m_DedicatedCount = 0;
+		VkDeviceSize m_DedicatedSize = 0;
+		uint32_t m_DeviceAllocationCount = 0;
+	};
+}
@@ -0,0 +1,365 @@
+#include "pch.h"
+#include "FrameCapture.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+#include <stb_image.h>
+
+#include "Core/JobSystem.h"
+#include "Core/Profiler.h"
+#include "Core/Timer.h"
+#include "DeviceAllocator.h"
+#include "HostAllocator.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t BytesPerPixel = 4;
+
+	enum class CaptureSlotState : uint8_t
+	{
+		Free = 0,
+		// The copy is recorded into a frame the GPU may not have finished
+		Recorded,
+		// Handed to a job, which frees the slot as soon as the pixels are copied out
+		Processing
+	};
+
+	struct CaptureSlot
+	{
+		VkBuffer Buffer = nullptr;
+		DeviceAllocation Memory;
+		std::atomic<CaptureSlotState> State = CaptureSlotState::Free;
+
+		std::string Name;
+		uint64_t Frame = 0;
+		uint64_t TimelineValue = 0;
+		VkFormat Format = VK_FORMAT_UNDEFINED;
+		VkExtent2D Extent = {};
+	};
+
+	static FrameCaptureSettings s_Settings;
+	static bool s_Initialized = false;
+	// Captures were asked for but the backbuffer can't be read back, which fails the run instead of passing silently
+	static bool s_Unavailable = false;
+
+	static std::vector<std::unique_ptr<CaptureSlot>> s_Slots;
+	static JobCounter s_Counter;
+
+	static std::mutex s_ResultsMutex;
+	static std::vector<CaptureResult> s_Results;
+
+	// 8-bit sRGB to linear, EXR files hold linear values
+	static float s_SrgbToLinear[256];
+
+	static bool IsSupportedFormat(VkFormat format)
+	{
+		return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+	}
+
+	static bool IsBGRA(VkFormat format)
+	{
+		return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+	}
+
+	static bool IsSRGB(VkFormat format)
+	{
+		return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB;
+	}
+
+	static void AddResult(CaptureResult&& result)
+	{
+		std::lock_guard<std::mutex> lock(s_ResultsMutex);
+		s_Results.push_back(std::move(result));
+	}
+
+	static void CompareToGolden(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, CaptureResult& result)
+	{
+		const std::filesystem::path goldenPath = s_Settings.GoldenDirectory / (result.Name + ".png");
+		const uint64_t pixelCount = (uint64_t)width * height;
+		if (s_Settings.UpdateGoldens)
+		{
+			result.Status = ImageWriter::WritePNG(goldenPath, width, height, rgba.data()) ? CaptureStatus::GoldenUpdated : CaptureStatus::Failed;
+			return;
+		}
+
+		int goldenWidth, goldenHeight, channels;
+		stbi_uc* golden = stbi_load(goldenPath.string().c_str(), &goldenWidth, &goldenHeight, &channels, STBI_rgb_alpha);
+		if (!golden)
+		{
+			LOG_ERROR("FrameCapture: no golden image {} for {}", goldenPath.string(), result.Name);
+			result.Status = CaptureStatus::MissingGolden;
+			return;
+		}
+
+		if ((uint32_t)goldenWidth != width || (uint32_t)goldenHeight != height)
+		{
+			LOG_ERROR("FrameCapture: {} is {}x{} but its golden image is {}x{}", result.Name, width, height, goldenWidth, goldenHeight);
+			result.Diff.Pixels = pixelCount;
+			result.Diff.MismatchedPixels = pixelCount;
+			result.Status = CaptureStatus::Mismatch;
+			stbi_image_free(golden);
+			return;
+		}
+
+		result.Diff = ImageDiff::Compare(rgba.data(), golden, pixelCount, s_Settings.Tolerance);
+		result.Status = result.Diff.GetMismatchRatio() <= s_Settings.MaxMismatchRatio ? CaptureStatus::Passed : CaptureStatus::Mismatch;
+		if (result.Status == CaptureStatus::Mismatch)
+		{
+			std::vector<uint8_t> diffImage(pixelCount * BytesPerPixel);
+			ImageDiff::BuildDiffImage(rgba.data(), golden, pixelCount, s_Settings.Tolerance, diffImage.data());
+			ImageWriter::WritePNG(s_Settings.OutputDirectory / (result.Name + ".diff.png"), width, height, diffImage.data());
+			LOG_ERROR("FrameCapture: {} differs from its golden image in {} of {} pixels, by up to {}", result.Name,
+				result.Diff.MismatchedPixels, result.Diff.Pixels, result.Diff.MaxDifference);
+		}
+		stbi_image_free(golden);
+	}
+
+	static void ProcessSlot(CaptureSlot& slot)
+	{
+		TESTBED_PROFILE_FUNCTION();
+		Timer timer;
+
+		CaptureResult result;
+		result.Name = slot.Name;
+		result.Frame = slot.Frame;
+		const uint32_t width = slot.Extent.width;
+		const uint32_t height = slot.Extent.height;
+		const uint64_t pixelCount = (uint64_t)width * height;
+		const bool srgb = IsSRGB(slot.Format);
+
+		// Reading uncached memory is slow, so it is read exactly once, straight into the RGBA order the files want
+		std::vector<uint8_t> rgba(pixelCount * BytesPerPixel);
+		const uint8_t* source = (const uint8_t*)slot.Memory.MappedData;
+		if (IsBGRA(slot.Format))
+		{
+			for (uint64_t pixel = 0; pixel < pixelCount * BytesPerPixel; pixel += BytesPerPixel)
+			{
+				rgba[pixel + 0] = source[pixel + 2];
+				rgba[pixel + 1] = source[pixel + 1];
+				rgba[pixel + 2] = source[pixel + 0];
+				rgba[pixel + 3] = source[pixel + 3];
+			}
+		}
+		else
+		{
+			memcpy(rgba.data(), source, rgba.size());
+		}
+		slot.State.store(CaptureSlotState::Free, std::memory_order_release);
+
+		bool written;
+		const std::filesystem::path path = s_Settings.OutputDirectory / (result.Name + ImageWriter::GetExtension(s_Settings.Format));
+		if (s_Settings.Format == ImageFileFormat::EXR)
+		{
+			std::vector<float> linear(rgba.size());
+			for (size_t i = 0; i < rgba.size(); ++i)
+				linear[i] = srgb && (i % BytesPerPixel) != 3 ? s_SrgbToLinear[rgba[i]] : (float)rgba[i] / 255.0f;
+			written = ImageWriter::WriteEXR(path, width, height, linear.data());
+		}
+		else
+		{
+			written = ImageWriter::WritePNG(path, width, height, rgba.data());
+		}
+
+		if (!written)
+			result.Status = CaptureStatus::Failed;
+		else if (s_Settings.GoldenDirectory.empty())
+			result.Status = CaptureStatus::Written;
+		else
+			CompareToGolden(rgba, width, height, result);
+
+		result.ProcessSeconds = timer.Elapsed();
+		AddResult(std::move(result));
+	}
+
+	void FrameCapture::Init(const FrameCaptureSettings& settings)
+	{
+		s_Settings = settings;
+		s_Settings.Slots = std::max(s_Settings.Slots, 1u);
+
+		const VkFormat format = VulkanContext::GetBackbufferFormat();
+		if (!VulkanContext::IsBackbufferReadable() || !IsSupportedFormat(format))
+		{
+			LOG_ERROR("FrameCapture: the backbuffer can't be read back (format {}), frames won't be captured", (int)format);
+			s_Unavailable = true;
+			return;
+		}
+
+		std::error_code error;
+		std::filesystem::create_directories(s_Settings.OutputDirectory, error);
+		if (s_Settings.UpdateGoldens && !s_Settings.GoldenDirectory.empty())
+			std::filesystem::create_directories(s_Settings.GoldenDirectory, error);
+
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			const float value = (float)i / 255.0f;
+			s_SrgbToLinear[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+
+		const VkExtent2D extent = VulkanContext::GetExtent();
+		VkBufferCreateInfo bufferCreateInfo = {};
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = (VkDeviceSize)extent.width * extent.height * BytesPerPixel;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		s_Slots.resize(s_Settings.Slots);
+		bool cached = true;
+		for (std::unique_ptr<CaptureSlot>& slot : s_Slots)
+		{
+			slot = std::make_unique<CaptureSlot>();
+			VkResult result = vkCreateBuffer(VulkanContext::GetDevice(), &bufferCreateInfo, HostAllocator::GetCallbacks(HostSubsystem::Frame), &slot->Buffer);
+			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create capture readback buffer!");
+
+			// Cached memory is read by the CPU at full speed, uncached memory is still correct, just slower to read
+			slot->Memory = VulkanContext::GetAllocator().AllocateBuffer(slot->Buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+			if (!slot->Memory.Memory)
+			{
+				cached = false;
+				slot->Memory = VulkanContext::GetAllocator().AllocateBuffer(slot->Buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			}
+			TESTBED_ASSERT(slot->Memory.MappedData, "Failed to allocate capture readback memory!");
+		}
+
+		s_Initialized = true;
+		LOG_INFO("FrameCapture: {} readback slots of {:.1f} MB ({}), writing {} files to {}", s_Slots.size(), (double)bufferCreateInfo.size / (1024.0 * 1024.0),
+			cached ? "cached" : "uncached", s_Settings.Format == ImageFileFormat::EXR ? "EXR" : "PNG", s_Settings.OutputDirectory.string());
+	}
+
+	void FrameCapture::Shutdown()
+	{
+		if (!s_Initialized)
+			return;
+
+		Flush();
+		for (std::unique_ptr<CaptureSlot>& slot : s_Slots)
+		{
+			vkDestroyBuffer(VulkanContext::GetDevice(), slot->Buffer, HostAllocator::GetCallbacks(HostSubsystem::Frame));
+			VulkanContext::GetAllocator().Free(slot->Memory);
+		}
+		s_Slots.clear();
+		s_Initialized = false;
+	}
+
+	bool FrameCapture::IsInitialized()
+	{
+		return s_Initialized;
+	}
+
+	bool FrameCapture::Capture(RenderGraph& graph, RenderResource backbuffer, const std::string& name)
+	{
+		if (!s_Initialized)
+			return false;
+
+		CaptureSlot* slot = nullptr;
+		for (std::unique_ptr<CaptureSlot>& candidate : s_Slots)
+		{
+			if (candidate->State.load(std::memory_order_acquire) == CaptureSlotState::Free)
+			{
+				slot = candidate.get();
+				break;
+			}
+		}
+
+		const uint64_t timelineValue = VulkanContext::GetFrameTimelineValue();
+		if (!slot)
+		{
+			LOG_ERROR("FrameCapture: every readback slot is busy, dropping {}", name);
+			CaptureResult result;
+			result.Name = name;
+			result.Frame = timelineValue - 1;
+			AddResult(std::move(result));
+			return false;
+		}
+
+		slot->Name = name;
+		slot->Frame = timelineValue - 1;
+		slot->TimelineValue = timelineValue;
+		slot->Format = VulkanContext::GetBackbufferFormat();
+		slot->Extent = VulkanContext::GetExtent();
+		slot->State.store(CaptureSlotState::Recorded, std::memory_order_relaxed);
+
+		graph.AddPass("Capture", [backbuffer](RenderPassBuilder& builder)
+		{
+			builder.Read(backbuffer, RenderAccess::TransferRead);
+			builder.SetSideEffects();
+		},
+		[backbuffer, slot](VkCommandBuffer commandBuffer, const RenderGraphResources& resources)
+		{
+			VkBufferImageCopy region = {};
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			region.imageExtent = { slot->Extent.width, slot->Extent.height, 1 };
+			vkCmdCopyImageToBuffer(commandBuffer, resources.GetImage(backbuffer), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->Buffer, 1, &region);
+
+			// Host reads happen after the frame's timeline value is reached, the barrier makes the copy visible to them
+			VkBufferMemoryBarrier2 barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+			barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = slot->Buffer;
+			barrier.size = VK_WHOLE_SIZE;
+
+			VkDependencyInfo dependencyInfo = {};
+			dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+			dependencyInfo.bufferMemoryBarrierCount = 1;
+			dependencyInfo.pBufferMemoryBarriers = &barrier;
+			VulkanContext::CmdPipelineBarrier2(commandBuffer, dependencyInfo);
+		});
+		return true;
+	}
+
+	void FrameCapture::Update()
+	{
+		if (!s_Initialized)
+			return;
+
+		const uint64_t completedValue = VulkanContext::GetCompletedTimelineValue();
+		for (std::unique_ptr<CaptureSlot>& slot : s_Slots)
+		{
+			if (slot->State.load(std::memory_order_acquire) != CaptureSlotState::Recorded || slot->TimelineValue > completedValue)
+				continue;
+
+			slot->State.store(CaptureSlotState::Processing, std::memory_order_relaxed);
+			CaptureSlot* processing = slot.get();
+			JobSystem::Run(s_Counter, [processing]() { ProcessSlot(*processing); });
+		}
+	}
+
+	void FrameCapture::Flush()
+	{
+		if (!s_Initialized)
+			return;
+
+		VulkanContext::WaitIdle();
+		Update();
+		JobSystem::Wait(s_Counter);
+	}
+
+	std::vector<CaptureResult> FrameCapture::GetResults()
+	{
+		std::lock_guard<std::mutex> lock(s_ResultsMutex);
+		std::vector<CaptureResult> results = s_Results;
+		std::sort(results.begin(), results.end(), [](const CaptureResult& a, const CaptureResult& b) { return a.Frame < b.Frame; });
+		return results;
+	}
+
+	bool FrameCapture::AllPassed()
+	{
+		if (s_Unavailable)
+			return false;
+
+		std::lock_guard<std::mutex> lock(s_ResultsMutex);
+		for (const CaptureResult& result : s_Results)
+		{
+			if (result.Status == CaptureStatus::Mismatch || result.Status == CaptureStatus::MissingGolden || result.Status == CaptureStatus::Failed)
+				return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <filesystem>
+
+#include "Asset/ImageDiff.h"
+#include "Asset/ImageWriter.h"
+#include "RenderGraph.h"
+#include "VulkanContext.h"
+
+namespace VulkanTestbed
+{
+	struct FrameCaptureSettings
+	{
+		// Readbacks the GPU may be writing or workers may be encoding at once, one more than the frames in flight
+		// captures every frame without waiting
+		uint32_t Slots = VulkanContext::MaxFramesInFlight + 1;
+		std::filesystem::path OutputDirectory = "Captures";
+		ImageFileFormat Format = ImageFileFormat::PNG;
+
+		// Captures are compared against <name>.png here, nothing is compared when empty
+		std::filesystem::path GoldenDirectory;
+		// Writes the captures as the new goldens instead of comparing against them
+		bool UpdateGoldens = false;
+		uint8_t Tolerance = 2;
+		// Fraction of the pixels allowed to be further off than the tolerance
+		double MaxMismatchRatio = 0.0;
+	};
+
+	enum class CaptureStatus : uint8_t
+	{
+		// Nothing to compare against
+		Written = 0,
+		Passed,
+		Mismatch,
+		MissingGolden,
+		GoldenUpdated,
+		// Couldn't be written, or the frame was dropped because every slot was busy
+		Failed
+	};
+
+	inline const char* CaptureStatusToString(CaptureStatus status)
+	{
+		switch (status)
+		{
+			case CaptureStatus::Written:		return "Written";
+			case CaptureStatus::Passed:			return "Passed";
+			case CaptureStatus::Mismatch:		return "Mismatch";
+			case CaptureStatus::MissingGolden:	return "MissingGolden";
+			case CaptureStatus::GoldenUpdated:	return "GoldenUpdated";
+			case CaptureStatus::Failed:			return "Failed";
+		}
+		return "Unknown";
+	}
+
+	struct CaptureResult
+	{
+		std::string Name;
+		// Frame number the capture was taken in
+		uint64_t Frame = 0;
+		CaptureStatus Status = CaptureStatus::Failed;
+		ImageDiffResult Diff;
+		// Conversion, encoding and comparison on the worker
+		double ProcessSeconds = 0.0;
+	};
+
+	// Copies the backbuffer into persistently mapped readback buffers from a render graph pass. The frame isn't
+	// waited on, Update hands slots the GPU has finished to a job that converts, writes and compares them while the
+	// next frames render. Capture and Update are main thread only.
+	class FrameCapture
+	{
+	public:
+		// Needs VulkanContext and the JobSystem, disabled when the backbuffer can't be read back
+		static void Init(const FrameCaptureSettings& settings = {});
+		static void Shutdown();
+		static bool IsInitialized();
+
+		// Adds a pass reading the backbuffer to the frame being declared, false when no slot is free
+		static bool Capture(RenderGraph& graph, RenderResource backbuffer, const std::string& name);
+		// Once per frame after VulkanContext::BeginFrame
+		static void Update();
+		// Waits for the GPU and every job, all captures so far have a result afterwards
+		static void Flush();
+
+		// Sorted by frame, only valid after Flush
+		static std::vector<CaptureResult> GetResults();
+		// No capture failed, mismatched or missed its golden
+		static bool AllPassed();
+	};
+}
@@ -0,0 +1,224 @@
+#include "pch.h"
+#include "GpuProfiler.h"
+
+#include <atomic>
+
+#include "HostAllocator.h"
+#include "VulkanContext.h"
+
+namespace VulkanTestbed
+{
+	struct GpuProfilerFrame
+	{
+		// Two queries per zone, begin and end
+		VkQueryPool QueryPool = nullptr;
+		std::vector<const char*> Names;
+		std::atomic<uint32_t> ZoneCount = 0;
+		// Queries written since the last reset, all of them before the first
+		uint32_t DirtyQueries = 0;
+		bool Pending = false;
+	};
+
+	static GpuProfilerSettings s_Settings;
+	static std::array<GpuProfilerFrame, VulkanContext::MaxFramesInFlight> s_Frames;
+	static GpuProfilerFrame* s_CurrentFrame = nullptr;
+	static bool s_Initialized = false;
+
+	static uint64_t s_TimestampMask = 0;
+	static double s_TimestampPeriod = 0.0;
+	static uint64_t s_CalibrationTicks = 0;
+	static int64_t s_CalibrationNanoseconds = 0;
+
+	static int64_t TicksToNanoseconds(uint64_t ticks)
+	{
+		// Signed, so timestamps a little before the calibration point don't wrap around
+		uint64_t delta = (ticks - s_CalibrationTicks) & s_TimestampMask;
+		if (s_TimestampMask != ~0ull && delta > (s_TimestampMask >> 1))
+			delta |= ~s_TimestampMask;
+		return s_CalibrationNanoseconds + (int64_t)((double)(int64_t)delta * s_TimestampPeriod);
+	}
+
+	// Writes one timestamp on the idle queue and pairs it with the CPU time halfway through the wait for it
+	static void Calibrate()
+	{
+		VkDevice device = VulkanContext::GetDevice();
+		const VkAllocationCallbacks* callbacks = HostAllocator::GetCallbacks(HostSubsystem::Frame);
+
+		VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCreateInfo.queryCount = 1;
+		VkQueryPool queryPool = nullptr;
+		VkResult result = vkCreateQueryPool(device, &queryPoolCreateInfo, callbacks, &queryPool);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create calibration query pool!");
+
+		VkCommandPoolCreateInfo poolCreateInfo = {};
+		poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolCreateInfo.queueFamilyIndex = VulkanContext::GetGraphicsQueueFamily();
+		VkCommandPool commandPool = nullptr;
+		result = vkCreateCommandPool(device, &poolCreateInfo, callbacks, &commandPool);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create calibration command pool!");
+
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		VkCommandBuffer commandBuffer = nullptr;
+		vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		vkCmdResetQueryPool(commandBuffer, queryPool, 0, 1);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+		vkEndCommandBuffer(commandBuffer);
+
+		VkFenceCreateInfo fenceCreateInfo = {};
+		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkFence fence = nullptr;
+		result = vkCreateFence(device, &fenceCreateInfo, callbacks, &fence);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create calibration fence!");
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		const int64_t submitNanoseconds = Profiler::NowNanoseconds();
+		result = vkQueueSubmit(VulkanContext::GetGraphicsQueue(), 1, &submitInfo, fence);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to submit calibration timestamp!");
+		vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+		const int64_t doneNanoseconds = Profiler::NowNanoseconds();
+
+		uint64_t ticks = 0;
+		vkGetQueryPoolResults(device, queryPool, 0, 1, sizeof(ticks), &ticks, sizeof(ticks), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+		s_CalibrationTicks = ticks & s_TimestampMask;
+		s_CalibrationNanoseconds = submitNanoseconds + (doneNanoseconds - submitNanoseconds) / 2;
+
+		vkDestroyFence(device, fence, callbacks);
+		vkDestroyCommandPool(device, commandPool, callbacks);
+		vkDestroyQueryPool(device, queryPool, callbacks);
+
+		LOG_INFO("GpuProfiler: {} ns per tick, calibrated to within {:.1f} us", s_TimestampPeriod, (double)(doneNanoseconds - submitNanoseconds) / 2000.0);
+	}
+
+	// Only for frames the GPU has finished
+	static void Collect(GpuProfilerFrame& frame)
+	{
+		const uint32_t zoneCount = std::min(frame.ZoneCount.load(std::memory_order_relaxed), s_Settings.ZonesPerFrame);
+		frame.DirtyQueries = std::max(frame.DirtyQueries, zoneCount * 2);
+		frame.Pending = false;
+		if (zoneCount == 0)
+			return;
+
+		// Value and availability per query, zones that were never ended stay unavailable and are skipped
+		std::vector<uint64_t> results(zoneCount * 4);
+		vkGetQueryPoolResults(VulkanContext::GetDevice(), frame.QueryPool, 0, zoneCount * 2, results.size() * sizeof(uint64_t), results.data(),
+			2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		for (uint32_t zone = 0; zone < zoneCount; ++zone)
+		{
+			const uint64_t* query = &results[zone * 4];
+			if (query[1] && query[3])
+				Profiler::RecordGpuZone(frame.Names[zone], TicksToNanoseconds(query[0] & s_TimestampMask), TicksToNanoseconds(query[2] & s_TimestampMask));
+		}
+	}
+
+	void GpuProfiler::Init(const GpuProfilerSettings& settings)
+	{
+		TESTBED_ASSERT(Profiler::IsInitialized(), "GpuProfiler needs the Profiler!");
+
+		const uint32_t validBits = VulkanContext::GetTimestampValidBits();
+		if (validBits == 0 || VulkanContext::GetTimestampPeriod() <= 0.0f)
+		{
+			LOG_WARN("GpuProfiler: the graphics queue doesn't support timestamps, GPU zones are disabled");
+			return;
+		}
+
+		s_Settings = settings;
+		s_TimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+		s_TimestampPeriod = (double)VulkanContext::GetTimestampPeriod();
+		Calibrate();
+
+		VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCreateInfo.queryCount = s_Settings.ZonesPerFrame * 2;
+		for (uint32_t i = 0; i < VulkanContext::GetFramesInFlight(); ++i)
+		{
+			GpuProfilerFrame& frame = s_Frames[i];
+			VkResult result = vkCreateQueryPool(VulkanContext::GetDevice(), &queryPoolCreateInfo, HostAllocator::GetCallbacks(HostSubsystem::Frame), &frame.QueryPool);
+			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create timestamp query pool!");
+			frame.Names.assign(s_Settings.ZonesPerFrame, nullptr);
+			frame.ZoneCount = 0;
+			frame.DirtyQueries = queryPoolCreateInfo.queryCount;
+			frame.Pending = false;
+		}
+		s_CurrentFrame = nullptr;
+		s_Initialized = true;
+	}
+
+	void GpuProfiler::Shutdown()
+	{
+		if (!s_Initialized)
+			return;
+
+		VulkanContext::WaitIdle();
+		for (uint32_t i = 0; i < VulkanContext::GetFramesInFlight(); ++i)
+		{
+			GpuProfilerFrame& frame = s_Frames[i];
+			if (frame.Pending)
+				Collect(frame);
+			vkDestroyQueryPool(VulkanContext::GetDevice(), frame.QueryPool, HostAllocator::GetCallbacks(HostSubsystem::Frame));
+			frame.QueryPool = nullptr;
+			frame.Names.clear();
+		}
+		s_CurrentFrame = nullptr;
+		s_Initialized = false;
+	}
+
+	bool GpuProfiler::IsInitialized()
+	{
+		return s_Initialized;
+	}
+
+	void GpuProfiler::BeginFrame()
+	{
+		if (!s_Initialized)
+			return;
+
+		GpuProfilerFrame& frame = s_Frames[VulkanContext::GetFrameIndex()];
+		if (frame.Pending)
+			Collect(frame);
+
+		if (frame.DirtyQueries > 0)
+			vkCmdResetQueryPool(VulkanContext::GetCommandBuffer(), frame.QueryPool, 0, frame.DirtyQueries);
+		frame.DirtyQueries = 0;
+		frame.ZoneCount.store(0, std::memory_order_relaxed);
+		frame.Pending = true;
+		s_CurrentFrame = &frame;
+	}
+
+	uint32_t GpuProfiler::BeginZone(VkCommandBuffer commandBuffer, const char* name)
+	{
+		if (!s_CurrentFrame)
+			return InvalidZone;
+
+		GpuProfilerFrame& frame = *s_CurrentFrame;
+		const uint32_t zone = frame.ZoneCount.fetch_add(1, std::memory_order_relaxed);
+		if (zone >= s_Settings.ZonesPerFrame)
+			return InvalidZone;
+
+		frame.Names[zone] = name;
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.QueryPool, zone * 2);
+		return zone;
+	}
+
+	void GpuProfiler::EndZone(VkCommandBuffer commandBuffer, uint32_t zone)
+	{
+		if (zone != InvalidZone)
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, s_CurrentFrame->QueryPool, zone * 2 + 1);
+	}
+}
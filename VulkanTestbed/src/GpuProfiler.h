@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "Core/Profiler.h"
+
+namespace VulkanTestbed
+{
+	struct GpuProfilerSettings
+	{
+		// Zones past this many in one frame are dropped
+		uint32_t ZonesPerFrame = 256;
+	};
+
+	// Brackets zones with vkCmdWriteTimestamp into one query pool per frame in flight. A slot's results are read
+	// when it comes around again, by which time BeginFrame has waited for the GPU, converted to CPU time and handed
+	// to the Profiler on its GPU track. GPU ticks are mapped to CPU time once at Init, from a timestamp written by a
+	// one-shot submit on the idle queue, so zones may be off by up to half that submit's latency.
+	class GpuProfiler
+	{
+	public:
+		// Needs VulkanContext and an initialized Profiler. Submits to the graphics queue, call it on the main thread
+		// while nothing else does. Does nothing when the graphics queue can't write timestamps.
+		static void Init(const GpuProfilerSettings& settings = {});
+		// Waits for the GPU and passes the zones of every frame still in flight on
+		static void Shutdown();
+		static bool IsInitialized();
+
+		// Right after VulkanContext::BeginFrame, records the query reset into the frame's command buffer
+		static void BeginFrame();
+
+		// From any thread recording commands for the current frame. Name has to outlive the profiler.
+		static uint32_t BeginZone(VkCommandBuffer commandBuffer, const char* name);
+		static void EndZone(VkCommandBuffer commandBuffer, uint32_t zone);
+
+		static constexpr uint32_t InvalidZone = ~0u;
+	};
+
+	class GpuProfileScope
+	{
+	public:
+		GpuProfileScope(VkCommandBuffer commandBuffer, const char* name)
+			: m_CommandBuffer(commandBuffer), m_Zone(GpuProfiler::BeginZone(commandBuffer, name)) {}
+		~GpuProfileScope() { GpuProfiler::EndZone(m_CommandBuffer, m_Zone); }
+
+		GpuProfileScope(const GpuProfileScope&) = delete;
+		GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+	private:
+		VkCommandBuffer m_CommandBuffer;
+		uint32_t m_Zone;
+	};
+}
+
+#ifdef TESTBED_PROFILE
+	#define TESTBED_PROFILE_GPU_SCOPE(commandBuffer, name) ::VulkanTestbed::GpuProfileScope TESTBED_PROFILE_CONCAT(gpuProfileScope, __LINE__)(commandBuffer, name)
+#else
+	#define TESTBED_PROFILE_GPU_SCOPE(commandBuffer, name)
+#endif
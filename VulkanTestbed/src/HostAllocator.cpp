@@ -0,0 +1,336 @@
+#include "pch.h"
+#include "HostAllocator.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+namespace VulkanTestbed
+{
+	static constexpr size_t PageSize = 64 * 1024;
+	// Slots of 16 bytes up to 4KB, everything larger goes to malloc
+	static constexpr uint32_t MinClassShift = 4;
+	static constexpr uint32_t MaxClassShift = 12;
+	static constexpr uint32_t ClassCount = MaxClassShift - MinClassShift + 1;
+	static constexpr size_t MaxSlotSize = (size_t)1 << MaxClassShift;
+	static constexpr uint8_t LargeClass = 0xFF;
+	static constexpr uint32_t ScopeCount = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+	// Sits right in front of every pointer handed to the driver
+	struct AllocationHeader
+	{
+		uint64_t Size;
+		// From the start of the slot or malloc block to the pointer
+		uint32_t Offset;
+		uint8_t Class;
+		uint8_t Subsystem;
+		uint8_t Scope;
+		uint8_t Padding;
+	};
+	static constexpr size_t HeaderSize = sizeof(AllocationHeader);
+	static_assert(HeaderSize == 16, "Allocations have to stay 16 byte aligned");
+
+	struct SizeClass
+	{
+		std::mutex Mutex;
+		// Free slots, linked through their first bytes
+		void* FreeList = nullptr;
+		std::vector<void*> Pages;
+	};
+
+	struct AllocationCounters
+	{
+		std::atomic<uint64_t> LiveBytes = 0;
+		std::atomic<uint64_t> PeakBytes = 0;
+		std::atomic<uint64_t> LiveCount = 0;
+		std::atomic<uint64_t> TotalCount = 0;
+
+		void Add(uint64_t size)
+		{
+			const uint64_t live = LiveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+			uint64_t peak = PeakBytes.load(std::memory_order_relaxed);
+			while (live > peak && !PeakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+			LiveCount.fetch_add(1, std::memory_order_relaxed);
+			TotalCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void Remove(uint64_t size)
+		{
+			LiveBytes.fetch_sub(size, std::memory_order_relaxed);
+			LiveCount.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		HostAllocationStatistics Get() const
+		{
+			return { LiveBytes.load(), PeakBytes.load(), LiveCount.load(), TotalCount.load() };
+		}
+	};
+
+	static std::array<SizeClass, ClassCount> s_Classes;
+	static std::atomic<uint64_t> s_PageBytes = 0;
+
+	static AllocationCounters s_Counters[(uint32_t)HostSubsystem::Count][ScopeCount];
+	static AllocationCounters s_InternalCounters;
+	static AllocationCounters s_TotalCounters;
+
+	// Allocations and frees, the main thread turns them into per frame numbers
+	static std::atomic<uint64_t> s_Operations = 0;
+	static uint64_t s_FrameStartOperations = 0;
+	static HostFrameStatistics s_FrameStats;
+
+	const char* HostSubsystemToString(HostSubsystem subsystem)
+	{
+		switch (subsystem)
+		{
+			case HostSubsystem::Context:		return "Context";
+			case HostSubsystem::Swapchain:		return "Swapchain";
+			case HostSubsystem::Frame:			return "Frame";
+			case HostSubsystem::DeviceMemory:	return "DeviceMemory";
+			case HostSubsystem::Textures:		return "Textures";
+			case HostSubsystem::Pipelines:		return "Pipelines";
+			case HostSubsystem::RenderGraph:	return "RenderGraph";
+			case HostSubsystem::Uploads:		return "Uploads";
+			case HostSubsystem::Descriptors:	return "Descriptors";
+			case HostSubsystem::Meshes:			return "Meshes";
+			case HostSubsystem::Count:			break;
+		}
+		return "Unknown";
+	}
+
+	static const char* ScopeToString(uint32_t scope)
+	{
+		switch (scope)
+		{
+			case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:	return "Command";
+			case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:		return "Object";
+			case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:		return "Cache";
+			case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:		return "Device";
+			case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE:	return "Instance";
+		}
+		return "Unknown";
+	}
+
+	static uint8_t* AlignPointer(uint8_t* pointer, size_t alignment)
+	{
+		return (uint8_t*)(((uintptr_t)pointer + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	}
+
+	// Smallest class whose slots hold size bytes
+	static uint32_t GetSizeClass(size_t size)
+	{
+		uint32_t shift = MinClassShift;
+		while (((size_t)1 << shift) < size)
+			++shift;
+		return shift - MinClassShift;
+	}
+
+	static void* PopSlot(uint32_t classIndex)
+	{
+		SizeClass& sizeClass = s_Classes[classIndex];
+		std::lock_guard<std::mutex> lock(sizeClass.Mutex);
+
+		if (!sizeClass.FreeList)
+		{
+			// Aligned to the largest slot, so every slot is aligned to its own size
+			uint8_t* rawPage = (uint8_t*)malloc(PageSize + MaxSlotSize);
+			if (!rawPage)
+				return nullptr;
+			sizeClass.Pages.push_back(rawPage);
+			s_PageBytes.fetch_add(PageSize, std::memory_order_relaxed);
+
+			uint8_t* page = AlignPointer(rawPage, MaxSlotSize);
+			const size_t slotSize = (size_t)1 << (classIndex + MinClassShift);
+			for (size_t offset = PageSize; offset >= slotSize; offset -= slotSize)
+			{
+				void* slot = page + offset - slotSize;
+				*(void**)slot = sizeClass.FreeList;
+				sizeClass.FreeList = slot;
+			}
+		}
+
+		void* slot = sizeClass.FreeList;
+		sizeClass.FreeList = *(void**)slot;
+		return slot;
+	}
+
+	static void PushSlot(uint32_t classIndex, void* slot)
+	{
+		SizeClass& sizeClass = s_Classes[classIndex];
+		std::lock_guard<std::mutex> lock(sizeClass.Mutex);
+		*(void**)slot = sizeClass.FreeList;
+		sizeClass.FreeList = slot;
+	}
+
+	static AllocationHeader& GetHeader(void* memory)
+	{
+		return *(AllocationHeader*)((uint8_t*)memory - HeaderSize);
+	}
+
+	static void* VKAPI_CALL Allocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+	{
+		if (size == 0)
+			return nullptr;
+
+		alignment = std::max(alignment, HeaderSize);
+		const size_t offset = (HeaderSize + alignment - 1) & ~(alignment - 1);
+
+		uint8_t* base;
+		uint8_t classIndex;
+		if (offset + size <= MaxSlotSize)
+		{
+			// Slots are aligned to their size, which is at least the alignment
+			classIndex = (uint8_t)GetSizeClass(offset + size);
+			base = (uint8_t*)PopSlot(classIndex);
+		}
+		else
+		{
+			classIndex = LargeClass;
+			base = (uint8_t*)malloc(offset + size + alignment);
+		}
+		if (!base)
+			return nullptr;
+
+		uint8_t* memory = classIndex == LargeClass ? AlignPointer(base + HeaderSize, alignment) : base + offset;
+		AllocationHeader& header = GetHeader(memory);
+		header.Size = size;
+		header.Offset = (uint32_t)(memory - base);
+		header.Class = classIndex;
+		header.Subsystem = (uint8_t)(uintptr_t)userData;
+		header.Scope = (uint8_t)scope;
+
+		s_Counters[header.Subsystem][header.Scope].Add(size);
+		s_TotalCounters.Add(size);
+		s_Operations.fetch_add(1, std::memory_order_relaxed);
+		return memory;
+	}
+
+	static void VKAPI_CALL Free(void* userData, void* memory)
+	{
+		if (!memory)
+			return;
+
+		const AllocationHeader header = GetHeader(memory);
+		s_Counters[header.Subsystem][header.Scope].Remove(header.Size);
+		s_TotalCounters.Remove(header.Size);
+		s_Operations.fetch_add(1, std::memory_order_relaxed);
+
+		uint8_t* base = (uint8_t*)memory - header.Offset;
+		if (header.Class == LargeClass)
+			free(base);
+		else
+			PushSlot(header.Class, base);
+	}
+
+	static void* VKAPI_CALL Reallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+	{
+		if (!original)
+			return Allocate(userData, size, alignment, scope);
+		if (size == 0)
+		{
+			Free(userData, original);
+			return nullptr;
+		}
+
+		// Still fits its slot and is aligned the way the new request wants, only the bookkeeping changes
+		AllocationHeader& header = GetHeader(original);
+		const bool aligned = ((uintptr_t)original & (std::max<size_t>(alignment, 1) - 1)) == 0;
+		if (aligned && header.Class != LargeClass && header.Offset + size <= ((size_t)1 << (header.Class + MinClassShift)))
+		{
+			AllocationCounters& counters = s_Counters[header.Subsystem][header.Scope];
+			counters.Remove(header.Size);
+			counters.Add(size);
+			s_TotalCounters.Remove(header.Size);
+			s_TotalCounters.Add(size);
+			header.Size = size;
+			return original;
+		}
+
+		void* memory = Allocate(userData, size, alignment, scope);
+		if (!memory)
+			return nullptr;
+
+		memcpy(memory, original, std::min<size_t>(size, header.Size));
+		Free(userData, original);
+		return memory;
+	}
+
+	static void VKAPI_CALL InternalAllocation(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+	{
+		s_InternalCounters.Add(size);
+	}
+
+	static void VKAPI_CALL InternalFree(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+	{
+		s_InternalCounters.Remove(size);
+	}
+
+	const VkAllocationCallbacks* HostAllocator::GetCallbacks(HostSubsystem subsystem)
+	{
+		// The subsystem travels as the user data, so allocations remember who made them
+		static const auto s_Callbacks = []()
+		{
+			std::array<VkAllocationCallbacks, (size_t)HostSubsystem::Count> callbacks;
+			for (uint32_t i = 0; i < (uint32_t)HostSubsystem::Count; ++i)
+				callbacks[i] = { (void*)(uintptr_t)i, &Allocate, &Reallocate, &Free, &InternalAllocation, &InternalFree };
+			return callbacks;
+		}();
+
+		return &s_Callbacks[(size_t)subsystem];
+	}
+
+	HostAllocationStatistics HostAllocator::GetStatistics(HostSubsystem subsystem, VkSystemAllocationScope scope)
+	{
+		return s_Counters[(uint32_t)subsystem][scope].Get();
+	}
+
+	HostAllocationStatistics HostAllocator::GetInternalStatistics()
+	{
+		return s_InternalCounters.Get();
+	}
+
+	HostFrameStatistics HostAllocator::GetFrameStatistics()
+	{
+		return s_FrameStats;
+	}
+
+	void HostAllocator::EndFrame()
+	{
+		const uint64_t operations = s_Operations.load(std::memory_order_relaxed);
+		s_FrameStats.LastFrameOperations = operations - s_FrameStartOperations;
+		s_FrameStats.MaxFrameOperations = std::max(s_FrameStats.MaxFrameOperations, s_FrameStats.LastFrameOperations);
+		s_FrameStats.TotalOperations += s_FrameStats.LastFrameOperations;
+		++s_FrameStats.Frames;
+		s_FrameStartOperations = operations;
+	}
+
+	void HostAllocator::LogStatistics()
+	{
+		const HostAllocationStatistics total = s_TotalCounters.Get();
+		LOG_INFO("Vulkan host memory: {:.1f} KB live, {:.1f} KB peak, {} allocations, {:.1f} KB in pool pages",
+			(double)total.LiveBytes / 1024.0, (double)total.PeakBytes / 1024.0, total.TotalCount, (double)s_PageBytes.load() / 1024.0);
+
+		LOG_INFO("\t{:<12} | {:<8} | {:>10} | {:>10} | {:>6} | {:>8}", "Subsystem", "Scope", "live (KB)", "peak (KB)", "live", "total");
+		for (uint32_t subsystem = 0; subsystem < (uint32_t)HostSubsystem::Count; ++subsystem)
+		{
+			for (uint32_t scope = 0; scope < ScopeCount; ++scope)
+			{
+				const HostAllocationStatistics stats = s_Counters[subsystem][scope].Get();
+				if (stats.TotalCount == 0)
+					continue;
+
+				LOG_INFO("\t{:<12} | {:<8} | {:>10.1f} | {:>10.1f} | {:>6} | {:>8}", HostSubsystemToString((HostSubsystem)subsystem), ScopeToString(scope),
+					(double)stats.LiveBytes / 1024.0, (double)stats.PeakBytes / 1024.0, stats.LiveCount, stats.TotalCount);
+			}
+		}
+
+		const HostAllocationStatistics internal = s_InternalCounters.Get();
+		if (internal.TotalCount > 0)
+			LOG_INFO("\tDriver internal: {:.1f} KB live, {:.1f} KB peak", (double)internal.LiveBytes / 1024.0, (double)internal.PeakBytes / 1024.0);
+
+		if (s_FrameStats.Frames > 0)
+		{
+			LOG_INFO("\tChurn: {:.1f} allocations and frees per frame on average, {} in the worst frame",
+				(double)s_FrameStats.TotalOperations / (double)s_FrameStats.Frames, s_FrameStats.MaxFrameOperations);
+		}
+	}
+}
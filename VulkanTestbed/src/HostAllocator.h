@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace VulkanTestbed
+{
+	// Who created the Vulkan object a host allocation belongs to
+	enum class HostSubsystem : uint32_t
+	{
+		Context = 0,
+		Swapchain,
+		Frame,
+		DeviceMemory,
+		Textures,
+		Pipelines,
+		RenderGraph,
+		Uploads,
+		Descriptors,
+		Meshes,
+
+		Count
+	};
+
+	const char* HostSubsystemToString(HostSubsystem subsystem);
+
+	struct HostAllocationStatistics
+	{
+		uint64_t LiveBytes = 0;
+		uint64_t PeakBytes = 0;
+		uint64_t LiveCount = 0;
+		uint64_t TotalCount = 0;
+	};
+
+	struct HostFrameStatistics
+	{
+		uint64_t Frames = 0;
+		// Allocations plus frees in the last finished frame, and the worst frame so far
+		uint64_t LastFrameOperations = 0;
+		uint64_t MaxFrameOperations = 0;
+		uint64_t TotalOperations = 0;
+	};
+
+	// VkAllocationCallbacks that serve the driver's host allocations from pooled size classes and track them
+	// per subsystem and VkSystemAllocationScope. Small requests come from 64KB pages carved into power of two
+	// slots with a lock per size class, larger ones go to malloc.
+	class HostAllocator
+	{
+	public:
+		// Pass to every vkCreate*, vkAllocate* and their destroy and free counterparts
+		static const VkAllocationCallbacks* GetCallbacks(HostSubsystem subsystem);
+
+		static HostAllocationStatistics GetStatistics(HostSubsystem subsystem, VkSystemAllocationScope scope);
+		// Memory the driver allocated itself and only reported, such as executable memory for shaders
+		static HostAllocationStatistics GetInternalStatistics();
+		static HostFrameStatistics GetFrameStatistics();
+
+		// Closes the churn measurement of the current frame
+		static void EndFrame();
+		static void LogStatistics();
+	};
+}
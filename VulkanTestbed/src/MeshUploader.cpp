@@ -0,0 +1,193 @@
+#include "pch.h"
+#include "MeshUploader.h"
+
+#include <deque>
+
+#include "Core/Profiler.h"
+#include "Core/Timer.h"
+#include "DeviceAllocator.h"
+#include "HostAllocator.h"
+#include "UploadManager.h"
+#include "VulkanContext.h"
+
+namespace VulkanTestbed
+{
+	struct UploadedMesh
+	{
+		GpuMesh Mesh;
+		DeviceAllocation VertexMemory;
+		DeviceAllocation IndexMemory;
+		uint32_t PendingCopies = 0;
+	};
+
+	// One buffer's contents, staged in bands of at most the frame budget
+	struct PendingCopy
+	{
+		MeshHandle Handle;
+		VkBuffer Buffer;
+		const uint8_t* Source;
+		uint64_t Size;
+		uint64_t Uploaded;
+		VkPipelineStageFlags DstStages;
+		VkAccessFlags DstAccess;
+	};
+
+	static MeshUploaderSettings s_Settings;
+	static MeshUploaderStatistics s_Stats;
+	static std::vector<UploadedMesh> s_Meshes;
+	static std::deque<PendingCopy> s_Copies;
+	static Timer s_UploadTimer;
+
+	static VkBuffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, DeviceAllocation& outMemory)
+	{
+		VkBufferCreateInfo bufferCreateInfo = {};
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = size;
+		bufferCreateInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer buffer = nullptr;
+		VkResult result = vkCreateBuffer(VulkanContext::GetDevice(), &bufferCreateInfo, HostAllocator::GetCallbacks(HostSubsystem::Meshes), &buffer);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create mesh buffer!");
+
+		outMemory = VulkanContext::GetAllocator().AllocateBuffer(buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		TESTBED_ASSERT(outMemory.Memory, "Failed to allocate mesh memory!");
+		return buffer;
+	}
+
+	void MeshUploader::Init(const MeshUploaderSettings& settings)
+	{
+		s_Settings = settings;
+		s_Stats = {};
+	}
+
+	void MeshUploader::Shutdown()
+	{
+		if (!s_Meshes.empty())
+		{
+			VulkanContext::WaitIdle();
+			VkDevice device = VulkanContext::GetDevice();
+			for (UploadedMesh& mesh : s_Meshes)
+			{
+				if (mesh.Mesh.VertexBuffer)
+				{
+					vkDestroyBuffer(device, mesh.Mesh.VertexBuffer, HostAllocator::GetCallbacks(HostSubsystem::Meshes));
+					VulkanContext::GetAllocator().Free(mesh.VertexMemory);
+				}
+				if (mesh.Mesh.IndexBuffer)
+				{
+					vkDestroyBuffer(device, mesh.Mesh.IndexBuffer, HostAllocator::GetCallbacks(HostSubsystem::Meshes));
+					VulkanContext::GetAllocator().Free(mesh.IndexMemory);
+				}
+			}
+		}
+
+		s_Meshes.clear();
+		s_Copies.clear();
+		s_Stats = {};
+	}
+
+	MeshHandle MeshUploader::Upload(const MeshView& mesh)
+	{
+		if (IsIdle())
+			s_UploadTimer.Reset();
+
+		const MeshHandle handle = (MeshHandle)s_Meshes.size();
+		UploadedMesh& uploaded = s_Meshes.emplace_back();
+		GpuMesh& gpuMesh = uploaded.Mesh;
+		gpuMesh.VertexCount = mesh.VertexCount;
+		gpuMesh.IndexCount = mesh.IndexCount;
+		gpuMesh.IndexFormat = mesh.IndexFormat == IndexType::UInt16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+		gpuMesh.PackedVertices = mesh.PackedVertices != nullptr;
+		++s_Stats.Requested;
+
+		// The quantized stream is what a vertex shader reads, the float one only feeds CPU side processing
+		const void* vertices = gpuMesh.PackedVertices ? (const void*)mesh.PackedVertices : (const void*)mesh.Vertices;
+		const uint64_t vertexSize = gpuMesh.PackedVertices ? mesh.GetPackedVertexBufferSize() : mesh.GetVertexBufferSize();
+		const uint64_t indexSize = mesh.GetIndexBufferSize();
+
+		if (vertexSize > 0)
+		{
+			gpuMesh.VertexBuffer = CreateBuffer(vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, uploaded.VertexMemory);
+			s_Copies.push_back({ handle, gpuMesh.VertexBuffer, (const uint8_t*)vertices, vertexSize, 0,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT });
+			++uploaded.PendingCopies;
+		}
+		if (indexSize > 0)
+		{
+			gpuMesh.IndexBuffer = CreateBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, uploaded.IndexMemory);
+			s_Copies.push_back({ handle, gpuMesh.IndexBuffer, (const uint8_t*)mesh.Indices, indexSize, 0,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT });
+			++uploaded.PendingCopies;
+		}
+
+		if (uploaded.PendingCopies == 0)
+			++s_Stats.Resident;
+		return handle;
+	}
+
+	void MeshUploader::Update()
+	{
+		TESTBED_PROFILE_FUNCTION();
+		if (IsIdle())
+			return;
+
+		// Same banding as the texture streamer, the first band of a frame always goes out so huge buffers make progress
+		uint64_t budget = s_Settings.FrameBudget;
+		bool scheduled = false;
+		while (!s_Copies.empty())
+		{
+			PendingCopy& copy = s_Copies.front();
+			uint64_t size = std::min({ copy.Size - copy.Uploaded, budget, UploadManager::GetStagingSize() / 4 });
+			if (size == 0 && !scheduled)
+				size = std::min(copy.Size - copy.Uploaded, UploadManager::GetStagingSize() / 4);
+			if (size == 0)
+				break;
+
+			// The only CPU copy, straight out of the mapped cache into the staging ring
+			StagingAllocation staging;
+			if (!UploadManager::AllocateStaging(size, 16, staging))
+				break;
+
+			memcpy(staging.Data, copy.Source + copy.Uploaded, size);
+			UploadManager::CopyToBuffer(staging, copy.Buffer, copy.Uploaded, copy.DstStages, copy.DstAccess);
+			copy.Uploaded += size;
+			budget -= std::min(budget, size);
+			scheduled = true;
+			s_Stats.BytesUploaded += size;
+
+			if (copy.Uploaded < copy.Size)
+				continue;
+
+			if (--s_Meshes[copy.Handle].PendingCopies == 0)
+				++s_Stats.Resident;
+			s_Copies.pop_front();
+		}
+
+		if (IsIdle())
+		{
+			LOG_INFO("MeshUploader: {} meshes resident after {:.2f} s, {:.1f} MB uploaded",
+				s_Stats.Resident, s_UploadTimer.Elapsed(), (double)s_Stats.BytesUploaded / (1024.0 * 1024.0));
+		}
+	}
+
+	bool MeshUploader::IsResident(MeshHandle handle)
+	{
+		return s_Meshes[handle].PendingCopies == 0;
+	}
+
+	const GpuMesh& MeshUploader::GetMesh(MeshHandle handle)
+	{
+		return s_Meshes[handle].Mesh;
+	}
+
+	bool MeshUploader::IsIdle()
+	{
+		return s_Stats.Resident == s_Stats.Requested;
+	}
+
+	MeshUploaderStatistics MeshUploader::GetStatistics()
+	{
+		return s_Stats;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "Asset/Mesh.h"
+
+namespace VulkanTestbed
+{
+	using MeshHandle = uint32_t;
+
+	struct MeshUploaderSettings
+	{
+		// Upper bound on bytes staged per frame, large meshes are spread over several frames
+		uint64_t FrameBudget = 32ull << 20;
+	};
+
+	struct MeshUploaderStatistics
+	{
+		uint32_t Requested = 0;
+		uint32_t Resident = 0;
+		uint64_t BytesUploaded = 0;
+	};
+
+	struct GpuMesh
+	{
+		// Holds PackedVertex when the mesh was quantized, Vertex otherwise
+		VkBuffer VertexBuffer = nullptr;
+		VkBuffer IndexBuffer = nullptr;
+		VkIndexType IndexFormat = VK_INDEX_TYPE_UINT32;
+		uint32_t VertexCount = 0;
+		uint32_t IndexCount = 0;
+		bool PackedVertices = false;
+	};
+
+	// Copies mesh data from wherever it already is in memory, usually a mapped MeshCache, through the staging ring into
+	// device local vertex and index buffers. Nothing is parsed or copied on the CPU before staging. Main thread only.
+	class MeshUploader
+	{
+	public:
+		// Needs VulkanContext and UploadManager
+		static void Init(const MeshUploaderSettings& settings = {});
+		static void Shutdown();
+
+		// Creates the buffers and queues their contents, the view's memory has to stay valid until the mesh is resident
+		static MeshHandle Upload(const MeshView& mesh);
+		// Queues this frame's copies, call between VulkanContext::BeginFrame and UploadManager::Submit
+		static void Update();
+
+		// Resident meshes can be drawn from the frame that made them resident on
+		static bool IsResident(MeshHandle handle);
+		static const GpuMesh& GetMesh(MeshHandle handle);
+		static bool IsIdle();
+
+		static MeshUploaderStatistics GetStatistics();
+	};
+}
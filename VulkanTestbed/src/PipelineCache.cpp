@@ -0,0 +1,229 @@
+#include "pch.h"
+#include "PipelineCache.h"
+
+#include <fstream>
+
+#include "Core/Hash.h"
+#include "Core/JobSystem.h"
+#include "Core/MappedFile.h"
+#include "Core/Timer.h"
+#include "HostAllocator.h"
+#include "VulkanContext.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t PipelineCacheMagic = 0x43505654; // "TVPC"
+	static constexpr uint32_t PipelineCacheFormatVersion = 1;
+
+	struct PipelineCacheHeader
+	{
+		uint32_t Magic;
+		uint32_t FormatVersion;
+		uint32_t VendorID;
+		uint32_t DeviceID;
+		uint32_t DriverVersion;
+		uint32_t Padding;
+		uint8_t PipelineCacheUUID[VK_UUID_SIZE];
+		uint8_t DeviceUUID[VK_UUID_SIZE];
+		uint8_t DriverUUID[VK_UUID_SIZE];
+
+		uint64_t DataSize;
+		uint64_t DataHash;
+	};
+
+	static std::filesystem::path s_Path;
+	static VkPipelineCache s_Cache = nullptr;
+	// Hash of the data the file currently holds
+	static uint64_t s_SavedHash = 0;
+
+	static bool MatchesDevice(const PipelineCacheHeader& header, const DeviceIdentity& identity)
+	{
+		return header.VendorID == identity.VendorID
+			&& header.DeviceID == identity.DeviceID
+			&& header.DriverVersion == identity.DriverVersion
+			&& memcmp(header.PipelineCacheUUID, identity.PipelineCacheUUID, VK_UUID_SIZE) == 0
+			&& memcmp(header.DeviceUUID, identity.DeviceUUID, VK_UUID_SIZE) == 0
+			&& memcmp(header.DriverUUID, identity.DriverUUID, VK_UUID_SIZE) == 0;
+	}
+
+	// Drivers are not required to survive garbage in pInitialData, so everything is checked before it gets there
+	static bool ReadCacheData(const std::filesystem::path& path, MappedFile& file, const uint8_t*& outData, size_t& outSize)
+	{
+		if (!file.Open(path))
+			return false;
+
+		const PipelineCacheHeader* header = (const PipelineCacheHeader*)file.GetData();
+		if (file.GetSize() < sizeof(PipelineCacheHeader)
+			|| header->Magic != PipelineCacheMagic
+			|| header->FormatVersion != PipelineCacheFormatVersion
+			|| header->DataSize != file.GetSize() - sizeof(PipelineCacheHeader))
+		{
+			LOG_WARN("PipelineCache: {} is corrupt, starting empty", path.string());
+			return false;
+		}
+
+		if (!MatchesDevice(*header, VulkanContext::GetDeviceIdentity()))
+		{
+			LOG_INFO("PipelineCache: {} was written by another device or driver, starting empty", path.string());
+			return false;
+		}
+
+		outData = file.GetData() + sizeof(PipelineCacheHeader);
+		outSize = (size_t)header->DataSize;
+		if (Hash64(outData, outSize) != header->DataHash)
+		{
+			LOG_WARN("PipelineCache: {} is corrupt, starting empty", path.string());
+			return false;
+		}
+		s_SavedHash = header->DataHash;
+		return true;
+	}
+
+	static bool WriteCacheData(const std::filesystem::path& path, const std::vector<uint8_t>& data, uint64_t hash)
+	{
+		const DeviceIdentity& identity = VulkanContext::GetDeviceIdentity();
+		PipelineCacheHeader header = {};
+		header.Magic = PipelineCacheMagic;
+		header.FormatVersion = PipelineCacheFormatVersion;
+		header.VendorID = identity.VendorID;
+		header.DeviceID = identity.DeviceID;
+		header.DriverVersion = identity.DriverVersion;
+		memcpy(header.PipelineCacheUUID, identity.PipelineCacheUUID, VK_UUID_SIZE);
+		memcpy(header.DeviceUUID, identity.DeviceUUID, VK_UUID_SIZE);
+		memcpy(header.DriverUUID, identity.DriverUUID, VK_UUID_SIZE);
+		header.DataSize = data.size();
+		header.DataHash = hash;
+
+		// A crash halfway through the write must not leave a file that passes validation
+		std::filesystem::path tempPath = path;
+		tempPath += ".tmp";
+
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)data.data(), (std::streamsize)data.size());
+		file.close();
+		if (!file)
+			return false;
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, path, error);
+		return !error;
+	}
+
+	void PipelineCache::Init(const std::filesystem::path& path)
+	{
+		s_Path = path;
+		s_SavedHash = 0;
+
+		MappedFile file;
+		const uint8_t* initialData = nullptr;
+		size_t initialSize = 0;
+		if (!ReadCacheData(path, file, initialData, initialSize))
+		{
+			initialData = nullptr;
+			initialSize = 0;
+		}
+
+		VkPipelineCacheCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		createInfo.initialDataSize = initialSize;
+		createInfo.pInitialData = initialData;
+		VkResult result = vkCreatePipelineCache(VulkanContext::GetDevice(), &createInfo, HostAllocator::GetCallbacks(HostSubsystem::Pipelines), &s_Cache);
+		if (result != VK_SUCCESS && initialData)
+		{
+			LOG_WARN("PipelineCache: Driver rejected {}, starting empty", path.string());
+			createInfo.initialDataSize = 0;
+			createInfo.pInitialData = nullptr;
+			s_SavedHash = 0;
+			result = vkCreatePipelineCache(VulkanContext::GetDevice(), &createInfo, HostAllocator::GetCallbacks(HostSubsystem::Pipelines), &s_Cache);
+		}
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create pipeline cache!");
+
+		if (initialData)
+			LOG_INFO("PipelineCache: Loaded {:.1f} KB from {}", (double)initialSize / 1024.0, path.string());
+	}
+
+	void PipelineCache::Shutdown()
+	{
+		if (!s_Cache)
+			return;
+
+		Save();
+		vkDestroyPipelineCache(VulkanContext::GetDevice(), s_Cache, HostAllocator::GetCallbacks(HostSubsystem::Pipelines));
+		s_Cache = nullptr;
+	}
+
+	VkPipelineCache PipelineCache::Get()
+	{
+		return s_Cache;
+	}
+
+	void PipelineCache::Save()
+	{
+		TESTBED_ASSERT(s_Cache, "PipelineCache is not initialized!");
+
+		const VkDevice device = VulkanContext::GetDevice();
+		size_t size = 0;
+		VkResult result = vkGetPipelineCacheData(device, s_Cache, &size, nullptr);
+		if (result != VK_SUCCESS || size == 0)
+			return;
+
+		std::vector<uint8_t> data(size);
+		result = vkGetPipelineCacheData(device, s_Cache, &size, data.data());
+		if (result != VK_SUCCESS)
+			return;
+		data.resize(size);
+
+		const uint64_t hash = Hash64(data.data(), data.size());
+		if (hash == s_SavedHash)
+			return;
+
+		std::error_code error;
+		if (s_Path.has_parent_path())
+			std::filesystem::create_directories(s_Path.parent_path(), error);
+
+		if (!WriteCacheData(s_Path, data, hash))
+		{
+			LOG_ERROR("PipelineCache: Failed to write {}", s_Path.string());
+			return;
+		}
+		s_SavedHash = hash;
+		LOG_INFO("PipelineCache: Saved {:.1f} KB to {}", (double)data.size() / 1024.0, s_Path.string());
+	}
+
+	// One pipeline per call, the cache is internally synchronized so all threads share it
+	template<typename CreateInfo, typename CreateFunction>
+	static void CreatePipelinesParallel(const CreateInfo* infos, uint32_t count, VkPipeline* outPipelines, const char* kind, CreateFunction create)
+	{
+		Timer timer;
+		std::atomic<uint32_t> failed = 0;
+		ParallelFor(count, [&](uint32_t i)
+		{
+			outPipelines[i] = nullptr;
+			if (create(VulkanContext::GetDevice(), s_Cache, 1, &infos[i], HostAllocator::GetCallbacks(HostSubsystem::Pipelines), &outPipelines[i]) != VK_SUCCESS)
+			{
+				outPipelines[i] = nullptr;
+				failed.fetch_add(1, std::memory_order_relaxed);
+			}
+		});
+
+		if (failed > 0)
+			LOG_ERROR("PipelineCache: {} of {} {} pipelines failed to compile", failed.load(), count, kind);
+		LOG_INFO("PipelineCache: Created {} {} pipelines in {:.2f} ms", count - failed.load(), kind, timer.ElapsedMillis());
+	}
+
+	void PipelineCache::CreateGraphicsPipelines(const VkGraphicsPipelineCreateInfo* infos, uint32_t count, VkPipeline* outPipelines)
+	{
+		TESTBED_ASSERT(s_Cache, "PipelineCache is not initialized!");
+		CreatePipelinesParallel(infos, count, outPipelines, "graphics", vkCreateGraphicsPipelines);
+	}
+
+	void PipelineCache::CreateComputePipelines(const VkComputePipelineCreateInfo* infos, uint32_t count, VkPipeline* outPipelines)
+	{
+		TESTBED_ASSERT(s_Cache, "PipelineCache is not initialized!");
+		CreatePipelinesParallel(infos, count, outPipelines, "compute", vkCreateComputePipelines);
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <filesystem>
+
+#include <vulkan/vulkan.h>
+
+namespace VulkanTestbed
+{
+	// One VkPipelineCache shared by every pipeline, persisted across runs. The file is only handed back to the driver
+	// when it was written by the same device and driver, so a GPU or driver update starts from an empty cache.
+	class PipelineCache
+	{
+	public:
+		// Needs VulkanContext, a missing or stale file is not an error
+		static void Init(const std::filesystem::path& path);
+		// Saves the cache
+		static void Shutdown();
+
+		static VkPipelineCache Get();
+		// Skipped when the driver has nothing new since the last load or save
+		static void Save();
+
+		// Compiles the pipelines on all job threads against the shared cache, outPipelines[i] is null when info i failed
+		static void CreateGraphicsPipelines(const VkGraphicsPipelineCreateInfo* infos, uint32_t count, VkPipeline* outPipelines);
+		static void CreateComputePipelines(const VkComputePipelineCreateInfo* infos, uint32_t count, VkPipeline* outPipelines);
+	};
+}
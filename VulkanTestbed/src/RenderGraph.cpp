@@ -0,0 +1,803 @@
+#include "pch.h"
+#include "RenderGraph.h"
+
+#include "Core/Hash.h"
+#include "Core/Profiler.h"
+#include "GpuProfiler.h"
+#include "HostAllocator.h"
+#include "VulkanContext.h"
+
+namespace VulkanTestbed
+{
+	struct AccessInfo
+	{
+		VkPipelineStageFlags2 Stages;
+		VkAccessFlags2 Access;
+		VkImageLayout Layout;
+		VkImageUsageFlags ImageUsage;
+		VkBufferUsageFlags BufferUsage;
+	};
+
+	// Only flags below bit 32 are used so barriers translate to vkCmdPipelineBarrier unchanged
+	static const AccessInfo AccessInfos[] =
+	{
+		// None
+		{ VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, 0, 0 },
+		// Acquired, the stage VulkanContext::EndFrame waits for the acquire semaphore at
+		{ VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, 0, 0 },
+		// ColorAttachment
+		{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0 },
+		// DepthAttachment
+		{ VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0 },
+		// DepthAttachmentRead
+		{ VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0 },
+		// SampledFragment
+		{ VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, 0 },
+		// SampledCompute
+		{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, 0 },
+		// StorageReadCompute
+		{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+		// StorageWriteCompute
+		{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+			VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+		// TransferRead
+		{ VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT },
+		// TransferWrite
+		{ VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_BUFFER_USAGE_TRANSFER_DST_BIT },
+		// VertexBuffer
+		{ VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT },
+		// IndexBuffer
+		{ VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDEX_BUFFER_BIT },
+		// IndirectBuffer
+		{ VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT },
+		// UniformBuffer
+		{ VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_UNIFORM_READ_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT },
+		// Present
+		{ VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, 0 }
+	};
+	static_assert(sizeof(AccessInfos) / sizeof(AccessInfos[0]) == (size_t)RenderAccess::Count, "Every RenderAccess needs an entry");
+
+	static constexpr VkAccessFlags2 WriteAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+	static const AccessInfo& GetAccessInfo(RenderAccess access)
+	{
+		return AccessInfos[(size_t)access];
+	}
+
+	static VkImageAspectFlags GetImageAspect(VkFormat format)
+	{
+		switch (format)
+		{
+			case VK_FORMAT_D16_UNORM:
+			case VK_FORMAT_X8_D24_UNORM_PACK32:
+			case VK_FORMAT_D32_SFLOAT:			return VK_IMAGE_ASPECT_DEPTH_BIT;
+			case VK_FORMAT_D16_UNORM_S8_UINT:
+			case VK_FORMAT_D24_UNORM_S8_UINT:
+			case VK_FORMAT_D32_SFLOAT_S8_UINT:	return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+			case VK_FORMAT_S8_UINT:				return VK_IMAGE_ASPECT_STENCIL_BIT;
+			default:							return VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+	}
+
+	static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Where the last accesses left a resource while walking the schedule
+	struct ResourceState
+	{
+		VkImageLayout Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		// Last write, or layout transition, and the reads that happened since
+		VkPipelineStageFlags2 WriteStages = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 WriteAccess = VK_ACCESS_2_NONE;
+		VkPipelineStageFlags2 ReadStages = VK_PIPELINE_STAGE_2_NONE;
+		// Where the last write has already been made visible
+		VkPipelineStageFlags2 VisibleStages = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 VisibleAccess = VK_ACCESS_2_NONE;
+	};
+
+	void RenderPassBuilder::Read(RenderResource resource, RenderAccess access)
+	{
+		TESTBED_ASSERT(resource < m_Graph.m_Resources.size(), "Unknown render graph resource!");
+		m_Graph.m_Passes[m_Pass].Accesses.push_back({ resource, access, false });
+	}
+
+	void RenderPassBuilder::Write(RenderResource resource, RenderAccess access)
+	{
+		TESTBED_ASSERT(resource < m_Graph.m_Resources.size(), "Unknown render graph resource!");
+		m_Graph.m_Passes[m_Pass].Accesses.push_back({ resource, access, true });
+	}
+
+	void RenderPassBuilder::SetSideEffects()
+	{
+		m_Graph.m_Passes[m_Pass].SideEffects = true;
+	}
+
+	VkImage RenderGraphResources::GetImage(RenderResource resource) const
+	{
+		return m_Graph.GetImage(resource);
+	}
+
+	VkImageView RenderGraphResources::GetImageView(RenderResource resource) const
+	{
+		return m_Graph.GetImageView(resource);
+	}
+
+	VkBuffer RenderGraphResources::GetBuffer(RenderResource resource) const
+	{
+		return m_Graph.GetBuffer(resource);
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		TESTBED_ASSERT(m_Physical.empty() && m_Retired.empty(), "RenderGraph::Release has to be called before the device goes away!");
+	}
+
+	void RenderGraph::Reset()
+	{
+		m_Resources.clear();
+		m_Passes.clear();
+	}
+
+	RenderResource RenderGraph::ImportImage(const char* name, VkImage image, VkImageView view, const RenderImageDesc& desc, RenderAccess initialAccess, RenderAccess finalAccess)
+	{
+		Resource& resource = m_Resources.emplace_back();
+		resource.Name = name;
+		resource.IsImage = true;
+		resource.Imported = true;
+		resource.ImageDesc = desc;
+		resource.InitialAccess = initialAccess;
+		resource.FinalAccess = finalAccess;
+		resource.Image = image;
+		resource.View = view;
+		return (RenderResource)m_Resources.size() - 1;
+	}
+
+	RenderResource RenderGraph::ImportBuffer(const char* name, VkBuffer buffer, const RenderBufferDesc& desc, RenderAccess initialAccess, RenderAccess finalAccess)
+	{
+		Resource& resource = m_Resources.emplace_back();
+		resource.Name = name;
+		resource.Imported = true;
+		resource.BufferDesc = desc;
+		resource.InitialAccess = initialAccess;
+		resource.FinalAccess = finalAccess;
+		resource.Buffer = buffer;
+		return (RenderResource)m_Resources.size() - 1;
+	}
+
+	RenderResource RenderGraph::CreateImage(const char* name, const RenderImageDesc& desc)
+	{
+		Resource& resource = m_Resources.emplace_back();
+		resource.Name = name;
+		resource.IsImage = true;
+		resource.ImageDesc = desc;
+		return (RenderResource)m_Resources.size() - 1;
+	}
+
+	RenderResource RenderGraph::CreateBuffer(const char* name, const RenderBufferDesc& desc)
+	{
+		Resource& resource = m_Resources.emplace_back();
+		resource.Name = name;
+		resource.BufferDesc = desc;
+		return (RenderResource)m_Resources.size() - 1;
+	}
+
+	void RenderGraph::AddPass(const char* name, const RenderPassSetup& setup, RenderPassExecute execute)
+	{
+		Pass& pass = m_Passes.emplace_back();
+		pass.Name = name;
+		pass.Execute = std::move(execute);
+
+		RenderPassBuilder builder(*this, (uint32_t)m_Passes.size() - 1);
+		setup(builder);
+	}
+
+	uint64_t RenderGraph::HashTopology() const
+	{
+		uint64_t hash = HashCombine(m_Resources.size(), m_Passes.size());
+		for (const Resource& resource : m_Resources)
+		{
+			hash = HashCombine(hash, (uint64_t)resource.IsImage | (uint64_t)resource.Imported << 1
+				| (uint64_t)resource.InitialAccess << 8 | (uint64_t)resource.FinalAccess << 16);
+			if (resource.IsImage)
+			{
+				hash = HashCombine(hash, (uint64_t)resource.ImageDesc.Format | (uint64_t)resource.ImageDesc.MipLevels << 32);
+				hash = HashCombine(hash, (uint64_t)resource.ImageDesc.Extent.width | (uint64_t)resource.ImageDesc.Extent.height << 32);
+				hash = HashCombine(hash, resource.ImageDesc.ArrayLayers);
+			}
+			else
+			{
+				hash = HashCombine(hash, resource.BufferDesc.Size);
+			}
+		}
+
+		for (const Pass& pass : m_Passes)
+		{
+			hash = HashCombine(hash, Hash64(pass.Name.data(), pass.Name.size()));
+			hash = HashCombine(hash, pass.SideEffects ? 1 : 0);
+			for (const PassAccess& access : pass.Accesses)
+				hash = HashCombine(hash, (uint64_t)access.Resource | (uint64_t)access.Access << 32 | (uint64_t)access.Write << 40);
+		}
+		return hash;
+	}
+
+	void RenderGraph::Cull(std::vector<bool>& outKeptPasses) const
+	{
+		// Imported resources are what the frame produces, walking backwards marks everything they depend on
+		std::vector<bool> needed(m_Resources.size());
+		for (size_t i = 0; i < m_Resources.size(); ++i)
+			needed[i] = m_Resources[i].Imported;
+
+		outKeptPasses.assign(m_Passes.size(), false);
+		for (size_t i = m_Passes.size(); i-- > 0;)
+		{
+			const Pass& pass = m_Passes[i];
+			bool keep = pass.SideEffects;
+			for (const PassAccess& access : pass.Accesses)
+				keep |= access.Write && needed[access.Resource];
+			if (!keep)
+				continue;
+
+			// Writes count as reads too, a pass drawing on top of an attachment needs whatever was there
+			outKeptPasses[i] = true;
+			for (const PassAccess& access : pass.Accesses)
+				needed[access.Resource] = true;
+		}
+	}
+
+	void RenderGraph::Compile()
+	{
+		TESTBED_PROFILE_FUNCTION();
+		DestroyRetiredResources(false);
+
+		const uint64_t hash = HashTopology();
+		if (m_Compiled && hash == m_TopologyHash)
+		{
+			++m_Stats.CacheHits;
+			return;
+		}
+
+		RetireTransientResources();
+		m_TopologyHash = hash;
+		m_Compiled = true;
+
+		std::vector<bool> keptPasses;
+		Cull(keptPasses);
+
+		m_Schedule.clear();
+		for (uint32_t i = 0; i < (uint32_t)m_Passes.size(); ++i)
+		{
+			if (keptPasses[i])
+				m_Schedule.push_back({ i, 0, 0 });
+		}
+
+		std::vector<uint32_t> firstUse(m_Resources.size(), ~0u);
+		std::vector<uint32_t> lastUse(m_Resources.size(), 0);
+		for (uint32_t step = 0; step < (uint32_t)m_Schedule.size(); ++step)
+		{
+			for (const PassAccess& access : m_Passes[m_Schedule[step].Pass].Accesses)
+			{
+				firstUse[access.Resource] = std::min(firstUse[access.Resource], step);
+				lastUse[access.Resource] = std::max(lastUse[access.Resource], step);
+			}
+		}
+
+		std::vector<std::vector<RenderResource>> aliases;
+		CreateTransientResources(firstUse, lastUse, aliases);
+		PlanBarriers(firstUse, lastUse, aliases);
+
+		m_Stats.Passes = (uint32_t)m_Passes.size();
+		m_Stats.CulledPasses = (uint32_t)(m_Passes.size() - m_Schedule.size());
+		m_Stats.BarrierBatches = m_FinalBarrierCount > 0 ? 1 : 0;
+		for (const ScheduledPass& scheduled : m_Schedule)
+			m_Stats.BarrierBatches += scheduled.BarrierCount > 0 ? 1 : 0;
+		m_Stats.ImageBarriers = 0;
+		m_Stats.BufferBarriers = 0;
+		for (const RenderBarrier& barrier : m_Barriers)
+			++(m_Resources[barrier.Resource].IsImage ? m_Stats.ImageBarriers : m_Stats.BufferBarriers);
+		++m_Stats.Compilations;
+
+		const double mb = 1.0 / (1024.0 * 1024.0);
+		LOG_INFO("RenderGraph: Compiled {} passes ({} culled), {} barrier batches with {} image and {} buffer barriers, {} transient resources in {:.1f} MB ({:.1f} MB unaliased)",
+			m_Schedule.size(), m_Stats.CulledPasses, m_Stats.BarrierBatches, m_Stats.ImageBarriers, m_Stats.BufferBarriers,
+			m_Stats.TransientResources, (double)m_Stats.TransientSize * mb, (double)m_Stats.UnaliasedSize * mb);
+	}
+
+	void RenderGraph::CreateTransientResources(const std::vector<uint32_t>& firstUse, const std::vector<uint32_t>& lastUse, std::vector<std::vector<RenderResource>>& outAliases)
+	{
+		const VkDevice device = VulkanContext::GetDevice();
+		const VkAllocationCallbacks* callbacks = HostAllocator::GetCallbacks(HostSubsystem::RenderGraph);
+
+		m_Physical.assign(m_Resources.size(), {});
+		outAliases.assign(m_Resources.size(), {});
+		m_Stats.TransientResources = 0;
+		m_Stats.TransientSize = 0;
+		m_Stats.UnaliasedSize = 0;
+
+		std::vector<VkImageUsageFlags> imageUsage(m_Resources.size(), 0);
+		std::vector<VkBufferUsageFlags> bufferUsage(m_Resources.size(), 0);
+		for (const ScheduledPass& scheduled : m_Schedule)
+		{
+			for (const PassAccess& access : m_Passes[scheduled.Pass].Accesses)
+			{
+				imageUsage[access.Resource] |= GetAccessInfo(access.Access).ImageUsage;
+				bufferUsage[access.Resource] |= GetAccessInfo(access.Access).BufferUsage;
+			}
+		}
+
+		struct Placement
+		{
+			RenderResource Resource;
+			VkMemoryRequirements Requirements;
+			VkDeviceSize Offset;
+		};
+		// Images and buffers go to separate memory so bufferImageGranularity never applies between them
+		std::vector<Placement> placements[2];
+
+		for (RenderResource r = 0; r < (RenderResource)m_Resources.size(); ++r)
+		{
+			const Resource& resource = m_Resources[r];
+			if (resource.Imported || firstUse[r] == ~0u)
+				continue;
+
+			PhysicalResource& physical = m_Physical[r];
+			VkMemoryRequirements requirements = {};
+			if (resource.IsImage)
+			{
+				VkImageCreateInfo imageCreateInfo = {};
+				imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+				imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+				imageCreateInfo.format = resource.ImageDesc.Format;
+				imageCreateInfo.extent = { resource.ImageDesc.Extent.width, resource.ImageDesc.Extent.height, 1 };
+				imageCreateInfo.mipLevels = resource.ImageDesc.MipLevels;
+				imageCreateInfo.arrayLayers = resource.ImageDesc.ArrayLayers;
+				imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+				imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+				imageCreateInfo.usage = imageUsage[r];
+				imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+				imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				VkResult result = vkCreateImage(device, &imageCreateInfo, callbacks, &physical.Image);
+				TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create transient image!");
+				vkGetImageMemoryRequirements(device, physical.Image, &requirements);
+			}
+			else
+			{
+				VkBufferCreateInfo bufferCreateInfo = {};
+				bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+				bufferCreateInfo.size = resource.BufferDesc.Size;
+				bufferCreateInfo.usage = bufferUsage[r];
+				bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+				VkResult result = vkCreateBuffer(device, &bufferCreateInfo, callbacks, &physical.Buffer);
+				TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create transient buffer!");
+				vkGetBufferMemoryRequirements(device, physical.Buffer, &requirements);
+			}
+
+			placements[resource.IsImage ? 1 : 0].push_back({ r, requirements, 0 });
+			m_Stats.UnaliasedSize += AlignUp(requirements.size, requirements.alignment);
+			++m_Stats.TransientResources;
+		}
+
+		auto livesOverlap = [&](RenderResource a, RenderResource b) { return firstUse[a] <= lastUse[b] && firstUse[b] <= lastUse[a]; };
+
+		for (uint32_t kind = 0; kind < 2; ++kind)
+		{
+			std::vector<Placement>& heap = placements[kind];
+			if (heap.empty())
+				continue;
+
+			// Largest first, each at the lowest offset that is free for its whole lifetime
+			std::stable_sort(heap.begin(), heap.end(), [](const Placement& a, const Placement& b) { return a.Requirements.size > b.Requirements.size; });
+
+			VkMemoryRequirements heapRequirements = { 0, 1, ~0u };
+			std::vector<const Placement*> conflicts;
+			for (size_t i = 0; i < heap.size(); ++i)
+			{
+				Placement& placement = heap[i];
+				conflicts.clear();
+				for (size_t j = 0; j < i; ++j)
+				{
+					if (livesOverlap(placement.Resource, heap[j].Resource))
+						conflicts.push_back(&heap[j]);
+				}
+				std::sort(conflicts.begin(), conflicts.end(), [](const Placement* a, const Placement* b) { return a->Offset < b->Offset; });
+
+				VkDeviceSize offset = 0;
+				for (const Placement* conflict : conflicts)
+				{
+					if (AlignUp(offset, placement.Requirements.alignment) + placement.Requirements.size <= conflict->Offset)
+						break;
+					offset = std::max(offset, conflict->Offset + conflict->Requirements.size);
+				}
+				placement.Offset = AlignUp(offset, placement.Requirements.alignment);
+
+				heapRequirements.size = std::max(heapRequirements.size, placement.Offset + placement.Requirements.size);
+				heapRequirements.alignment = std::max(heapRequirements.alignment, placement.Requirements.alignment);
+				heapRequirements.memoryTypeBits &= placement.Requirements.memoryTypeBits;
+			}
+			TESTBED_ASSERT(heapRequirements.memoryTypeBits != 0, "Transient resources have no memory type in common!");
+
+			// Resources sharing memory, which only ever happens between disjoint lifetimes
+			for (const Placement& a : heap)
+			{
+				for (const Placement& b : heap)
+				{
+					const bool memoryOverlaps = a.Offset < b.Offset + b.Requirements.size && b.Offset < a.Offset + a.Requirements.size;
+					if (memoryOverlaps && a.Resource != b.Resource)
+						outAliases[a.Resource].push_back(b.Resource);
+				}
+			}
+
+			DeviceAllocation& memory = kind == 1 ? m_ImageMemory : m_BufferMemory;
+			memory = VulkanContext::GetAllocator().Allocate(heapRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				kind == 1 ? DeviceResourceKind::Optimal : DeviceResourceKind::Linear);
+			TESTBED_ASSERT(memory.Memory, "Failed to allocate transient memory!");
+			m_Stats.TransientSize += heapRequirements.size;
+
+			for (const Placement& placement : heap)
+			{
+				PhysicalResource& physical = m_Physical[placement.Resource];
+				if (physical.Image)
+					vkBindImageMemory(device, physical.Image, memory.Memory, memory.Offset + placement.Offset);
+				else
+					vkBindBufferMemory(device, physical.Buffer, memory.Memory, memory.Offset + placement.Offset);
+			}
+		}
+
+		for (RenderResource r = 0; r < (RenderResource)m_Resources.size(); ++r)
+		{
+			PhysicalResource& physical = m_Physical[r];
+			if (!physical.Image)
+				continue;
+
+			const RenderImageDesc& desc = m_Resources[r].ImageDesc;
+			VkImageViewCreateInfo viewCreateInfo = {};
+			viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewCreateInfo.image = physical.Image;
+			viewCreateInfo.viewType = desc.ArrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+			viewCreateInfo.format = desc.Format;
+			viewCreateInfo.subresourceRange = { GetImageAspect(desc.Format), 0, desc.MipLevels, 0, desc.ArrayLayers };
+			VkResult result = vkCreateImageView(device, &viewCreateInfo, callbacks, &physical.View);
+			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create transient image view!");
+		}
+	}
+
+	void RenderGraph::PlanBarriers(const std::vector<uint32_t>& firstUse, const std::vector<uint32_t>& lastUse, const std::vector<std::vector<RenderResource>>& aliases)
+	{
+		m_Barriers.clear();
+		std::vector<ResourceState> states(m_Resources.size());
+		std::vector<bool> touched(m_Resources.size(), false);
+
+		// Stages and access of the last pass using each resource, which is where the previous frame left it
+		std::vector<VkPipelineStageFlags2> lastStages(m_Resources.size(), VK_PIPELINE_STAGE_2_NONE);
+		std::vector<VkAccessFlags2> lastAccess(m_Resources.size(), VK_ACCESS_2_NONE);
+		for (uint32_t step = 0; step < (uint32_t)m_Schedule.size(); ++step)
+		{
+			for (const PassAccess& access : m_Passes[m_Schedule[step].Pass].Accesses)
+			{
+				if (lastUse[access.Resource] != step)
+					continue;
+
+				lastStages[access.Resource] |= GetAccessInfo(access.Access).Stages;
+				lastAccess[access.Resource] |= GetAccessInfo(access.Access).Access;
+			}
+		}
+
+		for (RenderResource r = 0; r < (RenderResource)m_Resources.size(); ++r)
+		{
+			const Resource& resource = m_Resources[r];
+			if (!resource.Imported)
+				continue;
+
+			const AccessInfo& initial = GetAccessInfo(resource.InitialAccess);
+			ResourceState& state = states[r];
+			state.Layout = resource.IsImage ? initial.Layout : VK_IMAGE_LAYOUT_UNDEFINED;
+			if (initial.Access & WriteAccessMask)
+			{
+				state.WriteStages = initial.Stages;
+				state.WriteAccess = initial.Access & WriteAccessMask;
+			}
+			else
+			{
+				state.ReadStages = initial.Stages;
+			}
+		}
+
+		auto transition = [&](RenderResource r, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout, bool write)
+		{
+			ResourceState& state = states[r];
+			if (!touched[r] && !m_Resources[r].Imported)
+			{
+				touched[r] = true;
+				// The plan is replayed every frame on the same images and memory, so the previous frame's last uses of
+				// this resource and of everything aliasing it may still be running. Queue order makes waiting on their
+				// stages enough.
+				state.WriteStages |= lastStages[r];
+				state.WriteAccess |= lastAccess[r] & WriteAccessMask;
+				for (RenderResource alias : aliases[r])
+				{
+					state.WriteStages |= lastStages[alias];
+					state.WriteAccess |= lastAccess[alias] & WriteAccessMask;
+					// Aliased memory: whatever the earlier occupants did this frame has to be done before the contents get clobbered
+					if (lastUse[alias] < firstUse[r])
+					{
+						state.WriteStages |= states[alias].WriteStages | states[alias].ReadStages;
+						state.WriteAccess |= states[alias].WriteAccess;
+					}
+				}
+			}
+
+			if (!m_Resources[r].IsImage)
+				layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			const bool layoutChange = layout != state.Layout;
+
+			if (write || layoutChange)
+			{
+				// Write after write needs the memory dependency, write after read only the execution one
+				const VkPipelineStageFlags2 srcStages = state.WriteStages | state.ReadStages;
+				if (layoutChange || srcStages != VK_PIPELINE_STAGE_2_NONE)
+					m_Barriers.push_back({ r, srcStages, state.WriteAccess, stages, access, state.Layout, layout });
+
+				state.Layout = layout;
+				if (write)
+				{
+					state.WriteStages = stages;
+					state.WriteAccess = access & WriteAccessMask;
+					state.ReadStages = VK_PIPELINE_STAGE_2_NONE;
+					state.VisibleStages = VK_PIPELINE_STAGE_2_NONE;
+					state.VisibleAccess = VK_ACCESS_2_NONE;
+				}
+				else
+				{
+					// The transition is a write of its own, made visible to this read by the same barrier
+					state.WriteStages = stages;
+					state.WriteAccess = VK_ACCESS_2_NONE;
+					state.ReadStages = stages;
+					state.VisibleStages = stages;
+					state.VisibleAccess = access;
+				}
+				return;
+			}
+
+			// Read after read in the same layout only needs the last write made visible to the new stages
+			const bool pendingWrite = state.WriteStages != VK_PIPELINE_STAGE_2_NONE;
+			if (pendingWrite && ((stages & ~state.VisibleStages) || (access & ~state.VisibleAccess)))
+			{
+				m_Barriers.push_back({ r, state.WriteStages, state.WriteAccess, stages, access, layout, layout });
+				state.VisibleStages |= stages;
+				state.VisibleAccess |= access;
+			}
+			state.ReadStages |= stages;
+		};
+
+		struct CombinedAccess
+		{
+			RenderResource Resource;
+			VkPipelineStageFlags2 Stages;
+			VkAccessFlags2 Access;
+			VkImageLayout Layout;
+			bool Write;
+		};
+		std::vector<CombinedAccess> combined;
+
+		for (ScheduledPass& scheduled : m_Schedule)
+		{
+			// All accesses of a pass to one resource become one barrier, so they have to agree on the layout
+			combined.clear();
+			for (const PassAccess& access : m_Passes[scheduled.Pass].Accesses)
+			{
+				const AccessInfo& info = GetAccessInfo(access.Access);
+				auto it = std::find_if(combined.begin(), combined.end(), [&](const CombinedAccess& c) { return c.Resource == access.Resource; });
+				if (it == combined.end())
+				{
+					combined.push_back({ access.Resource, info.Stages, info.Access, info.Layout, access.Write });
+					continue;
+				}
+
+				TESTBED_ASSERT(!m_Resources[access.Resource].IsImage || it->Layout == info.Layout, "A pass accesses an image in two different layouts!");
+				it->Stages |= info.Stages;
+				it->Access |= info.Access;
+				it->Write |= access.Write;
+			}
+
+			scheduled.FirstBarrier = (uint32_t)m_Barriers.size();
+			for (const CombinedAccess& access : combined)
+				transition(access.Resource, access.Stages, access.Access, access.Layout, access.Write);
+			scheduled.BarrierCount = (uint32_t)m_Barriers.size() - scheduled.FirstBarrier;
+		}
+
+		m_FinalBarrierFirst = (uint32_t)m_Barriers.size();
+		for (RenderResource r = 0; r < (RenderResource)m_Resources.size(); ++r)
+		{
+			const Resource& resource = m_Resources[r];
+			if (!resource.Imported)
+				continue;
+
+			const AccessInfo& final = GetAccessInfo(resource.FinalAccess);
+			transition(r, final.Stages, final.Access, final.Layout, (final.Access & WriteAccessMask) != 0);
+		}
+		m_FinalBarrierCount = (uint32_t)m_Barriers.size() - m_FinalBarrierFirst;
+	}
+
+	void RenderGraph::Execute(VkCommandBuffer commandBuffer)
+	{
+		TESTBED_PROFILE_FUNCTION();
+		TESTBED_ASSERT(m_Compiled && HashTopology() == m_TopologyHash, "RenderGraph has to be compiled after the declaration changed!");
+
+		const RenderGraphResources resources(*this);
+		for (const ScheduledPass& scheduled : m_Schedule)
+		{
+			RecordBarriers(commandBuffer, scheduled.FirstBarrier, scheduled.BarrierCount);
+			const Pass& pass = m_Passes[scheduled.Pass];
+			if (pass.Execute)
+			{
+				[[maybe_unused]] const char* profileName = Profiler::IsInitialized() ? Profiler::InternName(pass.Name) : nullptr;
+				TESTBED_PROFILE_SCOPE(profileName);
+				TESTBED_PROFILE_GPU_SCOPE(commandBuffer, profileName);
+				pass.Execute(commandBuffer, resources);
+			}
+		}
+		RecordBarriers(commandBuffer, m_FinalBarrierFirst, m_FinalBarrierCount);
+	}
+
+	void RenderGraph::RecordBarriers(VkCommandBuffer commandBuffer, uint32_t firstBarrier, uint32_t barrierCount)
+	{
+		if (barrierCount == 0)
+			return;
+
+		std::vector<VkImageMemoryBarrier2>& imageBarriers = m_ImageBarrierScratch;
+		std::vector<VkBufferMemoryBarrier2>& bufferBarriers = m_BufferBarrierScratch;
+		imageBarriers.clear();
+		bufferBarriers.clear();
+		for (uint32_t i = firstBarrier; i < firstBarrier + barrierCount; ++i)
+		{
+			const RenderBarrier& barrier = m_Barriers[i];
+			const Resource& resource = m_Resources[barrier.Resource];
+			if (resource.IsImage)
+			{
+				VkImageMemoryBarrier2& imageBarrier = imageBarriers.emplace_back();
+				imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+				imageBarrier.srcStageMask = barrier.SrcStages;
+				imageBarrier.srcAccessMask = barrier.SrcAccess;
+				imageBarrier.dstStageMask = barrier.DstStages;
+				imageBarrier.dstAccessMask = barrier.DstAccess;
+				imageBarrier.oldLayout = barrier.OldLayout;
+				imageBarrier.newLayout = barrier.NewLayout;
+				imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageBarrier.image = GetImage(barrier.Resource);
+				imageBarrier.subresourceRange = { GetImageAspect(resource.ImageDesc.Format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+			}
+			else
+			{
+				VkBufferMemoryBarrier2& bufferBarrier = bufferBarriers.emplace_back();
+				bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+				bufferBarrier.srcStageMask = barrier.SrcStages;
+				bufferBarrier.srcAccessMask = barrier.SrcAccess;
+				bufferBarrier.dstStageMask = barrier.DstStages;
+				bufferBarrier.dstAccessMask = barrier.DstAccess;
+				bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.buffer = GetBuffer(barrier.Resource);
+				bufferBarrier.offset = 0;
+				bufferBarrier.size = VK_WHOLE_SIZE;
+			}
+		}
+
+		VkDependencyInfo dependencyInfo = {};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.bufferMemoryBarrierCount = (uint32_t)bufferBarriers.size();
+		dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+		dependencyInfo.imageMemoryBarrierCount = (uint32_t)imageBarriers.size();
+		dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+		VulkanContext::CmdPipelineBarrier2(commandBuffer, dependencyInfo);
+	}
+
+	void RenderGraph::RetireTransientResources()
+	{
+		if (m_Physical.empty() && !m_ImageMemory.Memory && !m_BufferMemory.Memory)
+			return;
+
+		// Frames still in flight may use them, the one being recorded is the last that could
+		RetiredResources& retired = m_Retired.emplace_back();
+		retired.Resources = std::move(m_Physical);
+		retired.ImageMemory = m_ImageMemory;
+		retired.BufferMemory = m_BufferMemory;
+		retired.TimelineValue = VulkanContext::GetFrameTimelineValue();
+
+		m_Physical.clear();
+		m_ImageMemory = {};
+		m_BufferMemory = {};
+	}
+
+	void RenderGraph::DestroyRetiredResources(bool waitForGpu)
+	{
+		if (m_Retired.empty())
+			return;
+
+		const VkDevice device = VulkanContext::GetDevice();
+		const VkAllocationCallbacks* callbacks = HostAllocator::GetCallbacks(HostSubsystem::RenderGraph);
+		const uint64_t completed = waitForGpu ? ~0ull : VulkanContext::GetCompletedTimelineValue();
+
+		auto it = std::remove_if(m_Retired.begin(), m_Retired.end(), [&](RetiredResources& retired)
+		{
+			if (retired.TimelineValue > completed)
+				return false;
+
+			for (PhysicalResource& physical : retired.Resources)
+			{
+				if (physical.View)
+					vkDestroyImageView(device, physical.View, callbacks);
+				if (physical.Image)
+					vkDestroyImage(device, physical.Image, callbacks);
+				if (physical.Buffer)
+					vkDestroyBuffer(device, physical.Buffer, callbacks);
+			}
+			if (retired.ImageMemory.Memory)
+				VulkanContext::GetAllocator().Free(retired.ImageMemory);
+			if (retired.BufferMemory.Memory)
+				VulkanContext::GetAllocator().Free(retired.BufferMemory);
+			return true;
+		});
+		m_Retired.erase(it, m_Retired.end());
+	}
+
+	void RenderGraph::Release()
+	{
+		VulkanContext::WaitIdle();
+		RetireTransientResources();
+		DestroyRetiredResources(true);
+		m_Compiled = false;
+		m_Schedule.clear();
+		m_Barriers.clear();
+	}
+
+	void RenderGraph::LogSchedule() const
+	{
+		LOG_INFO("RenderGraph schedule:");
+		for (const ScheduledPass& scheduled : m_Schedule)
+			LOG_INFO("\t{:<24} | {} barriers", m_Passes[scheduled.Pass].Name, scheduled.BarrierCount);
+		LOG_INFO("\t{:<24} | {} barriers", "(final)", m_FinalBarrierCount);
+	}
+
+	bool RenderGraph::IsPassCulled(uint32_t pass) const
+	{
+		return std::none_of(m_Schedule.begin(), m_Schedule.end(), [&](const ScheduledPass& scheduled) { return scheduled.Pass == pass; });
+	}
+
+	void RenderGraph::GetPassBarriers(uint32_t pass, std::vector<RenderBarrier>& outBarriers) const
+	{
+		outBarriers.clear();
+		for (const ScheduledPass& scheduled : m_Schedule)
+		{
+			if (scheduled.Pass == pass)
+				outBarriers.assign(m_Barriers.begin() + scheduled.FirstBarrier, m_Barriers.begin() + scheduled.FirstBarrier + scheduled.BarrierCount);
+		}
+	}
+
+	void RenderGraph::GetFinalBarriers(std::vector<RenderBarrier>& outBarriers) const
+	{
+		outBarriers.assign(m_Barriers.begin() + m_FinalBarrierFirst, m_Barriers.begin() + m_FinalBarrierFirst + m_FinalBarrierCount);
+	}
+
+	VkImage RenderGraph::GetImage(RenderResource resource) const
+	{
+		return m_Resources[resource].Imported ? m_Resources[resource].Image : m_Physical[resource].Image;
+	}
+
+	VkImageView RenderGraph::GetImageView(RenderResource resource) const
+	{
+		return m_Resources[resource].Imported ? m_Resources[resource].View : m_Physical[resource].View;
+	}
+
+	VkBuffer RenderGraph::GetBuffer(RenderResource resource) const
+	{
+		return m_Resources[resource].Imported ? m_Resources[resource].Buffer : m_Physical[resource].Buffer;
+	}
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "DeviceAllocator.h"
+
+namespace VulkanTestbed
+{
+	using RenderResource = uint32_t;
+	static constexpr RenderResource InvalidRenderResource = ~0u;
+
+	// How a pass touches a resource. Each one maps to the stages, access flags, image layout and usage barriers
+	// and transient resources are derived from.
+	enum class RenderAccess : uint8_t
+	{
+		// Contents are undefined, only valid as the initial access of an imported resource
+		None = 0,
+		// Undefined as well, but only usable from the transfer stage on, where frames wait for the swapchain acquire
+		Acquired,
+		ColorAttachment,
+		DepthAttachment,
+		DepthAttachmentRead,
+		SampledFragment,
+		SampledCompute,
+		StorageReadCompute,
+		StorageWriteCompute,
+		TransferRead,
+		TransferWrite,
+		VertexBuffer,
+		IndexBuffer,
+		IndirectBuffer,
+		UniformBuffer,
+		Present,
+
+		Count
+	};
+
+	struct RenderImageDesc
+	{
+		VkFormat Format = VK_FORMAT_UNDEFINED;
+		VkExtent2D Extent = {};
+		uint32_t MipLevels = 1;
+		uint32_t ArrayLayers = 1;
+	};
+
+	struct RenderBufferDesc
+	{
+		VkDeviceSize Size = 0;
+	};
+
+	struct RenderBarrier
+	{
+		RenderResource Resource;
+		VkPipelineStageFlags2 SrcStages;
+		VkAccessFlags2 SrcAccess;
+		VkPipelineStageFlags2 DstStages;
+		VkAccessFlags2 DstAccess;
+		VkImageLayout OldLayout;
+		VkImageLayout NewLayout;
+	};
+
+	class RenderGraph;
+
+	class RenderPassBuilder
+	{
+	public:
+		void Read(RenderResource resource, RenderAccess access);
+		void Write(RenderResource resource, RenderAccess access);
+		// Keeps the pass even when nothing reads what it writes, for readbacks and queries
+		void SetSideEffects();
+
+	private:
+		RenderPassBuilder(RenderGraph& graph, uint32_t pass)
+			: m_Graph(graph), m_Pass(pass) {}
+
+	private:
+		RenderGraph& m_Graph;
+		uint32_t m_Pass;
+
+		friend class RenderGraph;
+	};
+
+	// Resolves the resources of the frame being executed
+	class RenderGraphResources
+	{
+	public:
+		VkImage GetImage(RenderResource resource) const;
+		// Whole image, null for imported images that came without a view
+		VkImageView GetImageView(RenderResource resource) const;
+		VkBuffer GetBuffer(RenderResource resource) const;
+
+	private:
+		RenderGraphResources(const RenderGraph& graph)
+			: m_Graph(graph) {}
+
+	private:
+		const RenderGraph& m_Graph;
+
+		friend class RenderGraph;
+	};
+
+	using RenderPassSetup = std::function<void(RenderPassBuilder& builder)>;
+	using RenderPassExecute = std::function<void(VkCommandBuffer commandBuffer, const RenderGraphResources& resources)>;
+
+	struct RenderGraphStatistics
+	{
+		uint32_t Passes = 0;
+		uint32_t CulledPasses = 0;
+		// vkCmdPipelineBarrier2 calls per execution and the barriers they carry
+		uint32_t BarrierBatches = 0;
+		uint32_t ImageBarriers = 0;
+		uint32_t BufferBarriers = 0;
+		uint32_t TransientResources = 0;
+		// Memory backing the transient resources, and what they would take without aliasing
+		VkDeviceSize TransientSize = 0;
+		VkDeviceSize UnaliasedSize = 0;
+
+		uint32_t Compilations = 0;
+		uint32_t CacheHits = 0;
+	};
+
+	// Declared from scratch every frame: resources, then passes with the accesses they make. Compile culls passes that
+	// contribute nothing to an imported resource, plans one batch of barriers per pass and places transient resources
+	// with disjoint lifetimes on the same memory. The plan is reused as long as the declared topology doesn't change,
+	// only the imported handles and the execute functions are taken from the new declaration.
+	class RenderGraph
+	{
+	public:
+		RenderGraph() = default;
+		~RenderGraph();
+
+		RenderGraph(const RenderGraph&) = delete;
+		RenderGraph& operator=(const RenderGraph&) = delete;
+
+		// Starts the next declaration
+		void Reset();
+
+		// The graph transitions the resource from initialAccess on entry to finalAccess after the last pass
+		RenderResource ImportImage(const char* name, VkImage image, VkImageView view, const RenderImageDesc& desc, RenderAccess initialAccess, RenderAccess finalAccess);
+		RenderResource ImportBuffer(const char* name, VkBuffer buffer, const RenderBufferDesc& desc, RenderAccess initialAccess, RenderAccess finalAccess);
+		// Owned by the graph, the contents are undefined before the first pass that uses them
+		RenderResource CreateImage(const char* name, const RenderImageDesc& desc);
+		RenderResource CreateBuffer(const char* name, const RenderBufferDesc& desc);
+
+		void AddPass(const char* name, const RenderPassSetup& setup, RenderPassExecute execute);
+
+		void Compile();
+		// Between VulkanContext::BeginFrame and EndFrame
+		void Execute(VkCommandBuffer commandBuffer);
+
+		// Frees the transient resources once the GPU is done with them, call before VulkanContext::Shutdown
+		void Release();
+
+		const RenderGraphStatistics& GetStatistics() const { return m_Stats; }
+		void LogSchedule() const;
+
+		// Compiled plan, passes are indexed in declaration order
+		bool IsPassCulled(uint32_t pass) const;
+		// Recorded right before the pass, empty for culled passes
+		void GetPassBarriers(uint32_t pass, std::vector<RenderBarrier>& outBarriers) const;
+		// Recorded after the last pass, moves imported resources to their final access
+		void GetFinalBarriers(std::vector<RenderBarrier>& outBarriers) const;
+
+	private:
+		struct Resource
+		{
+			std::string Name;
+			bool IsImage = false;
+			bool Imported = false;
+			RenderImageDesc ImageDesc;
+			RenderBufferDesc BufferDesc;
+			RenderAccess InitialAccess = RenderAccess::None;
+			RenderAccess FinalAccess = RenderAccess::None;
+
+			// Imported handles, transient ones live in the compiled state
+			VkImage Image = nullptr;
+			VkImageView View = nullptr;
+			VkBuffer Buffer = nullptr;
+		};
+
+		struct PassAccess
+		{
+			RenderResource Resource;
+			RenderAccess Access;
+			bool Write;
+		};
+
+		struct Pass
+		{
+			std::string Name;
+			std::vector<PassAccess> Accesses;
+			RenderPassExecute Execute;
+			bool SideEffects = false;
+		};
+
+		struct ScheduledPass
+		{
+			uint32_t Pass;
+			uint32_t FirstBarrier;
+			uint32_t BarrierCount;
+		};
+
+		struct PhysicalResource
+		{
+			VkImage Image = nullptr;
+			VkImageView View = nullptr;
+			VkBuffer Buffer = nullptr;
+		};
+
+		// Transient resources of a previous compilation, destroyed once the GPU passed TimelineValue
+		struct RetiredResources
+		{
+			std::vector<PhysicalResource> Resources;
+			DeviceAllocation ImageMemory;
+			DeviceAllocation BufferMemory;
+			uint64_t TimelineValue = 0;
+		};
+
+		uint64_t HashTopology() const;
+		void Cull(std::vector<bool>& outKeptPasses) const;
+		void CreateTransientResources(const std::vector<uint32_t>& firstUse, const std::vector<uint32_t>& lastUse, std::vector<std::vector<RenderResource>>& outAliases);
+		void PlanBarriers(const std::vector<uint32_t>& firstUse, const std::vector<uint32_t>& lastUse, const std::vector<std::vector<RenderResource>>& aliases);
+		void RetireTransientResources();
+		void DestroyRetiredResources(bool waitForGpu);
+		void RecordBarriers(VkCommandBuffer commandBuffer, uint32_t firstBarrier, uint32_t barrierCount);
+
+		VkImage GetImage(RenderResource resource) const;
+		VkImageView GetImageView(RenderResource resource) const;
+		VkBuffer GetBuffer(RenderResource resource) const;
+
+	private:
+		// Current declaration
+		std::vector<Resource> m_Resources;
+		std::vector<Pass> m_Passes;
+
+		// Compiled state
+		uint64_t m_TopologyHash = 0;
+		bool m_Compiled = false;
+		std::vector<ScheduledPass> m_Schedule;
+		std::vector<RenderBarrier> m_Barriers;
+		uint32_t m_FinalBarrierFirst = 0;
+		uint32_t m_FinalBarrierCount = 0;
+		std::vector<PhysicalResource> m_Physical;
+		DeviceAllocation m_ImageMemory;
+		DeviceAllocation m_BufferMemory;
+
+		std::vector<RetiredResources> m_Retired;
+		RenderGraphStatistics m_Stats;
+
+		// Reused by every batch so recording doesn't allocate once they reached their largest size
+		std::vector<VkImageMemoryBarrier2> m_ImageBarrierScratch;
+		std::vector<VkBufferMemoryBarrier2> m_BufferBarrierScratch;
+
+		friend class RenderPassBuilder;
+		friend class RenderGraphResources;
+	};
+}
@@ -0,0 +1,80 @@
+#include "pch.h"
+#include "RenderQueue.h"
+
+#include "Core/JobSystem.h"
+#include "Core/RadixSort.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t GatherGrainSize = 1u << 14;
+
+	void RenderQueue::Reserve(uint32_t drawCount)
+	{
+		m_Keys.reserve(drawCount);
+		m_Draws.reserve(drawCount);
+		m_Order.reserve(drawCount);
+		m_ScratchKeys.reserve(drawCount);
+		m_ScratchOrder.reserve(drawCount);
+		m_SortedPayloads.reserve(drawCount);
+	}
+
+	void RenderQueue::Reset()
+	{
+		m_Keys.clear();
+		m_Draws.clear();
+		m_Batches.clear();
+		m_SortedPayloads.clear();
+		m_Statistics = {};
+	}
+
+	void RenderQueue::Sort()
+	{
+		const uint32_t drawCount = GetDrawCount();
+		m_Order.resize(drawCount);
+		m_ScratchKeys.resize(drawCount);
+		m_ScratchOrder.resize(drawCount);
+		m_SortedPayloads.resize(drawCount);
+		m_Batches.clear();
+		m_Statistics = {};
+		m_Statistics.Draws = drawCount;
+		if (drawCount == 0)
+			return;
+
+		for (uint32_t i = 0; i < drawCount; ++i)
+			m_Order[i] = i;
+		RadixSort(m_Keys.data(), m_Order.data(), m_ScratchKeys.data(), m_ScratchOrder.data(), drawCount);
+
+		// Scratch is free again and holds the sorted geometry, so merging reads everything sequentially
+		std::vector<uint32_t>& sortedGeometry = m_ScratchOrder;
+		ParallelForRange(drawCount, GatherGrainSize, [this, &sortedGeometry](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				const Draw& draw = m_Draws[m_Order[i]];
+				sortedGeometry[i] = draw.Geometry;
+				m_SortedPayloads[i] = draw.Payload;
+			}
+		});
+
+		// Depth only orders draws within a state, it doesn't keep them from being instanced together
+		DrawBatch batch = { m_Keys[0], sortedGeometry[0], 0, 1 };
+		m_Statistics.PipelineBinds = 1;
+		m_Statistics.StateBinds = 1;
+		for (uint32_t i = 1; i < drawCount; ++i)
+		{
+			const uint64_t key = m_Keys[i];
+			if (((key ^ batch.Key) & DrawKey::StateMask) == 0 && sortedGeometry[i] == batch.Geometry)
+			{
+				++batch.InstanceCount;
+				continue;
+			}
+
+			m_Statistics.PipelineBinds += ((key ^ batch.Key) & DrawKey::PipelineMask) != 0;
+			m_Statistics.StateBinds += ((key ^ batch.Key) & DrawKey::StateMask) != 0;
+			m_Batches.push_back(batch);
+			batch = { key, sortedGeometry[i], i, 1 };
+		}
+		m_Batches.push_back(batch);
+		m_Statistics.Batches = (uint32_t)m_Batches.size();
+	}
+}
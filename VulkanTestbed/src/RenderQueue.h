@@ -0,0 +1,103 @@
+#pragma once
+
+namespace VulkanTestbed
+{
+	// Packed from the most to the least significant bits, so sorting by key groups draws by pass first, then by
+	// pipeline and material, and orders them by depth within the same state
+	struct DrawKey
+	{
+		static constexpr uint32_t PassBits = 8;
+		static constexpr uint32_t PipelineBits = 16;
+		static constexpr uint32_t MaterialBits = 24;
+		static constexpr uint32_t DepthBits = 16;
+
+		static constexpr uint32_t DepthShift = 0;
+		static constexpr uint32_t MaterialShift = DepthShift + DepthBits;
+		static constexpr uint32_t PipelineShift = MaterialShift + MaterialBits;
+		static constexpr uint32_t PassShift = PipelineShift + PipelineBits;
+
+		// Everything that needs a bind when it changes
+		static constexpr uint64_t StateMask = ~((1ull << MaterialShift) - 1);
+		static constexpr uint64_t PipelineMask = ~((1ull << PipelineShift) - 1);
+
+		static uint64_t Make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t depthBucket)
+		{
+			TESTBED_ASSERT(pass < (1u << PassBits) && pipeline < (1u << PipelineBits) && material < (1u << MaterialBits) && depthBucket < (1u << DepthBits));
+			return ((uint64_t)pass << PassShift) | ((uint64_t)pipeline << PipelineShift) | ((uint64_t)material << MaterialShift) | ((uint64_t)depthBucket << DepthShift);
+		}
+
+		// Depth normalized to [0, 1], front to back for opaque passes and back to front for blended ones
+		static uint32_t DepthBucket(float depth, bool backToFront = false)
+		{
+			const float clamped = std::clamp(backToFront ? 1.0f - depth : depth, 0.0f, 1.0f);
+			return (uint32_t)(clamped * (float)((1u << DepthBits) - 1) + 0.5f);
+		}
+
+		static uint32_t GetPass(uint64_t key) { return (uint32_t)(key >> PassShift) & ((1u << PassBits) - 1); }
+		static uint32_t GetPipeline(uint64_t key) { return (uint32_t)(key >> PipelineShift) & ((1u << PipelineBits) - 1); }
+		static uint32_t GetMaterial(uint64_t key) { return (uint32_t)(key >> MaterialShift) & ((1u << MaterialBits) - 1); }
+	};
+
+	// Consecutive sorted draws with the same state and geometry, drawn with one instanced call. Instance i reads
+	// the payload at FirstInstance + i of the sorted payloads, which is what gl_InstanceIndex indexes when
+	// FirstInstance is passed as firstInstance.
+	struct DrawBatch
+	{
+		uint64_t Key = 0;
+		uint32_t Geometry = 0;
+		uint32_t FirstInstance = 0;
+		uint32_t InstanceCount = 0;
+	};
+
+	struct RenderQueueStatistics
+	{
+		uint32_t Draws = 0;
+		uint32_t Batches = 0;
+		uint32_t PipelineBinds = 0;
+		// Pipeline or material changes, each needs at least a descriptor bind
+		uint32_t StateBinds = 0;
+	};
+
+	// Draws are submitted in any order with a key and the geometry they draw, and come out sorted and merged into
+	// instanced batches. The payload is opaque to the queue, usually an index into the frame's instance data.
+	// Submission is single threaded, Sort spreads over the job threads for large queues.
+	class RenderQueue
+	{
+	public:
+		void Reserve(uint32_t drawCount);
+		void Reset();
+
+		void Submit(uint64_t key, uint32_t geometry, uint32_t payload)
+		{
+			m_Keys.push_back(key);
+			m_Draws.push_back({ geometry, payload });
+		}
+
+		// Once per frame after the last Submit, Reset before submitting the next frame's draws
+		void Sort();
+
+		uint32_t GetDrawCount() const { return (uint32_t)m_Keys.size(); }
+		const std::vector<DrawBatch>& GetBatches() const { return m_Batches; }
+		const std::vector<uint32_t>& GetSortedPayloads() const { return m_SortedPayloads; }
+		const RenderQueueStatistics& GetStatistics() const { return m_Statistics; }
+
+	private:
+		struct Draw
+		{
+			uint32_t Geometry;
+			uint32_t Payload;
+		};
+
+		std::vector<uint64_t> m_Keys;
+		std::vector<Draw> m_Draws;
+
+		// Submission indices sort along with the keys, the draws are gathered through them afterwards
+		std::vector<uint32_t> m_Order;
+		std::vector<uint64_t> m_ScratchKeys;
+		std::vector<uint32_t> m_ScratchOrder;
+
+		std::vector<DrawBatch> m_Batches;
+		std::vector<uint32_t> m_SortedPayloads;
+		RenderQueueStatistics m_Statistics;
+	};
+}
@@ -0,0 +1,275 @@
+#include "pch.h"
+#include "InstanceCuller.h"
+
+#include <glm/geometric.hpp>
+
+#include "Core/JobSystem.h"
+#include "Core/Simd.h"
+
+namespace VulkanTestbed
+{
+	// Multiple of InstanceDatabase::Padding, every chunk is culled by one job
+	static constexpr uint32_t ChunkSize = 4096;
+	static_assert(ChunkSize % InstanceDatabase::Padding == 0);
+
+	Frustum Frustum::FromViewProjection(const glm::mat4& viewProjection)
+	{
+		const glm::mat4 m = glm::transpose(viewProjection);
+		Frustum frustum;
+		frustum.Planes[Left] = m[3] + m[0];
+		frustum.Planes[Right] = m[3] - m[0];
+		frustum.Planes[Bottom] = m[3] + m[1];
+		frustum.Planes[Top] = m[3] - m[1];
+		frustum.Planes[Near] = m[2];
+		frustum.Planes[Far] = m[3] - m[2];
+		for (glm::vec4& plane : frustum.Planes)
+			plane /= glm::length(glm::vec3(plane));
+		return frustum;
+	}
+
+	// Visible lanes of the 8 instances starting at first as a bit mask
+#if defined(TESTBED_AVX2)
+	struct FrustumSplats
+	{
+		__m256 X[Frustum::PlaneCount], Y[Frustum::PlaneCount], Z[Frustum::PlaneCount], W[Frustum::PlaneCount];
+	};
+
+	static uint32_t CullBlock(const InstanceBoundsView& bounds, const FrustumSplats& planes, uint32_t first)
+	{
+		const __m256 centerX = _mm256_loadu_ps(bounds[InstanceBoundsComponent::CenterX] + first);
+		const __m256 centerY = _mm256_loadu_ps(bounds[InstanceBoundsComponent::CenterY] + first);
+		const __m256 centerZ = _mm256_loadu_ps(bounds[InstanceBoundsComponent::CenterZ] + first);
+		const __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(bounds[InstanceBoundsComponent::Radius] + first));
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (uint32_t plane = 0; plane < Frustum::PlaneCount; ++plane)
+		{
+			const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(centerX, planes.X[plane]), _mm256_mul_ps(centerY, planes.Y[plane])),
+				_mm256_add_ps(_mm256_mul_ps(centerZ, planes.Z[plane]), planes.W[plane]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GT_OQ));
+		}
+		if (_mm256_movemask_ps(inside) == 0)
+			return 0;
+
+		// Spheres are loose for long thin boxes, the corner farthest along each plane normal has to be inside too
+		const __m256 minX = _mm256_loadu_ps(bounds[InstanceBoundsComponent::MinX] + first);
+		const __m256 minY = _mm256_loadu_ps(bounds[InstanceBoundsComponent::MinY] + first);
+		const __m256 minZ = _mm256_loadu_ps(bounds[InstanceBoundsComponent::MinZ] + first);
+		const __m256 maxX = _mm256_loadu_ps(bounds[InstanceBoundsComponent::MaxX] + first);
+		const __m256 maxY = _mm256_loadu_ps(bounds[InstanceBoundsComponent::MaxY] + first);
+		const __m256 maxZ = _mm256_loadu_ps(bounds[InstanceBoundsComponent::MaxZ] + first);
+		for (uint32_t plane = 0; plane < Frustum::PlaneCount; ++plane)
+		{
+			const __m256 x = _mm256_max_ps(_mm256_mul_ps(minX, planes.X[plane]), _mm256_mul_ps(maxX, planes.X[plane]));
+			const __m256 y = _mm256_max_ps(_mm256_mul_ps(minY, planes.Y[plane]), _mm256_mul_ps(maxY, planes.Y[plane]));
+			const __m256 z = _mm256_max_ps(_mm256_mul_ps(minZ, planes.Z[plane]), _mm256_mul_ps(maxZ, planes.Z[plane]));
+			const __m256 distance = _mm256_add_ps(_mm256_add_ps(x, y), _mm256_add_ps(z, planes.W[plane]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		return (uint32_t)_mm256_movemask_ps(inside);
+	}
+#elif defined(TESTBED_SSE2)
+	struct FrustumSplats
+	{
+		__m128 X[Frustum::PlaneCount], Y[Frustum::PlaneCount], Z[Frustum::PlaneCount], W[Frustum::PlaneCount];
+	};
+
+	static uint32_t CullBlock4(const InstanceBoundsView& bounds, const FrustumSplats& planes, uint32_t first)
+	{
+		const __m128 centerX = _mm_loadu_ps(bounds[InstanceBoundsComponent::CenterX] + first);
+		const __m128 centerY = _mm_loadu_ps(bounds[InstanceBoundsComponent::CenterY] + first);
+		const __m128 centerZ = _mm_loadu_ps(bounds[InstanceBoundsComponent::CenterZ] + first);
+		const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(bounds[InstanceBoundsComponent::Radius] + first));
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (uint32_t plane = 0; plane < Frustum::PlaneCount; ++plane)
+		{
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(centerX, planes.X[plane]), _mm_mul_ps(centerY, planes.Y[plane])),
+				_mm_add_ps(_mm_mul_ps(centerZ, planes.Z[plane]), planes.W[plane]));
+			inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negRadius));
+		}
+		if (_mm_movemask_ps(inside) == 0)
+			return 0;
+
+		// Spheres are loose for long thin boxes, the corner farthest along each plane normal has to be inside too
+		const __m128 minX = _mm_loadu_ps(bounds[InstanceBoundsComponent::MinX] + first);
+		const __m128 minY = _mm_loadu_ps(bounds[InstanceBoundsComponent::MinY] + first);
+		const __m128 minZ = _mm_loadu_ps(bounds[InstanceBoundsComponent::MinZ] + first);
+		const __m128 maxX = _mm_loadu_ps(bounds[InstanceBoundsComponent::MaxX] + first);
+		const __m128 maxY = _mm_loadu_ps(bounds[InstanceBoundsComponent::MaxY] + first);
+		const __m128 maxZ = _mm_loadu_ps(bounds[InstanceBoundsComponent::MaxZ] + first);
+		for (uint32_t plane = 0; plane < Frustum::PlaneCount; ++plane)
+		{
+			const __m128 x = _mm_max_ps(_mm_mul_ps(minX, planes.X[plane]), _mm_mul_ps(maxX, planes.X[plane]));
+			const __m128 y = _mm_max_ps(_mm_mul_ps(minY, planes.Y[plane]), _mm_mul_ps(maxY, planes.Y[plane]));
+			const __m128 z = _mm_max_ps(_mm_mul_ps(minZ, planes.Z[plane]), _mm_mul_ps(maxZ, planes.Z[plane]));
+			const __m128 distance = _mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, planes.W[plane]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+		}
+		return (uint32_t)_mm_movemask_ps(inside);
+	}
+
+	// Two 4 wide halves, SSE2 is the baseline without AVX2
+	static uint32_t CullBlock(const InstanceBoundsView& bounds, const FrustumSplats& planes, uint32_t first)
+	{
+		return CullBlock4(bounds, planes, first) | (CullBlock4(bounds, planes, first + 4) << 4);
+	}
+#else
+	struct FrustumSplats
+	{
+		Frustum Source;
+	};
+
+	static uint32_t CullBlock(const InstanceBoundsView& bounds, const FrustumSplats& planes, uint32_t first)
+	{
+		uint32_t mask = 0;
+		for (uint32_t lane = 0; lane < 8; ++lane)
+		{
+			const uint32_t i = first + lane;
+			bool inside = true;
+			for (const glm::vec4& plane : planes.Source.Planes)
+			{
+				const float sphere = plane.x * bounds[InstanceBoundsComponent::CenterX][i] + plane.y * bounds[InstanceBoundsComponent::CenterY][i] +
+					plane.z * bounds[InstanceBoundsComponent::CenterZ][i] + plane.w;
+				const float box = std::max(plane.x * bounds[InstanceBoundsComponent::MinX][i], plane.x * bounds[InstanceBoundsComponent::MaxX][i]) +
+					std::max(plane.y * bounds[InstanceBoundsComponent::MinY][i], plane.y * bounds[InstanceBoundsComponent::MaxY][i]) +
+					std::max(plane.z * bounds[InstanceBoundsComponent::MinZ][i], plane.z * bounds[InstanceBoundsComponent::MaxZ][i]) + plane.w;
+				inside &= sphere > -bounds[InstanceBoundsComponent::Radius][i] && box >= 0.0f;
+			}
+			mask |= (uint32_t)inside << lane;
+		}
+		return mask;
+	}
+#endif
+
+	static FrustumSplats SplatFrustum(const Frustum& frustum)
+	{
+		FrustumSplats splats;
+#if defined(TESTBED_AVX2) || defined(TESTBED_SSE2)
+		for (uint32_t plane = 0; plane < Frustum::PlaneCount; ++plane)
+		{
+#ifdef TESTBED_AVX2
+			splats.X[plane] = _mm256_set1_ps(frustum.Planes[plane].x);
+			splats.Y[plane] = _mm256_set1_ps(frustum.Planes[plane].y);
+			splats.Z[plane] = _mm256_set1_ps(frustum.Planes[plane].z);
+			splats.W[plane] = _mm256_set1_ps(frustum.Planes[plane].w);
+#else
+			splats.X[plane] = _mm_set1_ps(frustum.Planes[plane].x);
+			splats.Y[plane] = _mm_set1_ps(frustum.Planes[plane].y);
+			splats.Z[plane] = _mm_set1_ps(frustum.Planes[plane].z);
+			splats.W[plane] = _mm_set1_ps(frustum.Planes[plane].w);
+#endif
+		}
+#else
+		splats.Source = frustum;
+#endif
+		return splats;
+	}
+
+	InstanceCuller::InstanceCuller(const CullSettings& settings)
+		: m_Settings(settings)
+	{
+		if (m_Settings.Occlusion)
+			m_OcclusionBuffer.Resize(m_Settings.OcclusionWidth, m_Settings.OcclusionHeight);
+	}
+
+	template<typename F>
+	uint32_t InstanceCuller::CullChunks(uint32_t count, const F& cullRange, std::vector<uint32_t>& outVisible)
+	{
+		const uint32_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+		m_ChunkVisible.resize(count);
+		m_ChunkCounts.resize(chunkCount);
+		ParallelForRange(chunkCount, 1, [&](uint32_t chunkBegin, uint32_t chunkEnd)
+		{
+			for (uint32_t chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+			{
+				const uint32_t begin = chunk * ChunkSize;
+				m_ChunkCounts[chunk] = cullRange(begin, std::min(count, begin + ChunkSize), m_ChunkVisible.data() + begin);
+			}
+		});
+
+		uint32_t visibleCount = 0;
+		// Counts become offsets into the compacted list
+		for (uint32_t& chunkOffset : m_ChunkCounts)
+		{
+			const uint32_t chunkVisible = chunkOffset;
+			chunkOffset = visibleCount;
+			visibleCount += chunkVisible;
+		}
+
+		outVisible.resize(visibleCount);
+		ParallelForRange(chunkCount, 1, [&](uint32_t chunkBegin, uint32_t chunkEnd)
+		{
+			for (uint32_t chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+			{
+				const uint32_t offset = m_ChunkCounts[chunk];
+				const uint32_t chunkVisible = (chunk + 1 < chunkCount ? m_ChunkCounts[chunk + 1] : visibleCount) - offset;
+				std::copy_n(m_ChunkVisible.data() + chunk * ChunkSize, chunkVisible, outVisible.data() + offset);
+			}
+		});
+		return visibleCount;
+	}
+
+	void InstanceCuller::Cull(const InstanceDatabase& instances, const glm::mat4& viewProjection, std::vector<uint32_t>& outVisible)
+	{
+		const InstanceBoundsView bounds = instances.GetBounds();
+		const FrustumSplats planes = SplatFrustum(Frustum::FromViewProjection(viewProjection));
+
+		m_Statistics = {};
+		m_Statistics.Instances = bounds.Count;
+
+		std::vector<uint32_t>& frustumVisible = m_Settings.Occlusion ? m_FrustumVisible : outVisible;
+		m_Statistics.FrustumVisible = CullChunks(bounds.Count, [&bounds, &planes](uint32_t begin, uint32_t end, uint32_t* out)
+		{
+			uint32_t visibleCount = 0;
+			for (uint32_t first = begin; first < end; first += 8)
+			{
+				// Writes every lane and only advances past the visible ones
+				const uint32_t mask = CullBlock(bounds, planes, first);
+				const uint32_t laneCount = std::min(8u, end - first);
+				for (uint32_t lane = 0; lane < laneCount; ++lane)
+				{
+					out[visibleCount] = first + lane;
+					visibleCount += (mask >> lane) & 1;
+				}
+			}
+			return visibleCount;
+		}, frustumVisible);
+		m_Statistics.Visible = m_Statistics.FrustumVisible;
+
+		if (!m_Settings.Occlusion)
+			return;
+
+		// Few and large by nature, rasterized on the calling thread
+		m_OcclusionBuffer.Clear();
+		const InstanceFlags* flags = instances.GetFlags();
+		for (uint32_t index : frustumVisible)
+		{
+			if (m_Statistics.Occluders == m_Settings.MaxOccluders)
+				break;
+			if (!HasFlag(flags[index], InstanceFlags::Occluder))
+				continue;
+
+			const glm::vec3 boundsMin(bounds[InstanceBoundsComponent::MinX][index], bounds[InstanceBoundsComponent::MinY][index], bounds[InstanceBoundsComponent::MinZ][index]);
+			const glm::vec3 boundsMax(bounds[InstanceBoundsComponent::MaxX][index], bounds[InstanceBoundsComponent::MaxY][index], bounds[InstanceBoundsComponent::MaxZ][index]);
+			m_OcclusionBuffer.RasterizeOccluder(viewProjection, boundsMin, boundsMax);
+			++m_Statistics.Occluders;
+		}
+		m_OcclusionBuffer.BuildPyramid();
+
+		m_Statistics.Visible = CullChunks(m_Statistics.FrustumVisible, [this, &bounds, &viewProjection](uint32_t begin, uint32_t end, uint32_t* out)
+		{
+			uint32_t visibleCount = 0;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				const uint32_t index = m_FrustumVisible[i];
+				const glm::vec3 boundsMin(bounds[InstanceBoundsComponent::MinX][index], bounds[InstanceBoundsComponent::MinY][index], bounds[InstanceBoundsComponent::MinZ][index]);
+				const glm::vec3 boundsMax(bounds[InstanceBoundsComponent::MaxX][index], bounds[InstanceBoundsComponent::MaxY][index], bounds[InstanceBoundsComponent::MaxZ][index]);
+				out[visibleCount] = index;
+				visibleCount += !m_OcclusionBuffer.IsOccluded(viewProjection, boundsMin, boundsMax);
+			}
+			return visibleCount;
+		}, outVisible);
+		m_Statistics.OcclusionCulled = m_Statistics.FrustumVisible - m_Statistics.Visible;
+	}
+}
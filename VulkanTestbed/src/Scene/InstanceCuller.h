@@ -0,0 +1,69 @@
+#pragma once
+
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "Scene/InstanceDatabase.h"
+#include "Scene/OcclusionBuffer.h"
+
+namespace VulkanTestbed
+{
+	struct CullSettings
+	{
+		// Rasterizes the occluders in view into a software depth buffer and culls what they hide
+		bool Occlusion = false;
+		uint32_t OcclusionWidth = 256;
+		uint32_t OcclusionHeight = 128;
+		// Occluders beyond this many in view only get frustum culled
+		uint32_t MaxOccluders = 1024;
+	};
+
+	struct CullStatistics
+	{
+		uint32_t Instances = 0;
+		uint32_t FrustumVisible = 0;
+		uint32_t Occluders = 0;
+		uint32_t OcclusionCulled = 0;
+		uint32_t Visible = 0;
+	};
+
+	// Inward facing planes with normalized normals, an instance is outside when its bounds are behind any of them
+	struct Frustum
+	{
+		enum Plane : uint32_t { Left = 0, Right, Bottom, Top, Near, Far, PlaneCount };
+
+		std::array<glm::vec4, PlaneCount> Planes;
+
+		// Gribb/Hartmann extraction for a 0 to 1 depth range
+		static Frustum FromViewProjection(const glm::mat4& viewProjection);
+	};
+
+	// Tests 8 bounding spheres per iteration against the frustum and the boxes of those that pass against it again,
+	// split into chunks across the job threads. The visible instances come out as a compact list of dense indices
+	// into the database, in ascending order.
+	class InstanceCuller
+	{
+	public:
+		explicit InstanceCuller(const CullSettings& settings = {});
+
+		void Cull(const InstanceDatabase& instances, const glm::mat4& viewProjection, std::vector<uint32_t>& outVisible);
+
+		const CullStatistics& GetStatistics() const { return m_Statistics; }
+		// Depth pyramid of the last occlusion culled view
+		const OcclusionBuffer& GetOcclusionBuffer() const { return m_OcclusionBuffer; }
+
+	private:
+		// Compacts what every chunk left at the start of its range into outVisible
+		template<typename F>
+		uint32_t CullChunks(uint32_t count, const F& cullRange, std::vector<uint32_t>& outVisible);
+
+	private:
+		CullSettings m_Settings;
+		CullStatistics m_Statistics;
+		OcclusionBuffer m_OcclusionBuffer;
+
+		std::vector<uint32_t> m_ChunkVisible;
+		std::vector<uint32_t> m_ChunkCounts;
+		std::vector<uint32_t> m_FrustumVisible;
+	};
+}
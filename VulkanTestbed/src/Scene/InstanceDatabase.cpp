@@ -0,0 +1,141 @@
+#include "pch.h"
+#include "InstanceDatabase.h"
+
+#include <glm/geometric.hpp>
+
+namespace VulkanTestbed
+{
+	InstanceID InstanceDatabase::Add(const glm::mat4& transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax, InstanceFlags flags)
+	{
+		InstanceID id;
+		if (!m_FreeIDs.empty())
+		{
+			id = m_FreeIDs.back();
+			m_FreeIDs.pop_back();
+		}
+		else
+		{
+			id = (InstanceID)m_Indices.size();
+			m_Indices.push_back(InvalidIndex);
+		}
+
+		const uint32_t index = GetCount();
+		m_Indices[id] = index;
+		m_IDs.push_back(id);
+		m_Transforms.push_back(transform);
+		m_LocalMin.push_back(boundsMin);
+		m_LocalMax.push_back(boundsMax);
+		m_Flags.push_back(flags);
+		Resize(index + 1);
+		UpdateBounds(index);
+		return id;
+	}
+
+	void InstanceDatabase::Remove(InstanceID id)
+	{
+		TESTBED_ASSERT(id < m_Indices.size() && m_Indices[id] != InvalidIndex, "Removing unknown instance!");
+		const uint32_t index = m_Indices[id];
+		const uint32_t last = GetCount() - 1;
+		if (index != last)
+		{
+			m_IDs[index] = m_IDs[last];
+			m_Indices[m_IDs[index]] = index;
+			m_Transforms[index] = m_Transforms[last];
+			m_LocalMin[index] = m_LocalMin[last];
+			m_LocalMax[index] = m_LocalMax[last];
+			m_Flags[index] = m_Flags[last];
+			for (std::vector<float>& component : m_Bounds)
+				component[index] = component[last];
+		}
+
+		m_IDs.pop_back();
+		m_Transforms.pop_back();
+		m_LocalMin.pop_back();
+		m_LocalMax.pop_back();
+		m_Flags.pop_back();
+		Resize(last);
+
+		m_Indices[id] = InvalidIndex;
+		m_FreeIDs.push_back(id);
+	}
+
+	void InstanceDatabase::SetTransform(InstanceID id, const glm::mat4& transform)
+	{
+		const uint32_t index = m_Indices[id];
+		m_Transforms[index] = transform;
+		UpdateBounds(index);
+	}
+
+	void InstanceDatabase::Reserve(uint32_t instanceCount)
+	{
+		m_Transforms.reserve(instanceCount);
+		m_LocalMin.reserve(instanceCount);
+		m_LocalMax.reserve(instanceCount);
+		m_Flags.reserve(instanceCount);
+		m_IDs.reserve(instanceCount);
+		m_Indices.reserve(instanceCount);
+		for (std::vector<float>& component : m_Bounds)
+			component.reserve(instanceCount + Padding);
+	}
+
+	void InstanceDatabase::Clear()
+	{
+		m_Transforms.clear();
+		m_LocalMin.clear();
+		m_LocalMax.clear();
+		m_Flags.clear();
+		m_IDs.clear();
+		m_Indices.clear();
+		m_FreeIDs.clear();
+		Resize(0);
+	}
+
+	InstanceBoundsView InstanceDatabase::GetBounds() const
+	{
+		InstanceBoundsView view;
+		for (size_t component = 0; component < m_Bounds.size(); ++component)
+			view.Components[component] = m_Bounds[component].data();
+		view.Count = GetCount();
+		return view;
+	}
+
+	void InstanceDatabase::UpdateBounds(uint32_t index)
+	{
+		const glm::mat4& transform = m_Transforms[index];
+		const glm::vec3 localCenter = (m_LocalMin[index] + m_LocalMax[index]) * 0.5f;
+		const glm::vec3 localExtent = (m_LocalMax[index] - m_LocalMin[index]) * 0.5f;
+
+		// Arvo's method, the extent along each world axis is the sum of the absolute rotated local extents
+		const glm::vec3 center = glm::vec3(transform * glm::vec4(localCenter, 1.0f));
+		glm::vec3 extent(0.0f);
+		for (int axis = 0; axis < 3; ++axis)
+			extent += glm::abs(glm::vec3(transform[axis])) * localExtent[axis];
+
+		const float maxScale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+		const float radius = glm::length(localExtent) * maxScale;
+
+		auto& bounds = m_Bounds;
+		auto set = [&bounds, index](InstanceBoundsComponent component, float value) { bounds[(size_t)component][index] = value; };
+		set(InstanceBoundsComponent::CenterX, center.x);
+		set(InstanceBoundsComponent::CenterY, center.y);
+		set(InstanceBoundsComponent::CenterZ, center.z);
+		set(InstanceBoundsComponent::Radius, radius);
+		set(InstanceBoundsComponent::MinX, center.x - extent.x);
+		set(InstanceBoundsComponent::MinY, center.y - extent.y);
+		set(InstanceBoundsComponent::MinZ, center.z - extent.z);
+		set(InstanceBoundsComponent::MaxX, center.x + extent.x);
+		set(InstanceBoundsComponent::MaxY, center.y + extent.y);
+		set(InstanceBoundsComponent::MaxZ, center.z + extent.z);
+	}
+
+	void InstanceDatabase::Resize(uint32_t count)
+	{
+		// The padding is masked off by culling, zero keeps it free of NaNs
+		const size_t paddedCount = (count + Padding - 1) / Padding * Padding;
+		for (std::vector<float>& component : m_Bounds)
+		{
+			component.resize(paddedCount);
+			std::fill(component.begin() + count, component.end(), 0.0f);
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+namespace VulkanTestbed
+{
+	using InstanceID = uint32_t;
+	static constexpr InstanceID InvalidInstanceID = ~0u;
+
+	enum class InstanceFlags : uint8_t
+	{
+		None = 0,
+		// The geometry fills its bounding box, so the box can hide what is behind it (walls, floors, buildings)
+		Occluder = 1 << 0,
+	};
+
+	enum class InstanceBoundsComponent : uint32_t
+	{
+		// World space bounding sphere
+		CenterX = 0, CenterY, CenterZ, Radius,
+		// World space axis aligned bounding box
+		MinX, MinY, MinZ, MaxX, MaxY, MaxZ,
+
+		Count
+	};
+
+	// Dense arrays in SoA layout, padded to a multiple of Padding elements so culling can always load full registers
+	struct InstanceBoundsView
+	{
+		std::array<const float*, (size_t)InstanceBoundsComponent::Count> Components = {};
+		uint32_t Count = 0;
+
+		const float* operator[](InstanceBoundsComponent component) const { return Components[(size_t)component]; }
+	};
+
+	// Every scene instance as a world transform and the bounds derived from it. Instances are kept densely packed,
+	// removing one moves the last into its place, so dense indices are only stable until the next Remove while IDs
+	// stay valid until their instance is removed.
+	class InstanceDatabase
+	{
+	public:
+		static constexpr uint32_t Padding = 8;
+
+		// Bounds are in object space and transformed along with the instance
+		InstanceID Add(const glm::mat4& transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax, InstanceFlags flags = InstanceFlags::None);
+		void Remove(InstanceID id);
+		void SetTransform(InstanceID id, const glm::mat4& transform);
+		void Reserve(uint32_t instanceCount);
+		void Clear();
+
+		uint32_t GetCount() const { return (uint32_t)m_IDs.size(); }
+		uint32_t GetIndex(InstanceID id) const { return m_Indices[id]; }
+		InstanceID GetID(uint32_t index) const { return m_IDs[index]; }
+		const glm::mat4& GetTransform(uint32_t index) const { return m_Transforms[index]; }
+		InstanceFlags GetFlags(uint32_t index) const { return m_Flags[index]; }
+		const InstanceFlags* GetFlags() const { return m_Flags.data(); }
+		InstanceBoundsView GetBounds() const;
+
+	private:
+		void UpdateBounds(uint32_t index);
+		void Resize(uint32_t count);
+
+	private:
+		std::vector<glm::mat4> m_Transforms;
+		std::vector<glm::vec3> m_LocalMin;
+		std::vector<glm::vec3> m_LocalMax;
+		std::vector<InstanceFlags> m_Flags;
+		std::array<std::vector<float>, (size_t)InstanceBoundsComponent::Count> m_Bounds;
+
+		std::vector<InstanceID> m_IDs;
+		// Dense index of every ID handed out, InvalidIndex once removed
+		std::vector<uint32_t> m_Indices;
+		std::vector<InstanceID> m_FreeIDs;
+
+		static constexpr uint32_t InvalidIndex = ~0u;
+	};
+
+	inline bool HasFlag(InstanceFlags flags, InstanceFlags flag) { return ((uint8_t)flags & (uint8_t)flag) != 0; }
+}
@@ -0,0 +1,201 @@
+#include "pch.h"
+#include "OcclusionBuffer.h"
+
+#include <cmath>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+namespace VulkanTestbed
+{
+	// Corners closer than this to the camera plane can't be projected reliably
+	static constexpr float MinClipW = 1e-5f;
+
+	// Corners in pixels and depth, false when one of them is behind the near plane
+	static bool ProjectBox(const glm::mat4& viewProjection, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+		uint32_t width, uint32_t height, std::array<glm::vec3, 8>& outCorners)
+	{
+		for (uint32_t corner = 0; corner < 8; ++corner)
+		{
+			const glm::vec4 position((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y, (corner & 4) ? boundsMax.z : boundsMin.z, 1.0f);
+			const glm::vec4 clip = viewProjection * position;
+			if (clip.w < MinClipW || clip.z < 0.0f)
+				return false;
+
+			const float invW = 1.0f / clip.w;
+			outCorners[corner] = glm::vec3((clip.x * invW * 0.5f + 0.5f) * (float)width, (clip.y * invW * 0.5f + 0.5f) * (float)height, clip.z * invW);
+		}
+		return true;
+	}
+
+	static float Cross(const glm::vec2& origin, const glm::vec2& a, const glm::vec2& b)
+	{
+		return (a.x - origin.x) * (b.y - origin.y) - (a.y - origin.y) * (b.x - origin.x);
+	}
+
+	void OcclusionBuffer::Resize(uint32_t width, uint32_t height)
+	{
+		m_Width = std::max(1u, width);
+		m_Height = std::max(1u, height);
+		m_Levels.clear();
+		for (uint32_t levelWidth = m_Width, levelHeight = m_Height;; levelWidth = (levelWidth + 1) / 2, levelHeight = (levelHeight + 1) / 2)
+		{
+			Level& level = m_Levels.emplace_back();
+			level.Width = levelWidth;
+			level.Height = levelHeight;
+			level.Depth.resize((size_t)levelWidth * levelHeight, 1.0f);
+			if (levelWidth == 1 && levelHeight == 1)
+				break;
+		}
+	}
+
+	void OcclusionBuffer::Clear()
+	{
+		for (Level& level : m_Levels)
+			std::fill(level.Depth.begin(), level.Depth.end(), 1.0f);
+	}
+
+	void OcclusionBuffer::RasterizeOccluder(const glm::mat4& viewProjection, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		std::array<glm::vec3, 8> corners;
+		if (!ProjectBox(viewProjection, boundsMin, boundsMax, m_Width, m_Height, corners))
+			return;
+
+		// Convex hull of the projected corners (Andrew's monotone chain), counter clockwise
+		std::array<glm::vec2, 8> points;
+		float depth = 0.0f;
+		for (uint32_t corner = 0; corner < 8; ++corner)
+		{
+			points[corner] = glm::vec2(corners[corner]);
+			depth = std::max(depth, corners[corner].z);
+		}
+		std::sort(points.begin(), points.end(), [](const glm::vec2& a, const glm::vec2& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+
+		std::array<glm::vec2, 16> hull;
+		uint32_t hullSize = 0;
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			while (hullSize >= 2 && Cross(hull[hullSize - 2], hull[hullSize - 1], points[i]) <= 0.0f)
+				--hullSize;
+			hull[hullSize++] = points[i];
+		}
+		for (uint32_t i = 7, lowerSize = hullSize + 1; i-- > 0;)
+		{
+			while (hullSize >= lowerSize && Cross(hull[hullSize - 2], hull[hullSize - 1], points[i]) <= 0.0f)
+				--hullSize;
+			hull[hullSize++] = points[i];
+		}
+		// The first point was added again at the end
+		--hullSize;
+		if (hullSize < 3)
+			return;
+
+		glm::vec2 hullMin = hull[0], hullMax = hull[0];
+		for (uint32_t i = 1; i < hullSize; ++i)
+		{
+			hullMin = glm::min(hullMin, hull[i]);
+			hullMax = glm::max(hullMax, hull[i]);
+		}
+		const int32_t x0 = std::max(0, (int32_t)std::floor(hullMin.x));
+		const int32_t y0 = std::max(0, (int32_t)std::floor(hullMin.y));
+		const int32_t x1 = std::min((int32_t)m_Width - 1, (int32_t)std::ceil(hullMax.x));
+		const int32_t y1 = std::min((int32_t)m_Height - 1, (int32_t)std::ceil(hullMax.y));
+
+		// Edge functions evaluated at the pixel corner farthest inside, a pixel is written when it passes every edge
+		struct Edge
+		{
+			float A, B, C;
+		};
+		std::array<Edge, 16> edges;
+		for (uint32_t i = 0; i < hullSize; ++i)
+		{
+			const glm::vec2& a = hull[i];
+			const glm::vec2& b = hull[(i + 1) % hullSize];
+			Edge& edge = edges[i];
+			edge.A = a.y - b.y;
+			edge.B = b.x - a.x;
+			edge.C = -(edge.A * a.x + edge.B * a.y) - 0.5f * (std::abs(edge.A) + std::abs(edge.B));
+		}
+
+		std::vector<float>& buffer = m_Levels[0].Depth;
+		for (int32_t y = y0; y <= y1; ++y)
+		{
+			const float centerY = (float)y + 0.5f;
+			for (int32_t x = x0; x <= x1; ++x)
+			{
+				const float centerX = (float)x + 0.5f;
+				bool covered = true;
+				for (uint32_t i = 0; i < hullSize && covered; ++i)
+					covered = edges[i].A * centerX + edges[i].B * centerY + edges[i].C >= 0.0f;
+
+				float& pixel = buffer[(size_t)y * m_Width + x];
+				if (covered)
+					pixel = std::min(pixel, depth);
+			}
+		}
+	}
+
+	void OcclusionBuffer::BuildPyramid()
+	{
+		// Every texel keeps the farthest depth of the pixels below it, odd edges repeat their last texel
+		for (size_t levelIndex = 1; levelIndex < m_Levels.size(); ++levelIndex)
+		{
+			const Level& source = m_Levels[levelIndex - 1];
+			Level& level = m_Levels[levelIndex];
+			for (uint32_t y = 0; y < level.Height; ++y)
+			{
+				const float* row0 = &source.Depth[(size_t)std::min(2 * y, source.Height - 1) * source.Width];
+				const float* row1 = &source.Depth[(size_t)std::min(2 * y + 1, source.Height - 1) * source.Width];
+				for (uint32_t x = 0; x < level.Width; ++x)
+				{
+					const uint32_t x0 = std::min(2 * x, source.Width - 1);
+					const uint32_t x1 = std::min(2 * x + 1, source.Width - 1);
+					level.Depth[(size_t)y * level.Width + x] = std::max({ row0[x0], row0[x1], row1[x0], row1[x1] });
+				}
+			}
+		}
+	}
+
+	bool OcclusionBuffer::IsOccluded(const glm::mat4& viewProjection, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+	{
+		std::array<glm::vec3, 8> corners;
+		if (!ProjectBox(viewProjection, boundsMin, boundsMax, m_Width, m_Height, corners))
+			return false;
+
+		glm::vec3 rectMin = corners[0], rectMax = corners[0];
+		for (uint32_t corner = 1; corner < 8; ++corner)
+		{
+			rectMin = glm::min(rectMin, corners[corner]);
+			rectMax = glm::max(rectMax, corners[corner]);
+		}
+
+		int32_t x0 = std::max(0, (int32_t)std::floor(rectMin.x));
+		int32_t y0 = std::max(0, (int32_t)std::floor(rectMin.y));
+		int32_t x1 = std::min((int32_t)m_Width - 1, (int32_t)std::floor(rectMax.x));
+		int32_t y1 = std::min((int32_t)m_Height - 1, (int32_t)std::floor(rectMax.y));
+		if (x0 > x1 || y0 > y1)
+			return false;
+
+		// Coarsest level at which the rectangle touches at most 2x2 texels
+		uint32_t levelIndex = 0;
+		while (levelIndex + 1 < m_Levels.size() && (x1 - x0 > 1 || y1 - y0 > 1))
+		{
+			++levelIndex;
+			x0 >>= 1;
+			y0 >>= 1;
+			x1 >>= 1;
+			y1 >>= 1;
+		}
+
+		const Level& level = m_Levels[levelIndex];
+		for (int32_t y = y0; y <= y1; ++y)
+		{
+			for (int32_t x = x0; x <= x1; ++x)
+			{
+				if (level.Depth[(size_t)y * level.Width + x] >= rectMin.z)
+					return false;
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+namespace VulkanTestbed
+{
+	// Low resolution software depth buffer with a max depth pyramid on top. Depth goes from 0 at the near plane to 1
+	// at the far one, matching GLM_FORCE_DEPTH_ZERO_TO_ONE.
+	class OcclusionBuffer
+	{
+	public:
+		void Resize(uint32_t width, uint32_t height);
+		void Clear();
+
+		// The box has to be filled by the occluder's geometry. Its silhouette is written with the depth of its farthest
+		// corner, only into pixels it covers entirely, so whatever the buffer hides the geometry hides too.
+		// Boxes crossing the near plane are skipped.
+		void RasterizeOccluder(const glm::mat4& viewProjection, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+		// After the last occluder, before IsOccluded
+		void BuildPyramid();
+
+		// True when the box is behind the occluders everywhere it covers, safe to call from several threads
+		bool IsOccluded(const glm::mat4& viewProjection, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+		uint32_t GetWidth() const { return m_Width; }
+		uint32_t GetHeight() const { return m_Height; }
+		uint32_t GetLevelCount() const { return (uint32_t)m_Levels.size(); }
+		const float* GetLevel(uint32_t level) const { return m_Levels[level].Depth.data(); }
+
+	private:
+		struct Level
+		{
+			uint32_t Width = 0;
+			uint32_t Height = 0;
+			std::vector<float> Depth;
+		};
+
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		std::vector<Level> m_Levels;
+	};
+}
@@ -0,0 +1,241 @@
+#include "pch.h"
+#include "TransformHierarchy.h"
+
+#include <atomic>
+
+#include "Core/JobSystem.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t UpdateGrainSize = 1024;
+
+	TransformNode TransformHierarchy::Create(TransformNode parent, const LocalTransform& local)
+	{
+		TESTBED_ASSERT(parent == InvalidTransformNode || IsAlive(parent), "Parent transform doesn't exist!");
+
+		TransformNode node;
+		if (!m_FreeNodes.empty())
+		{
+			node = m_FreeNodes.back();
+			m_FreeNodes.pop_back();
+		}
+		else
+		{
+			node = (TransformNode)m_Slots.size();
+			m_Slots.push_back(InvalidSlot);
+			m_NodeParents.push_back(InvalidTransformNode);
+		}
+
+		// Appended unsorted, Rebuild moves it behind its parent
+		m_Slots[node] = (uint32_t)m_Nodes.size();
+		m_NodeParents[node] = parent;
+		m_Nodes.push_back(node);
+		m_ParentSlots.push_back(InvalidSlot);
+		m_Positions.push_back(local.Position);
+		m_Rotations.push_back(local.Rotation);
+		m_Scales.push_back(local.Scale);
+		m_World.emplace_back(1.0f);
+		m_Flags.push_back(LocalDirty);
+		++m_NodeCount;
+		m_StructureDirty = true;
+		return node;
+	}
+
+	void TransformHierarchy::Destroy(TransformNode node)
+	{
+		TESTBED_ASSERT(IsAlive(node), "Destroying unknown transform!");
+		m_NodeParents[node] = DestroyedNode;
+		m_StructureDirty = true;
+	}
+
+	void TransformHierarchy::SetParent(TransformNode node, TransformNode parent)
+	{
+		TESTBED_ASSERT(IsAlive(node) && (parent == InvalidTransformNode || IsAlive(parent)));
+		for (TransformNode ancestor = parent; ancestor != InvalidTransformNode; ancestor = m_NodeParents[ancestor])
+			TESTBED_ASSERT(ancestor != node, "Parenting a transform to its own subtree!");
+
+		m_NodeParents[node] = parent;
+		m_Flags[m_Slots[node]] |= LocalDirty;
+		m_StructureDirty = true;
+	}
+
+	void TransformHierarchy::SetLocal(TransformNode node, const LocalTransform& local)
+	{
+		TESTBED_ASSERT(IsAlive(node));
+		const uint32_t slot = m_Slots[node];
+		m_Positions[slot] = local.Position;
+		m_Rotations[slot] = local.Rotation;
+		m_Scales[slot] = local.Scale;
+		m_Flags[slot] |= LocalDirty;
+
+		// Rebuild finds the dirty levels itself
+		if (!m_StructureDirty)
+			m_LevelDirty[GetLevel(slot)] = 1;
+	}
+
+	void TransformHierarchy::Reserve(uint32_t nodeCount)
+	{
+		m_NodeParents.reserve(nodeCount);
+		m_Slots.reserve(nodeCount);
+		m_Nodes.reserve(nodeCount);
+		m_ParentSlots.reserve(nodeCount);
+		m_Positions.reserve(nodeCount);
+		m_Rotations.reserve(nodeCount);
+		m_Scales.reserve(nodeCount);
+		m_World.reserve(nodeCount);
+		m_Flags.reserve(nodeCount);
+	}
+
+	LocalTransform TransformHierarchy::GetLocal(TransformNode node) const
+	{
+		const uint32_t slot = m_Slots[node];
+		return { m_Positions[slot], m_Rotations[slot], m_Scales[slot] };
+	}
+
+	void TransformHierarchy::Update()
+	{
+		if (m_StructureDirty)
+			Rebuild();
+
+		m_Statistics.UpdatedNodes = 0;
+		bool parentLevelUpdated = false;
+		for (uint32_t level = 0; level + 1 < m_LevelOffsets.size(); ++level)
+		{
+			// Untouched levels under untouched parents are skipped, unless the last Update left flags to clear
+			if (!m_LevelDirty[level] && !parentLevelUpdated && !m_LevelUpdated[level])
+			{
+				parentLevelUpdated = false;
+				continue;
+			}
+
+			const uint32_t levelBegin = m_LevelOffsets[level];
+			std::atomic<uint32_t> updatedNodes = 0;
+			ParallelForRange(m_LevelOffsets[level + 1] - levelBegin, UpdateGrainSize, [&](uint32_t begin, uint32_t end)
+			{
+				uint32_t rangeUpdatedNodes = 0;
+				for (uint32_t slot = levelBegin + begin; slot < levelBegin + end; ++slot)
+				{
+					const uint32_t parent = m_ParentSlots[slot];
+					const bool dirty = (m_Flags[slot] & LocalDirty) || (parent != InvalidSlot && (m_Flags[parent] & WorldUpdated));
+					m_Flags[slot] = dirty ? WorldUpdated : 0;
+					if (!dirty)
+						continue;
+
+					const glm::mat3 rotation = glm::mat3_cast(m_Rotations[slot]);
+					const glm::vec3& scale = m_Scales[slot];
+					const glm::aligned_mat4 local(
+						glm::aligned_vec4(rotation[0] * scale.x, 0.0f),
+						glm::aligned_vec4(rotation[1] * scale.y, 0.0f),
+						glm::aligned_vec4(rotation[2] * scale.z, 0.0f),
+						glm::aligned_vec4(m_Positions[slot], 1.0f));
+					m_World[slot] = parent == InvalidSlot ? local : m_World[parent] * local;
+					++rangeUpdatedNodes;
+				}
+				updatedNodes.fetch_add(rangeUpdatedNodes, std::memory_order_relaxed);
+			});
+
+			m_LevelDirty[level] = 0;
+			m_LevelUpdated[level] = updatedNodes > 0;
+			parentLevelUpdated = updatedNodes > 0;
+			m_Statistics.UpdatedNodes += updatedNodes;
+		}
+	}
+
+	uint32_t TransformHierarchy::GetLevel(uint32_t slot) const
+	{
+		return (uint32_t)(std::upper_bound(m_LevelOffsets.begin(), m_LevelOffsets.end(), slot) - m_LevelOffsets.begin()) - 1;
+	}
+
+	void TransformHierarchy::Rebuild()
+	{
+		// Children grouped by parent with a counting sort, roots go under the extra entry at the end
+		const uint32_t nodeCapacity = (uint32_t)m_Slots.size();
+		std::vector<uint32_t> childOffsets(nodeCapacity + 2, 0);
+		std::vector<TransformNode> children(m_Nodes.size());
+		for (TransformNode node : m_Nodes)
+		{
+			const TransformNode parent = m_NodeParents[node];
+			if (parent != DestroyedNode)
+				++childOffsets[(parent == InvalidTransformNode ? nodeCapacity : parent) + 1];
+		}
+		for (uint32_t i = 1; i < childOffsets.size(); ++i)
+			childOffsets[i] += childOffsets[i - 1];
+		std::vector<uint32_t> childCursors(childOffsets.begin(), childOffsets.end() - 1);
+		for (TransformNode node : m_Nodes)
+		{
+			const TransformNode parent = m_NodeParents[node];
+			if (parent != DestroyedNode)
+				children[childCursors[parent == InvalidTransformNode ? nodeCapacity : parent]++] = node;
+		}
+
+		// Breadth first from the roots, destroyed nodes and everything below them are never reached
+		std::vector<TransformNode> order;
+		order.reserve(m_Nodes.size());
+		order.insert(order.end(), children.begin() + childOffsets[nodeCapacity], children.begin() + childOffsets[nodeCapacity + 1]);
+		m_LevelOffsets.assign(1, 0);
+		for (uint32_t levelBegin = 0, levelEnd = (uint32_t)order.size(); levelBegin < levelEnd; levelBegin = levelEnd, levelEnd = (uint32_t)order.size())
+		{
+			m_LevelOffsets.push_back(levelEnd);
+			for (uint32_t i = levelBegin; i < levelEnd; ++i)
+				order.insert(order.end(), children.begin() + childOffsets[order[i]], children.begin() + childOffsets[order[i] + 1]);
+		}
+
+		std::vector<uint32_t> parentSlots(order.size());
+		std::vector<glm::vec3> positions(order.size());
+		std::vector<glm::quat> rotations(order.size());
+		std::vector<glm::vec3> scales(order.size());
+		std::vector<glm::aligned_mat4> world(order.size());
+		std::vector<uint8_t> flags(order.size());
+
+		// Reached nodes get their new slot below, whatever is left was under a destroyed node
+		std::vector<uint32_t> oldSlots(order.size());
+		for (uint32_t slot = 0; slot < order.size(); ++slot)
+			oldSlots[slot] = m_Slots[order[slot]];
+		for (TransformNode node : m_Nodes)
+		{
+			m_Slots[node] = InvalidSlot;
+			m_NodeParents[node] = m_NodeParents[node] == DestroyedNode ? InvalidTransformNode : m_NodeParents[node];
+		}
+
+		m_LevelDirty.assign(m_LevelOffsets.size() - 1, 0);
+		m_LevelUpdated.assign(m_LevelOffsets.size() - 1, 0);
+		for (uint32_t level = 0, slot = 0; slot < order.size(); ++slot)
+		{
+			while (slot >= m_LevelOffsets[level + 1])
+				++level;
+
+			const TransformNode node = order[slot];
+			const uint32_t oldSlot = oldSlots[slot];
+			m_Slots[node] = slot;
+			const TransformNode parent = m_NodeParents[node];
+			parentSlots[slot] = parent == InvalidTransformNode ? InvalidSlot : m_Slots[parent];
+			positions[slot] = m_Positions[oldSlot];
+			rotations[slot] = m_Rotations[oldSlot];
+			scales[slot] = m_Scales[oldSlot];
+			world[slot] = m_World[oldSlot];
+			flags[slot] = m_Flags[oldSlot];
+			m_LevelDirty[level] |= flags[slot] & LocalDirty;
+			m_LevelUpdated[level] |= (flags[slot] & WorldUpdated) != 0;
+		}
+
+		for (TransformNode node : m_Nodes)
+		{
+			if (m_Slots[node] == InvalidSlot)
+				m_FreeNodes.push_back(node);
+		}
+
+		m_Nodes = std::move(order);
+		m_ParentSlots = std::move(parentSlots);
+		m_Positions = std::move(positions);
+		m_Rotations = std::move(rotations);
+		m_Scales = std::move(scales);
+		m_World = std::move(world);
+		m_Flags = std::move(flags);
+		m_NodeCount = (uint32_t)m_Nodes.size();
+		m_StructureDirty = false;
+
+		m_Statistics.Nodes = m_NodeCount;
+		m_Statistics.Levels = (uint32_t)m_LevelOffsets.size() - 1;
+		++m_Statistics.Rebuilds;
+	}
+}
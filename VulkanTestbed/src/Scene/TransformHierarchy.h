@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_aligned.hpp>
+
+namespace VulkanTestbed
+{
+	using TransformNode = uint32_t;
+	static constexpr TransformNode InvalidTransformNode = ~0u;
+
+	struct LocalTransform
+	{
+		glm::vec3 Position = glm::vec3(0.0f);
+		glm::quat Rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		glm::vec3 Scale = glm::vec3(1.0f);
+	};
+
+	struct TransformStatistics
+	{
+		uint32_t Nodes = 0;
+		uint32_t Levels = 0;
+		// World matrices recomputed by the last Update
+		uint32_t UpdatedNodes = 0;
+		uint32_t Rebuilds = 0;
+	};
+
+	// Parent indices, local TRS and world matrices in SoA arrays sorted by depth, so every parent comes before its
+	// children and each level only reads the one before it. Update walks the levels in order and recomputes a
+	// level's nodes in parallel, but only where the local transform or one of the ancestors changed. Adding,
+	// destroying or reparenting nodes re-sorts the arrays on the next Update. Main thread only.
+	class TransformHierarchy
+	{
+	public:
+		TransformNode Create(TransformNode parent = InvalidTransformNode, const LocalTransform& local = {});
+		// Destroys the whole subtree, none of its nodes may be used afterwards. They are freed by the next Update.
+		void Destroy(TransformNode node);
+		void SetParent(TransformNode node, TransformNode parent);
+		void SetLocal(TransformNode node, const LocalTransform& local);
+		void Reserve(uint32_t nodeCount);
+
+		void Update();
+
+		TransformNode GetParent(TransformNode node) const { return m_NodeParents[node]; }
+		LocalTransform GetLocal(TransformNode node) const;
+		// As of the last Update
+		glm::mat4 GetWorld(TransformNode node) const { return glm::mat4(m_World[m_Slots[node]]); }
+		// True when the last Update recomputed the node's world matrix
+		bool WasUpdated(TransformNode node) const { return (m_Flags[m_Slots[node]] & WorldUpdated) != 0; }
+
+		uint32_t GetNodeCount() const { return m_NodeCount; }
+		const TransformStatistics& GetStatistics() const { return m_Statistics; }
+
+	private:
+		enum NodeFlags : uint8_t
+		{
+			LocalDirty = 1 << 0,
+			WorldUpdated = 1 << 1,
+		};
+
+		bool IsAlive(TransformNode node) const { return node < m_Slots.size() && m_Slots[node] != InvalidSlot && m_NodeParents[node] != DestroyedNode; }
+		uint32_t GetLevel(uint32_t slot) const;
+		// Sorts the slots by depth, drops destroyed subtrees and frees their nodes
+		void Rebuild();
+
+	private:
+		static constexpr uint32_t InvalidSlot = ~0u;
+		// Stands in for the parent of destroyed nodes until Rebuild frees them
+		static constexpr TransformNode DestroyedNode = ~1u;
+
+		// Indexed by node
+		std::vector<TransformNode> m_NodeParents;
+		std::vector<uint32_t> m_Slots;
+		std::vector<TransformNode> m_FreeNodes;
+		uint32_t m_NodeCount = 0;
+
+		// Indexed by slot, depth sorted after Rebuild
+		std::vector<TransformNode> m_Nodes;
+		std::vector<uint32_t> m_ParentSlots;
+		std::vector<glm::vec3> m_Positions;
+		std::vector<glm::quat> m_Rotations;
+		std::vector<glm::vec3> m_Scales;
+		std::vector<glm::aligned_mat4> m_World;
+		std::vector<uint8_t> m_Flags;
+
+		// First slot of every level plus the end of the last one
+		std::vector<uint32_t> m_LevelOffsets;
+		// Levels with nodes whose local transform changed and levels the last Update touched
+		std::vector<uint8_t> m_LevelDirty;
+		std::vector<uint8_t> m_LevelUpdated;
+		bool m_StructureDirty = false;
+
+		TransformStatistics m_Statistics;
+	};
+}
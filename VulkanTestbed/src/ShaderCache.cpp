@@ -0,0 +1,332 @@
+#include "pch.h"
+#include "ShaderCache.h"
+
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+
+#include "Core/Hash.h"
+#include "Core/JobSystem.h"
+#include "Core/MappedFile.h"
+#include "Core/Timer.h"
+#include "HostAllocator.h"
+#include "VulkanContext.h"
+
+namespace VulkanTestbed
+{
+	static constexpr uint32_t SpirvMagic = 0x07230203;
+	// Include chains deeper than this are treated as cycles
+	static constexpr uint32_t MaxIncludeDepth = 32;
+
+	static std::filesystem::path s_CacheDirectory;
+	static std::string s_Compiler;
+
+	// Makes temporary compiler outputs unique, the job system's thread index is the same on every thread it doesn't own
+	static std::atomic<uint32_t> s_TempFileCounter = 0;
+	static std::atomic<uint32_t> s_Hits = 0;
+	static std::atomic<uint32_t> s_Compiled = 0;
+	static std::atomic<uint32_t> s_Failed = 0;
+	static std::mutex s_CompileTimeMutex;
+	static double s_CompileSeconds = 0.0;
+
+	static const char* ShaderStageToGlslc(ShaderStage stage)
+	{
+		switch (stage)
+		{
+			case ShaderStage::Vertex:	return "vert";
+			case ShaderStage::Fragment:	return "frag";
+			case ShaderStage::Compute:	return "comp";
+		}
+		TESTBED_ASSERT(false, "Unknown shader stage!");
+		return "";
+	}
+
+	// Moves past whitespace and comments that close on the same line, sets inComment when one runs past the end of it
+	static size_t SkipSpaceAndComments(const char* text, size_t i, size_t lineEnd, bool& inComment)
+	{
+		while (i < lineEnd)
+		{
+			if (inComment)
+			{
+				while (i + 1 < lineEnd && !(text[i] == '*' && text[i + 1] == '/'))
+					++i;
+				if (i + 1 >= lineEnd)
+					return lineEnd;
+				inComment = false;
+				i += 2;
+			}
+			else if (text[i] == ' ' || text[i] == '\t' || text[i] == '\r')
+				++i;
+			else if (i + 1 < lineEnd && text[i] == '/' && text[i + 1] == '*')
+			{
+				inComment = true;
+				i += 2;
+			}
+			else
+				break;
+		}
+		return i;
+	}
+
+	// Hashes the file and, depth first, every file it includes. Only the quoted form is followed, the same files glslc opens.
+	// Directives inside comments are not, the preprocessor never sees them either.
+	static bool HashSourceTree(const std::filesystem::path& path, uint32_t depth, uint64_t& hash)
+	{
+		if (depth > MaxIncludeDepth)
+		{
+			LOG_ERROR("ShaderCache: Include depth exceeded in {}", path.string());
+			return false;
+		}
+
+		MappedFile file;
+		if (!file.Open(path))
+		{
+			LOG_ERROR("ShaderCache: Failed to open {}", path.string());
+			return false;
+		}
+
+		const char* text = (const char*)file.GetData();
+		const size_t size = file.GetSize();
+		hash = HashCombine(hash, Hash64(text, size));
+
+		bool inComment = false;
+		size_t lineStart = 0;
+		while (lineStart < size)
+		{
+			size_t lineEnd = lineStart;
+			while (lineEnd < size && text[lineEnd] != '\n')
+				++lineEnd;
+
+			const size_t i = SkipSpaceAndComments(text, lineStart, lineEnd, inComment);
+
+			static constexpr char IncludeDirective[] = "#include";
+			static constexpr size_t IncludeLength = sizeof(IncludeDirective) - 1;
+			if (lineEnd - i > IncludeLength && memcmp(text + i, IncludeDirective, IncludeLength) == 0)
+			{
+				const char* begin = (const char*)memchr(text + i + IncludeLength, '"', lineEnd - i - IncludeLength);
+				const char* end = begin ? (const char*)memchr(begin + 1, '"', text + lineEnd - begin - 1) : nullptr;
+				if (end && !HashSourceTree(path.parent_path() / std::string(begin + 1, end), depth + 1, hash))
+					return false;
+			}
+
+			// A block comment opened further along the line hides the lines after it, line comments end the scan
+			for (size_t j = i; j + 1 < lineEnd; ++j)
+			{
+				if (text[j] == '/' && text[j + 1] == '/')
+					break;
+				if (text[j] == '/' && text[j + 1] == '*')
+				{
+					j = SkipSpaceAndComments(text, j, lineEnd, inComment) - 1;
+					if (inComment)
+						break;
+				}
+			}
+			lineStart = lineEnd + 1;
+		}
+		return true;
+	}
+
+	static bool ComputeKey(const ShaderDesc& desc, uint64_t& outKey)
+	{
+		uint64_t key = HashCombine(ShaderCache::Version, (uint64_t)desc.Stage);
+		for (const ShaderDefine& define : desc.Defines)
+		{
+			key = HashCombine(key, Hash64(define.Name.data(), define.Name.size()));
+			key = HashCombine(key, Hash64(define.Value.data(), define.Value.size()));
+		}
+
+		if (!HashSourceTree(desc.Path, 0, key))
+			return false;
+		outKey = key;
+		return true;
+	}
+
+	static bool ReadSpirv(const std::filesystem::path& path, std::vector<uint32_t>& outSpirv)
+	{
+		MappedFile file;
+		if (!file.Open(path))
+			return false;
+
+		const size_t size = file.GetSize();
+		if (size < sizeof(uint32_t) * 5 || size % sizeof(uint32_t) != 0 || *(const uint32_t*)file.GetData() != SpirvMagic)
+			return false;
+
+		outSpirv.resize(size / sizeof(uint32_t));
+		memcpy(outSpirv.data(), file.GetData(), size);
+		return true;
+	}
+
+	// Defines end up on a shell command line. Names have to be identifiers and values may not contain anything a shell
+	// or cmd expands inside double quotes.
+	static bool IsValidDefine(const ShaderDefine& define)
+	{
+		if (define.Name.empty() || std::isdigit((unsigned char)define.Name[0]))
+			return false;
+		for (char c : define.Name)
+		{
+			if (!std::isalnum((unsigned char)c) && c != '_')
+				return false;
+		}
+
+		for (char c : define.Value)
+		{
+			if (c < ' ' || c > '~' || strchr("\"\\$`%!", c))
+				return false;
+		}
+		return true;
+	}
+
+	static bool Compile(const ShaderDesc& desc, const std::filesystem::path& cachePath)
+	{
+		for (const ShaderDefine& define : desc.Defines)
+		{
+			if (!IsValidDefine(define))
+			{
+				LOG_ERROR("ShaderCache: Define '{}' of {} can't be passed to the compiler", define.Name, desc.Path.string());
+				return false;
+			}
+		}
+
+		// glslc writes next to the final name, and only a complete module is renamed into place. Two threads may compile
+		// the same key, so the temporary name is unique within the process.
+		std::filesystem::path tempPath = cachePath;
+		tempPath += "." + std::to_string(s_TempFileCounter.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+
+		std::string command = "\"" + s_Compiler + "\" -fshader-stage=" + ShaderStageToGlslc(desc.Stage) + " --target-env=vulkan1.2 -O";
+		for (const ShaderDefine& define : desc.Defines)
+			command += " \"-D" + define.Name + (define.Value.empty() ? "" : "=" + define.Value) + "\"";
+		command += " -o \"" + tempPath.string() + "\" \"" + desc.Path.string() + "\"";
+#ifdef _WIN32
+		// cmd strips the outer quotes when the command starts with one
+		command = "\"" + command + "\"";
+#endif
+
+		const int exitCode = std::system(command.c_str());
+
+		std::error_code error;
+		if (exitCode != 0)
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+
+		std::filesystem::rename(tempPath, cachePath, error);
+		return !error;
+	}
+
+	void ShaderCache::Init(const std::filesystem::path& cacheDirectory)
+	{
+		s_CacheDirectory = cacheDirectory;
+		s_Hits = 0;
+		s_Compiled = 0;
+		s_Failed = 0;
+		s_CompileSeconds = 0.0;
+
+		std::error_code error;
+		std::filesystem::create_directories(s_CacheDirectory, error);
+		if (error)
+			LOG_ERROR("ShaderCache: Failed to create {}: {}", s_CacheDirectory.string(), error.message());
+
+#ifdef _WIN32
+		static constexpr const char* CompilerName = "glslc.exe";
+#else
+		static constexpr const char* CompilerName = "glslc";
+#endif
+		// Falls back to whatever glslc is on the PATH
+		const char* sdk = std::getenv("VULKAN_SDK");
+		s_Compiler = sdk ? (std::filesystem::path(sdk) / "bin" / CompilerName).string() : CompilerName;
+	}
+
+	void ShaderCache::Shutdown()
+	{
+		LogStatistics();
+	}
+
+	bool ShaderCache::Load(const ShaderDesc& desc, std::vector<uint32_t>& outSpirv)
+	{
+		outSpirv.clear();
+
+		uint64_t key;
+		if (!ComputeKey(desc, key))
+		{
+			s_Failed.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		const std::filesystem::path cachePath = s_CacheDirectory / fmt::format("{:016x}.spv", key);
+		if (ReadSpirv(cachePath, outSpirv))
+		{
+			s_Hits.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		Timer timer;
+		const bool compiled = Compile(desc, cachePath) && ReadSpirv(cachePath, outSpirv);
+		{
+			std::lock_guard<std::mutex> lock(s_CompileTimeMutex);
+			s_CompileSeconds += timer.Elapsed();
+		}
+
+		if (!compiled)
+		{
+			LOG_ERROR("ShaderCache: Failed to compile {}", desc.Path.string());
+			s_Failed.fetch_add(1, std::memory_order_relaxed);
+			outSpirv.clear();
+			return false;
+		}
+
+		s_Compiled.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	void ShaderCache::LoadAll(const std::vector<ShaderDesc>& descs, std::vector<std::vector<uint32_t>>& outSpirv)
+	{
+		outSpirv.resize(descs.size());
+		// One shader per job, a miss blocks its thread on the compiler process
+		ParallelForRange((uint32_t)descs.size(), 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++i)
+				Load(descs[i], outSpirv[i]);
+		});
+	}
+
+	VkShaderModule ShaderCache::CreateModule(const std::vector<uint32_t>& spirv)
+	{
+		VkShaderModuleCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = spirv.size() * sizeof(uint32_t);
+		createInfo.pCode = spirv.data();
+
+		VkShaderModule module = nullptr;
+		if (vkCreateShaderModule(VulkanContext::GetDevice(), &createInfo, HostAllocator::GetCallbacks(HostSubsystem::Pipelines), &module) != VK_SUCCESS)
+			return nullptr;
+		return module;
+	}
+
+	void ShaderCache::DestroyModule(VkShaderModule module)
+	{
+		vkDestroyShaderModule(VulkanContext::GetDevice(), module, HostAllocator::GetCallbacks(HostSubsystem::Pipelines));
+	}
+
+	ShaderCacheStatistics ShaderCache::GetStatistics()
+	{
+		ShaderCacheStatistics stats;
+		stats.Hits = s_Hits.load(std::memory_order_relaxed);
+		stats.Compiled = s_Compiled.load(std::memory_order_relaxed);
+		stats.Failed = s_Failed.load(std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(s_CompileTimeMutex);
+		stats.CompileSeconds = s_CompileSeconds;
+		return stats;
+	}
+
+	void ShaderCache::LogStatistics()
+	{
+		const ShaderCacheStatistics stats = GetStatistics();
+		if (stats.Hits + stats.Compiled + stats.Failed == 0)
+			return;
+
+		LOG_INFO("ShaderCache: {} hits, {} compiled in {:.2f} ms, {} failed", stats.Hits, stats.Compiled, stats.CompileSeconds * 1000.0, stats.Failed);
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <filesystem>
+
+#include <vulkan/vulkan.h>
+
+namespace VulkanTestbed
+{
+	enum class ShaderStage : uint8_t
+	{
+		Vertex = 0,
+		Fragment,
+		Compute
+	};
+
+	struct ShaderDefine
+	{
+		std::string Name;
+		std::string Value;
+	};
+
+	struct ShaderDesc
+	{
+		// GLSL source, #include "..." is resolved relative to the including file
+		std::filesystem::path Path;
+		ShaderStage Stage = ShaderStage::Vertex;
+		std::vector<ShaderDefine> Defines;
+	};
+
+	struct ShaderCacheStatistics
+	{
+		uint32_t Hits = 0;
+		uint32_t Compiled = 0;
+		uint32_t Failed = 0;
+		double CompileSeconds = 0.0;
+	};
+
+	// Content addressed SPIR-V: the file name is a hash of the source, everything it includes, the stage and the defines,
+	// so a hit needs no timestamps and never starts the compiler. Misses run glslc from the Vulkan SDK.
+	class ShaderCache
+	{
+	public:
+		// Bump when the compiler flags change, old entries are then simply never looked up again
+		static constexpr uint32_t Version = 1;
+
+		static void Init(const std::filesystem::path& cacheDirectory);
+		static void Shutdown();
+
+		// Returns false when the source is missing or doesn't compile
+		static bool Load(const ShaderDesc& desc, std::vector<uint32_t>& outSpirv);
+		// Misses are compiled in parallel, outSpirv[i] is empty when desc i failed
+		static void LoadAll(const std::vector<ShaderDesc>& descs, std::vector<std::vector<uint32_t>>& outSpirv);
+
+		// Null when the device rejects the module
+		static VkShaderModule CreateModule(const std::vector<uint32_t>& spirv);
+		static void DestroyModule(VkShaderModule module);
+
+		static ShaderCacheStatistics GetStatistics();
+		static void LogStatistics();
+	};
+}
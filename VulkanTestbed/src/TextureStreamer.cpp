@@ -0,0 +1,429 @@
+#include "pch.h"
+#include "TextureStreamer.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <queue>
+
+#include "Asset/TextureCache.h"
+#include "Asset/TextureImporter.h"
+#include "BindlessDescriptors.h"
+#include "Core/JobSystem.h"
+#include "Core/Profiler.h"
+#include "Core/Timer.h"
+#include "DeviceAllocator.h"
+#include "HostAllocator.h"
+#include "UploadManager.h"
+#include "VulkanContext.h"
+
+namespace VulkanTestbed
+{
+	struct StreamedTexture
+	{
+		std::string Name;
+		VkImage Image = nullptr;
+		DeviceAllocation Memory;
+		// Covers the resident mips only, null until the smallest one landed
+		VkImageView View = nullptr;
+		uint32_t MipCount = 0;
+		uint32_t ResidentMip = 0;
+		// Block rows of mip ResidentMip - 1 that are already copied, texel rows for uncompressed formats
+		uint32_t UploadedRows = 0;
+		BindlessIndex BindlessSlot = InvalidBindlessIndex;
+
+		// Freed once the last mip is uploaded
+		std::unique_ptr<TextureData> Data;
+	};
+
+	struct DecodeRequest
+	{
+		TextureHandle Handle;
+		std::filesystem::path Path;
+	};
+
+	struct DecodeResult
+	{
+		TextureHandle Handle;
+		std::unique_ptr<TextureData> Data;
+	};
+
+	struct UploadRequest
+	{
+		// Texels in the next mip to upload, smaller mips go first
+		uint64_t TexelCount;
+		TextureHandle Handle;
+
+		bool operator<(const UploadRequest& other) const
+		{
+			return TexelCount != other.TexelCount ? TexelCount > other.TexelCount : Handle > other.Handle;
+		}
+	};
+
+	static TextureStreamerSettings s_Settings;
+
+	// Owned by the main thread
+	static std::vector<StreamedTexture> s_Textures;
+	static std::priority_queue<UploadRequest> s_UploadQueue;
+	static TextureStreamerStatistics s_Stats;
+	static Timer s_StreamTimer;
+
+	// Appended by the main thread only, decode jobs hold pointers into it which a deque never invalidates
+	static std::deque<DecodeRequest> s_DecodeRequests;
+	static JobCounter s_DecodeCounter;
+	static std::atomic<bool> s_Running = false;
+	// Cleared by InitDevice when the device can't sample BC formats, decodes after that skip compression
+	static std::atomic<bool> s_CompressionSupported = true;
+	static std::mutex s_ResultMutex;
+	static std::vector<DecodeResult> s_DecodeResults;
+
+	static bool s_DeviceInitialized = false;
+	// Views replaced by finer ones and the timeline value of the last frame that could have sampled them
+	static std::deque<std::pair<VkImageView, uint64_t>> s_RetiredViews;
+
+	static VkFormat GetVkFormat(TextureFormat format, bool srgb)
+	{
+		switch (format)
+		{
+			case TextureFormat::RGBA8:	return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+			case TextureFormat::BC1:	return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+			case TextureFormat::BC3:	return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+			case TextureFormat::BC5:	return VK_FORMAT_BC5_UNORM_BLOCK;
+			case TextureFormat::BC7:	return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+		}
+
+		TESTBED_ASSERT(false, "Unknown texture format!");
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	// Naming convention only, normal maps are stored linear and compressed to two channels
+	static bool IsNormalMap(const std::filesystem::path& path)
+	{
+		std::string stem = path.stem().string();
+		std::transform(stem.begin(), stem.end(), stem.begin(), [](char c) { return (char)std::tolower(c); });
+
+		auto endsWith = [&](const char* suffix)
+		{
+			const size_t length = strlen(suffix);
+			return stem.size() >= length && stem.compare(stem.size() - length, length, suffix) == 0;
+		};
+		return stem.find("normal") != std::string::npos || endsWith("_n") || endsWith("_nrm") || endsWith("_norm");
+	}
+
+	static void DecodeTexture(const DecodeRequest& request)
+	{
+		TESTBED_PROFILE_FUNCTION();
+		// Shutting down, the result would be thrown away
+		if (!s_Running)
+			return;
+
+		const bool normalMap = IsNormalMap(request.Path);
+		auto texture = std::make_unique<TextureData>();
+		bool loaded = false;
+		if (s_Settings.Compression == TextureCompression::None || !s_CompressionSupported)
+		{
+			loaded = TextureImporter::Import(request.Path, *texture);
+			texture->SRGB = !normalMap;
+		}
+		else
+		{
+			loaded = TextureCache::Load(request.Path, s_Settings.Compression, normalMap, *texture);
+		}
+
+		if (!loaded)
+			texture.reset();
+
+		std::lock_guard<std::mutex> lock(s_ResultMutex);
+		s_DecodeResults.push_back({ request.Handle, std::move(texture) });
+	}
+
+	static void CreateImage(StreamedTexture& texture)
+	{
+		VkDevice device = VulkanContext::GetDevice();
+		const TextureData& data = *texture.Data;
+
+		VkImageCreateInfo imageCreateInfo = {};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = GetVkFormat(data.Format, data.SRGB);
+		imageCreateInfo.extent = { data.Width, data.Height, 1 };
+		imageCreateInfo.mipLevels = data.GetMipCount();
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkResult result = vkCreateImage(device, &imageCreateInfo, HostAllocator::GetCallbacks(HostSubsystem::Textures), &texture.Image);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create texture image!");
+
+		texture.Memory = VulkanContext::GetAllocator().AllocateImage(texture.Image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		TESTBED_ASSERT(texture.Memory.Memory, "Failed to allocate texture memory!");
+
+		texture.MipCount = data.GetMipCount();
+		texture.ResidentMip = texture.MipCount;
+		texture.UploadedRows = 0;
+
+		// The slot samples the placeholder until there is a mip to show
+		if (BindlessDescriptors::IsEnabled())
+			texture.BindlessSlot = BindlessDescriptors::RegisterTexture(nullptr);
+	}
+
+	// Swaps in a view that starts at the resident mip, so nothing samples mips that are still undefined
+	static void UpdateResidentView(StreamedTexture& texture)
+	{
+		VkImageViewCreateInfo viewCreateInfo = {};
+		viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewCreateInfo.image = texture.Image;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = GetVkFormat(texture.Data->Format, texture.Data->SRGB);
+		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, texture.ResidentMip, texture.MipCount - texture.ResidentMip, 0, 1 };
+		VkImageView view = nullptr;
+		VkResult result = vkCreateImageView(VulkanContext::GetDevice(), &viewCreateInfo, HostAllocator::GetCallbacks(HostSubsystem::Textures), &view);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create texture image view!");
+
+		if (texture.View)
+			s_RetiredViews.emplace_back(texture.View, VulkanContext::GetFrameTimelineValue());
+		texture.View = view;
+
+		if (texture.BindlessSlot != InvalidBindlessIndex)
+			texture.BindlessSlot = BindlessDescriptors::UpdateTexture(texture.BindlessSlot, view);
+	}
+
+	static void DestroyRetiredViews(uint64_t completedValue)
+	{
+		while (!s_RetiredViews.empty() && s_RetiredViews.front().second <= completedValue)
+		{
+			vkDestroyImageView(VulkanContext::GetDevice(), s_RetiredViews.front().first, HostAllocator::GetCallbacks(HostSubsystem::Textures));
+			s_RetiredViews.pop_front();
+		}
+	}
+
+	static void QueueNextMip(TextureHandle handle)
+	{
+		const StreamedTexture& texture = s_Textures[handle];
+		const TextureMip& mip = texture.Data->Mips[texture.ResidentMip - 1];
+		s_UploadQueue.push({ (uint64_t)mip.Width * mip.Height, handle });
+	}
+
+	static void CollectDecodedTextures()
+	{
+		std::vector<DecodeResult> results;
+		{
+			std::lock_guard<std::mutex> lock(s_ResultMutex);
+			results.swap(s_DecodeResults);
+		}
+
+		for (DecodeResult& result : results)
+		{
+			StreamedTexture& texture = s_Textures[result.Handle];
+			if (!result.Data)
+			{
+				++s_Stats.Failed;
+				continue;
+			}
+
+			// Decoded before InitDevice found out the device can't sample it
+			if (result.Data->Format != TextureFormat::RGBA8 && !s_CompressionSupported)
+			{
+				auto decompressed = std::make_unique<TextureData>();
+				TextureCompressor::Decompress(*result.Data, *decompressed);
+				result.Data = std::move(decompressed);
+			}
+
+			texture.Data = std::move(result.Data);
+			CreateImage(texture);
+			QueueNextMip(result.Handle);
+		}
+	}
+
+	// Picks mips in queue order until the frame budget or the staging ring runs out, large mips are split into row bands
+	static void ScheduleCopies()
+	{
+		uint64_t budget = s_Settings.FrameBudget;
+		bool scheduled = false;
+		while (!s_UploadQueue.empty())
+		{
+			const TextureHandle handle = s_UploadQueue.top().Handle;
+			StreamedTexture& texture = s_Textures[handle];
+			const uint32_t mip = texture.ResidentMip - 1;
+			const TextureMip& mipInfo = texture.Data->Mips[mip];
+
+			const uint64_t rowPitch = texture.Data->GetRowPitch(mip);
+			const uint32_t blockRowCount = texture.Data->GetBlockRowCount(mip);
+			const uint64_t maxBandSize = std::min(budget, UploadManager::GetStagingSize() / 4);
+			uint32_t rowCount = std::min(blockRowCount - texture.UploadedRows, (uint32_t)(maxBandSize / rowPitch));
+			// Always make progress on rows that are wider than the whole budget
+			if (rowCount == 0 && !scheduled)
+				rowCount = 1;
+			if (rowCount == 0)
+				break;
+
+			const uint64_t size = rowCount * rowPitch;
+			StagingAllocation staging;
+			if (!UploadManager::AllocateStaging(size, 16, staging))
+				break;
+
+			memcpy(staging.Data, texture.Data->GetMipPixels(mip) + texture.UploadedRows * rowPitch, size);
+			budget -= std::min(budget, size);
+			scheduled = true;
+
+			// Bands of compressed mips cover whole blocks, except where they reach the bottom edge
+			const uint32_t blockDimension = texture.Data->GetBlockDimension();
+			const uint32_t firstRow = texture.UploadedRows * blockDimension;
+			ImageUpload upload;
+			upload.Image = texture.Image;
+			upload.Subresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 };
+			upload.Offset = { 0, (int32_t)firstRow, 0 };
+			upload.Extent = { mipInfo.Width, std::min(rowCount * blockDimension, mipInfo.Height - firstRow), 1 };
+			upload.First = texture.UploadedRows == 0;
+			upload.Last = texture.UploadedRows + rowCount == blockRowCount;
+			UploadManager::CopyToImage(staging, upload);
+
+			texture.UploadedRows += rowCount;
+			if (!upload.Last)
+				continue;
+
+			// UploadManager::Submit hands the mip to the graphics queue ahead of any draw in this frame, so it can be sampled right away
+			s_UploadQueue.pop();
+			texture.ResidentMip = mip;
+			texture.UploadedRows = 0;
+			s_Stats.BytesUploaded += texture.Data->GetMipSize(mip);
+			UpdateResidentView(texture);
+			if (mip > 0)
+			{
+				QueueNextMip(handle);
+				continue;
+			}
+
+			texture.Data.reset();
+			++s_Stats.Resident;
+		}
+	}
+
+	void TextureStreamer::Init(const TextureStreamerSettings& settings)
+	{
+		s_Settings = settings;
+		s_CompressionSupported = true;
+		s_Running = true;
+	}
+
+	void TextureStreamer::InitDevice()
+	{
+		TESTBED_ASSERT(s_Running, "TextureStreamer::Init has to be called first!");
+		s_DeviceInitialized = true;
+
+		if (s_Settings.Compression != TextureCompression::None)
+		{
+			const VkFormat formats[] = { VK_FORMAT_BC1_RGB_SRGB_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK };
+			for (VkFormat format : formats)
+			{
+				if (!VulkanContext::IsFormatSupported(format, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT))
+				{
+					LOG_WARN("TextureStreamer: BC formats are not supported, textures are uploaded uncompressed");
+					s_CompressionSupported = false;
+					break;
+				}
+			}
+		}
+	}
+
+	void TextureStreamer::Shutdown()
+	{
+		s_Running = false;
+		JobSystem::Wait(s_DecodeCounter);
+		s_DecodeRequests.clear();
+		s_DecodeResults.clear();
+
+		// Images only exist once the device side was initialized
+		if (s_DeviceInitialized)
+		{
+			VulkanContext::WaitIdle();
+			DestroyRetiredViews(~0ull);
+			VkDevice device = VulkanContext::GetDevice();
+			for (StreamedTexture& texture : s_Textures)
+			{
+				if (!texture.Image)
+					continue;
+
+				if (texture.BindlessSlot != InvalidBindlessIndex)
+					BindlessDescriptors::ReleaseTexture(texture.BindlessSlot);
+				if (texture.View)
+					vkDestroyImageView(device, texture.View, HostAllocator::GetCallbacks(HostSubsystem::Textures));
+				vkDestroyImage(device, texture.Image, HostAllocator::GetCallbacks(HostSubsystem::Textures));
+				VulkanContext::GetAllocator().Free(texture.Memory);
+			}
+
+			s_DeviceInitialized = false;
+		}
+
+		s_Textures.clear();
+		s_UploadQueue = {};
+		s_Stats = {};
+	}
+
+	TextureHandle TextureStreamer::Load(const std::filesystem::path& path)
+	{
+		if (IsIdle())
+			s_StreamTimer.Reset();
+
+		const TextureHandle handle = (TextureHandle)s_Textures.size();
+		s_Textures.emplace_back().Name = path.filename().string();
+		++s_Stats.Requested;
+
+		const DecodeRequest* request = &s_DecodeRequests.emplace_back(DecodeRequest{ handle, path });
+		// Never picked up by the main thread, waiting on startup or a ParallelFor doesn't end up decoding a texture
+		JobSystem::RunBackground(s_DecodeCounter, [request]() { DecodeTexture(*request); });
+		return handle;
+	}
+
+	void TextureStreamer::Update()
+	{
+		TESTBED_PROFILE_FUNCTION();
+		if (s_DeviceInitialized)
+			DestroyRetiredViews(VulkanContext::GetCompletedTimelineValue());
+		if (IsIdle())
+			return;
+
+		TESTBED_ASSERT(s_DeviceInitialized, "TextureStreamer::InitDevice has to be called before the first Update!");
+
+		CollectDecodedTextures();
+		ScheduleCopies();
+
+		if (IsIdle())
+		{
+			LOG_INFO("TextureStreamer: {} textures resident after {:.2f} s, {:.1f} MB uploaded, {} failed",
+				s_Stats.Resident, s_StreamTimer.Elapsed(), (double)s_Stats.BytesUploaded / (1024.0 * 1024.0), s_Stats.Failed);
+		}
+	}
+
+	uint32_t TextureStreamer::GetResidentMip(TextureHandle handle)
+	{
+		return s_Textures[handle].ResidentMip;
+	}
+
+	uint32_t TextureStreamer::GetMipCount(TextureHandle handle)
+	{
+		return s_Textures[handle].MipCount;
+	}
+
+	VkImageView TextureStreamer::GetImageView(TextureHandle handle)
+	{
+		return s_Textures[handle].View;
+	}
+
+	BindlessIndex TextureStreamer::GetBindlessIndex(TextureHandle handle)
+	{
+		return s_Textures[handle].BindlessSlot;
+	}
+
+	bool TextureStreamer::IsIdle()
+	{
+		return s_Stats.Resident + s_Stats.Failed == s_Stats.Requested;
+	}
+
+	TextureStreamerStatistics TextureStreamer::GetStatistics()
+	{
+		return s_Stats;
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <filesystem>
+
+#include <vulkan/vulkan.h>
+
+#include "Asset/TextureCompressor.h"
+#include "BindlessDescriptors.h"
+
+namespace VulkanTestbed
+{
+	using TextureHandle = uint32_t;
+	static constexpr TextureHandle InvalidTexture = ~0u;
+
+	struct TextureStreamerSettings
+	{
+		// Upper bound on bytes staged per frame, keeps the frame time stable while streaming
+		uint64_t FrameBudget = 16ull << 20;
+		// Falls back to None when the device lacks BC support. Compressed mips are cached next to the source.
+		TextureCompression Compression = TextureCompression::Normal;
+	};
+
+	struct TextureStreamerStatistics
+	{
+		uint32_t Requested = 0;
+		uint32_t Resident = 0;
+		uint32_t Failed = 0;
+		uint64_t BytesUploaded = 0;
+	};
+
+	// Decodes textures and builds their mip chains in jobs, then uploads the mips coarsest first
+	// through UploadManager. Textures become usable as soon as their smallest mip lands, the main thread
+	// never waits on a decode.
+	class TextureStreamer
+	{
+	public:
+		// CPU side only, textures can be loaded and decoded before the device exists
+		static void Init(const TextureStreamerSettings& settings = {});
+		// Needs VulkanContext and UploadManager, has to happen before the first Update
+		static void InitDevice();
+		static void Shutdown();
+
+		// Queues the file for decoding and returns immediately
+		static TextureHandle Load(const std::filesystem::path& path);
+		// Queues this frame's uploads, call between VulkanContext::BeginFrame and UploadManager::Submit
+		static void Update();
+
+		// Finest mip with valid contents. Equals the mip count until the first mip is uploaded.
+		static uint32_t GetResidentMip(TextureHandle handle);
+		static uint32_t GetMipCount(TextureHandle handle);
+		// Starts at the resident mip and is replaced as finer ones arrive, so look it up every frame. Null until the
+		// smallest mip is uploaded.
+		static VkImageView GetImageView(TextureHandle handle);
+		// Slot in BindlessDescriptors once the image exists, InvalidBindlessIndex before or when bindless is off. The
+		// placeholder until the smallest mip is uploaded, then the current view. The index may change with the view.
+		static BindlessIndex GetBindlessIndex(TextureHandle handle);
+		// True once every requested texture is fully resident or failed to load
+		static bool IsIdle();
+
+		static TextureStreamerStatistics GetStatistics();
+	};
+}
@@ -0,0 +1,398 @@
+#include "pch.h"
+#include "UploadManager.h"
+
+#include <cstring>
+
+#include "Core/Profiler.h"
+#include "DeviceAllocator.h"
+#include "HostAllocator.h"
+#include "VulkanContext.h"
+
+namespace VulkanTestbed
+{
+	// One batch per frame, so one more than the frames in flight covers the usual case without waiting on a fence
+	static constexpr uint32_t BatchCount = VulkanContext::MaxFramesInFlight + 1;
+
+	struct UploadBatch
+	{
+		VkCommandPool CommandPool = nullptr;
+		VkCommandBuffer CommandBuffer = nullptr;
+		VkFence Fence = nullptr;
+		// Ring position up to which the batch's copies read, the tail moves there once the fence signals
+		uint64_t StagingEnd = 0;
+	};
+
+	struct PendingImageCopy
+	{
+		ImageUpload Upload;
+		VkDeviceSize StagingOffset;
+	};
+
+	struct PendingBufferCopy
+	{
+		VkBuffer Buffer;
+		VkBufferCopy Region;
+		VkPipelineStageFlags DstStages;
+		VkAccessFlags DstAccess;
+	};
+
+	static UploadManagerSettings s_Settings;
+	static UploadStatistics s_Stats;
+
+	// Positions are monotonic byte counters, the buffer offset is the position modulo the ring size
+	static VkBuffer s_StagingBuffer = nullptr;
+	static DeviceAllocation s_StagingMemory;
+	static uint8_t* s_StagingData = nullptr;
+	static uint64_t s_StagingHead = 0;
+	static uint64_t s_StagingTail = 0;
+
+	// Submitted batches are s_OldestBatch and the s_PendingCount - 1 slots after it
+	static std::array<UploadBatch, BatchCount> s_Batches;
+	static uint32_t s_OldestBatch = 0;
+	static uint32_t s_PendingCount = 0;
+	// Signalled with the batch number once a batch is done, the graphics queue waits on it
+	static VkSemaphore s_Semaphore = nullptr;
+	static uint64_t s_SubmittedValue = 0;
+
+	static std::vector<PendingImageCopy> s_ImageCopies;
+	static std::vector<PendingBufferCopy> s_BufferCopies;
+
+	static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Moves the ring tail past every batch whose fence has signalled, in submission order
+	static void RetireBatches()
+	{
+		while (s_PendingCount > 0)
+		{
+			const UploadBatch& batch = s_Batches[s_OldestBatch];
+			if (vkGetFenceStatus(VulkanContext::GetDevice(), batch.Fence) != VK_SUCCESS)
+				break;
+
+			s_StagingTail = batch.StagingEnd;
+			s_OldestBatch = (s_OldestBatch + 1) % BatchCount;
+			--s_PendingCount;
+		}
+	}
+
+	static bool TryAllocate(VkDeviceSize size, VkDeviceSize alignment, uint64_t& outPosition)
+	{
+		uint64_t position = AlignUp(s_StagingHead, alignment);
+		// Allocations never straddle the end of the ring
+		if (position % s_Settings.StagingSize + size > s_Settings.StagingSize)
+			position = AlignUp(position, s_Settings.StagingSize);
+		if (position + size - s_StagingTail > s_Settings.StagingSize)
+			return false;
+
+		outPosition = position;
+		return true;
+	}
+
+	void UploadManager::Init(const UploadManagerSettings& settings)
+	{
+		s_Settings = settings;
+		s_Stats = {};
+		VkDevice device = VulkanContext::GetDevice();
+		const VkAllocationCallbacks* callbacks = HostAllocator::GetCallbacks(HostSubsystem::Uploads);
+
+		VkBufferCreateInfo bufferCreateInfo = {};
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = s_Settings.StagingSize;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VkResult result = vkCreateBuffer(device, &bufferCreateInfo, callbacks, &s_StagingBuffer);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create staging buffer!");
+
+		s_StagingMemory = VulkanContext::GetAllocator().AllocateBuffer(s_StagingBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		TESTBED_ASSERT(s_StagingMemory.MappedData, "Failed to allocate staging memory!");
+		s_StagingData = (uint8_t*)s_StagingMemory.MappedData;
+		s_StagingHead = 0;
+		s_StagingTail = 0;
+
+		VkCommandPoolCreateInfo poolCreateInfo = {};
+		poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolCreateInfo.queueFamilyIndex = VulkanContext::GetTransferQueueFamily();
+
+		VkFenceCreateInfo fenceCreateInfo = {};
+		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		for (UploadBatch& batch : s_Batches)
+		{
+			result = vkCreateCommandPool(device, &poolCreateInfo, callbacks, &batch.CommandPool);
+			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create upload command pool!");
+
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = batch.CommandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+			vkAllocateCommandBuffers(device, &allocInfo, &batch.CommandBuffer);
+
+			result = vkCreateFence(device, &fenceCreateInfo, callbacks, &batch.Fence);
+			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create upload fence!");
+			batch.StagingEnd = 0;
+		}
+		s_OldestBatch = 0;
+		s_PendingCount = 0;
+
+		VkSemaphoreTypeCreateInfo timelineCreateInfo = {};
+		timelineCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		timelineCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		timelineCreateInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+		semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreCreateInfo.pNext = &timelineCreateInfo;
+		result = vkCreateSemaphore(device, &semaphoreCreateInfo, callbacks, &s_Semaphore);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create upload semaphore!");
+		s_SubmittedValue = 0;
+	}
+
+	void UploadManager::Shutdown()
+	{
+		if (!s_StagingBuffer)
+			return;
+
+		VulkanContext::WaitIdle();
+		LogStatistics();
+
+		VkDevice device = VulkanContext::GetDevice();
+		const VkAllocationCallbacks* callbacks = HostAllocator::GetCallbacks(HostSubsystem::Uploads);
+		for (UploadBatch& batch : s_Batches)
+		{
+			vkDestroyFence(device, batch.Fence, callbacks);
+			vkDestroyCommandPool(device, batch.CommandPool, callbacks);
+			batch = {};
+		}
+		vkDestroySemaphore(device, s_Semaphore, callbacks);
+		s_Semaphore = nullptr;
+
+		vkDestroyBuffer(device, s_StagingBuffer, callbacks);
+		VulkanContext::GetAllocator().Free(s_StagingMemory);
+		s_StagingBuffer = nullptr;
+		s_StagingData = nullptr;
+
+		s_ImageCopies.clear();
+		s_BufferCopies.clear();
+	}
+
+	bool UploadManager::AllocateStaging(VkDeviceSize size, VkDeviceSize alignment, StagingAllocation& outAllocation)
+	{
+		TESTBED_ASSERT(size <= s_Settings.StagingSize, "Upload is larger than the staging ring!");
+
+		uint64_t position = 0;
+		if (!TryAllocate(size, alignment, position))
+		{
+			RetireBatches();
+			if (!TryAllocate(size, alignment, position))
+			{
+				++s_Stats.RingFull;
+				return false;
+			}
+		}
+
+		s_StagingHead = position + size;
+		outAllocation.Offset = position % s_Settings.StagingSize;
+		outAllocation.Data = s_StagingData + outAllocation.Offset;
+		outAllocation.Size = size;
+		s_Stats.BytesStaged += size;
+		return true;
+	}
+
+	void UploadManager::CopyToImage(const StagingAllocation& source, const ImageUpload& upload)
+	{
+		s_ImageCopies.push_back({ upload, source.Offset });
+	}
+
+	void UploadManager::CopyToBuffer(const StagingAllocation& source, VkBuffer buffer, VkDeviceSize offset, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess)
+	{
+		s_BufferCopies.push_back({ buffer, { source.Offset, offset, source.Size }, dstStages, dstAccess });
+	}
+
+	bool UploadManager::UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess)
+	{
+		StagingAllocation allocation;
+		if (!AllocateStaging(size, 16, allocation))
+			return false;
+
+		memcpy(allocation.Data, data, size);
+		CopyToBuffer(allocation, buffer, offset, dstStages, dstAccess);
+		return true;
+	}
+
+	void UploadManager::Submit()
+	{
+		TESTBED_PROFILE_FUNCTION();
+		RetireBatches();
+		if (s_ImageCopies.empty() && s_BufferCopies.empty())
+			return;
+
+		VkDevice device = VulkanContext::GetDevice();
+		if (s_PendingCount == BatchCount)
+		{
+			vkWaitForFences(device, 1, &s_Batches[s_OldestBatch].Fence, VK_TRUE, UINT64_MAX);
+			++s_Stats.BatchWaits;
+			RetireBatches();
+		}
+
+		UploadBatch& batch = s_Batches[(s_OldestBatch + s_PendingCount) % BatchCount];
+		vkResetFences(device, 1, &batch.Fence);
+		vkResetCommandPool(device, batch.CommandPool, 0);
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(batch.CommandBuffer, &beginInfo);
+
+		// Without a dedicated family the queue semaphore alone makes the copies visible, only layouts still change
+		const bool ownershipTransfer = VulkanContext::HasDedicatedTransferQueue();
+		const uint32_t srcFamily = ownershipTransfer ? VulkanContext::GetTransferQueueFamily() : VK_QUEUE_FAMILY_IGNORED;
+		const uint32_t dstFamily = ownershipTransfer ? VulkanContext::GetGraphicsQueueFamily() : VK_QUEUE_FAMILY_IGNORED;
+
+		std::vector<VkImageMemoryBarrier> toTransfer;
+		std::vector<VkImageMemoryBarrier> imageReleases;
+		std::vector<VkImageMemoryBarrier> imageAcquires;
+		std::vector<VkBufferMemoryBarrier> bufferReleases;
+		std::vector<VkBufferMemoryBarrier> bufferAcquires;
+		VkPipelineStageFlags acquireStages = 0;
+
+		for (const PendingImageCopy& copy : s_ImageCopies)
+		{
+			const ImageUpload& upload = copy.Upload;
+			VkImageMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = upload.Image;
+			barrier.subresourceRange = { upload.Subresource.aspectMask, upload.Subresource.mipLevel, 1, upload.Subresource.baseArrayLayer, upload.Subresource.layerCount };
+
+			if (upload.First)
+			{
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				toTransfer.push_back(barrier);
+			}
+			if (!upload.Last)
+				continue;
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = upload.FinalLayout;
+			barrier.srcQueueFamilyIndex = srcFamily;
+			barrier.dstQueueFamilyIndex = dstFamily;
+			imageReleases.push_back(barrier);
+			acquireStages |= upload.DstStages;
+
+			if (ownershipTransfer)
+			{
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = upload.DstAccess;
+				imageAcquires.push_back(barrier);
+			}
+		}
+
+		for (const PendingBufferCopy& copy : s_BufferCopies)
+		{
+			acquireStages |= copy.DstStages;
+			if (!ownershipTransfer)
+				continue;
+
+			VkBufferMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.srcQueueFamilyIndex = srcFamily;
+			barrier.dstQueueFamilyIndex = dstFamily;
+			barrier.buffer = copy.Buffer;
+			barrier.offset = copy.Region.dstOffset;
+			barrier.size = copy.Region.size;
+			bufferReleases.push_back(barrier);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = copy.DstAccess;
+			bufferAcquires.push_back(barrier);
+		}
+
+		const VkCommandBuffer commandBuffer = batch.CommandBuffer;
+		if (!toTransfer.empty())
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, (uint32_t)toTransfer.size(), toTransfer.data());
+
+		for (const PendingImageCopy& copy : s_ImageCopies)
+		{
+			VkBufferImageCopy region = {};
+			region.bufferOffset = copy.StagingOffset;
+			region.imageSubresource = copy.Upload.Subresource;
+			region.imageOffset = copy.Upload.Offset;
+			region.imageExtent = copy.Upload.Extent;
+			vkCmdCopyBufferToImage(commandBuffer, s_StagingBuffer, copy.Upload.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		}
+		for (const PendingBufferCopy& copy : s_BufferCopies)
+			vkCmdCopyBuffer(commandBuffer, s_StagingBuffer, copy.Buffer, 1, &copy.Region);
+
+		if (!imageReleases.empty() || !bufferReleases.empty())
+		{
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+				(uint32_t)bufferReleases.size(), bufferReleases.data(), (uint32_t)imageReleases.size(), imageReleases.data());
+		}
+		vkEndCommandBuffer(commandBuffer);
+
+		const uint64_t signalValue = ++s_SubmittedValue;
+		VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineSubmitInfo.signalSemaphoreValueCount = 1;
+		timelineSubmitInfo.pSignalSemaphoreValues = &signalValue;
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineSubmitInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &s_Semaphore;
+		VkResult result = vkQueueSubmit(VulkanContext::GetTransferQueue(), 1, &submitInfo, batch.Fence);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to submit uploads!");
+
+		batch.StagingEnd = s_StagingHead;
+		++s_PendingCount;
+
+		// Partial image regions stay with the transfer queue, nothing in this frame can use them yet
+		if (acquireStages)
+		{
+			// The acquire has to happen-after the wait, so it starts from the stages the frame waits at
+			if (!imageAcquires.empty() || !bufferAcquires.empty())
+			{
+				vkCmdPipelineBarrier(VulkanContext::GetCommandBuffer(), acquireStages, acquireStages, 0, 0, nullptr,
+					(uint32_t)bufferAcquires.size(), bufferAcquires.data(), (uint32_t)imageAcquires.size(), imageAcquires.data());
+			}
+			VulkanContext::AddFrameWait(s_Semaphore, signalValue, acquireStages);
+		}
+
+		++s_Stats.Batches;
+		s_Stats.Copies += s_ImageCopies.size() + s_BufferCopies.size();
+		s_Stats.OwnershipTransfers += imageAcquires.size() + bufferAcquires.size();
+		s_ImageCopies.clear();
+		s_BufferCopies.clear();
+	}
+
+	VkDeviceSize UploadManager::GetStagingSize()
+	{
+		return s_Settings.StagingSize;
+	}
+
+	UploadStatistics UploadManager::GetStatistics()
+	{
+		return s_Stats;
+	}
+
+	void UploadManager::LogStatistics()
+	{
+		LOG_INFO("UploadManager: {} batches ({} queue), {} copies, {:.1f} MB staged, {} ownership transfers, {} allocations on a full ring, {} batch waits",
+			s_Stats.Batches, VulkanContext::HasDedicatedTransferQueue() ? "dedicated" : "graphics", s_Stats.Copies,
+			(double)s_Stats.BytesStaged / (1024.0 * 1024.0), s_Stats.OwnershipTransfers, s_Stats.RingFull, s_Stats.BatchWaits);
+	}
+}
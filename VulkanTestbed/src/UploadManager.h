@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace VulkanTestbed
+{
+	struct UploadManagerSettings
+	{
+		// Persistently mapped ring every upload is staged in
+		uint64_t StagingSize = 64ull << 20;
+	};
+
+	// Space in the staging ring, fill Data before queueing the copy that reads it
+	struct StagingAllocation
+	{
+		uint8_t* Data = nullptr;
+		VkDeviceSize Offset = 0;
+		VkDeviceSize Size = 0;
+	};
+
+	// Copies tightly packed texels into one subresource region. Regions of a subresource can be spread over several
+	// frames, the first one discards the previous contents and the last one hands it to the graphics queue.
+	struct ImageUpload
+	{
+		VkImage Image = nullptr;
+		VkImageSubresourceLayers Subresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		VkOffset3D Offset = {};
+		VkExtent3D Extent = {};
+		bool First = true;
+		bool Last = true;
+		VkImageLayout FinalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		// Where the graphics queue first uses the subresource after the last region
+		VkPipelineStageFlags DstStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		VkAccessFlags DstAccess = VK_ACCESS_SHADER_READ_BIT;
+	};
+
+	struct UploadStatistics
+	{
+		uint64_t Batches = 0;
+		uint64_t Copies = 0;
+		uint64_t BytesStaged = 0;
+		// Images and buffers released by the transfer queue and acquired by the graphics queue
+		uint64_t OwnershipTransfers = 0;
+		// Allocations turned away because the ring was full of copies the GPU hasn't finished
+		uint64_t RingFull = 0;
+		// Submits that had to wait for the fence of the batch whose slot they reuse
+		uint64_t BatchWaits = 0;
+	};
+
+	// Stages uploads in a persistently mapped ring and submits all copies queued during a frame as one batch on the
+	// transfer queue. Ring space is retired when the batch's fence signals. With a dedicated transfer family the
+	// resources are released to the graphics queue, which acquires them at the start of the frame after waiting
+	// for the batch. Main thread only.
+	class UploadManager
+	{
+	public:
+		// Needs VulkanContext
+		static void Init(const UploadManagerSettings& settings = {});
+		static void Shutdown();
+
+		// False when the ring is full, try again next frame
+		static bool AllocateStaging(VkDeviceSize size, VkDeviceSize alignment, StagingAllocation& outAllocation);
+		// The copy reads all of source, the image region has to fit it exactly
+		static void CopyToImage(const StagingAllocation& source, const ImageUpload& upload);
+		// The buffer has to be created with VK_BUFFER_USAGE_TRANSFER_DST_BIT
+		static void CopyToBuffer(const StagingAllocation& source, VkBuffer buffer, VkDeviceSize offset, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+		// Stages and queues in one go, false when the ring is full
+		static bool UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+
+		// Submits everything queued since the last call, between VulkanContext::BeginFrame and EndFrame and before
+		// anything in the frame's command buffer uses the uploaded resources
+		static void Submit();
+
+		static VkDeviceSize GetStagingSize();
+		static UploadStatistics GetStatistics();
+		static void LogStatistics();
+	};
+}
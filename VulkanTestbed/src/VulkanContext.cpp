@@ -4,14 +4,16 @@
 #include <optional>
 #include <set>
 
-#define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.h>
-#define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3.h>
-#include <GLFW/glfw3native.h>
 
 #include <glm/glm.hpp>
 
+#include "Core/Profiler.h"
+#include "Core/Timer.h"
+#include "DeviceAllocator.h"
+#include "HostAllocator.h"
+
 namespace VulkanTestbed
 {
 	static VkInstance s_VkInstance = nullptr;
@@ -19,23 +21,81 @@ namespace VulkanTestbed
 	static VkDevice s_LogicalDevice = nullptr;
 	static VkQueue s_GraphicsQueue = nullptr;
 	static VkQueue s_PresentQueue = nullptr;
+	// The graphics queue when the device has no usable transfer-only family
+	static VkQueue s_TransferQueue = nullptr;
 	static VkDebugReportCallbackEXT s_DebugReport = nullptr;
+	static std::unique_ptr<DeviceAllocator> s_Allocator;
 
 	static GLFWwindow* s_GlfwWindow = nullptr;
 	static VkSurfaceKHR s_Surface = nullptr;
 	static VkSwapchainKHR s_Swapchain = nullptr;
 
+	static bool s_Headless = false;
+	static VkExtent2D s_Extent = {};
+	static VkFormat s_ColorFormat = VK_FORMAT_UNDEFINED;
+	// Backbuffers can be copied from, always for offscreen images and where the surface allows it for swapchains
+	static bool s_BackbufferReadable = false;
+	// Swapchain images, or the offscreen images that rotate in their place when headless
+	static std::vector<VkImage> s_Images;
+	static std::vector<DeviceAllocation> s_OffscreenMemory;
+	static uint32_t s_ImageIndex = 0;
+
+	struct FrameData
+	{
+		// Transient, reset as a whole instead of per command buffer
+		VkCommandPool CommandPool = nullptr;
+		VkCommandBuffer CommandBuffer = nullptr;
+		VkDescriptorPool DescriptorPool = nullptr;
+		VkSemaphore ImageAvailable = nullptr;
+		// Signalled on the timeline semaphore once the last submission from this slot is done
+		uint64_t TimelineValue = 0;
+
+		VkBuffer UploadBuffer = nullptr;
+		DeviceAllocation UploadMemory;
+		VkDeviceSize UploadOffset = 0;
+	};
+
+	static VulkanContextSettings s_Settings;
+	static std::array<FrameData, VulkanContext::MaxFramesInFlight> s_Frames;
+	static uint32_t s_FrameIndex = 0;
+	static uint64_t s_FrameCount = 0;
+	static VkSemaphore s_TimelineSemaphore = nullptr;
+	// One per swapchain image rather than per frame, presentation may still wait on it when the frame slot comes around
+	static std::vector<VkSemaphore> s_RenderFinished;
+	static FrameStatistics s_FrameStats;
+
+	// Waited on by the next frame submission next to the swapchain image
+	struct FrameWait
+	{
+		VkSemaphore Semaphore;
+		uint64_t Value;
+		VkPipelineStageFlags Stages;
+	};
+	static std::vector<FrameWait> s_FrameWaits;
+
 	struct QueueFamilyIndices
 	{
 		std::optional<uint32_t> GraphicsFamily;
 		std::optional<uint32_t> PresentFamily;
+		std::optional<uint32_t> TransferFamily;
 
 		bool IsComplete() const
 		{
-			return GraphicsFamily.has_value() && PresentFamily.has_value();
+			return GraphicsFamily.has_value() && (s_Headless || PresentFamily.has_value());
 		}
 	};
 
+	static QueueFamilyIndices s_QueueFamilyIndices;
+	static bool s_TextureCompressionBC = false;
+	static bool s_DescriptorIndexing = false;
+	static bool s_DynamicDescriptorIndexing = false;
+	// Loaded from VK_KHR_synchronization2, null when the device lacks it and barriers go through vkCmdPipelineBarrier
+	static PFN_vkCmdPipelineBarrier2 s_CmdPipelineBarrier2 = nullptr;
+	static DeviceIdentity s_DeviceIdentity;
+	// Nanoseconds per timestamp tick, and the bits graphics queue timestamps carry, 0 when it can't write any
+	static float s_TimestampPeriod = 0.0f;
+	static uint32_t s_TimestampValidBits = 0;
+
 	struct SwapChainSupportDetails
 	{
 		VkSurfaceCapabilitiesKHR Capabilities;
@@ -178,10 +238,113 @@ namespace VulkanTestbed
 		return actualExtent;
 	}
 
-	void VulkanContext::Init(void* glfwWindow)
+	static void CreateOffscreenImages(uint32_t imageCount)
 	{
-		s_GlfwWindow = (GLFWwindow*)glfwWindow;
+		s_ColorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+		s_BackbufferReadable = true;
+		s_Images.resize(imageCount);
+		s_OffscreenMemory.resize(imageCount);
+
+		for (uint32_t i = 0; i < imageCount; ++i)
+		{
+			VkImageCreateInfo imageCreateInfo = {};
+			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = s_ColorFormat;
+			imageCreateInfo.extent = { s_Extent.width, s_Extent.height, 1 };
+			imageCreateInfo.mipLevels = 1;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkResult result = vkCreateImage(s_LogicalDevice, &imageCreateInfo, HostAllocator::GetCallbacks(HostSubsystem::Swapchain), &s_Images[i]);
+			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create offscreen image!");
+
+			s_OffscreenMemory[i] = s_Allocator->AllocateImage(s_Images[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			TESTBED_ASSERT(s_OffscreenMemory[i].Memory, "Failed to allocate offscreen image memory!");
+		}
+	}
+
+	static void CreateFrameResources()
+	{
+		VkSemaphoreTypeCreateInfo timelineCreateInfo = {};
+		timelineCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		timelineCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		timelineCreateInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+		semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreCreateInfo.pNext = &timelineCreateInfo;
+		VkResult result = vkCreateSemaphore(s_LogicalDevice, &semaphoreCreateInfo, HostAllocator::GetCallbacks(HostSubsystem::Frame), &s_TimelineSemaphore);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create timeline semaphore!");
+		semaphoreCreateInfo.pNext = nullptr;
+
+		const uint32_t descriptorCount = s_Settings.DescriptorSetsPerFrame * 4;
+		const VkDescriptorPoolSize poolSizes[] =
+		{
+			{ VK_DESCRIPTOR_TYPE_SAMPLER, descriptorCount },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, descriptorCount },
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, descriptorCount },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, descriptorCount },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, descriptorCount },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, descriptorCount }
+		};
+
+		for (uint32_t i = 0; i < s_Settings.FramesInFlight; ++i)
+		{
+			FrameData& frame = s_Frames[i];
+
+			VkCommandPoolCreateInfo poolCreateInfo = {};
+			poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			poolCreateInfo.queueFamilyIndex = s_QueueFamilyIndices.GraphicsFamily.value();
+			result = vkCreateCommandPool(s_LogicalDevice, &poolCreateInfo, HostAllocator::GetCallbacks(HostSubsystem::Frame), &frame.CommandPool);
+			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create command pool!");
+
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = frame.CommandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+			vkAllocateCommandBuffers(s_LogicalDevice, &allocInfo, &frame.CommandBuffer);
+
+			VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
+			descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+			descriptorPoolCreateInfo.maxSets = s_Settings.DescriptorSetsPerFrame;
+			descriptorPoolCreateInfo.poolSizeCount = (uint32_t)std::size(poolSizes);
+			descriptorPoolCreateInfo.pPoolSizes = poolSizes;
+			result = vkCreateDescriptorPool(s_LogicalDevice, &descriptorPoolCreateInfo, HostAllocator::GetCallbacks(HostSubsystem::Frame), &frame.DescriptorPool);
+			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create descriptor pool!");
+
+			VkBufferCreateInfo bufferCreateInfo = {};
+			bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferCreateInfo.size = s_Settings.UploadBufferSize;
+			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+				| VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			result = vkCreateBuffer(s_LogicalDevice, &bufferCreateInfo, HostAllocator::GetCallbacks(HostSubsystem::Frame), &frame.UploadBuffer);
+			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create frame upload buffer!");
+
+			frame.UploadMemory = s_Allocator->AllocateBuffer(frame.UploadBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			TESTBED_ASSERT(frame.UploadMemory.MappedData, "Failed to allocate frame upload memory!");
 
+			// Offscreen images are never presented, so there is nothing to synchronize with
+			if (!s_Headless)
+				vkCreateSemaphore(s_LogicalDevice, &semaphoreCreateInfo, HostAllocator::GetCallbacks(HostSubsystem::Frame), &frame.ImageAvailable);
+		}
+
+		if (!s_Headless)
+		{
+			s_RenderFinished.resize(s_Images.size());
+			for (VkSemaphore& semaphore : s_RenderFinished)
+				vkCreateSemaphore(s_LogicalDevice, &semaphoreCreateInfo, HostAllocator::GetCallbacks(HostSubsystem::Frame), &semaphore);
+		}
+	}
+
+	static void InitInternal()
+	{
 		VkApplicationInfo appInfo = {};
 		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
 		appInfo.pApplicationName = "Vulkan Testbed";
@@ -190,9 +353,13 @@ namespace VulkanTestbed
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.apiVersion = VK_API_VERSION_1_2;
 
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		std::vector<const char*> extensions;
+		if (!s_Headless)
+		{
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 #ifdef TESTBED_DEBUG
 		extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
 #endif
@@ -225,7 +392,7 @@ namespace VulkanTestbed
 		createInfo.enabledLayerCount = 0;
 #endif
 
-		VkResult result = vkCreateInstance(&createInfo, nullptr, &s_VkInstance);
+		VkResult result = vkCreateInstance(&createInfo, HostAllocator::GetCallbacks(HostSubsystem::Context), &s_VkInstance);
 		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create vulkan instance!");
 		
 #ifdef TESTBED_DEBUG
@@ -237,22 +404,19 @@ namespace VulkanTestbed
 		debugReportCI.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT;
 		debugReportCI.pfnCallback = &VulkanDebugCallback;
 		debugReportCI.pUserData = nullptr;
-		vkCreateDebugReportCallbackEXT(s_VkInstance, &debugReportCI, nullptr, &s_DebugReport);
+		vkCreateDebugReportCallbackEXT(s_VkInstance, &debugReportCI, HostAllocator::GetCallbacks(HostSubsystem::Context), &s_DebugReport);
 #endif
 
 		// Surface
+		if (!s_Headless)
 		{
-			VkWin32SurfaceCreateInfoKHR surfaceCreateInfo = {};
-			surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-			surfaceCreateInfo.hwnd = glfwGetWin32Window((GLFWwindow*)glfwWindow);
-
-			surfaceCreateInfo.hinstance = GetModuleHandle(nullptr);
-			result = vkCreateWin32SurfaceKHR(s_VkInstance, &surfaceCreateInfo, nullptr, &s_Surface);
+			result = glfwCreateWindowSurface(s_VkInstance, s_GlfwWindow, HostAllocator::GetCallbacks(HostSubsystem::Swapchain), &s_Surface);
 			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create vulkan surface!");
 		}
 
 		uint32_t deviceCount = 0;
 		vkEnumeratePhysicalDevices(s_VkInstance, &deviceCount, nullptr);
+		TESTBED_ASSERT(deviceCount > 0, "No vulkan capable device found!");
 		std::vector<VkPhysicalDevice> devices(deviceCount);
 		vkEnumeratePhysicalDevices(s_VkInstance, &deviceCount, devices.data());
 		for (const auto& device : devices)
@@ -278,33 +442,62 @@ namespace VulkanTestbed
 		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
 		vkGetPhysicalDeviceQueueFamilyProperties(s_PhysicalDevice, &queueFamilyCount, queueFamilies.data());
 
-		QueueFamilyIndices queueFamilyIndices;
+		QueueFamilyIndices& queueFamilyIndices = s_QueueFamilyIndices;
 		int i = 0;
 		for (const auto& queueFamily : queueFamilies)
 		{
 			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
 				queueFamilyIndices.GraphicsFamily = i;
 
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(s_PhysicalDevice, i, s_Surface, &presentSupport);
-			if (presentSupport)
-				queueFamilyIndices.PresentFamily = i;
+			if (!s_Headless)
+			{
+				VkBool32 presentSupport = false;
+				vkGetPhysicalDeviceSurfaceSupportKHR(s_PhysicalDevice, i, s_Surface, &presentSupport);
+				if (presentSupport)
+					queueFamilyIndices.PresentFamily = i;
+			}
 
 			i++;
 		}
+		TESTBED_ASSERT(queueFamilyIndices.IsComplete(), "Required queue families not found!");
+		s_TimestampValidBits = queueFamilies[queueFamilyIndices.GraphicsFamily.value()].timestampValidBits;
 
+		// Transfer-only families map to the copy engines, which run next to graphics work. Banded texture copies
+		// start at arbitrary rows, so only families without a transfer granularity qualify.
+		if (s_Settings.DedicatedTransferQueue)
+		{
+			int bestScore = 0;
+			for (uint32_t family = 0; family < queueFamilyCount; ++family)
+			{
+				const VkQueueFamilyProperties& properties = queueFamilies[family];
+				const VkExtent3D& granularity = properties.minImageTransferGranularity;
+				if (!(properties.queueFlags & VK_QUEUE_TRANSFER_BIT) || (properties.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+					|| granularity.width != 1 || granularity.height != 1 || granularity.depth != 1)
+					continue;
+
+				const int score = (properties.queueFlags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					queueFamilyIndices.TransferFamily = family;
+				}
+			}
+		}
 
 		SwapChainSupportDetails swapChainSupport = {};
-		QuerrySwapChainSupport(swapChainSupport);
-		bool swapchainAdequate = !swapChainSupport.Formats.empty() && !swapChainSupport.PresentModes.empty();
-		TESTBED_ASSERT(swapchainAdequate, "Swapchain Not supported!");
+		if (!s_Headless)
+		{
+			QuerrySwapChainSupport(swapChainSupport);
+			bool swapchainAdequate = !swapChainSupport.Formats.empty() && !swapChainSupport.PresentModes.empty();
+			TESTBED_ASSERT(swapchainAdequate, "Swapchain Not supported!");
+		}
 		{
 			std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-			std::set<uint32_t> uniqueQueueFamilies =
-			{
-				queueFamilyIndices.GraphicsFamily.value(),
-				queueFamilyIndices.PresentFamily.value()
-			};
+			std::set<uint32_t> uniqueQueueFamilies = { queueFamilyIndices.GraphicsFamily.value() };
+			if (queueFamilyIndices.PresentFamily.has_value())
+				uniqueQueueFamilies.insert(queueFamilyIndices.PresentFamily.value());
+			if (queueFamilyIndices.TransferFamily.has_value())
+				uniqueQueueFamilies.insert(queueFamilyIndices.TransferFamily.value());
 
 			const float queuePriorities = 1.0f;
 			for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -317,27 +510,79 @@ namespace VulkanTestbed
 				queueCreateInfos.push_back(queueCreateInfo);
 			}
 
-			const std::vector<const char*> deviceExtensions =
-			{
-				VK_KHR_SWAPCHAIN_EXTENSION_NAME
-			};
+			std::vector<const char*> deviceExtensions;
+			if (!s_Headless)
+				deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
 			uint32_t deviceExtensionsCount = 0;
 			vkEnumerateDeviceExtensionProperties(s_PhysicalDevice, nullptr, &deviceExtensionsCount, nullptr);
 			std::vector<VkExtensionProperties> availableDeviceExtensions(deviceExtensionsCount);
 			vkEnumerateDeviceExtensionProperties(s_PhysicalDevice, nullptr, &deviceExtensionsCount, availableDeviceExtensions.data());
 			std::set<std::string> remainingExtensions(deviceExtensions.begin(), deviceExtensions.end());
+			bool synchronization2Available = false;
 			for (const auto& ext : availableDeviceExtensions)
+			{
 				remainingExtensions.erase(ext.extensionName);
+				synchronization2Available |= strcmp(ext.extensionName, "VK_KHR_synchronization2") == 0;
+			}
 			TESTBED_ASSERT(remainingExtensions.empty(), "Not all device extensions are supported!");
 			
+			VkPhysicalDeviceSynchronization2Features supportedSynchronization2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES };
+			VkPhysicalDeviceVulkan12Features supportedFeatures12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES, synchronization2Available ? &supportedSynchronization2 : nullptr };
+			VkPhysicalDeviceFeatures2 supportedFeatures2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &supportedFeatures12 };
+			vkGetPhysicalDeviceFeatures2(s_PhysicalDevice, &supportedFeatures2);
+			const VkPhysicalDeviceFeatures& supportedFeatures = supportedFeatures2.features;
+			TESTBED_ASSERT(supportedFeatures12.timelineSemaphore, "Timeline semaphores are not supported!");
+
 			VkPhysicalDeviceFeatures deviceFeatures = {};
+			deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+			s_TextureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+
+			// Frame pacing waits on a timeline semaphore instead of per frame fences
+			VkPhysicalDeviceVulkan12Features deviceFeatures12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+			deviceFeatures12.timelineSemaphore = VK_TRUE;
+
+			// Bindless descriptors: arrays indexed by non-uniform IDs, partially bound and written while in use.
+			// Without these the arrays still work with dynamically uniform indices, one set per frame in flight.
+			s_DynamicDescriptorIndexing = s_Settings.DescriptorIndexing && supportedFeatures.shaderSampledImageArrayDynamicIndexing
+				&& supportedFeatures.shaderStorageBufferArrayDynamicIndexing;
+			deviceFeatures.shaderSampledImageArrayDynamicIndexing = s_DynamicDescriptorIndexing;
+			deviceFeatures.shaderStorageBufferArrayDynamicIndexing = s_DynamicDescriptorIndexing;
+
+			s_DescriptorIndexing = s_DynamicDescriptorIndexing && supportedFeatures12.descriptorIndexing
+				&& supportedFeatures12.shaderSampledImageArrayNonUniformIndexing && supportedFeatures12.shaderStorageBufferArrayNonUniformIndexing
+				&& supportedFeatures12.descriptorBindingSampledImageUpdateAfterBind && supportedFeatures12.descriptorBindingStorageBufferUpdateAfterBind
+				&& supportedFeatures12.descriptorBindingUpdateUnusedWhilePending && supportedFeatures12.descriptorBindingPartiallyBound
+				&& supportedFeatures12.runtimeDescriptorArray;
+			if (s_DescriptorIndexing)
+			{
+				deviceFeatures12.descriptorIndexing = VK_TRUE;
+				deviceFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+				deviceFeatures12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+				deviceFeatures12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+				deviceFeatures12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+				deviceFeatures12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+				deviceFeatures12.descriptorBindingPartiallyBound = VK_TRUE;
+				deviceFeatures12.runtimeDescriptorArray = VK_TRUE;
+			}
+
+			// The render graph batches its barriers into vkCmdPipelineBarrier2 when available
+			VkPhysicalDeviceSynchronization2Features deviceSynchronization2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES };
+			deviceSynchronization2.synchronization2 = VK_TRUE;
+			synchronization2Available &= supportedSynchronization2.synchronization2 == VK_TRUE;
+			if (synchronization2Available)
+			{
+				deviceExtensions.push_back("VK_KHR_synchronization2");
+				deviceFeatures12.pNext = &deviceSynchronization2;
+			}
 
 			VkDeviceCreateInfo createInfo = {};
 			createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 			createInfo.queueCreateInfoCount = (uint32_t)queueCreateInfos.size();
 			createInfo.pQueueCreateInfos = queueCreateInfos.data();
+			createInfo.pNext = &deviceFeatures12;
 			createInfo.pEnabledFeatures = &deviceFeatures;
-			createInfo.enabledExtensionCount = deviceExtensions.size();
+			createInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
 			createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 #ifdef TESTBED_DEBUG
 			createInfo.enabledLayerCount = (uint32_t)validationLayers.size();
@@ -345,19 +590,36 @@ namespace VulkanTestbed
 #else
 			createInfo.enabledLayerCount = 0;
 #endif
-			VkResult result = vkCreateDevice(s_PhysicalDevice, &createInfo, nullptr, &s_LogicalDevice);
+			VkResult result = vkCreateDevice(s_PhysicalDevice, &createInfo, HostAllocator::GetCallbacks(HostSubsystem::Context), &s_LogicalDevice);
 			TESTBED_ASSERT(result == VK_SUCCESS);
 
 			vkGetDeviceQueue(s_LogicalDevice, queueFamilyIndices.GraphicsFamily.value(), 0, &s_GraphicsQueue);
-			vkGetDeviceQueue(s_LogicalDevice, queueFamilyIndices.PresentFamily.value(), 0, &s_PresentQueue);
+			if (queueFamilyIndices.PresentFamily.has_value())
+				vkGetDeviceQueue(s_LogicalDevice, queueFamilyIndices.PresentFamily.value(), 0, &s_PresentQueue);
+			s_TransferQueue = s_GraphicsQueue;
+			if (queueFamilyIndices.TransferFamily.has_value())
+				vkGetDeviceQueue(s_LogicalDevice, queueFamilyIndices.TransferFamily.value(), 0, &s_TransferQueue);
+
+			s_Allocator = std::make_unique<DeviceAllocator>(CreateVulkanMemoryBackend(s_PhysicalDevice, s_LogicalDevice));
+
+			s_CmdPipelineBarrier2 = synchronization2Available ? (PFN_vkCmdPipelineBarrier2)vkGetDeviceProcAddr(s_LogicalDevice, "vkCmdPipelineBarrier2KHR") : nullptr;
 		}
 
 		{
-			VkPhysicalDeviceDriverProperties driverProps{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DRIVER_PROPERTIES };
+			VkPhysicalDeviceIDProperties idProps{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+			VkPhysicalDeviceDriverProperties driverProps{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DRIVER_PROPERTIES, &idProps };
 			VkPhysicalDeviceProperties2 deviceProps2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, &driverProps };
 			vkGetPhysicalDeviceProperties2(s_PhysicalDevice, &deviceProps2);
 			const VkPhysicalDeviceProperties& deviceProps = deviceProps2.properties;
 
+			s_DeviceIdentity.VendorID = deviceProps.vendorID;
+			s_DeviceIdentity.DeviceID = deviceProps.deviceID;
+			s_DeviceIdentity.DriverVersion = deviceProps.driverVersion;
+			memcpy(s_DeviceIdentity.PipelineCacheUUID, deviceProps.pipelineCacheUUID, VK_UUID_SIZE);
+			memcpy(s_DeviceIdentity.DeviceUUID, idProps.deviceUUID, VK_UUID_SIZE);
+			memcpy(s_DeviceIdentity.DriverUUID, idProps.driverUUID, VK_UUID_SIZE);
+			s_TimestampPeriod = deviceProps.limits.timestampPeriod;
+
 			const char* vendorName = "Unknown Vendor";
 			if (VendorMap.find(deviceProps.vendorID) != VendorMap.end())
 				vendorName = VendorIdToStringMap.at(VendorMap.at(deviceProps.vendorID));
@@ -373,9 +635,20 @@ namespace VulkanTestbed
 				VK_VERSION_PATCH(deviceProps.apiVersion),
 				driverProps.driverName,
 				driverString);
+			if (s_QueueFamilyIndices.TransferFamily.has_value())
+				LOG_INFO("\tTransfer queue: dedicated, family {}", s_QueueFamilyIndices.TransferFamily.value());
+			else
+				LOG_INFO("\tTransfer queue: shared with graphics");
 		}
 
+		if (s_Headless)
+		{
+			// Same image count a swapchain would typically give us, but never one an unfinished frame may still write
+			CreateOffscreenImages(std::max(3u, s_Settings.FramesInFlight + 1));
+			LOG_INFO("Headless: rendering into {} offscreen images ({}x{})", s_Images.size(), s_Extent.width, s_Extent.height);
+		}
 		// Create SwapChain
+		else
 		{
 			VkSurfaceFormatKHR surfaceFormat = ChooseSwapChainSurfaceFormat(swapChainSupport.Formats);
 			VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapChainSupport.PresentModes);
@@ -392,7 +665,10 @@ namespace VulkanTestbed
 			createInfo.imageColorSpace = surfaceFormat.colorSpace;
 			createInfo.imageExtent = extent;
 			createInfo.imageArrayLayers = 1;
-			createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			s_BackbufferReadable = (swapChainSupport.Capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+			if (s_BackbufferReadable)
+				createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 
 			uint32_t queueFamilyIndicesArray[] = { queueFamilyIndices.GraphicsFamily.value(), queueFamilyIndices.PresentFamily.value() };
 			if (queueFamilyIndices.GraphicsFamily != queueFamilyIndices.PresentFamily)
@@ -414,23 +690,422 @@ namespace VulkanTestbed
 			createInfo.clipped = VK_TRUE;
 			createInfo.oldSwapchain = VK_NULL_HANDLE;
 
-			result = vkCreateSwapchainKHR(s_LogicalDevice, &createInfo, nullptr, &s_Swapchain);
+			result = vkCreateSwapchainKHR(s_LogicalDevice, &createInfo, HostAllocator::GetCallbacks(HostSubsystem::Swapchain), &s_Swapchain);
 			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to create the swapchain!");
+
+			s_Extent = extent;
+			s_ColorFormat = surfaceFormat.format;
+
+			uint32_t swapchainImageCount = 0;
+			vkGetSwapchainImagesKHR(s_LogicalDevice, s_Swapchain, &swapchainImageCount, nullptr);
+			s_Images.resize(swapchainImageCount);
+			vkGetSwapchainImagesKHR(s_LogicalDevice, s_Swapchain, &swapchainImageCount, s_Images.data());
 		}
+
+		CreateFrameResources();
+	}
+
+	static void SetSettings(const VulkanContextSettings& settings)
+	{
+		s_Settings = settings;
+		// Comes straight from the command line, the frame ring is sized for at most MaxFramesInFlight
+		s_Settings.FramesInFlight = std::clamp(settings.FramesInFlight, 1u, VulkanContext::MaxFramesInFlight);
+		if (s_Settings.FramesInFlight != settings.FramesInFlight)
+			LOG_WARN("{} frames in flight are not supported, using {}", settings.FramesInFlight, s_Settings.FramesInFlight);
+		s_FrameIndex = 0;
+		s_FrameCount = 0;
+		s_FrameStats = {};
+		s_FrameWaits.clear();
+		s_QueueFamilyIndices = {};
+	}
+
+	void VulkanContext::Init(void* glfwWindow, const VulkanContextSettings& settings)
+	{
+		SetSettings(settings);
+		s_GlfwWindow = (GLFWwindow*)glfwWindow;
+		s_Headless = false;
+
+		InitInternal();
+	}
+
+	void VulkanContext::InitHeadless(uint32_t width, uint32_t height, const VulkanContextSettings& settings)
+	{
+		SetSettings(settings);
+		s_GlfwWindow = nullptr;
+		s_Headless = true;
+		s_Extent = { width, height };
+
+		InitInternal();
 	}
 
 	void VulkanContext::Shutdown()
 	{
-		vkDestroySwapchainKHR(s_LogicalDevice, s_Swapchain, nullptr);
-		vkDestroyDevice(s_LogicalDevice, nullptr);
-		vkDestroySurfaceKHR(s_VkInstance, s_Surface, nullptr);
+		WaitIdle();
+
+		for (uint32_t i = 0; i < s_Settings.FramesInFlight; ++i)
+		{
+			FrameData& frame = s_Frames[i];
+			vkDestroyCommandPool(s_LogicalDevice, frame.CommandPool, HostAllocator::GetCallbacks(HostSubsystem::Frame));
+			vkDestroyDescriptorPool(s_LogicalDevice, frame.DescriptorPool, HostAllocator::GetCallbacks(HostSubsystem::Frame));
+			vkDestroyBuffer(s_LogicalDevice, frame.UploadBuffer, HostAllocator::GetCallbacks(HostSubsystem::Frame));
+			s_Allocator->Free(frame.UploadMemory);
+			if (frame.ImageAvailable)
+				vkDestroySemaphore(s_LogicalDevice, frame.ImageAvailable, HostAllocator::GetCallbacks(HostSubsystem::Frame));
+			frame = {};
+		}
+		for (VkSemaphore semaphore : s_RenderFinished)
+			vkDestroySemaphore(s_LogicalDevice, semaphore, HostAllocator::GetCallbacks(HostSubsystem::Frame));
+		s_RenderFinished.clear();
+		vkDestroySemaphore(s_LogicalDevice, s_TimelineSemaphore, HostAllocator::GetCallbacks(HostSubsystem::Frame));
+		s_TimelineSemaphore = nullptr;
+
+		if (s_Headless)
+		{
+			for (size_t i = 0; i < s_Images.size(); ++i)
+			{
+				vkDestroyImage(s_LogicalDevice, s_Images[i], HostAllocator::GetCallbacks(HostSubsystem::Swapchain));
+				s_Allocator->Free(s_OffscreenMemory[i]);
+			}
+			s_OffscreenMemory.clear();
+		}
+		else
+		{
+			vkDestroySwapchainKHR(s_LogicalDevice, s_Swapchain, HostAllocator::GetCallbacks(HostSubsystem::Swapchain));
+		}
+		s_Images.clear();
+
+		s_Allocator->LogStatistics();
+		s_Allocator.reset();
+		vkDestroyDevice(s_LogicalDevice, HostAllocator::GetCallbacks(HostSubsystem::Context));
+		if (s_Surface)
+			vkDestroySurfaceKHR(s_VkInstance, s_Surface, HostAllocator::GetCallbacks(HostSubsystem::Swapchain));
 
 #ifdef TESTBED_DEBUG
 		// Remove the debug report callback
 		auto vkDestroyDebugReportCallbackEXT = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(s_VkInstance, "vkDestroyDebugReportCallbackEXT");
-		vkDestroyDebugReportCallbackEXT(s_VkInstance, s_DebugReport, nullptr);
+		vkDestroyDebugReportCallbackEXT(s_VkInstance, s_DebugReport, HostAllocator::GetCallbacks(HostSubsystem::Context));
 #endif
 
-		vkDestroyInstance(s_VkInstance, nullptr);
+		vkDestroyInstance(s_VkInstance, HostAllocator::GetCallbacks(HostSubsystem::Context));
+		HostAllocator::LogStatistics();
+	}
+
+	void VulkanContext::BeginFrame()
+	{
+		TESTBED_PROFILE_FUNCTION();
+		FrameData& frame = s_Frames[s_FrameIndex];
+		if (GetCompletedTimelineValue() < frame.TimelineValue)
+		{
+			Timer timer;
+			VkSemaphoreWaitInfo waitInfo = {};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &s_TimelineSemaphore;
+			waitInfo.pValues = &frame.TimelineValue;
+			vkWaitSemaphores(s_LogicalDevice, &waitInfo, UINT64_MAX);
+
+			const double waited = timer.Elapsed();
+			++s_FrameStats.StalledFrames;
+			s_FrameStats.CpuWaitSeconds += waited;
+			s_FrameStats.MaxCpuWaitSeconds = std::max(s_FrameStats.MaxCpuWaitSeconds, waited);
+		}
+
+		vkResetCommandPool(s_LogicalDevice, frame.CommandPool, 0);
+		vkResetDescriptorPool(s_LogicalDevice, frame.DescriptorPool, 0);
+		frame.UploadOffset = 0;
+
+		if (s_Headless)
+		{
+			s_ImageIndex = (uint32_t)(s_FrameCount % s_Images.size());
+		}
+		else
+		{
+			Timer timer;
+			VkResult result = vkAcquireNextImageKHR(s_LogicalDevice, s_Swapchain, UINT64_MAX, frame.ImageAvailable, VK_NULL_HANDLE, &s_ImageIndex);
+			TESTBED_ASSERT(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR, "Failed to acquire swapchain image!");
+			s_FrameStats.AcquireWaitSeconds += timer.Elapsed();
+		}
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(frame.CommandBuffer, &beginInfo);
+	}
+
+	void VulkanContext::EndFrame()
+	{
+		TESTBED_PROFILE_FUNCTION();
+		FrameData& frame = s_Frames[s_FrameIndex];
+		vkEndCommandBuffer(frame.CommandBuffer);
+
+		// The binary semaphores ignore their values, the timeline one is signalled last so the slot is only released
+		// once everything else from this submission is done
+		const uint64_t timelineValue = GetFrameTimelineValue();
+		const VkSemaphore signalSemaphores[] = { s_Headless ? nullptr : s_RenderFinished[s_ImageIndex], s_TimelineSemaphore };
+		const uint64_t signalValues[] = { 0, timelineValue };
+		const uint32_t signalOffset = s_Headless ? 1 : 0;
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<uint64_t> waitValues;
+		std::vector<VkPipelineStageFlags> waitStages;
+		if (!s_Headless)
+		{
+			waitSemaphores.push_back(frame.ImageAvailable);
+			waitValues.push_back(0);
+			waitStages.push_back(VK_PIPELINE_STAGE_TRANSFER_BIT);
+		}
+		for (const FrameWait& wait : s_FrameWaits)
+		{
+			waitSemaphores.push_back(wait.Semaphore);
+			waitValues.push_back(wait.Value);
+			waitStages.push_back(wait.Stages);
+		}
+		s_FrameWaits.clear();
+
+		VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineSubmitInfo.signalSemaphoreValueCount = 2 - signalOffset;
+		timelineSubmitInfo.pSignalSemaphoreValues = signalValues + signalOffset;
+		timelineSubmitInfo.waitSemaphoreValueCount = (uint32_t)waitValues.size();
+		timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineSubmitInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &frame.CommandBuffer;
+		submitInfo.signalSemaphoreCount = 2 - signalOffset;
+		submitInfo.pSignalSemaphores = signalSemaphores + signalOffset;
+		submitInfo.waitSemaphoreCount = (uint32_t)waitSemaphores.size();
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		VkResult result = vkQueueSubmit(s_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+		TESTBED_ASSERT(result == VK_SUCCESS, "Failed to submit frame!");
+		frame.TimelineValue = timelineValue;
+
+		if (!s_Headless)
+		{
+			VkPresentInfoKHR presentInfo = {};
+			presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+			presentInfo.waitSemaphoreCount = 1;
+			presentInfo.pWaitSemaphores = &s_RenderFinished[s_ImageIndex];
+			presentInfo.swapchainCount = 1;
+			presentInfo.pSwapchains = &s_Swapchain;
+			presentInfo.pImageIndices = &s_ImageIndex;
+			vkQueuePresentKHR(s_PresentQueue, &presentInfo);
+		}
+
+		s_FrameIndex = (s_FrameIndex + 1) % s_Settings.FramesInFlight;
+		++s_FrameCount;
+		s_FrameStats.Frames = s_FrameCount;
+		HostAllocator::EndFrame();
+	}
+
+	void VulkanContext::WaitIdle()
+	{
+		if (s_LogicalDevice)
+			vkDeviceWaitIdle(s_LogicalDevice);
+	}
+
+	bool VulkanContext::IsHeadless()
+	{
+		return s_Headless;
+	}
+
+	bool VulkanContext::IsDescriptorIndexingEnabled()
+	{
+		return s_DescriptorIndexing;
+	}
+
+	bool VulkanContext::IsDynamicDescriptorIndexingEnabled()
+	{
+		return s_DynamicDescriptorIndexing;
+	}
+
+	bool VulkanContext::IsFormatSupported(VkFormat format, VkFormatFeatureFlags features)
+	{
+		if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK && !s_TextureCompressionBC)
+			return false;
+
+		VkFormatProperties formatProps;
+		vkGetPhysicalDeviceFormatProperties(s_PhysicalDevice, format, &formatProps);
+		return (formatProps.optimalTilingFeatures & features) == features;
+	}
+
+	VkDevice VulkanContext::GetDevice()
+	{
+		return s_LogicalDevice;
+	}
+
+	VkPhysicalDevice VulkanContext::GetPhysicalDevice()
+	{
+		return s_PhysicalDevice;
+	}
+
+	uint32_t VulkanContext::GetGraphicsQueueFamily()
+	{
+		return s_QueueFamilyIndices.GraphicsFamily.value();
+	}
+
+	VkQueue VulkanContext::GetGraphicsQueue()
+	{
+		return s_GraphicsQueue;
+	}
+
+	float VulkanContext::GetTimestampPeriod()
+	{
+		return s_TimestampPeriod;
+	}
+
+	uint32_t VulkanContext::GetTimestampValidBits()
+	{
+		return s_TimestampValidBits;
+	}
+
+	uint32_t VulkanContext::GetTransferQueueFamily()
+	{
+		return s_QueueFamilyIndices.TransferFamily.value_or(s_QueueFamilyIndices.GraphicsFamily.value());
+	}
+
+	VkQueue VulkanContext::GetTransferQueue()
+	{
+		return s_TransferQueue;
+	}
+
+	bool VulkanContext::HasDedicatedTransferQueue()
+	{
+		return s_QueueFamilyIndices.TransferFamily.has_value();
+	}
+
+	void VulkanContext::AddFrameWait(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stages)
+	{
+		s_FrameWaits.push_back({ semaphore, value, stages });
+	}
+
+	const DeviceIdentity& VulkanContext::GetDeviceIdentity()
+	{
+		return s_DeviceIdentity;
+	}
+
+	DeviceAllocator& VulkanContext::GetAllocator()
+	{
+		return *s_Allocator;
+	}
+
+	VkCommandBuffer VulkanContext::GetCommandBuffer()
+	{
+		return s_Frames[s_FrameIndex].CommandBuffer;
+	}
+
+	uint32_t VulkanContext::GetFrameIndex()
+	{
+		return s_FrameIndex;
+	}
+
+	uint32_t VulkanContext::GetFramesInFlight()
+	{
+		return s_Settings.FramesInFlight;
+	}
+
+	VkDescriptorPool VulkanContext::GetFrameDescriptorPool()
+	{
+		return s_Frames[s_FrameIndex].DescriptorPool;
+	}
+
+	FrameUpload VulkanContext::AllocateFrameUpload(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		FrameData& frame = s_Frames[s_FrameIndex];
+		const VkDeviceSize offset = (frame.UploadOffset + alignment - 1) / alignment * alignment;
+		if (offset + size > s_Settings.UploadBufferSize)
+			return {};
+
+		frame.UploadOffset = offset + size;
+		return { frame.UploadBuffer, offset, (uint8_t*)frame.UploadMemory.MappedData + offset };
+	}
+
+	VkImage VulkanContext::GetBackbuffer()
+	{
+		return s_Images[s_ImageIndex];
+	}
+
+	VkFormat VulkanContext::GetBackbufferFormat()
+	{
+		return s_ColorFormat;
+	}
+
+	bool VulkanContext::IsBackbufferReadable()
+	{
+		return s_BackbufferReadable;
+	}
+
+	VkExtent2D VulkanContext::GetExtent()
+	{
+		return s_Extent;
+	}
+
+	void VulkanContext::CmdPipelineBarrier2(VkCommandBuffer commandBuffer, const VkDependencyInfo& dependencyInfo)
+	{
+		if (s_CmdPipelineBarrier2)
+		{
+			s_CmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+			return;
+		}
+
+		// The lower 32 bits of the synchronization2 stage and access flags are the original ones. The stages of all
+		// barriers end up in the one call, which is coarser but never wrong.
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		std::vector<VkMemoryBarrier> memoryBarriers(dependencyInfo.memoryBarrierCount);
+		for (uint32_t i = 0; i < dependencyInfo.memoryBarrierCount; ++i)
+		{
+			const VkMemoryBarrier2& barrier = dependencyInfo.pMemoryBarriers[i];
+			srcStages |= (VkPipelineStageFlags)barrier.srcStageMask;
+			dstStages |= (VkPipelineStageFlags)barrier.dstStageMask;
+			memoryBarriers[i] = { VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, (VkAccessFlags)barrier.srcAccessMask, (VkAccessFlags)barrier.dstAccessMask };
+		}
+
+		std::vector<VkBufferMemoryBarrier> bufferBarriers(dependencyInfo.bufferMemoryBarrierCount);
+		for (uint32_t i = 0; i < dependencyInfo.bufferMemoryBarrierCount; ++i)
+		{
+			const VkBufferMemoryBarrier2& barrier = dependencyInfo.pBufferMemoryBarriers[i];
+			srcStages |= (VkPipelineStageFlags)barrier.srcStageMask;
+			dstStages |= (VkPipelineStageFlags)barrier.dstStageMask;
+			bufferBarriers[i] = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, nullptr, (VkAccessFlags)barrier.srcAccessMask, (VkAccessFlags)barrier.dstAccessMask,
+				barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex, barrier.buffer, barrier.offset, barrier.size };
+		}
+
+		std::vector<VkImageMemoryBarrier> imageBarriers(dependencyInfo.imageMemoryBarrierCount);
+		for (uint32_t i = 0; i < dependencyInfo.imageMemoryBarrierCount; ++i)
+		{
+			const VkImageMemoryBarrier2& barrier = dependencyInfo.pImageMemoryBarriers[i];
+			srcStages |= (VkPipelineStageFlags)barrier.srcStageMask;
+			dstStages |= (VkPipelineStageFlags)barrier.dstStageMask;
+			imageBarriers[i] = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, (VkAccessFlags)barrier.srcAccessMask, (VkAccessFlags)barrier.dstAccessMask,
+				barrier.oldLayout, barrier.newLayout, barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex, barrier.image, barrier.subresourceRange };
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, srcStages ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			dependencyInfo.dependencyFlags, (uint32_t)memoryBarriers.size(), memoryBarriers.data(), (uint32_t)bufferBarriers.size(), bufferBarriers.data(),
+			(uint32_t)imageBarriers.size(), imageBarriers.data());
+	}
+
+	VkSemaphore VulkanContext::GetTimelineSemaphore()
+	{
+		return s_TimelineSemaphore;
+	}
+
+	uint64_t VulkanContext::GetFrameTimelineValue()
+	{
+		return s_FrameCount + 1;
+	}
+
+	uint64_t VulkanContext::GetCompletedTimelineValue()
+	{
+		uint64_t value = 0;
+		vkGetSemaphoreCounterValue(s_LogicalDevice, s_TimelineSemaphore, &value);
+		return value;
+	}
+
+	FrameStatistics VulkanContext::GetFrameStatistics()
+	{
+		return s_FrameStats;
 	}
 }
@@ -1,11 +1,130 @@
 #pragma once
 
+#include <vulkan/vulkan.h>
+
 namespace VulkanTestbed
 {
+	class DeviceAllocator;
+
+	// What the driver's compiled pipeline data depends on, anything persisted from it has to match all of these
+	struct DeviceIdentity
+	{
+		uint32_t VendorID = 0;
+		uint32_t DeviceID = 0;
+		uint32_t DriverVersion = 0;
+		uint8_t PipelineCacheUUID[VK_UUID_SIZE] = {};
+		uint8_t DeviceUUID[VK_UUID_SIZE] = {};
+		uint8_t DriverUUID[VK_UUID_SIZE] = {};
+	};
+
+	struct VulkanContextSettings
+	{
+		// Frames the CPU may record ahead of the GPU, at most VulkanContext::MaxFramesInFlight
+		uint32_t FramesInFlight = 2;
+		// Per frame ring of host visible memory for data the GPU reads only during that frame
+		VkDeviceSize UploadBufferSize = 8ull << 20;
+		// Per frame descriptor pool, reset wholesale when the frame slot comes around again
+		uint32_t DescriptorSetsPerFrame = 256;
+		// Uploads go through a transfer-only queue family when the device has one
+		bool DedicatedTransferQueue = true;
+		// Enables the descriptor indexing features bindless descriptors need, as far as the device supports them
+		bool DescriptorIndexing = false;
+	};
+
+	struct FrameStatistics
+	{
+		uint64_t Frames = 0;
+		// Frames whose BeginFrame found the GPU still busy with the slot's previous submission
+		uint64_t StalledFrames = 0;
+		// Time BeginFrame blocked on the timeline semaphore, the CPU running ahead of the GPU
+		double CpuWaitSeconds = 0.0;
+		double MaxCpuWaitSeconds = 0.0;
+		// Time blocked in vkAcquireNextImageKHR, the presentation engine holding all images
+		double AcquireWaitSeconds = 0.0;
+	};
+
+	// Valid until the frame slot is reused, Data is null when the ring is exhausted
+	struct FrameUpload
+	{
+		VkBuffer Buffer = nullptr;
+		VkDeviceSize Offset = 0;
+		void* Data = nullptr;
+	};
+
 	class VulkanContext
 	{
 	public:
-		static void Init(void* glfwWindow);
+		static void Init(void* glfwWindow, const VulkanContextSettings& settings = {});
+		// Renders into offscreen images instead of a swapchain, no window or surface is required
+		static void InitHeadless(uint32_t width, uint32_t height, const VulkanContextSettings& settings = {});
 		static void Shutdown();
+
+		// Only blocks when the GPU hasn't finished the frame that last used this slot, FramesInFlight frames ago
+		static void BeginFrame();
+		// Submits without waiting, the frame's completion is signalled on the timeline semaphore
+		static void EndFrame();
+		static void WaitIdle();
+
+		static bool IsHeadless();
+
+		static VkDevice GetDevice();
+		static VkPhysicalDevice GetPhysicalDevice();
+		static uint32_t GetGraphicsQueueFamily();
+		// Frames are submitted to it from the main thread, one-shot submits have to come from there too
+		static VkQueue GetGraphicsQueue();
+		// Equal to the graphics family and queue when there is no dedicated transfer queue
+		static uint32_t GetTransferQueueFamily();
+		static VkQueue GetTransferQueue();
+		static bool HasDedicatedTransferQueue();
+		static const DeviceIdentity& GetDeviceIdentity();
+		// Nanoseconds per GPU timestamp tick
+		static float GetTimestampPeriod();
+		// Significant bits of graphics queue timestamps, 0 when the queue doesn't support them
+		static uint32_t GetTimestampValidBits();
+		// Device memory for every resource goes through it, created right after the device
+		static DeviceAllocator& GetAllocator();
+		// Primary command buffer of the frame being recorded, only valid between BeginFrame and EndFrame
+		static VkCommandBuffer GetCommandBuffer();
+		// In [0, GetFramesInFlight()), the resources of this slot were last used GetFramesInFlight() frames ago
+		// and are free to reuse once BeginFrame returns
+		static uint32_t GetFrameIndex();
+		static uint32_t GetFramesInFlight();
+
+		// Reset at BeginFrame, sets allocated from it must not outlive the frame
+		static VkDescriptorPool GetFrameDescriptorPool();
+		static FrameUpload AllocateFrameUpload(VkDeviceSize size, VkDeviceSize alignment);
+
+		// Frame N signals value N + 1 once the GPU has finished it
+		static VkSemaphore GetTimelineSemaphore();
+		// Value the frame being recorded will signal
+		static uint64_t GetFrameTimelineValue();
+		static uint64_t GetCompletedTimelineValue();
+
+		static FrameStatistics GetFrameStatistics();
+
+		// The frame being recorded waits on the semaphore at stages before any of its commands there run,
+		// value is ignored for binary semaphores
+		static void AddFrameWait(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stages);
+
+		// Image the current frame renders into. It starts out undefined and has to be left in PRESENT_SRC, or
+		// TRANSFER_SRC when headless, by the end of the frame.
+		static VkImage GetBackbuffer();
+		static VkFormat GetBackbufferFormat();
+		static VkExtent2D GetExtent();
+		// Backbuffers were created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT, some surfaces don't allow it
+		static bool IsBackbufferReadable();
+
+		// vkCmdPipelineBarrier2 where VK_KHR_synchronization2 is supported, translated to vkCmdPipelineBarrier elsewhere
+		static void CmdPipelineBarrier2(VkCommandBuffer commandBuffer, const VkDependencyInfo& dependencyInfo);
+
+		// Non-uniform indexing, partially bound and update-after-bind descriptor arrays
+		static bool IsDescriptorIndexingEnabled();
+		// Descriptor arrays indexed with dynamically uniform values, a core feature most devices have
+		static bool IsDynamicDescriptorIndexingEnabled();
+
+		// For optimal tiling, block compressed formats also require the device feature, which is enabled when available
+		static bool IsFormatSupported(VkFormat format, VkFormatFeatureFlags features);
+
+		static constexpr uint32_t MaxFramesInFlight = 4;
 	};
 }
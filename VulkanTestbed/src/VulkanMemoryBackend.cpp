@@ -0,0 +1,110 @@
+#include "pch.h"
+#include "DeviceAllocator.h"
+
+#include "HostAllocator.h"
+#include "VulkanContext.h"
+
+namespace VulkanTestbed
+{
+	// Everything in the allocator that calls into Vulkan lives here, the rest of it builds and runs without a device
+	class VulkanMemoryBackend : public DeviceMemoryBackend
+	{
+	public:
+		VulkanMemoryBackend(VkPhysicalDevice physicalDevice, VkDevice device)
+			: m_Device(device)
+		{
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+
+			VkPhysicalDeviceProperties deviceProps;
+			vkGetPhysicalDeviceProperties(physicalDevice, &deviceProps);
+			m_BufferImageGranularity = deviceProps.limits.bufferImageGranularity;
+		}
+
+		const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const override { return m_MemoryProperties; }
+		VkDeviceSize GetBufferImageGranularity() const override { return m_BufferImageGranularity; }
+
+		VkDeviceMemory Allocate(uint32_t memoryType, VkDeviceSize size, VkImage dedicatedImage, VkBuffer dedicatedBuffer) override
+		{
+			VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+			dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+			dedicatedInfo.image = dedicatedImage;
+			dedicatedInfo.buffer = dedicatedBuffer;
+
+			VkMemoryAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.pNext = dedicatedImage || dedicatedBuffer ? &dedicatedInfo : nullptr;
+			allocInfo.allocationSize = size;
+			allocInfo.memoryTypeIndex = memoryType;
+
+			VkDeviceMemory memory = nullptr;
+			if (vkAllocateMemory(m_Device, &allocInfo, HostAllocator::GetCallbacks(HostSubsystem::DeviceMemory), &memory) != VK_SUCCESS)
+				return nullptr;
+			return memory;
+		}
+
+		void Free(VkDeviceMemory memory) override
+		{
+			vkFreeMemory(m_Device, memory, HostAllocator::GetCallbacks(HostSubsystem::DeviceMemory));
+		}
+
+		void* Map(VkDeviceMemory memory) override
+		{
+			void* data = nullptr;
+			VkResult result = vkMapMemory(m_Device, memory, 0, VK_WHOLE_SIZE, 0, &data);
+			TESTBED_ASSERT(result == VK_SUCCESS, "Failed to map device memory!");
+			return data;
+		}
+
+	private:
+		VkDevice m_Device;
+		VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+		VkDeviceSize m_BufferImageGranularity;
+	};
+
+	std::unique_ptr<DeviceMemoryBackend> CreateVulkanMemoryBackend(VkPhysicalDevice physicalDevice, VkDevice device)
+	{
+		return std::make_unique<VulkanMemoryBackend>(physicalDevice, device);
+	}
+
+	DeviceAllocation DeviceAllocator::AllocateImage(VkImage image, VkMemoryPropertyFlags properties)
+	{
+		VkDevice device = VulkanContext::GetDevice();
+
+		VkMemoryDedicatedRequirements dedicatedRequirements = {};
+		dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+		VkMemoryRequirements2 requirements = {};
+		requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		requirements.pNext = &dedicatedRequirements;
+		VkImageMemoryRequirementsInfo2 requirementsInfo = {};
+		requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+		requirementsInfo.image = image;
+		vkGetImageMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+		const bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+		DeviceAllocation allocation = AllocateInternal(requirements.memoryRequirements, properties, DeviceResourceKind::Optimal, dedicated, image, nullptr);
+		if (allocation.Memory)
+			vkBindImageMemory(device, image, allocation.Memory, allocation.Offset);
+		return allocation;
+	}
+
+	DeviceAllocation DeviceAllocator::AllocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties)
+	{
+		VkDevice device = VulkanContext::GetDevice();
+
+		VkMemoryDedicatedRequirements dedicatedRequirements = {};
+		dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+		VkMemoryRequirements2 requirements = {};
+		requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		requirements.pNext = &dedicatedRequirements;
+		VkBufferMemoryRequirementsInfo2 requirementsInfo = {};
+		requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+		requirementsInfo.buffer = buffer;
+		vkGetBufferMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+		const bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+		DeviceAllocation allocation = AllocateInternal(requirements.memoryRequirements, properties, DeviceResourceKind::Linear, dedicated, nullptr, buffer);
+		if (allocation.Memory)
+			vkBindBufferMemory(device, buffer, allocation.Memory, allocation.Offset);
+		return allocation;
+	}
+}
@@ -18,6 +18,7 @@
 #include <vector>
 #include <unordered_map>
 #include <map>
+#include <filesystem>
 
 #include "Core/Log.h"
 #include "Core/Assert.h"
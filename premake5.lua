@@ -14,6 +14,12 @@ workspace "VulkanTestbed"
 		"MultiProcessorCompile"
 	}
 
+newoption
+{
+	trigger = "avx2",
+	description = "Compile for CPUs with AVX2, enables the 8 wide SIMD paths"
+}
+
 outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}";
 
 -- Include directories relavtive to root folder (solution directory)